@@ -13,6 +13,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,7 +28,8 @@ typedef enum {
     ISON_ERROR_MEMORY = -1,
     ISON_ERROR_PARSE = -2,
     ISON_ERROR_IO = -3,
-    ISON_ERROR_INVALID = -4
+    ISON_ERROR_INVALID = -4,
+    ISON_ERROR_OVERFLOW = -5
 } ison_error_t;
 
 /* Value types */
@@ -37,7 +39,8 @@ typedef enum {
     ISON_TYPE_INT,
     ISON_TYPE_FLOAT,
     ISON_TYPE_STRING,
-    ISON_TYPE_REFERENCE
+    ISON_TYPE_REFERENCE,
+    ISON_TYPE_UNKNOWN       /* lazily parsed cell, decoded on first access */
 } ison_type_t;
 
 /* Reference structure */
@@ -56,6 +59,10 @@ typedef struct {
         double float_val;
         char *string_val;
         ison_reference_t ref_val;
+        struct {
+            char *text;         /* unescaped token, stored with its row entry */
+            char *type_hint;
+        } raw_val;
     } data;
 } ison_value_t;
 
@@ -76,6 +83,7 @@ typedef struct {
     ison_row_entry_t *head;
     ison_row_entry_t *tail;
     size_t count;
+    size_t arena_count;  /* leading entries stored in the document's arena (lazy parsing) */
 } ison_row_t;
 
 /* Block - table, object, or meta */
@@ -98,6 +106,7 @@ typedef struct {
     size_t block_capacity;
     char **order;
     size_t order_count;
+    void *arena;         /* row entries of a lazy parse; its rows must not outlive the document */
 } ison_document_t;
 
 /* Serialization options */
@@ -106,6 +115,30 @@ typedef struct {
     char *delimiter;   /* default: " " */
 } ison_dumps_options_t;
 
+/* CSV/TSV options */
+typedef struct {
+    char delimiter;    /* default: ',' */
+    bool header;       /* first record names the fields */
+    bool type_row;     /* a record of type hints follows the header */
+} ison_csv_options_t;
+
+/* JSON import options */
+typedef struct {
+    bool summaries;    /* a top-level "<name>_summary" object is block <name>'s summary row, as ison_to_json writes it */
+} ison_json_options_t;
+
+/* Binary (ISONB) options */
+typedef struct {
+    bool compress;     /* encode each column chunk (FOR/delta packing, LZ) when that makes it smaller */
+} ison_binary_options_t;
+
+/* Per-file timing from ison_load_many */
+typedef struct {
+    double read_seconds;
+    double parse_seconds;
+    size_t bytes;
+} ison_load_timing_t;
+
 /* FromDict options */
 typedef struct {
     bool auto_refs;
@@ -124,6 +157,75 @@ typedef struct {
 /* Callback for ISONL streaming */
 typedef void (*isonl_callback_t)(const isonl_record_t *record, void *userdata);
 
+/* Default rows between checkpoints of an ISONL index */
+#define ISONL_INDEX_STRIDE 1024
+
+/* Sidecar row index over an ISONL file, opened with isonl_open_indexed */
+typedef struct isonl_index isonl_index_t;
+
+/* ISONL follow options */
+typedef struct {
+    unsigned poll_interval_ms;  /* longest wait between checks of the file (the only wakeup without inotify) */
+    unsigned idle_timeout_ms;   /* return after this long without new data; 0 = follow until stopped */
+    bool from_end;              /* skip the records already in the file */
+    volatile int *stop;         /* return once this is set non-zero, e.g. from the callback */
+} isonl_follow_options_t;
+
+/* ISONL appender options (group commit) */
+typedef struct {
+    size_t flush_bytes;          /* write a batch once this many bytes are pending */
+    unsigned flush_interval_ms;  /* also write pending records this often; 0 = only on size, flush and close */
+    bool sync;                   /* fdatasync after each batch */
+} isonl_appender_options_t;
+
+/* Appends ISONL records to a file; safe to share between threads */
+typedef struct isonl_appender isonl_appender_t;
+
+/* Parser buffers kept between ison_parse_with calls; one thread at a time */
+typedef struct ison_parse_ctx ison_parse_ctx_t;
+
+/* Output sink for a streaming writer; receives each flushed buffer */
+typedef ison_error_t (*ison_sink_t)(void *userdata, const char *data, size_t len);
+
+/* Buffer size that fits any ison_format_int / ison_format_double output */
+#define ISON_NUMBER_BUFFER_SIZE 32
+
+/* Default buffer size for sink-backed writers */
+#define ISON_WRITER_BUFFER_SIZE 65536
+
+/* Buffered writer - grows in memory, or flushes to a sink through a fixed buffer */
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    ison_sink_t sink;      /* NULL: in-memory, buf grows as needed */
+    void *userdata;
+    size_t total;          /* bytes written so far */
+    ison_error_t error;    /* first error seen; later writes are dropped */
+    bool fixed;            /* caller-owned buf, never grown; output past cap is only counted */
+} ison_writer_t;
+
+/* Input source for a streaming reader; sets *out_len to 0 at end of input */
+typedef ison_error_t (*ison_source_t)(void *userdata, char *buf, size_t cap, size_t *out_len);
+
+/* Default buffer size for source-backed readers */
+#define ISON_READER_BUFFER_SIZE 65536
+
+/* Line reader - over a memory range, or over a source through a buffer that only grows to the longest line */
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    size_t pos;            /* start of the next unread line in buf */
+    const char *data;      /* memory input (no buffer, lines point into it) */
+    size_t data_len;
+    ison_source_t source;
+    void *userdata;
+    size_t line_no;        /* lines returned so far */
+    bool eof;
+    ison_error_t error;
+} ison_reader_t;
+
 /* ==================== Value Constructors ==================== */
 
 ison_value_t ison_null(void);
@@ -145,8 +247,13 @@ bool ison_value_as_ref(const ison_value_t *value, ison_reference_t *out);
 
 /* ==================== Value Operations ==================== */
 
+ison_value_t ison_value_copy(const ison_value_t *value);
 char *ison_value_to_ison(const ison_value_t *value);
 char *ison_value_to_json(const ison_value_t *value);
+size_t ison_value_write_ison(const ison_value_t *value, char *buf, size_t cap);
+size_t ison_value_write_json(const ison_value_t *value, char *buf, size_t cap);
+void ison_value_append(ison_writer_t *w, const ison_value_t *value);
+void ison_value_append_json(ison_writer_t *w, const ison_value_t *value);
 void ison_value_free(ison_value_t *value);
 
 /* ==================== Reference Operations ==================== */
@@ -160,6 +267,7 @@ void ison_reference_free(ison_reference_t *ref);
 /* ==================== Row Operations ==================== */
 
 ison_row_t *ison_row_create(void);
+/* The row takes ownership of *value's strings and reference parts */
 void ison_row_set(ison_row_t *row, const char *key, const ison_value_t *value);
 bool ison_row_get(const ison_row_t *row, const char *key, ison_value_t *out);
 ison_value_t *ison_row_get_ptr(const ison_row_t *row, const char *key);
@@ -169,7 +277,16 @@ void ison_row_free(ison_row_t *row);
 
 ison_block_t *ison_block_create(const char *kind, const char *name);
 void ison_block_add_field(ison_block_t *block, const char *name, const char *type_hint);
+/*
+ * ison_block_add_row and ison_block_set_summary deep-copy row: the block gets
+ * its own strings and references, and the caller still owns and frees row.
+ * (Earlier versions copied the values shallowly, so the block shared the
+ * caller's strings; code that leaked row to keep them alive now just leaks.)
+ * ison_block_take_row appends row itself; the block frees it, and frees it
+ * right away if it cannot grow.
+ */
 void ison_block_add_row(ison_block_t *block, const ison_row_t *row);
+void ison_block_take_row(ison_block_t *block, ison_row_t *row);
 void ison_block_set_summary(ison_block_t *block, const ison_row_t *row);
 char **ison_block_get_field_names(const ison_block_t *block, size_t *count);
 void ison_block_free(ison_block_t *block);
@@ -181,17 +298,72 @@ void ison_document_add_block(ison_document_t *doc, ison_block_t *block);
 ison_block_t *ison_document_get(const ison_document_t *doc, const char *name);
 const char **ison_document_get_order(const ison_document_t *doc, size_t *count);
 void ison_document_free(ison_document_t *doc);
+/* Decodes every lazily parsed cell, e.g. before sharing the document between threads */
+void ison_document_materialize(ison_document_t *doc);
 
 /* ==================== Parsing ==================== */
 
 ison_document_t *ison_parse(const char *text, ison_error_t *error);
 ison_document_t *ison_parse_isonl(const char *text, ison_error_t *error);
+/* The same over len bytes that need not be NUL-terminated */
+ison_document_t *ison_parse_n(const char *text, size_t len, ison_error_t *error);
+ison_document_t *ison_parse_isonl_n(const char *text, size_t len, ison_error_t *error);
+
+ison_parse_ctx_t *ison_parse_ctx_create(void);
+void ison_parse_ctx_free(ison_parse_ctx_t *ctx);
+/* Releases the buffers the context has grown, e.g. after an unusually large input */
+void ison_parse_ctx_reset(ison_parse_ctx_t *ctx);
+/*
+ * In lazy mode cells keep their token and are decoded when ison_row_get, ison_row_get_ptr,
+ * an ison_value_* function or a serializer first reads them. Reading a cell updates it,
+ * so a lazy document must not be read from several threads at once until it is materialized.
+ * Its row entries are carved from an arena the document owns, so its blocks and rows
+ * must not outlive it; copy rows out with ison_block_add_row.
+ */
+void ison_parse_ctx_set_lazy(ison_parse_ctx_t *ctx, bool lazy);
+/* ison_parse over len bytes of text, reusing the context's buffers; the document does not borrow from ctx */
+ison_document_t *ison_parse_with(ison_parse_ctx_t *ctx, const char *text, size_t len, ison_error_t *error);
 
 /* ==================== Serialization ==================== */
 
 char *ison_dumps(const ison_document_t *doc);
 char *ison_dumps_with_options(const ison_document_t *doc, const ison_dumps_options_t *options);
 char *ison_dumps_isonl(const ison_document_t *doc);
+char *ison_dumps_exact(const ison_document_t *doc);
+/*
+ * Renders into buf the way snprintf does: *needed is the text length without the
+ * terminating NUL, so cap must be at least *needed + 1. With a smaller cap buf holds a
+ * NUL-terminated prefix and ISON_ERROR_OVERFLOW is returned; pass NULL and 0 to measure.
+ */
+ison_error_t ison_dumps_into(const ison_document_t *doc, char *buf, size_t cap, size_t *needed);
+char *ison_dumps_parallel(const ison_document_t *doc, const ison_dumps_options_t *options, int nthreads);
+char *ison_dumps_isonl_parallel(const ison_document_t *doc, int nthreads);
+ison_error_t ison_dump_writer(const ison_document_t *doc, ison_writer_t *w, const ison_dumps_options_t *options);
+ison_error_t ison_dump_isonl_writer(const ison_document_t *doc, ison_writer_t *w);
+ison_error_t ison_dump_json_writer(const ison_document_t *doc, ison_writer_t *w);
+
+/* ==================== Writer ==================== */
+
+ison_error_t ison_writer_init_memory(ison_writer_t *w, size_t initial_cap);
+ison_error_t ison_writer_init_sink(ison_writer_t *w, ison_sink_t sink, void *userdata, size_t buffer_size);
+ison_error_t ison_writer_init_fd(ison_writer_t *w, int fd, size_t buffer_size);
+ison_error_t ison_writer_init_file(ison_writer_t *w, FILE *file, size_t buffer_size);
+ison_error_t ison_writer_init_buffer(ison_writer_t *w, char *buf, size_t cap);
+void ison_writer_write(ison_writer_t *w, const char *data, size_t len);
+void ison_writer_puts(ison_writer_t *w, const char *str);
+void ison_writer_putc(ison_writer_t *w, char ch);
+ison_error_t ison_writer_flush(ison_writer_t *w);
+char *ison_writer_finish(ison_writer_t *w, size_t *out_len);
+void ison_writer_free(ison_writer_t *w);
+
+/* ==================== Reader ==================== */
+
+ison_error_t ison_reader_init_memory(ison_reader_t *r, const char *data, size_t len);
+ison_error_t ison_reader_init_source(ison_reader_t *r, ison_source_t source, void *userdata, size_t buffer_size);
+ison_error_t ison_reader_init_fd(ison_reader_t *r, int fd, size_t buffer_size);
+ison_error_t ison_reader_init_file(ison_reader_t *r, FILE *file, size_t buffer_size);
+bool ison_reader_next_line(ison_reader_t *r, const char **line, size_t *len);
+void ison_reader_free(ison_reader_t *r);
 
 /* ==================== File I/O ==================== */
 
@@ -199,27 +371,193 @@ ison_document_t *ison_load(const char *path, ison_error_t *error);
 ison_error_t ison_dump(const ison_document_t *doc, const char *path);
 ison_document_t *ison_load_isonl(const char *path, ison_error_t *error);
 ison_error_t ison_dump_isonl(const ison_document_t *doc, const char *path);
+ison_error_t ison_dump_fd(const ison_document_t *doc, int fd, const ison_dumps_options_t *options);
+ison_error_t ison_dump_isonl_fd(const ison_document_t *doc, int fd);
+/*
+ * Loads count files on up to nthreads threads (<= 0: one per CPU), largest first.
+ * Files ending in .isonl or .isonb are read as such, others as ISON. docs_out[i] is
+ * NULL where errs_out[i] is an error; errs_out and timings may be NULL. Returns the
+ * error of the first failed path, or ISON_OK.
+ */
+ison_error_t ison_load_many(const char *const *paths, size_t count, int nthreads, ison_document_t **docs_out,
+                            ison_error_t *errs_out, ison_load_timing_t *timings);
 
 /* ==================== Format Conversion ==================== */
 
 char *ison_to_isonl(const char *ison_text, ison_error_t *error);
 char *isonl_to_ison(const char *isonl_text, ison_error_t *error);
 char *ison_to_json(const char *ison_text, ison_error_t *error);
+/*
+ * Objects and arrays may nest 1024 deep; deeper input fails with ISON_ERROR_PARSE.
+ * The structural index keeps 32-bit offsets, so input (or, for NDJSON, one line)
+ * must be under 4 GiB; larger input fails with ISON_ERROR_OVERFLOW.
+ */
 ison_document_t *ison_from_json(const char *json_text, ison_error_t *error);
+char *ison_to_json_n(const char *ison_text, size_t len, ison_error_t *error);
+ison_document_t *ison_from_json_n(const char *json_text, size_t len, ison_error_t *error);
+/*
+ * ison_from_json_n with options. By default every top-level member is its own block; set
+ * summaries to read back the summary rows of ison_to_json output. That mapping is opt-in
+ * because a real "<name>_summary" member beside "<name>" would otherwise change meaning.
+ */
+ison_document_t *ison_from_json_with_options(const char *json_text, size_t len, const ison_json_options_t *options,
+                                             ison_error_t *error);
+ison_error_t ison_to_json_stream(ison_reader_t *in, ison_writer_t *out);
+ison_error_t ison_to_isonl_stream(ison_reader_t *in, ison_writer_t *out);
+ison_error_t isonl_to_ison_stream(ison_reader_t *in, ison_writer_t *out);
+char *ndjson_to_isonl(const char *ndjson_text, const char *name, ison_error_t *error);
+ison_error_t ndjson_to_isonl_stream(ison_reader_t *in, ison_writer_t *out, const char *name);
+
+/* ==================== CSV ==================== */
+
+ison_block_t *ison_block_from_csv(ison_reader_t *in, const char *name, const ison_csv_options_t *options,
+                                  ison_error_t *error);
+ison_error_t ison_block_to_csv(const ison_block_t *block, ison_writer_t *out, const ison_csv_options_t *options);
+
+/* ==================== Arrow ==================== */
+
+/* Arrow C Data Interface ABI (https://arrow.apache.org/docs/format/CDataInterface.html) */
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+    void (*release)(struct ArrowSchema *);
+    void *private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+    void (*release)(struct ArrowArray *);
+    void *private_data;
+};
+
+#endif /* ARROW_C_DATA_INTERFACE */
+
+/* Block as a struct array; the caller releases both structs through their release callbacks */
+ison_error_t ison_block_export_arrow(const ison_block_t *block, struct ArrowArray *out_array,
+                                     struct ArrowSchema *out_schema);
+/* Block from a struct array; consumes (releases) both structs, also on failure */
+ison_block_t *ison_block_import_arrow(struct ArrowArray *array, struct ArrowSchema *schema, ison_error_t *error);
+
+/* ==================== Binary (ISONB) ==================== */
+
+/* Read-only view of an ISONB (binary ISON) file or buffer */
+typedef struct ison_binary ison_binary_t;
+
+/* A block of an ISONB view; strings point into the mapping and live until ison_binary_close */
+typedef struct {
+    const char *kind;
+    const char *name;
+    ison_field_info_t *fields;
+    size_t field_count;
+    size_t row_count;
+    bool has_summary;      /* the summary row is row index row_count */
+    const struct ison_binary_column *columns;
+} ison_binary_block_t;
+
+ison_error_t ison_dump_binary(const ison_document_t *doc, const char *path);
+ison_error_t ison_dump_binary_with_options(const ison_document_t *doc, const char *path,
+                                           const ison_binary_options_t *options);
+ison_error_t ison_dump_binary_writer(const ison_document_t *doc, ison_writer_t *w,
+                                     const ison_binary_options_t *options);
+ison_document_t *ison_load_binary(const char *path, ison_error_t *error);
+ison_binary_t *ison_binary_open(const char *path, ison_error_t *error);
+ison_binary_t *ison_binary_from_memory(const void *data, size_t len, ison_error_t *error);
+void ison_binary_close(ison_binary_t *bin);
+size_t ison_binary_block_count(const ison_binary_t *bin);
+const ison_binary_block_t *ison_binary_block(const ison_binary_t *bin, size_t index);
+const ison_binary_block_t *ison_binary_find(const ison_binary_t *bin, const char *name);
+/* Borrowed value of one cell; false when the cell is absent. Strings point into the view.
+   Compressed chunks are decoded on first access and kept until close. */
+bool ison_binary_get(const ison_binary_t *bin, const ison_binary_block_t *block, size_t row, size_t field,
+                     ison_value_t *out);
+ison_document_t *ison_binary_to_document(const ison_binary_t *bin, ison_error_t *error);
+ison_error_t ison_binary_dump_writer(const ison_binary_t *bin, ison_writer_t *w);
+ison_error_t ison_to_isonb(const char *ison_path, const char *isonb_path, const ison_binary_options_t *options);
+ison_error_t isonb_to_ison(const char *isonb_path, const char *ison_path);
 
 /* ==================== Streaming ==================== */
 
 ison_error_t isonl_stream_file(const char *path, isonl_callback_t callback, void *userdata);
 ison_error_t isonl_stream_buffer(const char *buffer, size_t len, isonl_callback_t callback, void *userdata);
+ison_error_t ison_from_ndjson_stream(int fd, const char *name, isonl_callback_t callback, void *userdata);
+/* Streams the records in the file, then those appended to it, across rotation (a new file at the path)
+   and truncation. A trailing line is held back until its line break arrives. */
+ison_error_t isonl_follow(const char *path, isonl_callback_t callback, void *userdata,
+                          const isonl_follow_options_t *options);
+
+/* ==================== Index ==================== */
+
+/* Records the offset of every stride-th row (0: ISONL_INDEX_STRIDE) and the row count of each block */
+ison_error_t isonl_build_index(const char *path, const char *index_path, size_t stride);
+isonl_index_t *isonl_open_indexed(const char *path, const char *index_path, ison_error_t *error);
+void isonl_index_close(isonl_index_t *ix);
+uint64_t isonl_index_rows(const isonl_index_t *ix);
+uint64_t isonl_index_block_rows(const isonl_index_t *ix, const char *name);
+/* Byte offset of a row; rows appended after indexing are found by scanning on from the last checkpoint.
+   ISON_ERROR_INVALID past the last row. Safe to call from several threads. */
+ison_error_t isonl_seek_row(const isonl_index_t *ix, uint64_t row, uint64_t *offset);
+/* Rows [start, start + count) as a document; fewer near the end of the file */
+ison_document_t *isonl_read_range(const isonl_index_t *ix, uint64_t start, uint64_t count, ison_error_t *error);
+
+/* ==================== Sorting ==================== */
+
+/*
+ * Sorts the rows of one block (every row when block is NULL) by the named key columns,
+ * using temporary files next to out_path when the rows do not fit in mem_budget bytes
+ * (0: 64 MiB). Rows of other blocks come first, in input order; ties keep input order.
+ * Keys compare null < bool < number < string < reference. in_path may equal out_path.
+ */
+ison_error_t isonl_sort_file(const char *in_path, const char *out_path, const char *block,
+                             const char **key_columns, size_t key_count, size_t mem_budget);
+/* Merges files already sorted that way into one */
+ison_error_t isonl_merge_sorted(const char **in_paths, size_t count, const char *out_path, const char *block,
+                                const char **key_columns, size_t key_count);
+
+/* ==================== Appender ==================== */
+
+isonl_appender_t *isonl_appender_open(const char *path, const isonl_appender_options_t *options,
+                                      ison_error_t *error);
+/* Queues one line; record fields are written as given, so "id:int" keeps its hint */
+ison_error_t isonl_append(isonl_appender_t *app, const isonl_record_t *record);
+/* Returns once every record appended before the call is written (and synced, if enabled) */
+ison_error_t isonl_appender_flush(isonl_appender_t *app);
+ison_error_t isonl_appender_close(isonl_appender_t *app);
 
 /* ==================== Utility ==================== */
 
+size_t ison_format_int(int64_t value, char *buf);
+size_t ison_format_double(double value, char *buf);
+
 char *ison_read_file(const char *path, size_t *out_len);
 ison_error_t ison_write_file(const char *path, const char *content);
 
 /* Default options */
 ison_dumps_options_t ison_default_dumps_options(void);
 ison_fromdict_options_t ison_default_fromdict_options(void);
+ison_binary_options_t ison_default_binary_options(void);
+ison_csv_options_t ison_default_csv_options(void);
+ison_json_options_t ison_default_json_options(void);
+isonl_appender_options_t isonl_default_appender_options(void);
+isonl_follow_options_t isonl_default_follow_options(void);
 
 /* Error string */
 const char *ison_error_string(ison_error_t error);
@@ -0,0 +1,292 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "ison.h"
+
+/*
+ * Group commit: producers append encoded lines to the active buffer under
+ * the lock. Whoever finds it over flush_bytes (or the timer thread, or an
+ * explicit flush) swaps it with the spare buffer and writes the batch with
+ * the lock released, while later producers fill the new active buffer.
+ * Only one batch is in flight at a time.
+ */
+
+#define APPENDER_HEADER_CACHE 16
+#define APPENDER_LINE_BUFFER 512
+
+typedef struct {
+    char *text;             /* "kind.name|fields|" */
+    size_t len;
+} cached_header_t;
+
+struct isonl_appender {
+    int fd;
+    isonl_appender_options_t options;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t timer;
+    bool has_timer;
+    bool closing;
+    bool flushing;
+    ison_writer_t active;
+    ison_writer_t spare;
+    uint64_t appended;      /* bytes handed to isonl_append so far */
+    uint64_t durable;       /* bytes written (and synced) so far */
+    ison_error_t error;     /* first I/O error; later calls return it */
+    cached_header_t headers[APPENDER_HEADER_CACHE];
+    size_t header_count;
+};
+
+isonl_appender_options_t isonl_default_appender_options(void) {
+    isonl_appender_options_t opts;
+    opts.flush_bytes = ISON_WRITER_BUFFER_SIZE;
+    opts.flush_interval_ms = 50;
+    opts.sync = false;
+    return opts;
+}
+
+static ison_error_t write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return ISON_ERROR_IO;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return ISON_OK;
+}
+
+/* Write out the active buffer; called with the lock held and no batch in flight */
+static void flush_locked(isonl_appender_t *app) {
+    ison_writer_t batch = app->active;
+    app->active = app->spare;
+    app->spare = batch;
+    uint64_t upto = app->appended;
+    app->flushing = true;
+    pthread_mutex_unlock(&app->lock);
+
+    ison_error_t err = write_all(app->fd, batch.buf, batch.len);
+    if (err == ISON_OK && app->options.sync && fdatasync(app->fd) != 0) err = ISON_ERROR_IO;
+
+    pthread_mutex_lock(&app->lock);
+    app->spare.len = 0;
+    app->flushing = false;
+    if (err != ISON_OK && app->error == ISON_OK) app->error = err;
+    if (err == ISON_OK) app->durable = upto;
+    pthread_cond_broadcast(&app->cond);
+}
+
+static void *timer_main(void *arg) {
+    isonl_appender_t *app = arg;
+    pthread_mutex_lock(&app->lock);
+    while (!app->closing) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += app->options.flush_interval_ms / 1000;
+        deadline.tv_nsec += (long)(app->options.flush_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&app->cond, &app->lock, &deadline);
+        if (!app->closing && !app->flushing && app->active.len > 0 && app->error == ISON_OK) flush_locked(app);
+    }
+    pthread_mutex_unlock(&app->lock);
+    return NULL;
+}
+
+isonl_appender_t *isonl_appender_open(const char *path, const isonl_appender_options_t *options,
+                                      ison_error_t *error) {
+    if (error) *error = ISON_OK;
+    if (!path) {
+        if (error) *error = ISON_ERROR_INVALID;
+        return NULL;
+    }
+
+    isonl_appender_t *app = calloc(1, sizeof(isonl_appender_t));
+    if (!app) {
+        if (error) *error = ISON_ERROR_MEMORY;
+        return NULL;
+    }
+    app->options = options ? *options : isonl_default_appender_options();
+    if (app->options.flush_bytes == 0) app->options.flush_bytes = ISON_WRITER_BUFFER_SIZE;
+
+    app->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (app->fd < 0) {
+        free(app);
+        if (error) *error = ISON_ERROR_IO;
+        return NULL;
+    }
+    if (ison_writer_init_memory(&app->active, app->options.flush_bytes + APPENDER_LINE_BUFFER) != ISON_OK ||
+        ison_writer_init_memory(&app->spare, app->options.flush_bytes + APPENDER_LINE_BUFFER) != ISON_OK) {
+        ison_writer_free(&app->active);
+        close(app->fd);
+        free(app);
+        if (error) *error = ISON_ERROR_MEMORY;
+        return NULL;
+    }
+    pthread_mutex_init(&app->lock, NULL);
+    pthread_cond_init(&app->cond, NULL);
+    if (app->options.flush_interval_ms > 0) {
+        app->has_timer = pthread_create(&app->timer, NULL, timer_main, app) == 0;
+    }
+    return app;
+}
+
+static void write_header(ison_writer_t *w, const isonl_record_t *record) {
+    ison_writer_puts(w, record->kind);
+    ison_writer_putc(w, '.');
+    ison_writer_puts(w, record->name);
+    ison_writer_putc(w, '|');
+    for (size_t i = 0; i < record->field_count; i++) {
+        if (i > 0) ison_writer_putc(w, ' ');
+        ison_writer_puts(w, record->fields[i]);
+    }
+    ison_writer_putc(w, '|');
+}
+
+/* Does a cached header spell this record's kind, name and fields? Compared in place, no rendering */
+static bool header_matches(const cached_header_t *h, const isonl_record_t *record) {
+    const char *p = h->text, *end = h->text + h->len;
+    size_t n = strlen(record->kind);
+    if ((size_t)(end - p) < n + 1 || memcmp(p, record->kind, n) != 0 || p[n] != '.') return false;
+    p += n + 1;
+    n = strlen(record->name);
+    if ((size_t)(end - p) < n + 1 || memcmp(p, record->name, n) != 0 || p[n] != '|') return false;
+    p += n + 1;
+    for (size_t i = 0; i < record->field_count; i++) {
+        n = strlen(record->fields[i]);
+        char sep = i + 1 < record->field_count ? ' ' : '|';
+        if ((size_t)(end - p) < n + 1 || memcmp(p, record->fields[i], n) != 0 || p[n] != sep) return false;
+        p += n + 1;
+    }
+    if (record->field_count == 0) {
+        if (p == end || *p != '|') return false;
+        p++;
+    }
+    return p == end;
+}
+
+/* Header text for a record; most recently used first. Called with the lock held. */
+static const cached_header_t *lookup_header(isonl_appender_t *app, const isonl_record_t *record) {
+    for (size_t i = 0; i < app->header_count; i++) {
+        if (!header_matches(&app->headers[i], record)) continue;
+        cached_header_t hit = app->headers[i];
+        memmove(&app->headers[1], &app->headers[0], i * sizeof(cached_header_t));
+        app->headers[0] = hit;
+        return &app->headers[0];
+    }
+
+    ison_writer_t w;
+    if (ison_writer_init_memory(&w, 64) != ISON_OK) return NULL;
+    write_header(&w, record);
+    cached_header_t fresh;
+    fresh.text = ison_writer_finish(&w, &fresh.len);
+    if (!fresh.text) return NULL;
+
+    if (app->header_count == APPENDER_HEADER_CACHE) {
+        free(app->headers[APPENDER_HEADER_CACHE - 1].text);
+        app->header_count--;
+    }
+    memmove(&app->headers[1], &app->headers[0], app->header_count * sizeof(cached_header_t));
+    app->headers[0] = fresh;
+    app->header_count++;
+    return &app->headers[0];
+}
+
+static void write_values(ison_writer_t *w, const isonl_record_t *record) {
+    for (size_t i = 0; i < record->field_count; i++) {
+        if (i > 0) ison_writer_putc(w, ' ');
+        ison_value_append(w, &record->values[i]);
+    }
+}
+
+ison_error_t isonl_append(isonl_appender_t *app, const isonl_record_t *record) {
+    if (!app || !record || !record->kind || !record->name) return ISON_ERROR_INVALID;
+    if (record->field_count && (!record->fields || !record->values)) return ISON_ERROR_INVALID;
+
+    /* Encode the cells before taking the lock */
+    char stack[APPENDER_LINE_BUFFER];
+    char *cells = stack;
+    ison_writer_t w;
+    ison_writer_init_buffer(&w, stack, sizeof(stack));
+    write_values(&w, record);
+    size_t cells_len = w.total;
+    if (cells_len > sizeof(stack)) {
+        cells = malloc(cells_len);
+        if (!cells) return ISON_ERROR_MEMORY;
+        ison_writer_init_buffer(&w, cells, cells_len);
+        write_values(&w, record);
+    }
+
+    pthread_mutex_lock(&app->lock);
+    /* Back-pressure: do not let the active buffer run far ahead of a slow disk */
+    while (app->error == ISON_OK && app->flushing && app->active.len >= app->options.flush_bytes * 4) {
+        pthread_cond_wait(&app->cond, &app->lock);
+    }
+    ison_error_t err = app->error;
+    const cached_header_t *header = err == ISON_OK ? lookup_header(app, record) : NULL;
+    if (err == ISON_OK && !header) err = ISON_ERROR_MEMORY;
+    if (err == ISON_OK) {
+        size_t before = app->active.len;
+        ison_writer_write(&app->active, header->text, header->len);
+        ison_writer_write(&app->active, cells, cells_len);
+        ison_writer_putc(&app->active, '\n');
+        if (app->active.error != ISON_OK) {
+            err = app->active.error;
+            app->active.error = ISON_OK;
+            app->active.len = before;
+        } else {
+            app->appended += app->active.len - before;
+            if (!app->flushing && app->active.len >= app->options.flush_bytes) flush_locked(app);
+        }
+    }
+    pthread_mutex_unlock(&app->lock);
+
+    if (cells != stack) free(cells);
+    return err;
+}
+
+ison_error_t isonl_appender_flush(isonl_appender_t *app) {
+    if (!app) return ISON_ERROR_INVALID;
+
+    pthread_mutex_lock(&app->lock);
+    uint64_t target = app->appended;
+    while (app->error == ISON_OK && app->durable < target) {
+        if (app->flushing) {
+            pthread_cond_wait(&app->cond, &app->lock);
+        } else {
+            flush_locked(app);
+        }
+    }
+    ison_error_t err = app->error;
+    pthread_mutex_unlock(&app->lock);
+    return err;
+}
+
+ison_error_t isonl_appender_close(isonl_appender_t *app) {
+    if (!app) return ISON_ERROR_INVALID;
+
+    ison_error_t err = isonl_appender_flush(app);
+    pthread_mutex_lock(&app->lock);
+    app->closing = true;
+    pthread_cond_broadcast(&app->cond);
+    pthread_mutex_unlock(&app->lock);
+    if (app->has_timer) pthread_join(app->timer, NULL);
+
+    if (close(app->fd) != 0 && err == ISON_OK) err = ISON_ERROR_IO;
+    for (size_t i = 0; i < app->header_count; i++) free(app->headers[i].text);
+    ison_writer_free(&app->active);
+    ison_writer_free(&app->spare);
+    pthread_cond_destroy(&app->cond);
+    pthread_mutex_destroy(&app->lock);
+    free(app);
+    return err;
+}
@@ -0,0 +1,494 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "lex.h"
+
+/*
+ * Arrow C Data Interface. A block travels as a struct array ("+s") with
+ * one child per field. Field type hints and the block kind ride along as
+ * "ison.type_hint" and "ison.kind" metadata so a round trip keeps them.
+ * Summary rows have no Arrow counterpart and are not exported.
+ */
+
+#define META_TYPE_HINT "ison.type_hint"
+#define META_KIND "ison.kind"
+
+static char *strdup_safe(const char *str) {
+    if (!str) return NULL;
+    size_t len = strlen(str);
+    char *copy = malloc(len + 1);
+    if (copy) memcpy(copy, str, len + 1);
+    return copy;
+}
+
+/* ==================== Export ==================== */
+
+typedef struct {
+    void *buffers[3];
+    const void *views[3];
+    struct ArrowArray *children;
+    struct ArrowArray **child_ptrs;
+} array_private_t;
+
+typedef struct {
+    char *name;
+    char *metadata;
+    struct ArrowSchema *children;
+    struct ArrowSchema **child_ptrs;
+} schema_private_t;
+
+static void release_array(struct ArrowArray *array) {
+    array_private_t *priv = array->private_data;
+    for (int64_t i = 0; i < array->n_children; i++) {
+        if (array->children[i]->release) array->children[i]->release(array->children[i]);
+    }
+    if (priv) {
+        for (int i = 0; i < 3; i++) free(priv->buffers[i]);
+        free(priv->children);
+        free(priv->child_ptrs);
+        free(priv);
+    }
+    array->release = NULL;
+}
+
+static void release_schema(struct ArrowSchema *schema) {
+    schema_private_t *priv = schema->private_data;
+    for (int64_t i = 0; i < schema->n_children; i++) {
+        if (schema->children[i]->release) schema->children[i]->release(schema->children[i]);
+    }
+    if (priv) {
+        free(priv->name);
+        free(priv->metadata);
+        free(priv->children);
+        free(priv->child_ptrs);
+        free(priv);
+    }
+    schema->release = NULL;
+}
+
+static int init_array(struct ArrowArray *array, int64_t length, int64_t n_buffers) {
+    memset(array, 0, sizeof(*array));
+    array_private_t *priv = calloc(1, sizeof(array_private_t));
+    if (!priv) return 0;
+    array->length = length;
+    array->n_buffers = n_buffers;
+    array->buffers = priv->views;
+    array->release = release_array;
+    array->private_data = priv;
+    return 1;
+}
+
+/* Metadata holding one key/value pair: int32 count, then length-prefixed key and value */
+static char *single_metadata(const char *key, const char *value) {
+    int32_t klen = (int32_t)strlen(key), vlen = (int32_t)strlen(value), one = 1;
+    char *md = malloc(12 + (size_t)klen + (size_t)vlen);
+    if (!md) return NULL;
+    memcpy(md, &one, 4);
+    memcpy(md + 4, &klen, 4);
+    memcpy(md + 8, key, (size_t)klen);
+    memcpy(md + 8 + klen, &vlen, 4);
+    memcpy(md + 12 + klen, value, (size_t)vlen);
+    return md;
+}
+
+static int init_schema(struct ArrowSchema *schema, const char *format, const char *name,
+                       const char *meta_key, const char *meta_value) {
+    memset(schema, 0, sizeof(*schema));
+    schema_private_t *priv = calloc(1, sizeof(schema_private_t));
+    if (!priv) return 0;
+    schema->release = release_schema;
+    schema->private_data = priv;
+    priv->name = strdup_safe(name ? name : "");
+    priv->metadata = single_metadata(meta_key, meta_value ? meta_value : "");
+    schema->format = format;
+    schema->name = priv->name;
+    schema->metadata = priv->metadata;
+    schema->flags = ARROW_FLAG_NULLABLE;
+    return priv->name && priv->metadata;
+}
+
+enum { COLUMN_INT, COLUMN_FLOAT, COLUMN_BOOL, COLUMN_UTF8 };
+
+/* Arrow type of a column: what the values agree on, the hint when they are all null */
+static int column_kind(const ison_value_t **cells, size_t rows, const char *hint) {
+    int any = 0, all_bool = 1, all_int = 1, all_num = 1;
+    for (size_t i = 0; i < rows; i++) {
+        const ison_value_t *v = cells[i];
+        if (!v || v->type == ISON_TYPE_NULL) continue;
+        any = 1;
+        if (v->type != ISON_TYPE_BOOL) all_bool = 0;
+        if (v->type != ISON_TYPE_INT) all_int = 0;
+        if (v->type != ISON_TYPE_INT && v->type != ISON_TYPE_FLOAT) all_num = 0;
+    }
+    if (!any) {
+        if (strcmp(hint, "int") == 0) return COLUMN_INT;
+        if (strcmp(hint, "float") == 0) return COLUMN_FLOAT;
+        if (strcmp(hint, "bool") == 0) return COLUMN_BOOL;
+        return COLUMN_UTF8;
+    }
+    if (all_bool) return COLUMN_BOOL;
+    if (all_int) return COLUMN_INT;
+    if (all_num) return COLUMN_FLOAT;
+    return COLUMN_UTF8;
+}
+
+/* Text of a cell in a utf8 column: strings as they are, anything else in ISON notation */
+static size_t cell_text(const ison_value_t *v, char *buf, size_t cap) {
+    if (v->type == ISON_TYPE_STRING) {
+        size_t len = v->data.string_val ? strlen(v->data.string_val) : 0;
+        if (len <= cap && len) memcpy(buf, v->data.string_val, len);
+        return len;
+    }
+    char tmp[ISON_NUMBER_BUFFER_SIZE];
+    size_t len = ison_value_write_ison(v, tmp, sizeof(tmp));
+    if (len < sizeof(tmp)) {
+        if (len <= cap) memcpy(buf, tmp, len);
+        return len;
+    }
+    if (len + 1 > cap) return len;
+    char *full = malloc(len + 1);
+    if (!full) return len;
+    ison_value_write_ison(v, full, len + 1);
+    memcpy(buf, full, len);
+    free(full);
+    return len;
+}
+
+static int export_utf8(const ison_value_t **cells, size_t rows, array_private_t *priv, const char **format) {
+    size_t total = 0;
+    for (size_t i = 0; i < rows; i++) {
+        if (cells[i] && cells[i]->type != ISON_TYPE_NULL) total += cell_text(cells[i], NULL, 0);
+    }
+    int large = total > INT32_MAX;
+    *format = large ? "U" : "u";
+
+    size_t width = large ? 8 : 4;
+    unsigned char *offsets = malloc((rows + 1) * width);
+    char *data = malloc(total ? total : 1);
+    priv->buffers[1] = offsets;
+    priv->buffers[2] = data;
+    if (!offsets || !data) return 0;
+
+    size_t pos = 0;
+    for (size_t i = 0; i <= rows; i++) {
+        if (large) {
+            int64_t o = (int64_t)pos;
+            memcpy(offsets + i * 8, &o, 8);
+        } else {
+            int32_t o = (int32_t)pos;
+            memcpy(offsets + i * 4, &o, 4);
+        }
+        if (i < rows && cells[i] && cells[i]->type != ISON_TYPE_NULL) {
+            pos += cell_text(cells[i], data + pos, total - pos);
+        }
+    }
+    return 1;
+}
+
+static int export_column(const ison_field_info_t *field, const ison_value_t **cells, size_t rows,
+                         struct ArrowArray *array, struct ArrowSchema *schema) {
+    int kind = column_kind(cells, rows, field->type_hint ? field->type_hint : "");
+    if (!init_array(array, (int64_t)rows, kind == COLUMN_UTF8 ? 3 : 2)) return 0;
+    array_private_t *priv = array->private_data;
+    const char *format = "u";
+
+    size_t null_count = 0;
+    for (size_t i = 0; i < rows; i++) {
+        if (!cells[i] || cells[i]->type == ISON_TYPE_NULL) null_count++;
+    }
+    if (null_count) {
+        unsigned char *validity = calloc((rows + 7) / 8, 1);
+        if (!validity) return 0;
+        for (size_t i = 0; i < rows; i++) {
+            if (cells[i] && cells[i]->type != ISON_TYPE_NULL) validity[i / 8] |= (unsigned char)(1u << (i % 8));
+        }
+        priv->buffers[0] = validity;
+    }
+    array->null_count = (int64_t)null_count;
+
+    if (kind == COLUMN_INT) {
+        int64_t *values = calloc(rows ? rows : 1, sizeof(int64_t));
+        if (!values) return 0;
+        for (size_t i = 0; i < rows; i++) {
+            if (cells[i] && cells[i]->type == ISON_TYPE_INT) values[i] = cells[i]->data.int_val;
+        }
+        priv->buffers[1] = values;
+        format = "l";
+    } else if (kind == COLUMN_FLOAT) {
+        double *values = calloc(rows ? rows : 1, sizeof(double));
+        if (!values) return 0;
+        for (size_t i = 0; i < rows; i++) {
+            if (cells[i]) ison_value_as_float(cells[i], &values[i]);
+        }
+        priv->buffers[1] = values;
+        format = "g";
+    } else if (kind == COLUMN_BOOL) {
+        unsigned char *bits = calloc((rows + 7) / 8 ? (rows + 7) / 8 : 1, 1);
+        if (!bits) return 0;
+        for (size_t i = 0; i < rows; i++) {
+            if (cells[i] && cells[i]->type == ISON_TYPE_BOOL && cells[i]->data.bool_val) {
+                bits[i / 8] |= (unsigned char)(1u << (i % 8));
+            }
+        }
+        priv->buffers[1] = bits;
+        format = "b";
+    } else if (!export_utf8(cells, rows, priv, &format)) {
+        return 0;
+    }
+
+    for (int i = 0; i < 3; i++) priv->views[i] = priv->buffers[i];
+    return init_schema(schema, format, field->name, META_TYPE_HINT, field->type_hint);
+}
+
+ison_error_t ison_block_export_arrow(const ison_block_t *block, struct ArrowArray *out_array,
+                                     struct ArrowSchema *out_schema) {
+    if (!block || !out_array || !out_schema) return ISON_ERROR_INVALID;
+
+    size_t rows = block->row_count, fields = block->field_count;
+    if (!init_array(out_array, (int64_t)rows, 1) ||
+        !init_schema(out_schema, "+s", block->name, META_KIND, block->kind)) {
+        goto fail;
+    }
+    out_schema->flags = 0;
+
+    array_private_t *apriv = out_array->private_data;
+    schema_private_t *spriv = out_schema->private_data;
+    apriv->children = calloc(fields ? fields : 1, sizeof(struct ArrowArray));
+    apriv->child_ptrs = calloc(fields ? fields : 1, sizeof(struct ArrowArray *));
+    spriv->children = calloc(fields ? fields : 1, sizeof(struct ArrowSchema));
+    spriv->child_ptrs = calloc(fields ? fields : 1, sizeof(struct ArrowSchema *));
+    const ison_value_t **cells = calloc(rows && fields ? rows * fields : 1, sizeof(ison_value_t *));
+    if (!apriv->children || !apriv->child_ptrs || !spriv->children || !spriv->child_ptrs || !cells) {
+        free(cells);
+        goto fail;
+    }
+    out_array->children = apriv->child_ptrs;
+    out_schema->children = spriv->child_ptrs;
+
+    /* Column-major cell table, one walk of each row's entries */
+    for (size_t r = 0; r < rows; r++) {
+        size_t guess = 0;
+        for (const ison_row_entry_t *e = block->rows[r]->head; e; e = e->next, guess++) {
+            size_t j = guess;
+            if (j >= fields || strcmp(block->fields[j].name, e->key) != 0) {
+                for (j = 0; j < fields && strcmp(block->fields[j].name, e->key) != 0; j++) {}
+            }
+            if (j < fields && !cells[j * rows + r]) {
+                ison_value_resolve(&e->value);
+                cells[j * rows + r] = &e->value;
+            }
+        }
+    }
+
+    for (size_t j = 0; j < fields; j++) {
+        apriv->child_ptrs[j] = &apriv->children[j];
+        spriv->child_ptrs[j] = &spriv->children[j];
+        out_array->n_children = out_schema->n_children = (int64_t)j + 1;
+        if (!export_column(&block->fields[j], cells + j * rows, rows, &apriv->children[j], &spriv->children[j])) {
+            free(cells);
+            goto fail;
+        }
+    }
+    free(cells);
+    return ISON_OK;
+
+fail:
+    if (out_array->release) out_array->release(out_array);
+    if (out_schema->release) out_schema->release(out_schema);
+    return ISON_ERROR_MEMORY;
+}
+
+/* ==================== Import ==================== */
+
+/* Value of key in Arrow metadata, or NULL */
+static const char *metadata_get(const char *metadata, const char *key, int32_t *len) {
+    if (!metadata) return NULL;
+    int32_t count;
+    memcpy(&count, metadata, 4);
+    const char *p = metadata + 4;
+    size_t klen = strlen(key);
+    for (int32_t i = 0; i < count; i++) {
+        int32_t kl, vl;
+        memcpy(&kl, p, 4);
+        const char *k = p + 4;
+        memcpy(&vl, k + kl, 4);
+        const char *v = k + kl + 4;
+        if ((size_t)kl == klen && memcmp(k, key, klen) == 0) {
+            *len = vl;
+            return v;
+        }
+        p = v + vl;
+    }
+    return NULL;
+}
+
+static const char *format_hint(const char *format) {
+    if (strlen(format) != 1) return "";
+    switch (format[0]) {
+        case 'c': case 'C': case 's': case 'S':
+        case 'i': case 'I': case 'l': case 'L':
+            return "int";
+        case 'f': case 'g':
+            return "float";
+        case 'b':
+            return "bool";
+        case 'u': case 'U':
+            return "string";
+        default:
+            return "";
+    }
+}
+
+static int bit_set(const void *bits, int64_t index) {
+    return (((const unsigned char *)bits)[index / 8] >> (index % 8)) & 1;
+}
+
+typedef struct {
+    char *scratch;
+    size_t cap;
+} import_scratch_t;
+
+/* Value of one utf8 cell; text under a non-string hint decodes like an ISON token */
+static ison_value_t utf8_value(import_scratch_t *sc, const char *data, size_t len, const char *hint, int lex) {
+    if (!lex) return ison_string_n(data, len);
+    if (len + 1 > sc->cap) {
+        char *s = realloc(sc->scratch, len + 1);
+        if (!s) return ison_string_n(data, len);
+        sc->scratch = s;
+        sc->cap = len + 1;
+    }
+    memcpy(sc->scratch, data, len);
+    sc->scratch[len] = '\0';
+    ison_value_t borrowed = ison_lex_value(sc->scratch, hint);
+    return ison_value_copy(&borrowed);
+}
+
+static ison_error_t import_column(const struct ArrowArray *array, const struct ArrowSchema *schema,
+                                  int64_t parent_offset, ison_row_t **rows, int64_t length,
+                                  ison_block_t *block, import_scratch_t *sc) {
+    const char *format = schema->format;
+    if (!format || !schema->name || strlen(format) != 1 || array->dictionary || array->length < parent_offset + length) {
+        return ISON_ERROR_INVALID;
+    }
+
+    int32_t hint_len = 0;
+    const char *meta = metadata_get(schema->metadata, META_TYPE_HINT, &hint_len);
+    char hint[32];
+    if (meta && hint_len < (int32_t)sizeof(hint)) {
+        memcpy(hint, meta, (size_t)hint_len);
+        hint[hint_len] = '\0';
+    } else {
+        strcpy(hint, format_hint(format));
+    }
+    int lex = meta && strcmp(hint, "string") != 0;
+    ison_block_add_field(block, schema->name, hint);
+
+    char f = format[0];
+    if (f != 'n' && (array->n_buffers < (f == 'u' || f == 'U' ? 3 : 2) || !array->buffers)) return ISON_ERROR_INVALID;
+    const void *validity = f == 'n' ? NULL : array->buffers[0];
+    const void *values = f == 'n' ? NULL : array->buffers[1];
+    if (f != 'n' && !values) return ISON_ERROR_INVALID;
+
+    for (int64_t r = 0; r < length; r++) {
+        int64_t i = array->offset + parent_offset + r;
+        ison_value_t val;
+        if (f == 'n' || (validity && !bit_set(validity, i))) {
+            val = ison_null();
+        } else {
+            switch (f) {
+                case 'c': val = ison_int(((const int8_t *)values)[i]); break;
+                case 'C': val = ison_int(((const uint8_t *)values)[i]); break;
+                case 's': val = ison_int(((const int16_t *)values)[i]); break;
+                case 'S': val = ison_int(((const uint16_t *)values)[i]); break;
+                case 'i': val = ison_int(((const int32_t *)values)[i]); break;
+                case 'I': val = ison_int(((const uint32_t *)values)[i]); break;
+                case 'l': val = ison_int(((const int64_t *)values)[i]); break;
+                case 'L': val = ison_int((int64_t)((const uint64_t *)values)[i]); break;
+                case 'f': val = ison_float(((const float *)values)[i]); break;
+                case 'g': val = ison_float(((const double *)values)[i]); break;
+                case 'b': val = ison_bool(bit_set(values, i)); break;
+                case 'u': {
+                    const int32_t *off = values;
+                    if (off[i + 1] < off[i]) return ISON_ERROR_INVALID;
+                    val = utf8_value(sc, (const char *)array->buffers[2] + off[i], (size_t)(off[i + 1] - off[i]), hint, lex);
+                    break;
+                }
+                case 'U': {
+                    const int64_t *off = values;
+                    if (off[i + 1] < off[i]) return ISON_ERROR_INVALID;
+                    val = utf8_value(sc, (const char *)array->buffers[2] + off[i], (size_t)(off[i + 1] - off[i]), hint, lex);
+                    break;
+                }
+                default:
+                    return ISON_ERROR_INVALID;
+            }
+        }
+        ison_row_set(rows[r], schema->name, &val);
+    }
+    return ISON_OK;
+}
+
+ison_block_t *ison_block_import_arrow(struct ArrowArray *array, struct ArrowSchema *schema, ison_error_t *error) {
+    if (error) *error = ISON_OK;
+    if (!array || !schema || !array->release || !schema->release) {
+        if (error) *error = ISON_ERROR_INVALID;
+        return NULL;
+    }
+
+    ison_error_t err = ISON_OK;
+    ison_block_t *block = NULL;
+    ison_row_t **rows = NULL;
+    import_scratch_t sc = {NULL, 0};
+
+    if (!schema->format || strcmp(schema->format, "+s") != 0 || array->n_children != schema->n_children ||
+        array->length < 0) {
+        err = ISON_ERROR_INVALID;
+        goto done;
+    }
+
+    int32_t kind_len = 0;
+    const char *kind_meta = metadata_get(schema->metadata, META_KIND, &kind_len);
+    char kind[16] = "table";
+    if (kind_meta && ison_lex_is_kind(kind_meta, (size_t)kind_len)) {
+        memcpy(kind, kind_meta, (size_t)kind_len);
+        kind[kind_len] = '\0';
+    }
+    block = ison_block_create(kind, schema->name && *schema->name ? schema->name : "arrow");
+    rows = calloc(array->length ? (size_t)array->length : 1, sizeof(ison_row_t *));
+    if (!block || !rows) {
+        err = ISON_ERROR_MEMORY;
+        goto done;
+    }
+    for (int64_t r = 0; r < array->length; r++) {
+        rows[r] = ison_row_create();
+        if (!rows[r]) {
+            err = ISON_ERROR_MEMORY;
+            goto done;
+        }
+    }
+
+    /* Struct-level nulls have no ISON counterpart; such rows keep their children's values */
+    for (int64_t j = 0; j < schema->n_children && err == ISON_OK; j++) {
+        err = import_column(array->children[j], schema->children[j], array->offset, rows, array->length, block, &sc);
+    }
+    for (int64_t r = 0; r < array->length && err == ISON_OK; r++) {
+        ison_block_take_row(block, rows[r]);
+        rows[r] = NULL;
+    }
+
+done:
+    if (rows) {
+        for (int64_t r = 0; r < array->length; r++) ison_row_free(rows[r]);
+        free(rows);
+    }
+    free(sc.scratch);
+    array->release(array);
+    schema->release(schema);
+    if (err != ISON_OK) {
+        ison_block_free(block);
+        block = NULL;
+    }
+    if (error) *error = err;
+    return block;
+}
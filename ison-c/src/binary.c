@@ -0,0 +1,1239 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ison.h"
+#include "lex.h"
+#include "lz.h"
+
+/*
+ * ISONB layout. Every integer is little-endian and every section starts
+ * on an 8-byte boundary.
+ *
+ *   header      64 bytes: magic, version, block count, file size and the
+ *               offsets of the directory, reference table and string heap
+ *   directory   one 48-byte entry per block: kind, name, row count, field
+ *               count, flags, and the offsets of its field and column tables
+ *   fields      16 bytes per field: name, type hint
+ *   columns     16 bytes per field: chunk count, chunk table offset
+ *   chunks      32 bytes per chunk of up to ISONB_CHUNK_ROWS rows: payload
+ *               offset, stored and raw size, rows, cell type, encoding
+ *   payloads    per chunk: a typed array (u8 for bool, u64 for int, float,
+ *               string or reference, nothing for all-null), or for mixed
+ *               chunks a u8 tag per row padded to 8 followed by u64 slots.
+ *               Compressed chunks store that payload encoded, see below.
+ *   references  24 bytes each, one per distinct reference: id, namespace,
+ *               relationship
+ *   heap        strings as u32 length, bytes, NUL; referenced by the
+ *               offset of their first byte. Offset 0 means no string.
+ *
+ * A summary row is stored after the data rows of its block.
+ */
+
+#define ISONB_MAGIC "ISONB\0\0\0"
+#define ISONB_VERSION 1
+#define HEADER_SIZE 64
+#define BLOCK_ENTRY_SIZE 48
+#define FIELD_ENTRY_SIZE 16
+#define COLUMN_ENTRY_SIZE 16
+#define CHUNK_ENTRY_SIZE 32
+#define REF_ENTRY_SIZE 24
+#define ISONB_CHUNK_ROWS 65536
+#define BLOCK_HAS_SUMMARY 1u
+
+enum {
+    TAG_NULL = 0,
+    TAG_BOOL,
+    TAG_INT,
+    TAG_FLOAT,
+    TAG_STRING,
+    TAG_REF,
+    TAG_MIXED = 0xFE,
+    TAG_ABSENT = 0xFF
+};
+
+/*
+ * Chunk encodings: a transform of u64 slot arrays in the low nibble,
+ * optionally followed by LZ. Packed payloads are a u64 base, a u8 bit
+ * width padded to 16 bytes, then little-endian bit-packed u64 words:
+ * value - base for FOR, zigzag deltas from the previous value for DELTA.
+ * LZ payloads are the u64 size of their input followed by the stream.
+ */
+enum {
+    ENCODING_RAW = 0,
+    ENCODING_FOR = 1,
+    ENCODING_DELTA = 2,
+    ENCODING_TRANSFORM = 0x0F,
+    ENCODING_LZ = 0x10
+};
+
+#define PACK_HEADER_SIZE 16
+
+static inline uint64_t align8(uint64_t n) {
+    return (n + 7) & ~(uint64_t)7;
+}
+
+static inline void put_le32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static inline void put_le64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static inline uint32_t get_le32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t get_le64(const unsigned char *p) {
+    return (uint64_t)get_le32(p) | (uint64_t)get_le32(p + 4) << 32;
+}
+
+static void write_le64(ison_writer_t *w, uint64_t v) {
+    unsigned char buf[8];
+    put_le64(buf, v);
+    ison_writer_write(w, (const char *)buf, 8);
+}
+
+static void write_padding(ison_writer_t *w, uint64_t to) {
+    static const char zeros[8] = {0};
+    while (w->total < to) {
+        size_t n = to - w->total < 8 ? (size_t)(to - w->total) : 8;
+        ison_writer_write(w, zeros, n);
+    }
+}
+
+/* ==================== Encoding ==================== */
+
+/* Interned strings; slots hold heap offsets, 0 marks an empty slot */
+typedef struct {
+    ison_writer_t heap;
+    uint64_t *slots;
+    size_t cap;
+    size_t count;
+} string_pool_t;
+
+static uint64_t hash_bytes(const char *s, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static int pool_init(string_pool_t *sp) {
+    memset(sp, 0, sizeof(*sp));
+    if (ison_writer_init_memory(&sp->heap, 4096) != ISON_OK) return 0;
+    write_le64(&sp->heap, 0);
+    sp->cap = 1024;
+    sp->slots = calloc(sp->cap, sizeof(uint64_t));
+    return sp->slots != NULL;
+}
+
+static void pool_free(string_pool_t *sp) {
+    ison_writer_free(&sp->heap);
+    free(sp->slots);
+}
+
+static int pool_grow(string_pool_t *sp) {
+    size_t cap = sp->cap * 2;
+    uint64_t *slots = calloc(cap, sizeof(uint64_t));
+    if (!slots) return 0;
+    for (size_t i = 0; i < sp->cap; i++) {
+        uint64_t off = sp->slots[i];
+        if (!off) continue;
+        const char *s = sp->heap.buf + off;
+        size_t j = hash_bytes(s, get_le32((const unsigned char *)s - 4)) & (cap - 1);
+        while (slots[j]) j = (j + 1) & (cap - 1);
+        slots[j] = off;
+    }
+    free(sp->slots);
+    sp->slots = slots;
+    sp->cap = cap;
+    return 1;
+}
+
+/* Heap offset of str, adding it on first sight; 0 for NULL or on failure */
+static uint64_t pool_intern(string_pool_t *sp, const char *str) {
+    if (!str || sp->heap.error != ISON_OK) return 0;
+    size_t len = strlen(str);
+    if (len > UINT32_MAX) {
+        sp->heap.error = ISON_ERROR_OVERFLOW;
+        return 0;
+    }
+
+    size_t i = hash_bytes(str, len) & (sp->cap - 1);
+    while (sp->slots[i]) {
+        const char *s = sp->heap.buf + sp->slots[i];
+        if (get_le32((const unsigned char *)s - 4) == len && memcmp(s, str, len) == 0) return sp->slots[i];
+        i = (i + 1) & (sp->cap - 1);
+    }
+
+    /* Length prefixes stay 4-byte aligned */
+    while (sp->heap.len % 4) ison_writer_putc(&sp->heap, '\0');
+    unsigned char prefix[4];
+    put_le32(prefix, (uint32_t)len);
+    ison_writer_write(&sp->heap, (const char *)prefix, 4);
+    uint64_t off = sp->heap.len;
+    ison_writer_write(&sp->heap, str, len + 1);
+    if (sp->heap.error != ISON_OK) return 0;
+
+    sp->slots[i] = off;
+    if (++sp->count * 2 > sp->cap && !pool_grow(sp)) {
+        sp->heap.error = ISON_ERROR_MEMORY;
+        return 0;
+    }
+    return off;
+}
+
+typedef struct {
+    ison_writer_t payload;
+    uint32_t rows;
+    uint8_t type;
+    uint8_t encoding;
+    uint64_t raw_size;
+    uint64_t offset;        /* file offset, set by the layout pass */
+} chunk_plan_t;
+
+typedef struct {
+    const ison_block_t *block;
+    uint64_t stored_rows;   /* data rows plus the summary row */
+    uint64_t fields_offset;
+    uint64_t columns_offset;
+    uint64_t chunks_offset;
+    size_t chunk_count;     /* per column */
+    chunk_plan_t *chunks;   /* column-major: chunks[field * chunk_count + c] */
+} block_plan_t;
+
+typedef struct {
+    string_pool_t pool;
+    ison_writer_t refs;
+    uint64_t ref_count;
+    uint64_t *ref_slots;    /* interned references: table index + 1, 0 marks an empty slot */
+    size_t ref_cap;
+    block_plan_t *blocks;
+    size_t block_count;
+    unsigned char *tags;    /* scratch for one chunk: field-major */
+    uint64_t *slots;
+    uint64_t *vals;         /* packing scratch for one column chunk */
+    size_t scratch_rows;
+    ison_error_t error;
+} binary_plan_t;
+
+static const ison_row_t *stored_row(const ison_block_t *block, size_t index) {
+    return index < block->row_count ? block->rows[index] : block->summary_row;
+}
+
+static int field_index(const ison_block_t *block, const char *key, size_t guess) {
+    if (guess < block->field_count && strcmp(block->fields[guess].name, key) == 0) return (int)guess;
+    for (size_t j = 0; j < block->field_count; j++) {
+        if (strcmp(block->fields[j].name, key) == 0) return (int)j;
+    }
+    return -1;
+}
+
+static int refs_grow(binary_plan_t *plan) {
+    size_t cap = plan->ref_cap ? plan->ref_cap * 2 : 256;
+    uint64_t *slots = calloc(cap, sizeof(uint64_t));
+    if (!slots) return 0;
+    for (uint64_t k = 0; k < plan->ref_count; k++) {
+        const char *e = plan->refs.buf + k * REF_ENTRY_SIZE;
+        size_t j = hash_bytes(e, REF_ENTRY_SIZE) & (cap - 1);
+        while (slots[j]) j = (j + 1) & (cap - 1);
+        slots[j] = k + 1;
+    }
+    free(plan->ref_slots);
+    plan->ref_slots = slots;
+    plan->ref_cap = cap;
+    return 1;
+}
+
+/* Index of ref in the reference table; equal references share an entry */
+static uint64_t plan_ref(binary_plan_t *plan, const ison_reference_t *ref) {
+    unsigned char entry[REF_ENTRY_SIZE];
+    put_le64(entry, pool_intern(&plan->pool, ref->id ? ref->id : ""));
+    put_le64(entry + 8, pool_intern(&plan->pool, ref->ns));
+    put_le64(entry + 16, pool_intern(&plan->pool, ref->relationship));
+    if ((plan->ref_count + 1) * 2 > plan->ref_cap && !refs_grow(plan)) {
+        plan->refs.error = ISON_ERROR_MEMORY;
+        return 0;
+    }
+
+    size_t j = hash_bytes((const char *)entry, REF_ENTRY_SIZE) & (plan->ref_cap - 1);
+    while (plan->ref_slots[j]) {
+        uint64_t k = plan->ref_slots[j] - 1;
+        if (memcmp(plan->refs.buf + k * REF_ENTRY_SIZE, entry, REF_ENTRY_SIZE) == 0) return k;
+        j = (j + 1) & (plan->ref_cap - 1);
+    }
+    ison_writer_write(&plan->refs, (const char *)entry, REF_ENTRY_SIZE);
+    if (plan->refs.error != ISON_OK) return 0;
+    plan->ref_slots[j] = plan->ref_count + 1;
+    return plan->ref_count++;
+}
+
+/* Tag and 8-byte slot of one cell */
+static void plan_cell(binary_plan_t *plan, const ison_value_t *val, unsigned char *tag, uint64_t *slot) {
+    *slot = 0;
+    ison_value_resolve(val);
+    switch (val->type) {
+        case ISON_TYPE_BOOL:
+            *tag = TAG_BOOL;
+            *slot = val->data.bool_val ? 1 : 0;
+            break;
+        case ISON_TYPE_INT:
+            *tag = TAG_INT;
+            *slot = (uint64_t)val->data.int_val;
+            break;
+        case ISON_TYPE_FLOAT:
+            *tag = TAG_FLOAT;
+            memcpy(slot, &val->data.float_val, sizeof(double));
+            break;
+        case ISON_TYPE_STRING:
+            *tag = TAG_STRING;
+            *slot = pool_intern(&plan->pool, val->data.string_val ? val->data.string_val : "");
+            break;
+        case ISON_TYPE_REFERENCE:
+            *tag = TAG_REF;
+            *slot = plan_ref(plan, &val->data.ref_val);
+            break;
+        default:
+            *tag = TAG_NULL;
+            break;
+    }
+}
+
+static void encode_chunk(chunk_plan_t *chunk, const unsigned char *tags, const uint64_t *slots, uint32_t rows) {
+    unsigned char type = rows ? tags[0] : TAG_ABSENT;
+    for (uint32_t r = 1; r < rows && type != TAG_MIXED; r++) {
+        if (tags[r] != type) type = TAG_MIXED;
+    }
+    chunk->type = type;
+    chunk->rows = rows;
+    chunk->encoding = ENCODING_RAW;
+
+    ison_writer_t *w = &chunk->payload;
+    if (type == TAG_MIXED) {
+        ison_writer_write(w, (const char *)tags, rows);
+        write_padding(w, align8(rows));
+    }
+    if (type == TAG_BOOL) {
+        for (uint32_t r = 0; r < rows; r++) ison_writer_putc(w, (char)slots[r]);
+        write_padding(w, align8(rows));
+    } else if (type != TAG_NULL && type != TAG_ABSENT) {
+        for (uint32_t r = 0; r < rows; r++) write_le64(w, slots[r]);
+    }
+    chunk->raw_size = w->len;
+}
+
+static int bit_width(uint64_t v) {
+    int width = 0;
+    while (v) {
+        width++;
+        v >>= 1;
+    }
+    return width;
+}
+
+static uint64_t packed_size(uint64_t count, int width) {
+    return PACK_HEADER_SIZE + (count * (uint64_t)width + 63) / 64 * 8;
+}
+
+static void pack_bits(ison_writer_t *w, uint64_t base, int width, const uint64_t *vals, size_t count) {
+    unsigned char header[PACK_HEADER_SIZE] = {0};
+    put_le64(header, base);
+    header[8] = (unsigned char)width;
+    ison_writer_write(w, (const char *)header, sizeof(header));
+
+    uint64_t acc = 0;
+    int bits = 0;
+    for (size_t i = 0; i < count && width > 0; i++) {
+        acc |= vals[i] << bits;
+        if (bits + width < 64) {
+            bits += width;
+            continue;
+        }
+        write_le64(w, acc);
+        int spill = bits + width - 64;
+        acc = spill ? vals[i] >> (width - spill) : 0;
+        bits = spill;
+    }
+    if (bits) write_le64(w, acc);
+}
+
+/* Frame-of-reference or delta packing of a u64 slot array, whichever is smaller */
+static int pack_slots(ison_writer_t *w, const uint64_t *slots, uint32_t rows, uint64_t *vals) {
+    int64_t lo = (int64_t)slots[0], hi = lo;
+    uint64_t deltas = 0;
+    for (uint32_t r = 1; r < rows; r++) {
+        int64_t v = (int64_t)slots[r];
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+        uint64_t d = slots[r] - slots[r - 1];
+        deltas |= (d << 1) ^ (uint64_t)((int64_t)d >> 63);
+    }
+    int for_width = bit_width((uint64_t)hi - (uint64_t)lo);
+    int delta_width = bit_width(deltas);
+
+    if (packed_size(rows - 1, delta_width) < packed_size(rows, for_width)) {
+        for (uint32_t r = 1; r < rows; r++) {
+            uint64_t d = slots[r] - slots[r - 1];
+            vals[r - 1] = (d << 1) ^ (uint64_t)((int64_t)d >> 63);
+        }
+        pack_bits(w, slots[0], delta_width, vals, rows - 1);
+        return ENCODING_DELTA;
+    }
+    for (uint32_t r = 0; r < rows; r++) vals[r] = slots[r] - (uint64_t)lo;
+    pack_bits(w, (uint64_t)lo, for_width, vals, rows);
+    return ENCODING_FOR;
+}
+
+static int lz_encode(ison_writer_t *out, const ison_writer_t *in) {
+    unsigned char *buf = malloc(ison_lz_bound(in->len));
+    if (!buf) return 0;
+    size_t n = ison_lz_compress(in->buf, in->len, buf);
+    write_le64(out, in->len);
+    ison_writer_write(out, (const char *)buf, n);
+    free(buf);
+    return out->error == ISON_OK;
+}
+
+/* Keep the smallest of raw, packed, and either of those through LZ */
+static int compress_chunk(chunk_plan_t *chunk, const uint64_t *slots, uint64_t *vals) {
+    if (chunk->payload.len == 0) return 1;
+
+    ison_writer_t packed;
+    int transform = ENCODING_RAW;
+    if (ison_writer_init_memory(&packed, 256) != ISON_OK) return 0;
+    if (chunk->type == TAG_INT || chunk->type == TAG_STRING || chunk->type == TAG_REF) {
+        transform = pack_slots(&packed, slots, chunk->rows, vals);
+        if (packed.error != ISON_OK) {
+            ison_writer_free(&packed);
+            return 0;
+        }
+    }
+    if (transform != ENCODING_RAW && packed.len < chunk->payload.len) {
+        ison_writer_free(&chunk->payload);
+        chunk->payload = packed;
+        chunk->encoding = (uint8_t)transform;
+    } else {
+        ison_writer_free(&packed);
+    }
+
+    ison_writer_t lz;
+    if (ison_writer_init_memory(&lz, chunk->payload.len / 2 + 64) != ISON_OK) return 0;
+    if (!lz_encode(&lz, &chunk->payload)) {
+        ison_writer_free(&lz);
+        return 0;
+    }
+    if (lz.len < chunk->payload.len) {
+        ison_writer_free(&chunk->payload);
+        chunk->payload = lz;
+        chunk->encoding |= ENCODING_LZ;
+    } else {
+        ison_writer_free(&lz);
+    }
+    return 1;
+}
+
+static int plan_block(binary_plan_t *plan, block_plan_t *bp, const ison_binary_options_t *options) {
+    const ison_block_t *block = bp->block;
+    size_t fields = block->field_count;
+    bp->stored_rows = block->row_count + (block->summary_row ? 1 : 0);
+    bp->chunk_count = (size_t)((bp->stored_rows + ISONB_CHUNK_ROWS - 1) / ISONB_CHUNK_ROWS);
+    if (fields == 0 || bp->chunk_count == 0) return 1;
+
+    bp->chunks = calloc(fields * bp->chunk_count, sizeof(chunk_plan_t));
+    if (!bp->chunks) return 0;
+
+    size_t rows_per = bp->stored_rows < ISONB_CHUNK_ROWS ? (size_t)bp->stored_rows : ISONB_CHUNK_ROWS;
+    if (fields * rows_per > plan->scratch_rows) {
+        free(plan->tags);
+        free(plan->slots);
+        free(plan->vals);
+        plan->scratch_rows = fields * rows_per;
+        plan->tags = malloc(plan->scratch_rows);
+        plan->slots = malloc(plan->scratch_rows * sizeof(uint64_t));
+        plan->vals = malloc(rows_per * sizeof(uint64_t));
+        if (!plan->tags || !plan->slots || !plan->vals) return 0;
+    }
+
+    for (size_t c = 0; c < bp->chunk_count; c++) {
+        size_t first = c * ISONB_CHUNK_ROWS;
+        size_t rows = bp->stored_rows - first < ISONB_CHUNK_ROWS ? (size_t)(bp->stored_rows - first) : ISONB_CHUNK_ROWS;
+        memset(plan->tags, TAG_ABSENT, fields * rows);
+        memset(plan->slots, 0, fields * rows * sizeof(uint64_t));
+
+        /* Gather row-major, one walk of each row's entries */
+        for (size_t r = 0; r < rows; r++) {
+            const ison_row_t *row = stored_row(block, first + r);
+            size_t guess = 0;
+            for (const ison_row_entry_t *e = row->head; e; e = e->next, guess++) {
+                int j = field_index(block, e->key, guess);
+                if (j < 0 || plan->tags[(size_t)j * rows + r] != TAG_ABSENT) continue;
+                plan_cell(plan, &e->value, &plan->tags[(size_t)j * rows + r], &plan->slots[(size_t)j * rows + r]);
+            }
+        }
+
+        for (size_t j = 0; j < fields; j++) {
+            chunk_plan_t *chunk = &bp->chunks[j * bp->chunk_count + c];
+            if (ison_writer_init_memory(&chunk->payload, 256) != ISON_OK) return 0;
+            encode_chunk(chunk, plan->tags + j * rows, plan->slots + j * rows, (uint32_t)rows);
+            if (chunk->payload.error != ISON_OK) return 0;
+            if (options->compress && !compress_chunk(chunk, plan->slots + j * rows, plan->vals)) return 0;
+        }
+    }
+    return plan->pool.heap.error == ISON_OK && plan->refs.error == ISON_OK;
+}
+
+static void plan_free(binary_plan_t *plan) {
+    for (size_t i = 0; i < plan->block_count; i++) {
+        block_plan_t *bp = &plan->blocks[i];
+        if (bp->chunks) {
+            for (size_t k = 0; k < bp->block->field_count * bp->chunk_count; k++) {
+                ison_writer_free(&bp->chunks[k].payload);
+            }
+        }
+        free(bp->chunks);
+    }
+    free(plan->blocks);
+    free(plan->tags);
+    free(plan->slots);
+    free(plan->vals);
+    free(plan->ref_slots);
+    ison_writer_free(&plan->refs);
+    pool_free(&plan->pool);
+}
+
+static void write_block_entry(ison_writer_t *w, binary_plan_t *plan, const block_plan_t *bp) {
+    unsigned char entry[BLOCK_ENTRY_SIZE] = {0};
+    put_le64(entry, pool_intern(&plan->pool, bp->block->kind));
+    put_le64(entry + 8, pool_intern(&plan->pool, bp->block->name));
+    /* Rows without fields carry nothing and would not survive text either */
+    bool rows = bp->block->field_count > 0;
+    put_le64(entry + 16, rows ? bp->block->row_count : 0);
+    put_le32(entry + 24, (uint32_t)bp->block->field_count);
+    put_le32(entry + 28, rows && bp->block->summary_row ? BLOCK_HAS_SUMMARY : 0);
+    put_le64(entry + 32, bp->fields_offset);
+    put_le64(entry + 40, bp->columns_offset);
+    ison_writer_write(w, (const char *)entry, sizeof(entry));
+}
+
+ison_binary_options_t ison_default_binary_options(void) {
+    ison_binary_options_t opts;
+    opts.compress = false;
+    return opts;
+}
+
+ison_error_t ison_dump_binary_writer(const ison_document_t *doc, ison_writer_t *w,
+                                     const ison_binary_options_t *options) {
+    if (!w) return ISON_ERROR_INVALID;
+    if (!doc) return ISON_ERROR_INVALID;
+    if (w->error != ISON_OK) return w->error;
+    ison_binary_options_t defaults = ison_default_binary_options();
+    if (!options) options = &defaults;
+
+    binary_plan_t plan;
+    memset(&plan, 0, sizeof(plan));
+    if (!pool_init(&plan.pool) || ison_writer_init_memory(&plan.refs, 1024) != ISON_OK) {
+        plan_free(&plan);
+        return ISON_ERROR_MEMORY;
+    }
+
+    plan.blocks = calloc(doc->order_count ? doc->order_count : 1, sizeof(block_plan_t));
+    if (!plan.blocks) plan.error = ISON_ERROR_MEMORY;
+    for (size_t i = 0; i < doc->order_count && plan.error == ISON_OK; i++) {
+        ison_block_t *block = ison_document_get(doc, doc->order[i]);
+        if (!block) continue;
+        if (block->field_count > UINT32_MAX) plan.error = ISON_ERROR_OVERFLOW;
+        block_plan_t *bp = &plan.blocks[plan.block_count++];
+        bp->block = block;
+        /* Names first, so the directory strings sit at the front of the heap */
+        pool_intern(&plan.pool, block->kind);
+        pool_intern(&plan.pool, block->name);
+        for (size_t j = 0; j < block->field_count; j++) {
+            pool_intern(&plan.pool, block->fields[j].name);
+            pool_intern(&plan.pool, block->fields[j].type_hint);
+        }
+        if (plan.error == ISON_OK && !plan_block(&plan, bp, options)) plan.error = ISON_ERROR_MEMORY;
+    }
+    if (plan.error == ISON_OK && plan.pool.heap.error != ISON_OK) plan.error = plan.pool.heap.error;
+    if (plan.error == ISON_OK && plan.refs.error != ISON_OK) plan.error = plan.refs.error;
+    if (plan.error != ISON_OK) {
+        plan_free(&plan);
+        return plan.error;
+    }
+
+    /* Layout */
+    uint64_t off = HEADER_SIZE + (uint64_t)plan.block_count * BLOCK_ENTRY_SIZE;
+    for (size_t i = 0; i < plan.block_count; i++) {
+        plan.blocks[i].fields_offset = off;
+        off += (uint64_t)plan.blocks[i].block->field_count * FIELD_ENTRY_SIZE;
+    }
+    for (size_t i = 0; i < plan.block_count; i++) {
+        plan.blocks[i].columns_offset = off;
+        off += (uint64_t)plan.blocks[i].block->field_count * COLUMN_ENTRY_SIZE;
+    }
+    for (size_t i = 0; i < plan.block_count; i++) {
+        block_plan_t *bp = &plan.blocks[i];
+        bp->chunks_offset = off;
+        off += (uint64_t)bp->block->field_count * bp->chunk_count * CHUNK_ENTRY_SIZE;
+    }
+    for (size_t i = 0; i < plan.block_count; i++) {
+        block_plan_t *bp = &plan.blocks[i];
+        for (size_t k = 0; k < bp->block->field_count * bp->chunk_count; k++) {
+            off = align8(off);
+            bp->chunks[k].offset = bp->chunks[k].payload.len ? off : 0;
+            off += bp->chunks[k].payload.len;
+        }
+    }
+    uint64_t refs_offset = align8(off);
+    uint64_t heap_offset = align8(refs_offset + plan.refs.len);
+    uint64_t file_size = align8(heap_offset + plan.pool.heap.len);
+
+    /* Header */
+    uint64_t start = w->total;
+    unsigned char header[HEADER_SIZE] = {0};
+    memcpy(header, ISONB_MAGIC, 8);
+    put_le32(header + 8, ISONB_VERSION);
+    put_le32(header + 12, (uint32_t)plan.block_count);
+    put_le64(header + 16, file_size);
+    put_le64(header + 24, HEADER_SIZE);
+    put_le64(header + 32, heap_offset);
+    put_le64(header + 40, plan.pool.heap.len);
+    put_le64(header + 48, refs_offset);
+    put_le64(header + 56, plan.ref_count);
+    ison_writer_write(w, (const char *)header, sizeof(header));
+
+    for (size_t i = 0; i < plan.block_count; i++) {
+        write_block_entry(w, &plan, &plan.blocks[i]);
+    }
+    for (size_t i = 0; i < plan.block_count; i++) {
+        const ison_block_t *block = plan.blocks[i].block;
+        for (size_t j = 0; j < block->field_count; j++) {
+            write_le64(w, pool_intern(&plan.pool, block->fields[j].name));
+            write_le64(w, pool_intern(&plan.pool, block->fields[j].type_hint));
+        }
+    }
+    for (size_t i = 0; i < plan.block_count; i++) {
+        block_plan_t *bp = &plan.blocks[i];
+        for (size_t j = 0; j < bp->block->field_count; j++) {
+            unsigned char entry[COLUMN_ENTRY_SIZE] = {0};
+            put_le32(entry, (uint32_t)bp->chunk_count);
+            put_le64(entry + 8, bp->chunks_offset + (uint64_t)j * bp->chunk_count * CHUNK_ENTRY_SIZE);
+            ison_writer_write(w, (const char *)entry, sizeof(entry));
+        }
+    }
+    for (size_t i = 0; i < plan.block_count; i++) {
+        block_plan_t *bp = &plan.blocks[i];
+        for (size_t k = 0; k < bp->block->field_count * bp->chunk_count; k++) {
+            const chunk_plan_t *chunk = &bp->chunks[k];
+            unsigned char entry[CHUNK_ENTRY_SIZE] = {0};
+            put_le64(entry, chunk->offset);
+            put_le64(entry + 8, chunk->payload.len);
+            put_le64(entry + 16, chunk->raw_size);
+            put_le32(entry + 24, chunk->rows);
+            entry[28] = chunk->type;
+            entry[29] = chunk->encoding;
+            ison_writer_write(w, (const char *)entry, sizeof(entry));
+        }
+    }
+    for (size_t i = 0; i < plan.block_count; i++) {
+        block_plan_t *bp = &plan.blocks[i];
+        for (size_t k = 0; k < bp->block->field_count * bp->chunk_count; k++) {
+            if (!bp->chunks[k].payload.len) continue;
+            write_padding(w, start + bp->chunks[k].offset);
+            ison_writer_write(w, bp->chunks[k].payload.buf, bp->chunks[k].payload.len);
+        }
+    }
+    write_padding(w, start + refs_offset);
+    ison_writer_write(w, plan.refs.buf, plan.refs.len);
+    write_padding(w, start + heap_offset);
+    ison_writer_write(w, plan.pool.heap.buf, plan.pool.heap.len);
+    write_padding(w, start + file_size);
+
+    plan_free(&plan);
+    return w->error;
+}
+
+ison_error_t ison_dump_binary(const ison_document_t *doc, const char *path) {
+    return ison_dump_binary_with_options(doc, path, NULL);
+}
+
+ison_error_t ison_dump_binary_with_options(const ison_document_t *doc, const char *path,
+                                           const ison_binary_options_t *options) {
+    if (!doc || !path) return ISON_ERROR_INVALID;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return ISON_ERROR_IO;
+
+    ison_writer_t w;
+    ison_error_t err = ison_writer_init_fd(&w, fd, 0);
+    if (err == ISON_OK) err = ison_dump_binary_writer(doc, &w, options);
+    if (err == ISON_OK) err = ison_writer_flush(&w);
+    ison_writer_free(&w);
+    if (close(fd) != 0 && err == ISON_OK) err = ISON_ERROR_IO;
+    return err;
+}
+
+/* ==================== Loading ==================== */
+
+typedef struct {
+    const unsigned char *data;  /* NULL for chunks without payload */
+    unsigned char *decoded;     /* raw payload of an encoded chunk, built on first access */
+    uint64_t size;
+    uint64_t raw_size;
+    uint32_t rows;
+    uint8_t type;
+    uint8_t encoding;
+} binary_chunk_t;
+
+/* Marks a chunk whose payload failed to decode, so it is not retried on every cell */
+static unsigned char decode_failed;
+
+struct ison_binary_column {
+    binary_chunk_t *chunks;
+    uint32_t chunk_count;
+};
+
+struct ison_binary {
+    const unsigned char *data;
+    uint64_t size;
+    void *map;                  /* mmap'ed file, or NULL */
+    const unsigned char *heap;
+    uint64_t heap_size;
+    const unsigned char *refs;
+    uint64_t ref_count;
+    ison_binary_block_t *blocks;
+    size_t block_count;
+    ison_field_info_t *fields;
+    struct ison_binary_column *columns;
+    binary_chunk_t *chunks;
+    size_t chunk_count;
+};
+
+static int in_file(const ison_binary_t *bin, uint64_t offset, uint64_t len) {
+    return offset <= bin->size && len <= bin->size - offset;
+}
+
+/* A heap string, or NULL when the offset does not point at one */
+static const char *heap_string(const ison_binary_t *bin, uint64_t offset) {
+    if (offset < 8 || offset >= bin->heap_size) return NULL;
+    uint32_t len = get_le32(bin->heap + offset - 4);
+    if (len >= bin->heap_size - offset || bin->heap[offset + len] != '\0') return NULL;
+    return (const char *)bin->heap + offset;
+}
+
+/* Expected raw payload size of a chunk */
+static uint64_t chunk_raw_size(uint8_t type, uint32_t rows) {
+    switch (type) {
+        case TAG_NULL:
+        case TAG_ABSENT: return 0;
+        case TAG_BOOL: return align8(rows);
+        case TAG_MIXED: return align8(rows) + (uint64_t)rows * 8;
+        case TAG_INT:
+        case TAG_FLOAT:
+        case TAG_STRING:
+        case TAG_REF: return (uint64_t)rows * 8;
+        default: return UINT64_MAX;
+    }
+}
+
+static int encoding_valid(const binary_chunk_t *chunk) {
+    int transform = chunk->encoding & ENCODING_TRANSFORM;
+    if (chunk->encoding & ~(ENCODING_TRANSFORM | ENCODING_LZ)) return 0;
+    if (chunk->encoding == ENCODING_RAW) return chunk->size == chunk->raw_size;
+    if (chunk->raw_size == 0) return 0;
+    if (transform == ENCODING_RAW) return 1;
+    return transform <= ENCODING_DELTA &&
+           (chunk->type == TAG_INT || chunk->type == TAG_STRING || chunk->type == TAG_REF);
+}
+
+/* Resolve the directory into pointers; nothing per row is touched */
+static ison_error_t binary_fixup(ison_binary_t *bin) {
+    const unsigned char *h = bin->data;
+    if (bin->size < HEADER_SIZE || memcmp(h, ISONB_MAGIC, 8) != 0) return ISON_ERROR_PARSE;
+    if (get_le32(h + 8) != ISONB_VERSION) return ISON_ERROR_PARSE;
+
+    size_t block_count = get_le32(h + 12);
+    uint64_t dir = get_le64(h + 24);
+    uint64_t heap = get_le64(h + 32);
+    bin->heap_size = get_le64(h + 40);
+    uint64_t refs = get_le64(h + 48);
+    bin->ref_count = get_le64(h + 56);
+    if (get_le64(h + 16) > bin->size || !in_file(bin, heap, bin->heap_size) ||
+        bin->ref_count > bin->size / REF_ENTRY_SIZE || !in_file(bin, refs, bin->ref_count * REF_ENTRY_SIZE) ||
+        block_count > bin->size / BLOCK_ENTRY_SIZE || !in_file(bin, dir, (uint64_t)block_count * BLOCK_ENTRY_SIZE)) {
+        return ISON_ERROR_PARSE;
+    }
+    bin->heap = bin->data + heap;
+    bin->refs = bin->data + refs;
+
+    /* Count fields and chunks first so every table is one allocation */
+    size_t total_fields = 0, total_chunks = 0;
+    for (size_t i = 0; i < block_count; i++) {
+        const unsigned char *e = bin->data + dir + i * BLOCK_ENTRY_SIZE;
+        uint64_t fields = get_le32(e + 24);
+        uint64_t columns = get_le64(e + 40);
+        if (fields > bin->size / COLUMN_ENTRY_SIZE || !in_file(bin, columns, fields * COLUMN_ENTRY_SIZE) ||
+            !in_file(bin, get_le64(e + 32), fields * FIELD_ENTRY_SIZE)) {
+            return ISON_ERROR_PARSE;
+        }
+        total_fields += (size_t)fields;
+        for (uint64_t j = 0; j < fields; j++) {
+            uint64_t n = get_le32(bin->data + columns + j * COLUMN_ENTRY_SIZE);
+            if (!in_file(bin, get_le64(bin->data + columns + j * COLUMN_ENTRY_SIZE + 8), n * CHUNK_ENTRY_SIZE)) {
+                return ISON_ERROR_PARSE;
+            }
+            total_chunks += (size_t)n;
+        }
+    }
+
+    bin->block_count = block_count;
+    bin->blocks = calloc(block_count ? block_count : 1, sizeof(ison_binary_block_t));
+    bin->columns = calloc(total_fields ? total_fields : 1, sizeof(struct ison_binary_column));
+    bin->chunks = calloc(total_chunks ? total_chunks : 1, sizeof(binary_chunk_t));
+    if (bin->chunks) bin->chunk_count = total_chunks;
+    bin->fields = calloc(total_fields ? total_fields : 1, sizeof(ison_field_info_t));
+    if (!bin->blocks || !bin->columns || !bin->chunks || !bin->fields) return ISON_ERROR_MEMORY;
+
+    struct ison_binary_column *column = bin->columns;
+    binary_chunk_t *chunk = bin->chunks;
+    ison_field_info_t *info = bin->fields;
+    for (size_t i = 0; i < block_count; i++) {
+        const unsigned char *e = bin->data + dir + i * BLOCK_ENTRY_SIZE;
+        ison_binary_block_t *block = &bin->blocks[i];
+        block->kind = heap_string(bin, get_le64(e));
+        block->name = heap_string(bin, get_le64(e + 8));
+        block->row_count = (size_t)get_le64(e + 16);
+        block->field_count = get_le32(e + 24);
+        block->has_summary = (get_le32(e + 28) & BLOCK_HAS_SUMMARY) != 0;
+        block->fields = info;
+        block->columns = column;
+        if (!block->kind || !block->name) goto corrupt;
+
+        uint64_t stored = (uint64_t)block->row_count + (block->has_summary ? 1 : 0);
+        if (block->field_count == 0 && stored > 0) goto corrupt;
+        uint64_t fields = get_le64(e + 32);
+        uint64_t columns = get_le64(e + 40);
+        for (size_t j = 0; j < block->field_count; j++, info++, column++) {
+            const unsigned char *f = bin->data + fields + j * FIELD_ENTRY_SIZE;
+            info->name = (char *)heap_string(bin, get_le64(f));
+            info->type_hint = (char *)heap_string(bin, get_le64(f + 8));
+            if (!info->name) goto corrupt;
+            if (!info->type_hint) info->type_hint = (char *)"";
+
+            const unsigned char *c = bin->data + columns + j * COLUMN_ENTRY_SIZE;
+            column->chunk_count = get_le32(c);
+            column->chunks = chunk;
+            if ((uint64_t)column->chunk_count != (stored + ISONB_CHUNK_ROWS - 1) / ISONB_CHUNK_ROWS) goto corrupt;
+
+            uint64_t table = get_le64(c + 8);
+            for (uint32_t k = 0; k < column->chunk_count; k++, chunk++) {
+                const unsigned char *ce = bin->data + table + (uint64_t)k * CHUNK_ENTRY_SIZE;
+                uint64_t offset = get_le64(ce);
+                chunk->size = get_le64(ce + 8);
+                chunk->raw_size = get_le64(ce + 16);
+                chunk->rows = get_le32(ce + 24);
+                chunk->type = ce[28];
+                chunk->encoding = ce[29];
+                uint64_t expect_rows = stored - (uint64_t)k * ISONB_CHUNK_ROWS;
+                if (expect_rows > ISONB_CHUNK_ROWS) expect_rows = ISONB_CHUNK_ROWS;
+                if (chunk->rows != expect_rows || !in_file(bin, offset, chunk->size) ||
+                    chunk->raw_size != chunk_raw_size(chunk->type, chunk->rows) ||
+                    !encoding_valid(chunk)) {
+                    goto corrupt;
+                }
+                chunk->data = chunk->size ? bin->data + offset : NULL;
+            }
+        }
+    }
+    return ISON_OK;
+
+corrupt:
+    return ISON_ERROR_PARSE;
+}
+
+static ison_binary_t *binary_open(ison_binary_t *bin, ison_error_t *error) {
+    ison_error_t err = binary_fixup(bin);
+    if (err != ISON_OK) {
+        ison_binary_close(bin);
+        if (error) *error = err;
+        return NULL;
+    }
+    return bin;
+}
+
+ison_binary_t *ison_binary_from_memory(const void *data, size_t len, ison_error_t *error) {
+    if (error) *error = ISON_OK;
+    if (!data) {
+        if (error) *error = ISON_ERROR_INVALID;
+        return NULL;
+    }
+    ison_binary_t *bin = calloc(1, sizeof(ison_binary_t));
+    if (!bin) {
+        if (error) *error = ISON_ERROR_MEMORY;
+        return NULL;
+    }
+    bin->data = data;
+    bin->size = len;
+    return binary_open(bin, error);
+}
+
+ison_binary_t *ison_binary_open(const char *path, ison_error_t *error) {
+    if (error) *error = ISON_OK;
+    if (!path) {
+        if (error) *error = ISON_ERROR_INVALID;
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (error) *error = ISON_ERROR_IO;
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        if (error) *error = ISON_ERROR_IO;
+        return NULL;
+    }
+    if (st.st_size < HEADER_SIZE) {
+        close(fd);
+        if (error) *error = ISON_ERROR_PARSE;
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        if (error) *error = ISON_ERROR_IO;
+        return NULL;
+    }
+
+    ison_binary_t *bin = calloc(1, sizeof(ison_binary_t));
+    if (!bin) {
+        munmap(map, (size_t)st.st_size);
+        if (error) *error = ISON_ERROR_MEMORY;
+        return NULL;
+    }
+    bin->map = map;
+    bin->data = map;
+    bin->size = (uint64_t)st.st_size;
+    return binary_open(bin, error);
+}
+
+void ison_binary_close(ison_binary_t *bin) {
+    if (!bin) return;
+    for (size_t i = 0; i < bin->chunk_count; i++) {
+        if (bin->chunks[i].decoded != &decode_failed) free(bin->chunks[i].decoded);
+    }
+    free(bin->blocks);
+    free(bin->fields);
+    free(bin->columns);
+    free(bin->chunks);
+    if (bin->map) munmap(bin->map, (size_t)bin->size);
+    free(bin);
+}
+
+size_t ison_binary_block_count(const ison_binary_t *bin) {
+    return bin ? bin->block_count : 0;
+}
+
+const ison_binary_block_t *ison_binary_block(const ison_binary_t *bin, size_t index) {
+    if (!bin || index >= bin->block_count) return NULL;
+    return &bin->blocks[index];
+}
+
+const ison_binary_block_t *ison_binary_find(const ison_binary_t *bin, const char *name) {
+    if (!bin || !name) return NULL;
+    for (size_t i = 0; i < bin->block_count; i++) {
+        if (strcmp(bin->blocks[i].name, name) == 0) return &bin->blocks[i];
+    }
+    return NULL;
+}
+
+static bool binary_ref(const ison_binary_t *bin, uint64_t index, ison_value_t *out) {
+    if (index >= bin->ref_count) return false;
+    const unsigned char *e = bin->refs + index * REF_ENTRY_SIZE;
+    uint64_t ns = get_le64(e + 8), rel = get_le64(e + 16);
+    out->type = ISON_TYPE_REFERENCE;
+    out->data.ref_val.id = (char *)heap_string(bin, get_le64(e));
+    out->data.ref_val.ns = ns ? (char *)heap_string(bin, ns) : NULL;
+    out->data.ref_val.relationship = rel ? (char *)heap_string(bin, rel) : NULL;
+    return out->data.ref_val.id && (!ns || out->data.ref_val.ns) && (!rel || out->data.ref_val.relationship);
+}
+
+static int unpack_bits(const unsigned char *p, uint64_t len, uint64_t *out, size_t count) {
+    if (len < PACK_HEADER_SIZE) return 0;
+    int width = p[8];
+    if (width > 64 || len != packed_size(count, width)) return 0;
+
+    const unsigned char *words = p + PACK_HEADER_SIZE;
+    uint64_t mask = width == 64 ? UINT64_MAX : ((uint64_t)1 << width) - 1;
+    uint64_t bit = 0;
+    for (size_t i = 0; i < count; i++, bit += (uint64_t)width) {
+        if (width == 0) {
+            out[i] = 0;
+            continue;
+        }
+        size_t word = (size_t)(bit >> 6);
+        int shift = (int)(bit & 63);
+        uint64_t v = get_le64(words + word * 8) >> shift;
+        if (shift + width > 64) v |= get_le64(words + (word + 1) * 8) << (64 - shift);
+        out[i] = v & mask;
+    }
+    return 1;
+}
+
+/* Undo a FOR or DELTA transform into rows little-endian u64 slots */
+static int unpack_slots(int transform, const unsigned char *p, uint64_t len, unsigned char *raw, uint32_t rows) {
+    uint64_t *vals = malloc((size_t)rows * sizeof(uint64_t));
+    if (!vals) return 0;
+    uint64_t base = len >= PACK_HEADER_SIZE ? get_le64(p) : 0;
+    int ok;
+    if (transform == ENCODING_FOR) {
+        ok = unpack_bits(p, len, vals, rows);
+        for (uint32_t r = 0; ok && r < rows; r++) put_le64(raw + (size_t)r * 8, base + vals[r]);
+    } else {
+        ok = unpack_bits(p, len, vals, rows - 1);
+        uint64_t v = base;
+        if (ok) put_le64(raw, v);
+        for (uint32_t r = 1; ok && r < rows; r++) {
+            uint64_t zz = vals[r - 1];
+            v += (zz >> 1) ^ (0 - (zz & 1));
+            put_le64(raw + (size_t)r * 8, v);
+        }
+    }
+    free(vals);
+    return ok;
+}
+
+static unsigned char *decode_chunk(const binary_chunk_t *chunk) {
+    const unsigned char *p = chunk->data;
+    uint64_t len = chunk->size;
+    unsigned char *lz = NULL;
+    int transform = chunk->encoding & ENCODING_TRANSFORM;
+
+    if (chunk->encoding & ENCODING_LZ) {
+        uint64_t inner = len >= 8 ? get_le64(p) : UINT64_MAX;
+        if (inner == UINT64_MAX || (transform == ENCODING_RAW && inner != chunk->raw_size) ||
+            inner > chunk->raw_size + PACK_HEADER_SIZE) {
+            return NULL;
+        }
+        lz = malloc(inner ? (size_t)inner : 1);
+        if (!lz || !ison_lz_decompress(p + 8, (size_t)(len - 8), lz, (size_t)inner)) {
+            free(lz);
+            return NULL;
+        }
+        if (transform == ENCODING_RAW) return lz;
+        p = lz;
+        len = inner;
+    }
+
+    unsigned char *raw = malloc((size_t)chunk->raw_size);
+    if (raw && !unpack_slots(transform, p, len, raw, chunk->rows)) {
+        free(raw);
+        raw = NULL;
+    }
+    free(lz);
+    return raw;
+}
+
+/* Raw payload of a chunk, decoding it on first use; safe to race, the first decoder wins */
+static const unsigned char *chunk_payload(binary_chunk_t *chunk) {
+    if (chunk->encoding == ENCODING_RAW) return chunk->data;
+    unsigned char *raw = __atomic_load_n(&chunk->decoded, __ATOMIC_ACQUIRE);
+    if (!raw) {
+        unsigned char *expected = NULL;
+        raw = decode_chunk(chunk);
+        if (!raw) raw = &decode_failed;
+        if (!__atomic_compare_exchange_n(&chunk->decoded, &expected, raw, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            if (raw != &decode_failed) free(raw);
+            raw = expected;
+        }
+    }
+    return raw == &decode_failed ? NULL : raw;
+}
+
+bool ison_binary_get(const ison_binary_t *bin, const ison_binary_block_t *block, size_t row, size_t field,
+                     ison_value_t *out) {
+    if (!bin || !block || !out || field >= block->field_count) return false;
+    if (row >= block->row_count + (block->has_summary ? 1 : 0)) return false;
+
+    binary_chunk_t *chunk = &block->columns[field].chunks[row / ISONB_CHUNK_ROWS];
+    size_t i = row % ISONB_CHUNK_ROWS;
+    uint8_t tag = chunk->type;
+    uint64_t slot = 0;
+    const unsigned char *data = NULL;
+    if (tag != TAG_NULL && tag != TAG_ABSENT) {
+        data = chunk_payload(chunk);
+        if (!data) return false;
+    }
+    if (tag == TAG_MIXED) {
+        tag = data[i];
+        slot = get_le64(data + align8(chunk->rows) + i * 8);
+    } else if (tag == TAG_BOOL) {
+        slot = data[i];
+    } else if (data) {
+        slot = get_le64(data + i * 8);
+    }
+
+    switch (tag) {
+        case TAG_NULL:
+            *out = ison_null();
+            return true;
+        case TAG_BOOL:
+            *out = ison_bool(slot != 0);
+            return true;
+        case TAG_INT:
+            *out = ison_int((int64_t)slot);
+            return true;
+        case TAG_FLOAT: {
+            double d;
+            memcpy(&d, &slot, sizeof(double));
+            *out = ison_float(d);
+            return true;
+        }
+        case TAG_STRING:
+            out->type = ISON_TYPE_STRING;
+            out->data.string_val = (char *)heap_string(bin, slot);
+            return out->data.string_val != NULL;
+        case TAG_REF:
+            return binary_ref(bin, slot, out);
+        default:
+            return false;
+    }
+}
+
+ison_document_t *ison_binary_to_document(const ison_binary_t *bin, ison_error_t *error) {
+    if (error) *error = ISON_OK;
+    if (!bin) {
+        if (error) *error = ISON_ERROR_INVALID;
+        return NULL;
+    }
+
+    ison_document_t *doc = ison_document_create();
+    if (!doc) {
+        if (error) *error = ISON_ERROR_MEMORY;
+        return NULL;
+    }
+    for (size_t i = 0; i < bin->block_count; i++) {
+        const ison_binary_block_t *bb = &bin->blocks[i];
+        ison_block_t *block = ison_block_create(bb->kind, bb->name);
+        if (!block) {
+            ison_document_free(doc);
+            if (error) *error = ISON_ERROR_MEMORY;
+            return NULL;
+        }
+        for (size_t j = 0; j < bb->field_count; j++) {
+            ison_block_add_field(block, bb->fields[j].name, bb->fields[j].type_hint);
+        }
+
+        size_t stored = bb->row_count + (bb->has_summary ? 1 : 0);
+        for (size_t r = 0; r < stored; r++) {
+            ison_row_t *row = ison_row_create();
+            for (size_t j = 0; row && j < bb->field_count; j++) {
+                ison_value_t raw;
+                if (!ison_binary_get(bin, bb, r, j, &raw)) continue;
+                ison_value_t val = ison_value_copy(&raw);
+                ison_row_set(row, bb->fields[j].name, &val);
+            }
+            if (r < bb->row_count) {
+                ison_block_take_row(block, row);
+            } else {
+                block->summary_row = row;
+            }
+        }
+        ison_document_add_block(doc, block);
+    }
+    return doc;
+}
+
+ison_document_t *ison_load_binary(const char *path, ison_error_t *error) {
+    ison_binary_t *bin = ison_binary_open(path, error);
+    if (!bin) return NULL;
+    ison_document_t *doc = ison_binary_to_document(bin, error);
+    ison_binary_close(bin);
+    return doc;
+}
+
+/* ==================== Text conversion ==================== */
+
+static void write_binary_row(ison_writer_t *w, const ison_binary_t *bin, const ison_binary_block_t *block,
+                             size_t row) {
+    for (size_t j = 0; j < block->field_count; j++) {
+        if (j > 0) ison_writer_putc(w, ' ');
+        ison_value_t val;
+        ison_value_append(w, ison_binary_get(bin, block, row, j, &val) ? &val : NULL);
+    }
+    ison_writer_putc(w, '\n');
+}
+
+/* Same text as ison_dump_writer with default options, straight from the columns */
+ison_error_t ison_binary_dump_writer(const ison_binary_t *bin, ison_writer_t *w) {
+    if (!bin || !w) return ISON_ERROR_INVALID;
+
+    for (size_t i = 0; i < bin->block_count && w->error == ISON_OK; i++) {
+        const ison_binary_block_t *block = &bin->blocks[i];
+        if (i > 0) ison_writer_putc(w, '\n');
+        ison_writer_puts(w, block->kind);
+        ison_writer_putc(w, '.');
+        ison_writer_puts(w, block->name);
+        ison_writer_putc(w, '\n');
+        for (size_t j = 0; j < block->field_count; j++) {
+            if (j > 0) ison_writer_putc(w, ' ');
+            ison_writer_puts(w, block->fields[j].name);
+            if (*block->fields[j].type_hint) {
+                ison_writer_putc(w, ':');
+                ison_writer_puts(w, block->fields[j].type_hint);
+            }
+        }
+        ison_writer_putc(w, '\n');
+
+        for (size_t r = 0; r < block->row_count && w->error == ISON_OK; r++) {
+            write_binary_row(w, bin, block, r);
+        }
+        if (block->has_summary) {
+            ison_writer_puts(w, "---\n");
+            write_binary_row(w, bin, block, block->row_count);
+        }
+    }
+    return w->error;
+}
+
+ison_error_t ison_to_isonb(const char *ison_path, const char *isonb_path, const ison_binary_options_t *options) {
+    ison_error_t err;
+    ison_document_t *doc = ison_load(ison_path, &err);
+    if (!doc) return err != ISON_OK ? err : ISON_ERROR_IO;
+    err = ison_dump_binary_with_options(doc, isonb_path, options);
+    ison_document_free(doc);
+    return err;
+}
+
+ison_error_t isonb_to_ison(const char *isonb_path, const char *ison_path) {
+    if (!ison_path) return ISON_ERROR_INVALID;
+
+    ison_error_t err;
+    ison_binary_t *bin = ison_binary_open(isonb_path, &err);
+    if (!bin) return err;
+
+    int fd = open(ison_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ison_binary_close(bin);
+        return ISON_ERROR_IO;
+    }
+    ison_writer_t w;
+    err = ison_writer_init_fd(&w, fd, 0);
+    if (err == ISON_OK) err = ison_binary_dump_writer(bin, &w);
+    if (err == ISON_OK) err = ison_writer_flush(&w);
+    ison_writer_free(&w);
+    if (close(fd) != 0 && err == ISON_OK) err = ISON_ERROR_IO;
+    ison_binary_close(bin);
+    return err;
+}
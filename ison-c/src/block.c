@@ -59,13 +59,31 @@ void ison_block_add_row(ison_block_t *block, const ison_row_t *row) {
     
     ison_row_entry_t *entry = row->head;
     while (entry) {
-        ison_row_set(copy, entry->key, &entry->value);
+        ison_value_t value = ison_value_copy(&entry->value);
+        ison_row_set(copy, entry->key, &value);
         entry = entry->next;
     }
     
     block->rows[block->row_count++] = copy;
 }
 
+void ison_block_take_row(ison_block_t *block, ison_row_t *row) {
+    if (!block || !row) return;
+    
+    if (block->row_count >= block->row_capacity) {
+        size_t new_cap = block->row_capacity == 0 ? 8 : block->row_capacity * 2;
+        ison_row_t **new_rows = realloc(block->rows, new_cap * sizeof(ison_row_t *));
+        if (!new_rows) {
+            ison_row_free(row);
+            return;
+        }
+        block->rows = new_rows;
+        block->row_capacity = new_cap;
+    }
+    
+    block->rows[block->row_count++] = row;
+}
+
 void ison_block_set_summary(ison_block_t *block, const ison_row_t *row) {
     if (!block) return;
     if (block->summary_row) {
@@ -81,7 +99,8 @@ void ison_block_set_summary(ison_block_t *block, const ison_row_t *row) {
     
     ison_row_entry_t *entry = row->head;
     while (entry) {
-        ison_row_set(block->summary_row, entry->key, &entry->value);
+        ison_value_t value = ison_value_copy(&entry->value);
+        ison_row_set(block->summary_row, entry->key, &value);
         entry = entry->next;
     }
 }
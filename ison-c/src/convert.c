@@ -1,363 +1,732 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/types.h>
 #include "ison.h"
+#include "lex.h"
 
-static void append_string(char **buf, size_t *len, size_t *cap, const char *str);
-static void append_char(char **buf, size_t *len, size_t *cap, char ch);
+/* Run a streaming converter from a string into a new string */
+static char *convert_text(ison_error_t (*convert)(ison_reader_t *, ison_writer_t *), const char *text,
+                          size_t len, ison_error_t *error) {
+    ison_reader_t r;
+    ison_writer_t w;
+    ison_reader_init_memory(&r, text, len);
+    ison_writer_init_memory(&w, 1024);
+    ison_error_t err = convert(&r, &w);
+    ison_reader_free(&r);
+    
+    char *result = ison_writer_finish(&w, NULL);
+    if (!result && err == ISON_OK) err = ISON_ERROR_MEMORY;
+    if (error) *error = err;
+    return result;
+}
 
 char *ison_to_isonl(const char *ison_text, ison_error_t *error) {
     if (error) *error = ISON_OK;
     if (!ison_text) return NULL;
-    
-    ison_document_t *doc = ison_parse(ison_text, error);
-    if (!doc) return NULL;
-    
-    char *result = ison_dumps_isonl(doc);
-    ison_document_free(doc);
-    return result;
+    return convert_text(ison_to_isonl_stream, ison_text, strlen(ison_text), error);
 }
 
 char *isonl_to_ison(const char *isonl_text, ison_error_t *error) {
     if (error) *error = ISON_OK;
     if (!isonl_text) return NULL;
-    
-    ison_document_t *doc = ison_parse_isonl(isonl_text, error);
-    if (!doc) return NULL;
-    
-    char *result = ison_dumps(doc);
-    ison_document_free(doc);
-    return result;
+    return convert_text(isonl_to_ison_stream, isonl_text, strlen(isonl_text), error);
 }
 
-char *ison_to_json(const char *ison_text, ison_error_t *error) {
-    if (error) *error = ISON_OK;
-    if (!ison_text) {
-        if (error) *error = ISON_ERROR_INVALID;
-        return NULL;
-    }
-    
-    ison_document_t *doc = ison_parse(ison_text, error);
-    if (!doc) {
-        if (error && *error == ISON_OK) *error = ISON_ERROR_PARSE;
-        return NULL;
-    }
-    
-    size_t len = 0, cap = 1024;
-    char *result = malloc(cap);
-    if (!result) {
-        ison_document_free(doc);
-        if (error) *error = ISON_ERROR_MEMORY;
-        return NULL;
+static void append_json_key(ison_writer_t *w, const char *key) {
+    ison_value_t v;
+    v.type = ISON_TYPE_STRING;
+    v.data.string_val = (char *)key;
+    ison_value_append_json(w, &v);
+    ison_writer_putc(w, ':');
+}
+
+/* A block's summary row is emitted beside its rows as "<name>_summary" */
+static void append_summary_key(ison_writer_t *w, const char *name) {
+    size_t len = strlen(name);
+    char *key = malloc(len + sizeof("_summary"));
+    if (!key) {
+        w->error = ISON_ERROR_MEMORY;
+        return;
     }
-    *result = '\0';
+    memcpy(key, name, len);
+    memcpy(key + len, "_summary", sizeof("_summary"));
+    ison_writer_putc(w, ',');
+    append_json_key(w, key);
+    free(key);
+}
+
+ison_error_t ison_dump_json_writer(const ison_document_t *doc, ison_writer_t *w) {
+    if (!w) return ISON_ERROR_INVALID;
+    if (!doc) return w->error;
     
-    append_string(&result, &len, &cap, "{");
+    ison_writer_putc(w, '{');
     
-    for (size_t i = 0; i < doc->order_count; i++) {
-        if (i > 0) append_string(&result, &len, &cap, ",");
+    for (size_t i = 0; i < doc->order_count && w->error == ISON_OK; i++) {
+        if (i > 0) ison_writer_putc(w, ',');
         
         ison_block_t *block = ison_document_get(doc, doc->order[i]);
         if (!block) continue;
         
-        append_char(&result, &len, &cap, '"');
-        append_string(&result, &len, &cap, block->name);
-        append_string(&result, &len, &cap, "\":[ ");
+        append_json_key(w, block->name);
+        ison_writer_puts(w, "[ ");
         
         for (size_t r = 0; r < block->row_count; r++) {
-            if (r > 0) append_string(&result, &len, &cap, ",");
-            append_string(&result, &len, &cap, "{");
+            if (r > 0) ison_writer_putc(w, ',');
+            ison_writer_putc(w, '{');
             
             ison_row_t *row = block->rows[r];
             int first = 1;
             for (size_t j = 0; j < block->field_count; j++) {
                 ison_value_t *val = ison_row_get_ptr(row, block->fields[j].name);
                 if (val) {
-                    if (!first) append_string(&result, &len, &cap, ",");
+                    if (!first) ison_writer_putc(w, ',');
                     first = 0;
                     
-                    append_char(&result, &len, &cap, '"');
-                    append_string(&result, &len, &cap, block->fields[j].name);
-                    append_string(&result, &len, &cap, "\":");
-                    
-                    char *json_val = ison_value_to_json(val);
-                    append_string(&result, &len, &cap, json_val);
-                    free(json_val);
+                    append_json_key(w, block->fields[j].name);
+                    ison_value_append_json(w, val);
                 }
             }
-            append_string(&result, &len, &cap, "}");
+            ison_writer_putc(w, '}');
         }
         
-        append_string(&result, &len, &cap, "]");
+        ison_writer_putc(w, ']');
+        
+        if (block->summary_row) {
+            append_summary_key(w, block->name);
+            ison_writer_putc(w, '{');
+            int first = 1;
+            for (size_t j = 0; j < block->field_count; j++) {
+                ison_value_t *val = ison_row_get_ptr(block->summary_row, block->fields[j].name);
+                if (val) {
+                    if (!first) ison_writer_putc(w, ',');
+                    first = 0;
+                    
+                    append_json_key(w, block->fields[j].name);
+                    ison_value_append_json(w, val);
+                }
+            }
+            ison_writer_putc(w, '}');
+        }
     }
     
-    append_string(&result, &len, &cap, "}");
-    ison_document_free(doc);
-    return result;
+    ison_writer_putc(w, '}');
+    return w->error;
+}
+
+/* ==================== Streaming conversion ==================== */
+
+typedef enum {
+    WALK_DONE,
+    WALK_BLOCK,      /* block line seen; kind and name are set */
+    WALK_FIELDS,     /* field line lexed into header and hints */
+    WALK_ROW,        /* data row lexed into cells */
+    WALK_SUMMARY,    /* summary row lexed into cells */
+    WALK_BLOCK_END
+} walk_event_t;
+
+/*
+ * Pull-style view of ISON text following ison_parse's block rules. Only
+ * the current block's kind, name and field header are held; row cells are
+ * valid until the next call.
+ */
+typedef struct {
+    ison_reader_t *in;
+    ison_lexer_t header;   /* field names, split from their types in place */
+    char **hints;
+    size_t hints_cap;
+    ison_lexer_t cells;
+    char *kind;
+    char *name;
+    const char *pending;   /* block line that ended the previous block */
+    size_t pending_len;
+    int state;             /* 0: between blocks, 1: expecting fields, 2: in rows */
+    int in_summary;
+    ison_error_t error;
+} ison_walker_t;
+
+static walk_event_t walk_fail(ison_walker_t *wk, ison_error_t error) {
+    wk->error = error;
+    return WALK_DONE;
 }
 
-static void skip_ws(const char **p) {
-    while (**p && (**p == ' ' || **p == '\t' || **p == '\n' || **p == '\r')) (*p)++;
+static int walk_begin(ison_walker_t *wk, const char *line, size_t len) {
+    /* kind and name share one allocation: "kind\0name\0" */
+    char *copy = realloc(wk->kind, len + 1);
+    if (!copy) return 0;
+    memcpy(copy, line, len);
+    copy[len] = '\0';
+    char *dot = strchr(copy, '.');
+    *dot = '\0';
+    wk->kind = copy;
+    wk->name = dot + 1;
+    wk->header.count = 0;
+    wk->in_summary = 0;
+    return 1;
 }
 
-static char *parse_json_string(const char **p) {
-    if (**p != '"') return NULL;
-    (*p)++;
+static int walk_header(ison_walker_t *wk, const char *line, size_t len) {
+    if (!ison_lex_line(&wk->header, line, len)) return 0;
+    if (wk->header.count > wk->hints_cap) {
+        char **hints = realloc(wk->hints, wk->header.count * sizeof(char *));
+        if (!hints) return 0;
+        wk->hints = hints;
+        wk->hints_cap = wk->header.count;
+    }
+    for (size_t i = 0; i < wk->header.count; i++) {
+        char *name;
+        ison_lex_field_def(wk->header.tokens[i].text, &name, &wk->hints[i]);
+    }
+    return 1;
+}
+
+static walk_event_t walk_next(ison_walker_t *wk) {
+    const char *line;
+    size_t len;
     
-    const char *start = *p;
-    size_t len = 0;
-    while (**p && **p != '"') {
-        if (**p == '\\') {
-            (*p) += 2;
-            len++;
+    for (;;) {
+        if (wk->pending) {
+            line = wk->pending;
+            len = wk->pending_len;
+            wk->pending = NULL;
+        } else if (ison_reader_next_line(wk->in, &line, &len)) {
+            ison_lex_trim(&line, &len);
         } else {
-            (*p)++;
-            len++;
+            if (wk->in->error != ISON_OK) return walk_fail(wk, wk->in->error);
+            if (wk->state == 0) return WALK_DONE;
+            wk->state = 0;
+            return WALK_BLOCK_END;
         }
-    }
-    
-    char *result = malloc(len + 1);
-    if (!result) return NULL;
-    
-    const char *src = start;
-    char *dst = result;
-    while (src < *p) {
-        if (*src == '\\') {
-            src++;
-            switch (*src) {
-                case '"': *dst++ = '"'; break;
-                case '\\': *dst++ = '\\'; break;
-                case '/': *dst++ = '/'; break;
-                case 'b': *dst++ = '\b'; break;
-                case 'f': *dst++ = '\f'; break;
-                case 'n': *dst++ = '\n'; break;
-                case 'r': *dst++ = '\r'; break;
-                case 't': *dst++ = '\t'; break;
-                default: *dst++ = *src;
+        
+        if (wk->state == 2) {
+            if (len == 0) {
+                wk->state = 0;
+                return WALK_BLOCK_END;
+            }
+            if (line[0] == '#') continue;
+            if (ison_lex_is_block_line(line, len)) {
+                wk->pending = line;
+                wk->pending_len = len;
+                wk->state = 0;
+                return WALK_BLOCK_END;
+            }
+            if (len == 3 && memcmp(line, "---", 3) == 0) {
+                wk->in_summary = 1;
+                continue;
             }
-            src++;
+            if (!ison_lex_line(&wk->cells, line, len)) return walk_fail(wk, ISON_ERROR_MEMORY);
+            return wk->in_summary ? WALK_SUMMARY : WALK_ROW;
+        }
+        
+        if (len == 0 || line[0] == '#') continue;
+        
+        if (wk->state == 1) {
+            if (!walk_header(wk, line, len)) return walk_fail(wk, ISON_ERROR_MEMORY);
+            wk->state = 2;
+            return WALK_FIELDS;
+        }
+        if (ison_lex_is_block_line(line, len)) {
+            if (!walk_begin(wk, line, len)) return walk_fail(wk, ISON_ERROR_MEMORY);
+            wk->state = 1;
+            return WALK_BLOCK;
+        }
+    }
+}
+
+static void walk_init(ison_walker_t *wk, ison_reader_t *in) {
+    memset(wk, 0, sizeof(*wk));
+    wk->in = in;
+}
+
+static void walk_free(ison_walker_t *wk) {
+    ison_lexer_free(&wk->header);
+    ison_lexer_free(&wk->cells);
+    free(wk->hints);
+    free(wk->kind);
+}
+
+static size_t walk_cell_count(const ison_walker_t *wk) {
+    return wk->cells.count < wk->header.count ? wk->cells.count : wk->header.count;
+}
+
+static void append_json_cells(ison_writer_t *w, ison_walker_t *wk) {
+    ison_writer_putc(w, '{');
+    size_t n = walk_cell_count(wk);
+    for (size_t i = 0; i < n; i++) {
+        ison_value_t val = ison_lex_value(wk->cells.tokens[i].text, wk->hints[i]);
+        if (i > 0) ison_writer_putc(w, ',');
+        append_json_key(w, wk->header.tokens[i].text);
+        ison_value_append_json(w, &val);
+    }
+    ison_writer_putc(w, '}');
+}
+
+/* Space-separated cells under the given hints; missing trailing cells print as null */
+static void append_ison_cells(ison_writer_t *w, ison_lexer_t *cells, char **hints, size_t field_count) {
+    for (size_t i = 0; i < field_count; i++) {
+        if (i > 0) ison_writer_putc(w, ' ');
+        if (i < cells->count) {
+            ison_value_t val = ison_lex_value(cells->tokens[i].text, hints[i]);
+            ison_value_append(w, &val);
         } else {
-            *dst++ = *src++;
+            ison_value_append(w, NULL);
         }
     }
-    *dst = '\0';
-    
-    if (**p == '"') (*p)++;
-    return result;
 }
 
-static ison_value_t parse_json_value(const char **p);
+static ison_error_t stream_result(const ison_walker_t *wk, const ison_writer_t *out) {
+    if (wk->error != ISON_OK) return wk->error;
+    return out->error;
+}
 
-static ison_row_t *parse_json_object(const char **p) {
-    if (**p != '{') return NULL;
-    (*p)++;
+ison_error_t ison_to_json_stream(ison_reader_t *in, ison_writer_t *out) {
+    if (!in || !out) return ISON_ERROR_INVALID;
     
-    ison_row_t *row = ison_row_create();
-    skip_ws(p);
+    ison_walker_t wk;
+    walk_init(&wk, in);
+    ison_writer_t summary;  /* JSON object of the latest summary row */
+    ison_writer_init_memory(&summary, 256);
+    size_t blocks = 0, rows = 0;
+    walk_event_t ev;
     
-    if (**p == '}') {
-        (*p)++;
-        return row;
+    ison_writer_putc(out, '{');
+    while (out->error == ISON_OK && (ev = walk_next(&wk)) != WALK_DONE) {
+        switch (ev) {
+            case WALK_BLOCK:
+                if (blocks++ > 0) ison_writer_putc(out, ',');
+                append_json_key(out, wk.name);
+                ison_writer_puts(out, "[ ");
+                summary.len = 0;
+                rows = 0;
+                break;
+            case WALK_ROW:
+                if (rows++ > 0) ison_writer_putc(out, ',');
+                append_json_cells(out, &wk);
+                break;
+            case WALK_SUMMARY:
+                summary.len = 0;
+                append_json_cells(&summary, &wk);
+                if (summary.error != ISON_OK) out->error = summary.error;
+                break;
+            case WALK_BLOCK_END:
+                ison_writer_putc(out, ']');
+                if (summary.len > 0) {
+                    append_summary_key(out, wk.name);
+                    ison_writer_write(out, summary.buf, summary.len);
+                }
+                break;
+            default:
+                break;
+        }
     }
+    ison_writer_putc(out, '}');
     
-    while (**p) {
-        skip_ws(p);
-        char *key = parse_json_string(p);
-        if (!key) break;
-        
-        skip_ws(p);
-        if (**p == ':') (*p)++;
-        skip_ws(p);
-        
-        ison_value_t val = parse_json_value(p);
-        ison_row_set(row, key, &val);
-        free(key);
-        
-        skip_ws(p);
-        if (**p == ',') {
-            (*p)++;
-            continue;
-        }
-        if (**p == '}') {
-            (*p)++;
-            break;
+    ison_error_t err = stream_result(&wk, out);
+    ison_writer_free(&summary);
+    walk_free(&wk);
+    return err;
+}
+
+ison_error_t ison_to_isonl_stream(ison_reader_t *in, ison_writer_t *out) {
+    if (!in || !out) return ISON_ERROR_INVALID;
+    
+    ison_walker_t wk;
+    walk_init(&wk, in);
+    ison_writer_t prefix;   /* "kind.name|fields|" of the current block */
+    ison_writer_init_memory(&prefix, 256);
+    int first_line = 1;
+    walk_event_t ev;
+    
+    while (out->error == ISON_OK && (ev = walk_next(&wk)) != WALK_DONE) {
+        if (ev == WALK_FIELDS) {
+            prefix.len = 0;
+            ison_writer_puts(&prefix, wk.kind);
+            ison_writer_putc(&prefix, '.');
+            ison_writer_puts(&prefix, wk.name);
+            ison_writer_putc(&prefix, '|');
+            for (size_t i = 0; i < wk.header.count; i++) {
+                if (i > 0) ison_writer_putc(&prefix, ' ');
+                ison_writer_puts(&prefix, wk.header.tokens[i].text);
+                if (*wk.hints[i]) {
+                    ison_writer_putc(&prefix, ':');
+                    ison_writer_puts(&prefix, wk.hints[i]);
+                }
+            }
+            ison_writer_putc(&prefix, '|');
+            if (prefix.error != ISON_OK) out->error = prefix.error;
+        } else if (ev == WALK_ROW) {
+            /* Summary rows have no ISONL form, as in ison_dump_isonl_writer */
+            if (!first_line) ison_writer_putc(out, '\n');
+            first_line = 0;
+            ison_writer_write(out, prefix.buf, prefix.len);
+            append_ison_cells(out, &wk.cells, wk.hints, wk.header.count);
         }
     }
     
-    return row;
+    ison_error_t err = stream_result(&wk, out);
+    ison_writer_free(&prefix);
+    walk_free(&wk);
+    return err;
+}
+
+/*
+ * Rows of each ISONL block are held until the input ends. They collect in
+ * small per-block buffers; once those hold SPILL_MEMORY_BUDGET bytes in
+ * total, every buffer is appended to one shared temporary file and the
+ * block remembers where its segments went. Memory, file descriptors and
+ * lookups therefore stay flat however many blocks the input names.
+ */
+#define SPILL_MEMORY_BUDGET (4u << 20)
+#define SPILL_COPY_BUFFER 65536
+
+typedef struct {
+    uint64_t offset;
+    size_t len;
+} spill_segment_t;
+
+/* Consecutive rows written when the block had this many fields */
+typedef struct {
+    size_t rows;
+    size_t fields;
+} spill_run_t;
+
+typedef struct {
+    ison_block_t *block;    /* fields only, in first-seen order */
+    uint32_t hash;
+    ison_writer_t pending;  /* rows not yet in the spill file */
+    spill_segment_t *segments;
+    size_t segment_count;
+    size_t segment_cap;
+    spill_run_t *runs;
+    size_t run_count;
+    size_t run_cap;
+} spill_t;
+
+typedef struct {
+    spill_t **blocks;       /* first-seen order */
+    size_t count;
+    size_t cap;
+    spill_t **table;        /* open addressing by name, power-of-two sized */
+    size_t table_cap;
+    size_t pending;         /* bytes across all pending buffers */
+    FILE *file;
+    uint64_t file_len;
+} spill_set_t;
+
+static uint32_t name_hash(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void spill_free(spill_t *spill) {
+    ison_block_free(spill->block);
+    ison_writer_free(&spill->pending);
+    free(spill->segments);
+    free(spill->runs);
+    free(spill);
+}
+
+static void spill_set_free(spill_set_t *set) {
+    for (size_t i = 0; i < set->count; i++) spill_free(set->blocks[i]);
+    free(set->blocks);
+    free(set->table);
+    if (set->file) fclose(set->file);
+}
+
+static int spill_table_grow(spill_set_t *set) {
+    size_t new_cap = set->table_cap ? set->table_cap * 2 : 64;
+    spill_t **table = calloc(new_cap, sizeof(spill_t *));
+    if (!table) return 0;
+    for (size_t i = 0; i < set->count; i++) {
+        size_t j = set->blocks[i]->hash & (new_cap - 1);
+        while (table[j]) j = (j + 1) & (new_cap - 1);
+        table[j] = set->blocks[i];
+    }
+    free(set->table);
+    set->table = table;
+    set->table_cap = new_cap;
+    return 1;
 }
 
-static ison_value_t parse_json_value(const char **p) {
-    skip_ws(p);
+/* The block named in header ("kind.name"), created on first sight; NULL when out of memory */
+static spill_t *spill_lookup(spill_set_t *set, const char *header, size_t header_len, const char *name,
+                             size_t name_len) {
+    if ((set->count + 1) * 2 > set->table_cap && !spill_table_grow(set)) return NULL;
+    uint32_t hash = name_hash(name, name_len);
+    size_t j = hash & (set->table_cap - 1);
+    for (spill_t *spill; (spill = set->table[j]); j = (j + 1) & (set->table_cap - 1)) {
+        if (spill->hash == hash && strlen(spill->block->name) == name_len &&
+            memcmp(spill->block->name, name, name_len) == 0) {
+            return spill;
+        }
+    }
     
-    if (**p == '"') {
-        char *s = parse_json_string(p);
-        ison_value_t v = ison_string(s);
-        free(s);
-        return v;
+    if (set->count >= set->cap) {
+        size_t new_cap = set->cap ? set->cap * 2 : 8;
+        spill_t **blocks = realloc(set->blocks, new_cap * sizeof(spill_t *));
+        if (!blocks) return NULL;
+        set->blocks = blocks;
+        set->cap = new_cap;
     }
-    if (strncmp(*p, "true", 4) == 0) {
-        *p += 4;
-        return ison_bool(1);
+    spill_t *spill = calloc(1, sizeof(spill_t));
+    if (!spill) return NULL;
+    spill->hash = hash;
+    /* kind and name share one allocation: "kind\0name\0" */
+    char *kind = malloc(header_len + 1);
+    if (kind) {
+        memcpy(kind, header, header_len);
+        kind[header_len] = '\0';
+        kind[(size_t)(name - header) - 1] = '\0';
+        spill->block = ison_block_create(kind, kind + (name - header));
+        free(kind);
     }
-    if (strncmp(*p, "false", 5) == 0) {
-        *p += 5;
-        return ison_bool(0);
+    if (!spill->block || ison_writer_init_memory(&spill->pending, 256) != ISON_OK) {
+        spill_free(spill);
+        return NULL;
     }
-    if (strncmp(*p, "null", 4) == 0) {
-        *p += 4;
-        return ison_null();
+    set->blocks[set->count++] = spill;
+    set->table[j] = spill;
+    return spill;
+}
+
+/* Move every pending buffer to the end of the shared spill file */
+static ison_error_t spill_flush(spill_set_t *set) {
+    if (!set->file && !(set->file = tmpfile())) return ISON_ERROR_IO;
+    for (size_t i = 0; i < set->count; i++) {
+        spill_t *spill = set->blocks[i];
+        if (spill->pending.len == 0) continue;
+        if (spill->segment_count >= spill->segment_cap) {
+            size_t new_cap = spill->segment_cap ? spill->segment_cap * 2 : 4;
+            spill_segment_t *segments = realloc(spill->segments, new_cap * sizeof(spill_segment_t));
+            if (!segments) return ISON_ERROR_MEMORY;
+            spill->segments = segments;
+            spill->segment_cap = new_cap;
+        }
+        if (fwrite(spill->pending.buf, 1, spill->pending.len, set->file) != spill->pending.len) return ISON_ERROR_IO;
+        spill->segments[spill->segment_count].offset = set->file_len;
+        spill->segments[spill->segment_count].len = spill->pending.len;
+        spill->segment_count++;
+        set->file_len += spill->pending.len;
+        /* Give the memory back rather than keep one grown buffer per block */
+        ison_writer_free(&spill->pending);
+        if (ison_writer_init_memory(&spill->pending, 256) != ISON_OK) return ISON_ERROR_MEMORY;
     }
-    if (**p == '{') {
-        ison_row_t *row = parse_json_object(p);
-        return ison_ref(&(ison_reference_t){(char*)row, NULL, NULL});
+    set->pending = 0;
+    return ISON_OK;
+}
+
+static int spill_note_row(spill_t *spill) {
+    size_t fields = spill->block->field_count;
+    if (spill->run_count == 0 || spill->runs[spill->run_count - 1].fields != fields) {
+        if (spill->run_count >= spill->run_cap) {
+            size_t new_cap = spill->run_cap ? spill->run_cap * 2 : 4;
+            spill_run_t *runs = realloc(spill->runs, new_cap * sizeof(spill_run_t));
+            if (!runs) return 0;
+            spill->runs = runs;
+            spill->run_cap = new_cap;
+        }
+        spill->runs[spill->run_count].rows = 0;
+        spill->runs[spill->run_count].fields = fields;
+        spill->run_count++;
     }
-    if (**p == '[') {
-        (*p)++;
-        skip_ws(p);
-        if (**p == ']') {
-            (*p)++;
-            return ison_null();
+    spill->runs[spill->run_count - 1].rows++;
+    return 1;
+}
+
+static void write_spill_head(ison_writer_t *w, const spill_t *spill) {
+    const ison_block_t *block = spill->block;
+    ison_writer_puts(w, block->kind);
+    ison_writer_putc(w, '.');
+    ison_writer_puts(w, block->name);
+    ison_writer_putc(w, '\n');
+    for (size_t i = 0; i < block->field_count; i++) {
+        if (i > 0) ison_writer_putc(w, ' ');
+        ison_writer_puts(w, block->fields[i].name);
+        if (block->fields[i].type_hint && *block->fields[i].type_hint) {
+            ison_writer_putc(w, ':');
+            ison_writer_puts(w, block->fields[i].type_hint);
         }
-        
-        while (**p && **p != ']') {
-            parse_json_value(p);
-            skip_ws(p);
-            if (**p == ',') (*p)++;
-            skip_ws(p);
+    }
+    ison_writer_putc(w, '\n');
+}
+
+/* Copies a block's rows out, padding those written before later fields appeared with nulls */
+typedef struct {
+    ison_writer_t *out;
+    const spill_t *spill;
+    size_t run;
+    size_t row;             /* rows of the current run already copied */
+} spill_copy_t;
+
+static void copy_rows(spill_copy_t *c, const char *data, size_t len) {
+    const spill_run_t *runs = c->spill->runs;
+    size_t fields = c->spill->block->field_count;
+    while (len > 0) {
+        /* Rows of the last run already have every field */
+        if (c->run + 1 >= c->spill->run_count) {
+            ison_writer_write(c->out, data, len);
+            return;
+        }
+        const char *nl = memchr(data, '\n', len);
+        size_t n = nl ? (size_t)(nl - data) : len;
+        ison_writer_write(c->out, data, n);
+        if (!nl) return;
+        for (size_t k = runs[c->run].fields; k < fields; k++) {
+            if (k > 0) ison_writer_putc(c->out, ' ');
+            ison_writer_putc(c->out, '~');
+        }
+        ison_writer_putc(c->out, '\n');
+        data += n + 1;
+        len -= n + 1;
+        if (++c->row == runs[c->run].rows) {
+            c->run++;
+            c->row = 0;
         }
-        if (**p == ']') (*p)++;
-        return ison_null();
     }
-    
-    char *end;
-    double d = strtod(*p, &end);
-    if (end != *p) {
-        *p = end;
-        if (d == (double)(int64_t)d) return ison_int((int64_t)d);
-        return ison_float(d);
+}
+
+static void copy_spill(ison_writer_t *out, spill_set_t *set, const spill_t *spill) {
+    spill_copy_t c = {out, spill, 0, 0};
+    if (spill->segment_count > 0) {
+        char buf[SPILL_COPY_BUFFER];
+        for (size_t i = 0; i < spill->segment_count && out->error == ISON_OK; i++) {
+            if (fseeko(set->file, (off_t)spill->segments[i].offset, SEEK_SET) != 0) {
+                out->error = ISON_ERROR_IO;
+                return;
+            }
+            size_t left = spill->segments[i].len;
+            while (left > 0 && out->error == ISON_OK) {
+                size_t n = fread(buf, 1, left < sizeof(buf) ? left : sizeof(buf), set->file);
+                if (n == 0) {
+                    out->error = ISON_ERROR_IO;
+                    return;
+                }
+                copy_rows(&c, buf, n);
+                left -= n;
+            }
+        }
     }
-    
-    return ison_null();
+    copy_rows(&c, spill->pending.buf, spill->pending.len);
 }
 
-ison_document_t *ison_from_json(const char *json_text, ison_error_t *error) {
-    if (error) *error = ISON_OK;
-    if (!json_text) {
-        if (error) *error = ISON_ERROR_INVALID;
-        return NULL;
+/*
+ * Cells of one line in block field order. Fields the line does not name
+ * print as null; fields first seen after this row are padded with nulls
+ * when the block is written out.
+ */
+static int append_mapped_cells(ison_writer_t *w, const ison_block_t *block, const ison_field_map_t *fm,
+                               ison_lexer_t *cells, size_t **slots, size_t *slots_cap) {
+    if (block->field_count > *slots_cap) {
+        size_t *grown = realloc(*slots, block->field_count * sizeof(size_t));
+        if (!grown) return 0;
+        *slots = grown;
+        *slots_cap = block->field_count;
     }
+    for (size_t j = 0; j < block->field_count; j++) (*slots)[j] = SIZE_MAX;
+    for (size_t i = 0; i < cells->count && i < fm->count; i++) (*slots)[fm->map[i]] = i;
     
-    ison_document_t *doc = ison_document_create();
-    const char *p = json_text;
-    
-    skip_ws(&p);
-    if (*p != '{') {
-        if (error) *error = ISON_ERROR_PARSE;
-        ison_document_free(doc);
-        return NULL;
+    for (size_t j = 0; j < block->field_count; j++) {
+        if (j > 0) ison_writer_putc(w, ' ');
+        size_t i = (*slots)[j];
+        if (i == SIZE_MAX) {
+            ison_value_append(w, NULL);
+            continue;
+        }
+        ison_value_t val = ison_lex_value(cells->tokens[i].text, block->fields[j].type_hint);
+        ison_value_append(w, &val);
     }
-    p++;
+    ison_writer_putc(w, '\n');
+    return 1;
+}
+
+/*
+ * Blocks come out in first-seen order with the union of the fields their
+ * lines named, matching isonl_to_ison. Rows are held per block until the
+ * input ends, since a later line may still add a field to any block's
+ * header. Consecutive lines of one block reuse the last lookup and field
+ * map, so grouped input costs one compare per line.
+ */
+ison_error_t isonl_to_ison_stream(ison_reader_t *in, ison_writer_t *out) {
+    if (!in || !out) return ISON_ERROR_INVALID;
     
-    while (*p) {
-        skip_ws(&p);
-        if (*p == '}') break;
-        
-        char *name = parse_json_string(&p);
-        if (!name) break;
+    spill_set_t set;
+    memset(&set, 0, sizeof(set));
+    spill_t *current = NULL;
+    ison_lexer_t lexer = {0};
+    ison_field_map_t fields = {0};
+    size_t *slots = NULL, slots_cap = 0;
+    const char *line;
+    size_t len;
+    
+    while (out->error == ISON_OK && ison_reader_next_line(in, &line, &len)) {
+        ison_lex_trim(&line, &len);
+        if (len == 0 || line[0] == '#') continue;
         
-        skip_ws(&p);
-        if (*p == ':') p++;
-        skip_ws(&p);
+        const char *p1 = memchr(line, '|', len);
+        const char *p2 = p1 ? memchr(p1 + 1, '|', len - (size_t)(p1 + 1 - line)) : NULL;
+        if (!p2) continue;
+        size_t header_len = (size_t)(p1 - line);
+        const char *dot = memchr(line, '.', header_len);
+        if (!dot) continue;
         
-        if (*p == '[') {
-            p++;
-            skip_ws(&p);
-            
-            ison_block_t *block = ison_block_create("table", name);
-            
-            if (*p != ']') {
-                const char *peek = p;
-                skip_ws(&peek);
-                if (*peek == '{') {
-                    ison_row_t *first = parse_json_object(&p);
-                    if (first) {
-                        ison_row_entry_t *entry = first->head;
-                        while (entry) {
-                            ison_block_add_field(block, entry->key, "");
-                            entry = entry->next;
-                        }
-                        
-                        ison_block_add_row(block, first);
-                        ison_row_free(first);
-                        
-                        skip_ws(&p);
-                        while (*p && *p != ']') {
-                            if (*p == ',') p++;
-                            skip_ws(&p);
-                            if (*p != '{') break;
-                            
-                            ison_row_t *row = parse_json_object(&p);
-                            if (row) {
-                                ison_block_add_row(block, row);
-                                ison_row_free(row);
-                            }
-                            skip_ws(&p);
-                        }
-                    }
-                }
+        /* Blocks are keyed by name alone, as in ison_document_get */
+        const char *name = dot + 1;
+        size_t name_len = header_len - (size_t)(name - line);
+        if (!current || strlen(current->block->name) != name_len ||
+            memcmp(current->block->name, name, name_len) != 0) {
+            current = spill_lookup(&set, line, header_len, name, name_len);
+            if (!current) {
+                out->error = ISON_ERROR_MEMORY;
+                break;
             }
-            
-            if (*p == ']') p++;
-            ison_document_add_block(doc, block);
-        } else if (*p == '{') {
-            ison_row_t *row = parse_json_object(&p);
-            if (row) {
-                ison_block_t *block = ison_block_create("object", name);
-                ison_row_entry_t *entry = row->head;
-                while (entry) {
-                    ison_block_add_field(block, entry->key, "");
-                    entry = entry->next;
-                }
-                ison_block_add_row(block, row);
-                ison_row_free(row);
-                ison_document_add_block(doc, block);
-            }
-        } else {
-            parse_json_value(&p);
         }
         
-        free(name);
-        
-        skip_ws(&p);
-        if (*p == ',') {
-            p++;
-            continue;
+        size_t before = current->pending.len;
+        if (!ison_field_map_update(&fields, current->block, &lexer, p1 + 1, (size_t)(p2 - p1 - 1)) ||
+            !ison_lex_line(&lexer, p2 + 1, len - (size_t)(p2 + 1 - line)) ||
+            !append_mapped_cells(&current->pending, current->block, &fields, &lexer, &slots, &slots_cap) ||
+            !spill_note_row(current)) {
+            out->error = ISON_ERROR_MEMORY;
+            break;
+        }
+        if (current->pending.error != ISON_OK) {
+            out->error = current->pending.error;
+            break;
         }
-        if (*p == '}') break;
+        set.pending += current->pending.len - before;
+        if (set.pending >= SPILL_MEMORY_BUDGET) out->error = spill_flush(&set);
     }
     
-    return doc;
+    for (size_t i = 0; i < set.count && out->error == ISON_OK && in->error == ISON_OK; i++) {
+        if (i > 0) ison_writer_putc(out, '\n');
+        write_spill_head(out, set.blocks[i]);
+        copy_spill(out, &set, set.blocks[i]);
+    }
+    
+    spill_set_free(&set);
+    free(slots);
+    ison_lexer_free(&lexer);
+    ison_field_map_free(&fields);
+    
+    if (in->error != ISON_OK) return in->error;
+    return out->error;
 }
 
-static void append_string(char **buf, size_t *len, size_t *cap, const char *str) {
-    if (!str) return;
-    size_t str_len = strlen(str);
-    if (*len + str_len + 1 > *cap) {
-        *cap = (*cap + str_len + 1) * 2;
-        *buf = realloc(*buf, *cap);
+char *ison_to_json_n(const char *ison_text, size_t len, ison_error_t *error) {
+    if (error) *error = ISON_OK;
+    if (!ison_text) {
+        if (error) *error = ISON_ERROR_INVALID;
+        return NULL;
     }
-    memcpy(*buf + *len, str, str_len);
-    *len += str_len;
-    (*buf)[*len] = '\0';
+    return convert_text(ison_to_json_stream, ison_text, len, error);
 }
 
-static void append_char(char **buf, size_t *len, size_t *cap, char ch) {
-    if (*len + 2 > *cap) {
-        *cap = *cap * 2;
-        *buf = realloc(*buf, *cap);
-    }
-    (*buf)[*len] = ch;
-    (*len)++;
-    (*buf)[*len] = '\0';
+char *ison_to_json(const char *ison_text, ison_error_t *error) {
+    return ison_to_json_n(ison_text, ison_text ? strlen(ison_text) : 0, error);
 }
@@ -0,0 +1,533 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "lex.h"
+#include "scan.h"
+
+/*
+ * RFC 4180 CSV with a configurable delimiter. Quoted fields may hold the
+ * delimiter, doubled quotes and line breaks. Unquoted empty fields are
+ * null, quoted empty fields are empty strings. In columns without a type
+ * hint other quoted cells are strings too. The rest decode like ISON
+ * tokens under their field's type hint, except that a leading ':' only
+ * makes a reference in "ref" columns. The writer quotes untyped strings
+ * that would otherwise read back as another type.
+ */
+
+ison_csv_options_t ison_default_csv_options(void) {
+    ison_csv_options_t opts;
+    opts.delimiter = ',';
+    opts.header = true;
+    opts.type_row = false;
+    return opts;
+}
+
+/* ==================== Reading ==================== */
+
+/*
+ * Records are split into a batch of up to CSV_BATCH_ROWS, then decoded a
+ * column at a time: each column's hint is looked at once per batch, and
+ * int and float columns take a strtol/strtod fast path before falling
+ * back to ison_lex_value. Short decimals are decoded in place, and untyped
+ * cells that can only be text skip the lexer. Records without quotes are
+ * copied whole and cut at their delimiters.
+ */
+#define CSV_BATCH_ROWS 256
+
+typedef struct {
+    size_t offset;          /* into the parser's scratch */
+    size_t len;
+    bool quoted;
+} csv_cell_t;
+
+typedef struct {
+    char delimiter;
+    csv_cell_t *cells;      /* cells of every record in the batch */
+    size_t count;
+    size_t capacity;
+    size_t *records;        /* index of each record's first cell */
+    size_t record_count;
+    size_t record_cap;
+    char *scratch;          /* unescaped cells, NUL-terminated */
+    size_t scratch_len;
+    size_t scratch_cap;
+    char *joined;           /* lines of a record that spans line breaks */
+    size_t joined_len;
+    size_t joined_cap;
+    ison_value_t *values;   /* decoded cells, parallel to cells */
+    size_t values_cap;
+} csv_parser_t;
+
+static int csv_push(csv_parser_t *p, size_t offset, size_t len, bool quoted) {
+    if (p->count >= p->capacity) {
+        size_t new_cap = p->capacity == 0 ? 256 : p->capacity * 2;
+        csv_cell_t *cells = realloc(p->cells, new_cap * sizeof(csv_cell_t));
+        if (!cells) return 0;
+        p->cells = cells;
+        p->capacity = new_cap;
+    }
+    p->scratch[offset + len] = '\0';
+    p->cells[p->count].offset = offset;
+    p->cells[p->count].len = len;
+    p->cells[p->count].quoted = quoted;
+    p->count++;
+    return 1;
+}
+
+/* Length of the unquoted text at s: up to the delimiter; quotes and line breaks in it are kept */
+static size_t csv_plain(const char *s, size_t len, char delimiter) {
+    size_t n = 0;
+    for (;;) {
+        n += ison_scan_csv_quote(s + n, len - n, delimiter);
+        if (n >= len || s[n] == delimiter) return n;
+        n++;
+    }
+}
+
+/*
+ * Split one record onto the end of the batch; 1 when done, 0 when a quoted
+ * field runs past the end, -1 on allocation failure. Anything but 1 leaves
+ * the batch as it was.
+ */
+static int csv_split(csv_parser_t *p, const char *s, size_t len) {
+    size_t first = p->count;
+    size_t base = p->scratch_len;
+    if (base + len + 2 > p->scratch_cap) {
+        size_t cap = p->scratch_cap ? p->scratch_cap * 2 : 4096;
+        while (cap < base + len + 2) cap *= 2;
+        char *scratch = realloc(p->scratch, cap);
+        if (!scratch) return -1;
+        p->scratch = scratch;
+        p->scratch_cap = cap;
+    }
+
+    char *out = p->scratch + base;
+    size_t i = 0;
+    int done = -1;
+    if (!memchr(s, '"', len)) {
+        /* No quotes: copy the record once and cut it at each delimiter */
+        memcpy(out, s, len);
+        for (;;) {
+            const char *d = memchr(s + i, p->delimiter, len - i);
+            size_t n = d ? (size_t)(d - (s + i)) : len - i;
+            if (!csv_push(p, base + i, n, false)) goto rollback;
+            if (!d) break;
+            i += n + 1;
+        }
+        out += len + 1;
+    } else {
+        for (;;) {
+            size_t start = (size_t)(out - p->scratch);
+            bool quoted = i < len && s[i] == '"';
+            if (quoted) {
+                i++;
+                for (;;) {
+                    const char *q = memchr(s + i, '"', len - i);
+                    if (!q) {
+                        done = 0;
+                        goto rollback;
+                    }
+                    size_t n = (size_t)(q - (s + i));
+                    memcpy(out, s + i, n);
+                    out += n;
+                    i += n + 1;
+                    if (i < len && s[i] == '"') {
+                        *out++ = '"';
+                        i++;
+                        continue;
+                    }
+                    break;
+                }
+            }
+            /* The whole of an unquoted field; stray text after a closing quote is kept as it is */
+            size_t n = csv_plain(s + i, len - i, p->delimiter);
+            memcpy(out, s + i, n);
+            out += n;
+            i += n;
+            if (!csv_push(p, start, (size_t)(out - p->scratch) - start, quoted)) goto rollback;
+            out++;
+            if (i >= len) break;
+            i++;
+            /* A trailing delimiter ends with an empty field */
+            if (i == len) {
+                if (!csv_push(p, (size_t)(out - p->scratch), 0, false)) goto rollback;
+                out++;
+                break;
+            }
+        }
+    }
+
+    if (p->record_count >= p->record_cap) {
+        size_t new_cap = p->record_cap == 0 ? CSV_BATCH_ROWS : p->record_cap * 2;
+        size_t *records = realloc(p->records, new_cap * sizeof(size_t));
+        if (!records) goto rollback;
+        p->records = records;
+        p->record_cap = new_cap;
+    }
+    p->records[p->record_count++] = first;
+    p->scratch_len = (size_t)(out - p->scratch);
+    return 1;
+
+rollback:
+    p->count = first;
+    return done;
+}
+
+static int joined_append(csv_parser_t *p, const char *line, size_t len, bool newline) {
+    size_t need = p->joined_len + len + 2;
+    if (need > p->joined_cap) {
+        size_t cap = p->joined_cap ? p->joined_cap * 2 : 256;
+        while (cap < need) cap *= 2;
+        char *joined = realloc(p->joined, cap);
+        if (!joined) return 0;
+        p->joined = joined;
+        p->joined_cap = cap;
+    }
+    if (newline) p->joined[p->joined_len++] = '\n';
+    memcpy(p->joined + p->joined_len, line, len);
+    p->joined_len += len;
+    return 1;
+}
+
+/* Split the next non-blank record onto the batch; false at end of input or on error */
+static bool csv_next(csv_parser_t *p, ison_reader_t *in, ison_error_t *err) {
+    const char *line;
+    size_t len;
+    while (ison_reader_next_line(in, &line, &len)) {
+        if (len == 0) continue;
+        int done = csv_split(p, line, len);
+        if (done == 0) {
+            /* Quoted line break: join lines until the quote closes */
+            p->joined_len = 0;
+            done = joined_append(p, line, len, false) ? 0 : -1;
+            while (done == 0) {
+                if (!ison_reader_next_line(in, &line, &len)) {
+                    *err = in->error != ISON_OK ? in->error : ISON_ERROR_PARSE;
+                    return false;
+                }
+                done = joined_append(p, line, len, true) ? csv_split(p, p->joined, p->joined_len) : -1;
+            }
+        }
+        if (done < 0) {
+            *err = ISON_ERROR_MEMORY;
+            return false;
+        }
+        return true;
+    }
+    if (in->error != ISON_OK) *err = in->error;
+    return false;
+}
+
+static void csv_reset(csv_parser_t *p) {
+    p->count = 0;
+    p->record_count = 0;
+    p->scratch_len = 0;
+}
+
+static void csv_parser_free(csv_parser_t *p) {
+    free(p->cells);
+    free(p->records);
+    free(p->scratch);
+    free(p->joined);
+    free(p->values);
+}
+
+/* Cells in record r of the batch */
+static size_t csv_record_cells(const csv_parser_t *p, size_t r) {
+    return (r + 1 < p->record_count ? p->records[r + 1] : p->count) - p->records[r];
+}
+
+enum { CSV_ANY, CSV_STRING, CSV_INT, CSV_FLOAT, CSV_HINTED };
+
+static int csv_column_kind(const char *hint) {
+    if (!hint || !*hint) return CSV_ANY;
+    if (strcmp(hint, "string") == 0) return CSV_STRING;
+    if (strcmp(hint, "int") == 0) return CSV_INT;
+    if (strcmp(hint, "float") == 0) return CSV_FLOAT;
+    return CSV_HINTED;
+}
+
+static bool csv_is_number_start(const char *s, bool fraction) {
+    if (*s == '-' || *s == '+') s++;
+    return (*s >= '0' && *s <= '9') || (fraction && *s == '.');
+}
+
+/* A signed decimal of at most 18 digits, decoded in place; anything else is left to strtol */
+static bool csv_int(const char *s, size_t len, int64_t *out) {
+    size_t i = *s == '-' || *s == '+';
+    if (i == len || len - i > 18) return false;
+    uint64_t val = 0;
+    for (; i < len; i++) {
+        unsigned digit = (unsigned char)s[i] - '0';
+        if (digit > 9) return false;
+        val = val * 10 + digit;
+    }
+    *out = *s == '-' ? -(int64_t)val : (int64_t)val;
+    return true;
+}
+
+/*
+ * Whether ison_lex_value can only make a string of s: its first byte
+ * starts no null, bool, reference or number, nor blanks strtod skips.
+ */
+static bool csv_is_text(const char *s) {
+    switch (*s) {
+    case '~': case ':': case '+': case '-': case '.':
+    case ' ': case '\t': case '\n': case '\v': case '\f': case '\r':
+    case 'f': case 'F': case 'i': case 'I': case 'n': case 'N': case 't': case 'T':
+        return false;
+    default:
+        return *s < '0' || *s > '9';
+    }
+}
+
+/*
+ * Quoted cells are strings unless the column has a non-string hint, so
+ * "007" survives an untyped column. Outside "ref" columns a leading ':'
+ * is text, not a reference.
+ */
+static ison_value_t csv_value(const csv_cell_t *cell, char *text, int kind, const char *hint) {
+    if (cell->len == 0) return cell->quoted ? ison_string_n(text, 0) : ison_null();
+    char *end;
+    int64_t ival;
+    switch (kind) {
+    case CSV_STRING:
+        return ison_string_n(text, cell->len);
+    case CSV_ANY:
+        if (cell->quoted || csv_is_text(text)) return ison_string_n(text, cell->len);
+        if (csv_int(text, cell->len, &ival)) return ison_int(ival);
+        break;
+    case CSV_INT:
+        if (csv_int(text, cell->len, &ival)) return ison_int(ival);
+        if (csv_is_number_start(text, false)) {
+            long val = strtol(text, &end, 10);
+            if (*end == '\0') return ison_int(val);
+        }
+        break;
+    case CSV_FLOAT:
+        if (csv_is_number_start(text, true)) {
+            double val = strtod(text, &end);
+            if (*end == '\0') return ison_float(val);
+        }
+        break;
+    }
+    if (text[0] == ':' && strcmp(hint, "ref") != 0) return ison_string_n(text, cell->len);
+    ison_value_t raw = ison_lex_value(text, hint);
+    return ison_value_copy(&raw);
+}
+
+/* Whether a header repeats a column name; such cells go through ison_row_set, where the last wins */
+static bool csv_fields_distinct(const ison_block_t *block) {
+    for (size_t j = 1; j < block->field_count; j++) {
+        for (size_t k = 0; k < j; k++) {
+            if (strcmp(block->fields[j].name, block->fields[k].name) == 0) return false;
+        }
+    }
+    return true;
+}
+
+/* Decode the batch a column at a time and append its rows to block */
+static ison_error_t csv_flush(csv_parser_t *p, ison_block_t *block) {
+    if (p->count > p->values_cap) {
+        ison_value_t *values = realloc(p->values, p->capacity * sizeof(ison_value_t));
+        if (!values) return ISON_ERROR_MEMORY;
+        p->values = values;
+        p->values_cap = p->capacity;
+    }
+    for (size_t j = 0; j < block->field_count; j++) {
+        const char *hint = block->fields[j].type_hint;
+        int kind = csv_column_kind(hint);
+        for (size_t r = 0; r < p->record_count; r++) {
+            size_t c = p->records[r] + j;
+            if (j >= csv_record_cells(p, r)) continue;
+            p->values[c] = csv_value(&p->cells[c], p->scratch + p->cells[c].offset, kind, hint);
+        }
+    }
+
+    ison_error_t err = ISON_OK;
+    bool distinct = csv_fields_distinct(block);
+    for (size_t r = 0; r < p->record_count; r++) {
+        size_t first = p->records[r], n = csv_record_cells(p, r);
+        ison_row_t *row = err == ISON_OK ? ison_row_create() : NULL;
+        if (!row) {
+            err = ISON_ERROR_MEMORY;
+            for (size_t i = 0; i < n; i++) ison_value_free(&p->values[first + i]);
+            continue;
+        }
+        for (size_t i = 0; i < n; i++) {
+            const char *key = block->fields[i].name;
+            if (distinct) ison_row_append(row, key, strlen(key), &p->values[first + i]);
+            else ison_row_set(row, key, &p->values[first + i]);
+        }
+        ison_block_take_row(block, row);
+    }
+    csv_reset(p);
+    return err;
+}
+
+ison_block_t *ison_block_from_csv(ison_reader_t *in, const char *name, const ison_csv_options_t *options,
+                                  ison_error_t *error) {
+    if (error) *error = ISON_OK;
+    if (!in || !name) {
+        if (error) *error = ISON_ERROR_INVALID;
+        return NULL;
+    }
+    ison_csv_options_t defaults = ison_default_csv_options();
+    if (!options) options = &defaults;
+
+    ison_error_t err = ISON_OK;
+    csv_parser_t p;
+    memset(&p, 0, sizeof(p));
+    p.delimiter = options->delimiter ? options->delimiter : ',';
+    ison_block_t *block = ison_block_create("table", name);
+    if (!block) {
+        if (error) *error = ISON_ERROR_MEMORY;
+        return NULL;
+    }
+
+    if (options->header && csv_next(&p, in, &err)) {
+        for (size_t i = 0; i < p.count; i++) ison_block_add_field(block, p.scratch + p.cells[i].offset, "");
+        csv_reset(&p);
+        if (options->type_row && csv_next(&p, in, &err)) {
+            for (size_t i = 0; i < p.count && i < block->field_count; i++) {
+                char *hint = malloc(p.cells[i].len + 1);
+                if (!hint) {
+                    err = ISON_ERROR_MEMORY;
+                    break;
+                }
+                memcpy(hint, p.scratch + p.cells[i].offset, p.cells[i].len + 1);
+                free(block->fields[i].type_hint);
+                block->fields[i].type_hint = hint;
+            }
+            csv_reset(&p);
+        }
+    }
+
+    while (err == ISON_OK && csv_next(&p, in, &err)) {
+        size_t cells = csv_record_cells(&p, p.record_count - 1);
+        if (cells > block->field_count) {
+            if (options->header) {
+                err = ISON_ERROR_PARSE;
+                break;
+            }
+            /* Without a header, columns are named by position */
+            while (block->field_count < cells) {
+                char col[32];
+                snprintf(col, sizeof(col), "c%zu", block->field_count + 1);
+                size_t before = block->field_count;
+                ison_block_add_field(block, col, "");
+                if (block->field_count == before) {
+                    err = ISON_ERROR_MEMORY;
+                    break;
+                }
+            }
+            if (err != ISON_OK) break;
+        }
+        if (p.record_count == CSV_BATCH_ROWS) err = csv_flush(&p, block);
+    }
+    if (err == ISON_OK && p.record_count > 0) err = csv_flush(&p, block);
+
+    csv_parser_free(&p);
+    if (err != ISON_OK) {
+        ison_block_free(block);
+        block = NULL;
+    }
+    if (error) *error = err;
+    return block;
+}
+
+/* ==================== Writing ==================== */
+
+static void csv_field(ison_writer_t *w, const char *str, size_t len, char delimiter, bool quote) {
+    if (!quote && len > 0 && ison_scan_csv_quote(str, len, delimiter) == len) {
+        ison_writer_write(w, str, len);
+        return;
+    }
+
+    ison_writer_putc(w, '"');
+    size_t pos = 0;
+    while (pos < len) {
+        const char *q = memchr(str + pos, '"', len - pos);
+        size_t run = q ? (size_t)(q - (str + pos)) + 1 : len - pos;
+        ison_writer_write(w, str + pos, run);
+        pos += run;
+        if (q) ison_writer_putc(w, '"');
+    }
+    ison_writer_putc(w, '"');
+}
+
+/* Whether s, written unquoted in an untyped column, reads back as something other than a string */
+static bool csv_reads_as_other(const char *s) {
+    if (*s == ':') return false;
+    /* ison_lex_value only writes to reference tokens */
+    ison_value_t v = ison_lex_value((char *)s, "");
+    return v.type != ISON_TYPE_STRING;
+}
+
+static void csv_cell(ison_writer_t *w, const ison_value_t *v, const char *hint, char delimiter) {
+    ison_value_resolve(v);
+    if (!v || v->type == ISON_TYPE_NULL) return;
+    if (v->type == ISON_TYPE_STRING) {
+        const char *s = v->data.string_val ? v->data.string_val : "";
+        csv_field(w, s, strlen(s), delimiter, !*hint && csv_reads_as_other(s));
+        return;
+    }
+    if (v->type != ISON_TYPE_REFERENCE) {
+        ison_value_append(w, v);
+        return;
+    }
+    char *text = ison_value_to_ison(v);
+    if (!text) {
+        w->error = ISON_ERROR_MEMORY;
+        return;
+    }
+    csv_field(w, text, strlen(text), delimiter, false);
+    free(text);
+}
+
+ison_error_t ison_block_to_csv(const ison_block_t *block, ison_writer_t *out, const ison_csv_options_t *options) {
+    if (!block || !out) return ISON_ERROR_INVALID;
+    ison_csv_options_t defaults = ison_default_csv_options();
+    if (!options) options = &defaults;
+    char delim = options->delimiter ? options->delimiter : ',';
+    size_t fields = block->field_count;
+
+    if (options->header) {
+        for (size_t j = 0; j < fields; j++) {
+            if (j > 0) ison_writer_putc(out, delim);
+            csv_field(out, block->fields[j].name, strlen(block->fields[j].name), delim, false);
+        }
+        ison_writer_write(out, "\r\n", 2);
+        if (options->type_row) {
+            for (size_t j = 0; j < fields; j++) {
+                const char *hint = block->fields[j].type_hint ? block->fields[j].type_hint : "";
+                if (j > 0) ison_writer_putc(out, delim);
+                if (*hint) csv_field(out, hint, strlen(hint), delim, false);
+            }
+            ison_writer_write(out, "\r\n", 2);
+        }
+    }
+
+    const ison_value_t **cells = calloc(fields ? fields : 1, sizeof(ison_value_t *));
+    if (!cells) return ISON_ERROR_MEMORY;
+    for (size_t r = 0; r < block->row_count && out->error == ISON_OK; r++) {
+        memset(cells, 0, fields * sizeof(ison_value_t *));
+        size_t guess = 0;
+        for (const ison_row_entry_t *e = block->rows[r]->head; e; e = e->next, guess++) {
+            size_t j = guess;
+            if (j >= fields || strcmp(block->fields[j].name, e->key) != 0) {
+                for (j = 0; j < fields && strcmp(block->fields[j].name, e->key) != 0; j++) {}
+            }
+            if (j < fields && !cells[j]) cells[j] = &e->value;
+        }
+        for (size_t j = 0; j < fields; j++) {
+            if (j > 0) ison_writer_putc(out, delim);
+            const char *hint = block->fields[j].type_hint ? block->fields[j].type_hint : "";
+            csv_cell(out, cells[j], hint, delim);
+        }
+        ison_writer_write(out, "\r\n", 2);
+    }
+    free(cells);
+    return out->error;
+}
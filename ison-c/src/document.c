@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ison.h"
+#include "lex.h"
 
 static char *strdup_safe(const char *str) {
     if (!str) return NULL;
@@ -66,6 +67,18 @@ const char **ison_document_get_order(const ison_document_t *doc, size_t *count)
     return (const char **)doc->order;
 }
 
+void ison_document_materialize(ison_document_t *doc) {
+    if (!doc) return;
+    for (size_t i = 0; i < doc->block_count; i++) {
+        const ison_block_t *block = doc->blocks[i];
+        for (size_t r = 0; r <= block->row_count; r++) {
+            const ison_row_t *row = r < block->row_count ? block->rows[r] : block->summary_row;
+            if (!row) continue;
+            for (const ison_row_entry_t *e = row->head; e; e = e->next) ison_value_resolve(&e->value);
+        }
+    }
+}
+
 void ison_document_free(ison_document_t *doc) {
     if (!doc) return;
     
@@ -78,6 +91,7 @@ void ison_document_free(ison_document_t *doc) {
         free(doc->order[i]);
     }
     free(doc->order);
+    ison_arena_release(doc->arena);
     
     free(doc);
 }
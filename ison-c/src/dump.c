@@ -1,7 +1,14 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #include "ison.h"
+#include "lex.h"
+#include "scan.h"
 
 static char *strdup_safe(const char *str) {
     if (!str) return NULL;
@@ -11,165 +18,670 @@ static char *strdup_safe(const char *str) {
     return copy;
 }
 
-static void append_string(char **buf, size_t *len, size_t *cap, const char *str) {
-    if (!str) return;
-    size_t str_len = strlen(str);
-    if (*len + str_len + 1 > *cap) {
-        *cap = (*cap + str_len + 1) * 2;
-        *buf = realloc(*buf, *cap);
+static size_t utf8_continuations(const char *str) {
+    size_t count = 0;
+    if (!str) return 0;
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        if ((*p & 0xC0) == 0x80) count++;
     }
-    memcpy(*buf + *len, str, str_len);
-    *len += str_len;
-    (*buf)[*len] = '\0';
+    return count;
 }
 
-static void append_char(char **buf, size_t *len, size_t *cap, char ch) {
-    if (*len + 2 > *cap) {
-        *cap = *cap * 2;
-        *buf = realloc(*buf, *cap);
+static size_t ref_tag_continuations(const ison_reference_t *ref) {
+    if (ref->relationship && *ref->relationship) return utf8_continuations(ref->relationship);
+    if (ref->ns && *ref->ns) return utf8_continuations(ref->ns);
+    return 0;
+}
+
+/* Bytes in a written cell that do not start a display column (UTF-8 continuations) */
+static size_t value_continuations(const ison_value_t *val) {
+    if (!val) return 0;
+    if (val->type == ISON_TYPE_STRING) return utf8_continuations(val->data.string_val);
+    if (val->type == ISON_TYPE_REFERENCE && val->data.ref_val.id) {
+        return utf8_continuations(val->data.ref_val.id) + ref_tag_continuations(&val->data.ref_val);
     }
-    (*buf)[*len] = ch;
-    (*len)++;
-    (*buf)[*len] = '\0';
+    return 0;
 }
 
-char *ison_dumps_with_options(const ison_document_t *doc, const ison_dumps_options_t *opts) {
-    if (!doc) return strdup_safe("");
+static size_t text_width(const char *str) {
+    return str ? strlen(str) - utf8_continuations(str) : 0;
+}
+
+static size_t int_width(int64_t value) {
+    uint64_t mag = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    size_t width = value < 0 ? 2 : 1;
+    while (mag >= 10) {
+        mag /= 10;
+        width++;
+    }
+    return width;
+}
+
+/* Display width of a string as append_ison_string() spells it */
+static size_t string_width(const char *str) {
+    size_t len = strlen(str);
+    size_t width = len - utf8_continuations(str);
+    if (len > 0 && ison_scan_ison_quote(str, len) == len) return width;
+    width += 2;
+    for (size_t pos = ison_scan_ison_escape(str, len); pos < len;
+         pos += 1 + ison_scan_ison_escape(str + pos + 1, len - pos - 1)) {
+        width++;
+    }
+    return width;
+}
+
+static size_t reference_width(const ison_reference_t *ref) {
+    if (!ref->id) return 0;
+    size_t width = 1 + text_width(ref->id);
+    if (ref->relationship && *ref->relationship) {
+        width += text_width(ref->relationship) + 1;
+    } else if (ref->ns && *ref->ns) {
+        width += text_width(ref->ns) + 1;
+    }
+    return width;
+}
+
+/* Display width of a cell as ison_value_append() writes it, without writing it */
+static size_t cell_width(const ison_value_t *val) {
+    if (!val) return 1;
+    ison_value_resolve(val);
+    switch (val->type) {
+        case ISON_TYPE_BOOL:
+            return val->data.bool_val ? 4 : 5;
+        case ISON_TYPE_INT:
+            return int_width(val->data.int_val);
+        case ISON_TYPE_FLOAT: {
+            char buf[ISON_NUMBER_BUFFER_SIZE];
+            return ison_format_double(val->data.float_val, buf);
+        }
+        case ISON_TYPE_STRING:
+            return val->data.string_val ? string_width(val->data.string_val) : 1;
+        case ISON_TYPE_REFERENCE:
+            return reference_width(&val->data.ref_val);
+        default:
+            return 1;
+    }
+}
+
+static size_t field_def_width(const ison_field_info_t *field) {
+    size_t width = text_width(field->name);
+    if (field->type_hint && *field->type_hint) {
+        width += 1 + text_width(field->type_hint);
+    }
+    return width;
+}
+
+static void pad(ison_writer_t *w, size_t width, size_t used) {
+    static const char spaces[] = "                                ";
+    size_t n = width > used ? width - used : 0;
+    while (n > 0) {
+        size_t chunk = n < sizeof(spaces) - 1 ? n : sizeof(spaces) - 1;
+        ison_writer_write(w, spaces, chunk);
+        n -= chunk;
+    }
+}
+
+/* Widen widths[] to fit rows [start, end); index row_count means the summary row */
+static void measure_rows(const ison_block_t *block, size_t start, size_t end, size_t *widths) {
+    size_t cols = block->field_count - 1;
+    for (size_t r = start; r < end; r++) {
+        const ison_row_t *row = r < block->row_count ? block->rows[r] : block->summary_row;
+        if (!row) continue;
+        for (size_t j = 0; j < cols; j++) {
+            size_t width = cell_width(ison_row_get_ptr(row, block->fields[j].name));
+            if (width > widths[j]) widths[j] = width;
+        }
+    }
+}
+
+static size_t *header_widths(const ison_block_t *block) {
+    if (block->field_count < 2) return NULL;
+    size_t *widths = calloc(block->field_count, sizeof(size_t));
+    if (!widths) return NULL;
+    for (size_t j = 0; j + 1 < block->field_count; j++) {
+        widths[j] = field_def_width(&block->fields[j]);
+    }
+    return widths;
+}
+
+/*
+ * Display width of every column but the last (which is never padded).
+ * Cells are sized by cell_width() rather than rendered: integers count
+ * digits, strings and references take a length and escape scan, and only
+ * floats are formatted, into a stack buffer. Each cell is rendered once,
+ * by the write pass.
+ */
+static size_t *column_widths(const ison_block_t *block) {
+    size_t *widths = header_widths(block);
+    if (widths) measure_rows(block, 0, block->row_count + 1, widths);
+    return widths;
+}
+
+static void write_field_defs(ison_writer_t *w, const ison_block_t *block, const char *delim,
+                             const size_t *widths) {
+    for (size_t j = 0; j < block->field_count; j++) {
+        if (j > 0) ison_writer_puts(w, delim);
+        ison_writer_puts(w, block->fields[j].name);
+        if (block->fields[j].type_hint && *block->fields[j].type_hint) {
+            ison_writer_putc(w, ':');
+            ison_writer_puts(w, block->fields[j].type_hint);
+        }
+        if (widths && j + 1 < block->field_count) {
+            pad(w, widths[j], field_def_width(&block->fields[j]));
+        }
+    }
+}
+
+/*
+ * Rows built by the parser store their entries in field order, so walking
+ * the entry list alongside the fields finds each cell without the
+ * per-field list search; anything out of order falls back to a lookup.
+ */
+static const ison_value_t *next_cell(const ison_row_t *row, const ison_row_entry_t **cursor,
+                                     const char *name) {
+    const ison_row_entry_t *entry = *cursor;
+    if (entry && strcmp(entry->key, name) == 0) {
+        *cursor = entry->next;
+        return &entry->value;
+    }
+    return ison_row_get_ptr(row, name);
+}
+
+static void write_row_values(ison_writer_t *w, const ison_block_t *block, const ison_row_t *row,
+                             const char *delim, const size_t *widths) {
+    const ison_row_entry_t *cursor = row->head;
+    for (size_t j = 0; j < block->field_count; j++) {
+        if (j > 0) ison_writer_puts(w, delim);
+        const ison_value_t *val = next_cell(row, &cursor, block->fields[j].name);
+        size_t start = w->total;
+        ison_value_append(w, val);
+        if (widths && j + 1 < block->field_count) {
+            pad(w, widths[j], w->total - start - value_continuations(val));
+        }
+    }
+}
+
+static void write_block_head(ison_writer_t *w, const ison_block_t *block, const char *delim,
+                             const size_t *widths) {
+    ison_writer_puts(w, block->kind);
+    ison_writer_putc(w, '.');
+    ison_writer_puts(w, block->name);
+    ison_writer_putc(w, '\n');
+    
+    write_field_defs(w, block, delim, widths);
+    ison_writer_putc(w, '\n');
+}
+
+static void write_block_rows(ison_writer_t *w, const ison_block_t *block, size_t start, size_t end,
+                             const char *delim, const size_t *widths) {
+    for (size_t r = start; r < end; r++) {
+        write_row_values(w, block, block->rows[r], delim, widths);
+        ison_writer_putc(w, '\n');
+    }
+}
+
+static void write_block_summary(ison_writer_t *w, const ison_block_t *block, const char *delim,
+                                const size_t *widths) {
+    if (!block->summary_row) return;
+    ison_writer_puts(w, "---\n");
+    write_row_values(w, block, block->summary_row, delim, widths);
+    ison_writer_putc(w, '\n');
+}
+
+ison_error_t ison_dump_writer(const ison_document_t *doc, ison_writer_t *w, const ison_dumps_options_t *opts) {
+    if (!w) return ISON_ERROR_INVALID;
+    if (!doc) return w->error;
     
     const char *delim = opts && opts->delimiter ? opts->delimiter : " ";
-    size_t len = 0, cap = 1024;
-    char *result = malloc(cap);
-    if (!result) return NULL;
-    *result = '\0';
     
-    for (size_t i = 0; i < doc->order_count; i++) {
-        if (i > 0) append_char(&result, &len, &cap, '\n');
+    for (size_t i = 0; i < doc->order_count && w->error == ISON_OK; i++) {
+        if (i > 0) ison_writer_putc(w, '\n');
         
         ison_block_t *block = ison_document_get(doc, doc->order[i]);
         if (!block) continue;
         
-        char header[256];
-        snprintf(header, sizeof(header), "%s.%s\n", block->kind, block->name);
-        append_string(&result, &len, &cap, header);
+        size_t *widths = opts && opts->align_columns ? column_widths(block) : NULL;
         
-        for (size_t j = 0; j < block->field_count; j++) {
-            if (j > 0) append_string(&result, &len, &cap, delim);
-            if (block->fields[j].type_hint && *block->fields[j].type_hint) {
-                char field[256];
-                snprintf(field, sizeof(field), "%s:%s", block->fields[j].name, block->fields[j].type_hint);
-                append_string(&result, &len, &cap, field);
-            } else {
-                append_string(&result, &len, &cap, block->fields[j].name);
-            }
-        }
-        append_char(&result, &len, &cap, '\n');
-        
-        for (size_t r = 0; r < block->row_count; r++) {
-            ison_row_t *row = block->rows[r];
-            for (size_t j = 0; j < block->field_count; j++) {
-                if (j > 0) append_string(&result, &len, &cap, delim);
-                ison_value_t *val = ison_row_get_ptr(row, block->fields[j].name);
-                if (val) {
-                    char *str = ison_value_to_ison(val);
-                    append_string(&result, &len, &cap, str);
-                    free(str);
-                } else {
-                    append_char(&result, &len, &cap, '~');
-                }
-            }
-            append_char(&result, &len, &cap, '\n');
-        }
+        write_block_head(w, block, delim, widths);
+        write_block_rows(w, block, 0, block->row_count, delim, widths);
+        write_block_summary(w, block, delim, widths);
         
-        if (block->summary_row) {
-            append_string(&result, &len, &cap, "---\n");
-            for (size_t j = 0; j < block->field_count; j++) {
-                if (j > 0) append_string(&result, &len, &cap, delim);
-                ison_value_t *val = ison_row_get_ptr(block->summary_row, block->fields[j].name);
-                if (val) {
-                    char *str = ison_value_to_ison(val);
-                    append_string(&result, &len, &cap, str);
-                    free(str);
-                } else {
-                    append_char(&result, &len, &cap, '~');
-                }
-            }
-            append_char(&result, &len, &cap, '\n');
-        }
+        free(widths);
     }
     
-    return result;
+    return w->error;
+}
+
+char *ison_dumps_with_options(const ison_document_t *doc, const ison_dumps_options_t *opts) {
+    if (!doc) return strdup_safe("");
+    
+    ison_writer_t w;
+    if (ison_writer_init_memory(&w, 1024) != ISON_OK) return NULL;
+    ison_dump_writer(doc, &w, opts);
+    return ison_writer_finish(&w, NULL);
 }
 
 char *ison_dumps(const ison_document_t *doc) {
     return ison_dumps_with_options(doc, NULL);
 }
 
-char *ison_dumps_isonl(const ison_document_t *doc) {
+char *ison_dumps_exact(const ison_document_t *doc) {
     if (!doc) return strdup_safe("");
     
-    size_t len = 0, cap = 1024;
-    char *result = malloc(cap);
+    /* A writer with no buffer only counts, so the first pass measures */
+    ison_writer_t w;
+    ison_writer_init_buffer(&w, NULL, 0);
+    ison_dump_writer(doc, &w, NULL);
+    size_t len = w.total;
+    
+    char *result = malloc(len + 1);
     if (!result) return NULL;
-    *result = '\0';
+    ison_writer_init_buffer(&w, result, len);
+    if (ison_dump_writer(doc, &w, NULL) != ISON_OK) {
+        free(result);
+        return NULL;
+    }
+    result[len] = '\0';
+    return result;
+}
+
+ison_error_t ison_dumps_into(const ison_document_t *doc, char *buf, size_t cap, size_t *needed) {
+    if (!buf && cap > 0) return ISON_ERROR_INVALID;
     
-    for (size_t i = 0; i < doc->order_count; i++) {
+    ison_writer_t w;
+    ison_writer_init_buffer(&w, buf, cap > 0 ? cap - 1 : 0);
+    ison_dump_writer(doc, &w, NULL);
+    if (needed) *needed = w.total;
+    if (cap > 0) buf[w.len] = '\0';
+    return w.total < cap ? ISON_OK : ISON_ERROR_OVERFLOW;
+}
+
+static void write_isonl_prefix(ison_writer_t *w, const ison_block_t *block) {
+    ison_writer_puts(w, block->kind);
+    ison_writer_putc(w, '.');
+    ison_writer_puts(w, block->name);
+    ison_writer_putc(w, '|');
+    write_field_defs(w, block, " ", NULL);
+    ison_writer_putc(w, '|');
+}
+
+/* Render "kind.name|field:type ...|" once into an exact-length buffer */
+static char *isonl_prefix(const ison_block_t *block, size_t *out_len) {
+    ison_writer_t w;
+    ison_writer_init_buffer(&w, NULL, 0);
+    write_isonl_prefix(&w, block);
+    
+    *out_len = w.total;
+    char *buf = malloc(*out_len);
+    if (!buf) return NULL;
+    ison_writer_init_buffer(&w, buf, *out_len);
+    write_isonl_prefix(&w, block);
+    return buf;
+}
+
+ison_error_t ison_dump_isonl_writer(const ison_document_t *doc, ison_writer_t *w) {
+    if (!w) return ISON_ERROR_INVALID;
+    if (!doc) return w->error;
+    
+    int first_line = 1;
+    for (size_t i = 0; i < doc->order_count && w->error == ISON_OK; i++) {
         ison_block_t *block = ison_document_get(doc, doc->order[i]);
-        if (!block) continue;
-        
-        char header[256];
-        snprintf(header, sizeof(header), "%s.%s|", block->kind, block->name);
+        if (!block || block->row_count == 0) continue;
         
-        for (size_t j = 0; j < block->field_count; j++) {
-            if (j > 0) {
-                append_char(&result, &len, &cap, ' ');
-            }
-            if (block->fields[j].type_hint && *block->fields[j].type_hint) {
-                char field[256];
-                snprintf(field, sizeof(field), "%s:%s", block->fields[j].name, block->fields[j].type_hint);
-                append_string(&result, &len, &cap, field);
-            } else {
-                append_string(&result, &len, &cap, block->fields[j].name);
-            }
+        size_t prefix_len;
+        char *prefix = isonl_prefix(block, &prefix_len);
+        if (!prefix) {
+            w->error = ISON_ERROR_MEMORY;
+            break;
         }
-        append_char(&result, &len, &cap, '|');
-        
-        char *field_header_end = result + len;
-        (void)field_header_end;
         
         for (size_t r = 0; r < block->row_count; r++) {
-            if (r > 0 || i > 0) append_char(&result, &len, &cap, '\n');
-            append_string(&result, &len, &cap, header);
+            if (!first_line) ison_writer_putc(w, '\n');
+            first_line = 0;
             
-            for (size_t j = 0; j < block->field_count; j++) {
-                if (j > 0) append_char(&result, &len, &cap, ' ');
-                if (block->fields[j].type_hint && *block->fields[j].type_hint) {
-                    char field[256];
-                    snprintf(field, sizeof(field), "%s:%s", block->fields[j].name, block->fields[j].type_hint);
-                    append_string(&result, &len, &cap, field);
-                } else {
-                    append_string(&result, &len, &cap, block->fields[j].name);
-                }
+            ison_writer_write(w, prefix, prefix_len);
+            write_row_values(w, block, block->rows[r], " ", NULL);
+        }
+        free(prefix);
+    }
+    
+    return w->error;
+}
+
+char *ison_dumps_isonl(const ison_document_t *doc) {
+    if (!doc) return strdup_safe("");
+    
+    ison_writer_t w;
+    if (ison_writer_init_memory(&w, 1024) != ISON_OK) return NULL;
+    ison_dump_isonl_writer(doc, &w);
+    return ison_writer_finish(&w, NULL);
+}
+
+/* ==================== Parallel serialization ==================== */
+
+#define PARALLEL_MIN_ROWS 4096
+
+/*
+ * A document is cut into tasks that each own a contiguous slice of the
+ * output: a block header, a range of rows, the summary row. Tasks format
+ * into private buffers on a small thread pool and are then stitched
+ * together in order, so the bytes match the single-threaded writers.
+ */
+typedef struct {
+    const ison_block_t *block;  /* NULL: separator only */
+    size_t order_index;
+    size_t start, end;          /* row range */
+    bool head;                  /* ISON: separator and block header */
+    bool tail;                  /* ISON: summary row */
+    bool first_line;            /* ISONL: holds the document's first record */
+    size_t *widths;             /* task-local widths while measuring */
+    ison_writer_t out;
+} dump_task_t;
+
+typedef struct {
+    const char *delim;
+    bool isonl;
+    bool measuring;
+    size_t **widths;            /* per order index, aligned ISON only */
+    char **prefixes;            /* per order index, ISONL only */
+    size_t *prefix_lens;
+    dump_task_t *tasks;
+    size_t task_count;
+    size_t task_capacity;
+    size_t next;
+    size_t last;
+    pthread_mutex_t lock;
+} dump_job_t;
+
+static dump_task_t *job_add_task(dump_job_t *job) {
+    if (job->task_count >= job->task_capacity) {
+        size_t new_cap = job->task_capacity == 0 ? 16 : job->task_capacity * 2;
+        dump_task_t *new_tasks = realloc(job->tasks, new_cap * sizeof(dump_task_t));
+        if (!new_tasks) return NULL;
+        job->tasks = new_tasks;
+        job->task_capacity = new_cap;
+    }
+    dump_task_t *t = &job->tasks[job->task_count++];
+    memset(t, 0, sizeof(*t));
+    return t;
+}
+
+static void run_task(dump_job_t *job, dump_task_t *t) {
+    const ison_block_t *block = t->block;
+    
+    if (job->measuring) {
+        if (!t->widths) return;
+        measure_rows(block, t->start, t->end, t->widths);
+        if (t->tail) measure_rows(block, block->row_count, block->row_count + 1, t->widths);
+        return;
+    }
+    
+    ison_writer_t *w = &t->out;
+    if (ison_writer_init_memory(w, 256 + (t->end - t->start) * 64) != ISON_OK) return;
+    
+    if (job->isonl) {
+        for (size_t r = t->start; r < t->end; r++) {
+            if (r > t->start || !t->first_line) ison_writer_putc(w, '\n');
+            ison_writer_write(w, job->prefixes[t->order_index], job->prefix_lens[t->order_index]);
+            write_row_values(w, block, block->rows[r], " ", NULL);
+        }
+        return;
+    }
+    
+    const size_t *widths = job->widths ? job->widths[t->order_index] : NULL;
+    if (t->head && t->order_index > 0) ison_writer_putc(w, '\n');
+    if (!block) return;
+    if (t->head) write_block_head(w, block, job->delim, widths);
+    write_block_rows(w, block, t->start, t->end, job->delim, widths);
+    if (t->tail) write_block_summary(w, block, job->delim, widths);
+}
+
+static void *dump_worker(void *arg) {
+    dump_job_t *job = arg;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        size_t i = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->last) break;
+        run_task(job, &job->tasks[i]);
+    }
+    return NULL;
+}
+
+/* Run tasks [first, last) on up to nthreads threads, the caller included */
+static void run_job(dump_job_t *job, size_t first, size_t last, int nthreads) {
+    job->next = first;
+    job->last = last;
+    if ((size_t)nthreads > last - first) nthreads = (int)(last - first);
+    
+    /* The calling thread is one of the workers; without room for the others it runs alone */
+    pthread_t *threads = nthreads > 1 ? malloc((size_t)(nthreads - 1) * sizeof(pthread_t)) : NULL;
+    int started = 0;
+    for (int i = 1; threads && i < nthreads; i++) {
+        if (pthread_create(&threads[started], NULL, dump_worker, job) == 0) started++;
+    }
+    dump_worker(job);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    free(threads);
+}
+
+static void job_free(dump_job_t *job, size_t order_count) {
+    for (size_t i = 0; i < job->task_count; i++) {
+        free(job->tasks[i].widths);
+        ison_writer_free(&job->tasks[i].out);
+    }
+    free(job->tasks);
+    for (size_t i = 0; i < order_count; i++) {
+        if (job->widths) free(job->widths[i]);
+        if (job->prefixes) free(job->prefixes[i]);
+    }
+    free(job->widths);
+    free(job->prefixes);
+    free(job->prefix_lens);
+    pthread_mutex_destroy(&job->lock);
+}
+
+static int plan_tasks(dump_job_t *job, const ison_document_t *doc, size_t chunk) {
+    bool first_line = true;
+    for (size_t i = 0; i < doc->order_count; i++) {
+        const ison_block_t *block = ison_document_get(doc, doc->order[i]);
+        
+        if (job->isonl) {
+            if (!block || block->row_count == 0) continue;
+            job->prefixes[i] = isonl_prefix(block, &job->prefix_lens[i]);
+            if (!job->prefixes[i]) return 0;
+        } else if (job->widths && block) {
+            job->widths[i] = header_widths(block);
+        }
+        
+        size_t rows = block ? block->row_count : 0;
+        size_t start = 0;
+        do {
+            dump_task_t *t = job_add_task(job);
+            if (!t) return 0;
+            t->block = block;
+            t->order_index = i;
+            t->start = start;
+            t->end = rows - start > chunk ? start + chunk : rows;
+            t->head = start == 0;
+            t->tail = t->end == rows;
+            t->first_line = first_line;
+            first_line = false;
+            start = t->end;
+        } while (start < rows);
+    }
+    return 1;
+}
+
+static ison_error_t job_check(const dump_job_t *job, size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+        if (job->tasks[i].out.error != ISON_OK) return job->tasks[i].out.error;
+        if (!job->tasks[i].out.buf) return ISON_ERROR_MEMORY;
+    }
+    return ISON_OK;
+}
+
+/* Plan the tasks and, for aligned output, settle the column widths */
+static ison_error_t job_prepare(dump_job_t *job, const ison_document_t *doc,
+                                const ison_dumps_options_t *opts, int nthreads, bool isonl,
+                                size_t chunk) {
+    memset(job, 0, sizeof(*job));
+    pthread_mutex_init(&job->lock, NULL);
+    job->isonl = isonl;
+    job->delim = !isonl && opts && opts->delimiter ? opts->delimiter : " ";
+    
+    size_t n = doc->order_count ? doc->order_count : 1;
+    if (isonl) {
+        job->prefixes = calloc(n, sizeof(char *));
+        job->prefix_lens = calloc(n, sizeof(size_t));
+        if (!job->prefixes || !job->prefix_lens) return ISON_ERROR_MEMORY;
+    } else if (opts && opts->align_columns) {
+        job->widths = calloc(n, sizeof(size_t *));
+        if (!job->widths) return ISON_ERROR_MEMORY;
+    }
+    if (!plan_tasks(job, doc, chunk)) return ISON_ERROR_MEMORY;
+    
+    if (job->widths) {
+        /* Measure row ranges in parallel, then fold into per-block widths */
+        for (size_t i = 0; i < job->task_count; i++) {
+            dump_task_t *t = &job->tasks[i];
+            if (t->block && job->widths[t->order_index]) {
+                t->widths = calloc(t->block->field_count, sizeof(size_t));
+                if (!t->widths) return ISON_ERROR_MEMORY;
             }
-            append_char(&result, &len, &cap, '|');
-            
-            ison_row_t *row = block->rows[r];
-            for (size_t j = 0; j < block->field_count; j++) {
-                if (j > 0) append_char(&result, &len, &cap, ' ');
-                ison_value_t *val = ison_row_get_ptr(row, block->fields[j].name);
-                if (val) {
-                    char *str = ison_value_to_ison(val);
-                    append_string(&result, &len, &cap, str);
-                    free(str);
-                } else {
-                    append_char(&result, &len, &cap, '~');
-                }
+        }
+        job->measuring = true;
+        run_job(job, 0, job->task_count, nthreads);
+        job->measuring = false;
+        for (size_t i = 0; i < job->task_count; i++) {
+            dump_task_t *t = &job->tasks[i];
+            if (!t->widths) continue;
+            size_t *widths = job->widths[t->order_index];
+            for (size_t j = 0; j + 1 < t->block->field_count; j++) {
+                if (t->widths[j] > widths[j]) widths[j] = t->widths[j];
             }
         }
     }
+    return ISON_OK;
+}
+
+static ison_error_t dump_parallel(dump_job_t *job, const ison_document_t *doc,
+                                  const ison_dumps_options_t *opts, int nthreads, bool isonl) {
+    if (nthreads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 0 ? (int)cpus : 1;
+    }
     
+    size_t total_rows = 0;
+    for (size_t i = 0; i < doc->block_count; i++) total_rows += doc->blocks[i]->row_count;
+    size_t chunk = total_rows / ((size_t)nthreads * 4);
+    if (chunk < PARALLEL_MIN_ROWS) chunk = PARALLEL_MIN_ROWS;
+    
+    ison_error_t err = job_prepare(job, doc, opts, nthreads, isonl, chunk);
+    if (err != ISON_OK) return err;
+    run_job(job, 0, job->task_count, nthreads);
+    return job_check(job, 0, job->task_count);
+}
+
+static char *dumps_parallel(const ison_document_t *doc, const ison_dumps_options_t *opts,
+                            int nthreads, bool isonl) {
+    if (!doc) return strdup_safe("");
+    
+    dump_job_t job;
+    char *result = NULL;
+    if (dump_parallel(&job, doc, opts, nthreads, isonl) == ISON_OK) {
+        size_t total = 0;
+        for (size_t i = 0; i < job.task_count; i++) total += job.tasks[i].out.len;
+        result = malloc(total + 1);
+        if (result) {
+            char *p = result;
+            for (size_t i = 0; i < job.task_count; i++) {
+                memcpy(p, job.tasks[i].out.buf, job.tasks[i].out.len);
+                p += job.tasks[i].out.len;
+            }
+            *p = '\0';
+        }
+    }
+    job_free(&job, doc->order_count);
     return result;
 }
 
+char *ison_dumps_parallel(const ison_document_t *doc, const ison_dumps_options_t *opts, int nthreads) {
+    return dumps_parallel(doc, opts, nthreads, false);
+}
+
+char *ison_dumps_isonl_parallel(const ison_document_t *doc, int nthreads) {
+    return dumps_parallel(doc, NULL, nthreads, true);
+}
+
+/* ==================== Vectored fd output ==================== */
+
+#define FD_CHUNK_ROWS 1024
+#define FD_IOV_BATCH 64
+
+static ison_error_t writev_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return ISON_ERROR_IO;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return ISON_OK;
+}
+
+/*
+ * Serialize in row chunks and hand each batch of chunk buffers to the
+ * kernel with a single writev, so the output is never stitched into one
+ * string and memory stays bounded by one batch.
+ */
+static ison_error_t dump_fd(const ison_document_t *doc, int fd, const ison_dumps_options_t *opts,
+                            bool isonl) {
+    if (fd < 0) return ISON_ERROR_INVALID;
+    if (!doc) return ISON_OK;
+    
+    dump_job_t job;
+    ison_error_t err = job_prepare(&job, doc, opts, 1, isonl, FD_CHUNK_ROWS);
+    
+    struct iovec iov[FD_IOV_BATCH];
+    for (size_t first = 0; err == ISON_OK && first < job.task_count; first += FD_IOV_BATCH) {
+        size_t last = first + FD_IOV_BATCH < job.task_count ? first + FD_IOV_BATCH : job.task_count;
+        run_job(&job, first, last, 1);
+        err = job_check(&job, first, last);
+        
+        int count = 0;
+        for (size_t i = first; err == ISON_OK && i < last; i++) {
+            if (job.tasks[i].out.len == 0) continue;
+            iov[count].iov_base = job.tasks[i].out.buf;
+            iov[count].iov_len = job.tasks[i].out.len;
+            count++;
+        }
+        if (err == ISON_OK) err = writev_all(fd, iov, count);
+        
+        for (size_t i = first; i < last; i++) ison_writer_free(&job.tasks[i].out);
+    }
+    
+    job_free(&job, doc->order_count);
+    return err;
+}
+
+ison_error_t ison_dump_fd(const ison_document_t *doc, int fd, const ison_dumps_options_t *opts) {
+    return dump_fd(doc, fd, opts, false);
+}
+
+ison_error_t ison_dump_isonl_fd(const ison_document_t *doc, int fd) {
+    return dump_fd(doc, fd, NULL, true);
+}
+
 ison_dumps_options_t ison_default_dumps_options(void) {
     ison_dumps_options_t opts = {0};
     opts.align_columns = 0;
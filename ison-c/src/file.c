@@ -1,6 +1,13 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 #include "ison.h"
 
 char *ison_read_file(const char *path, size_t *out_len) {
@@ -49,45 +56,240 @@ ison_error_t ison_write_file(const char *path, const char *content) {
 ison_document_t *ison_load(const char *path, ison_error_t *error) {
     if (error) *error = ISON_OK;
     
-    char *content = ison_read_file(path, NULL);
+    size_t len;
+    char *content = ison_read_file(path, &len);
     if (!content) {
         if (error) *error = ISON_ERROR_IO;
         return NULL;
     }
     
-    ison_document_t *doc = ison_parse(content, error);
+    ison_document_t *doc = ison_parse_n(content, len, error);
     free(content);
     return doc;
 }
 
-ison_error_t ison_dump(const ison_document_t *doc, const char *path) {
-    char *content = ison_dumps(doc);
-    if (!content) return ISON_ERROR_MEMORY;
+static ison_error_t dump_to_path(const ison_document_t *doc, const char *path, bool isonl) {
+    if (!path) return ISON_ERROR_INVALID;
     
-    ison_error_t err = ison_write_file(path, content);
-    free(content);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return ISON_ERROR_IO;
+    
+    ison_error_t err = isonl ? ison_dump_isonl_fd(doc, fd) : ison_dump_fd(doc, fd, NULL);
+    if (close(fd) != 0 && err == ISON_OK) err = ISON_ERROR_IO;
     return err;
 }
 
+ison_error_t ison_dump(const ison_document_t *doc, const char *path) {
+    return dump_to_path(doc, path, false);
+}
+
 ison_document_t *ison_load_isonl(const char *path, ison_error_t *error) {
     if (error) *error = ISON_OK;
     
-    char *content = ison_read_file(path, NULL);
+    size_t len;
+    char *content = ison_read_file(path, &len);
     if (!content) {
         if (error) *error = ISON_ERROR_IO;
         return NULL;
     }
     
-    ison_document_t *doc = ison_parse_isonl(content, error);
+    ison_document_t *doc = ison_parse_isonl_n(content, len, error);
     free(content);
     return doc;
 }
 
 ison_error_t ison_dump_isonl(const ison_document_t *doc, const char *path) {
-    char *content = ison_dumps_isonl(doc);
-    if (!content) return ISON_ERROR_MEMORY;
-    
-    ison_error_t err = ison_write_file(path, content);
-    free(content);
+    return dump_to_path(doc, path, true);
+}
+
+/* ==================== Loading many files ==================== */
+
+typedef struct {
+    size_t index;
+    uint64_t size;
+} load_task_t;
+
+typedef struct {
+    const char *const *paths;
+    load_task_t *tasks;
+    size_t count;
+    size_t next;
+    size_t workers;
+    pthread_mutex_t lock;
+    ison_document_t **docs;
+    ison_error_t *errs;
+    ison_load_timing_t *timings;
+} load_job_t;
+
+static double load_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool has_suffix(const char *path, const char *suffix) {
+    size_t len = strlen(path), n = strlen(suffix);
+    return len >= n && strcmp(path + len - n, suffix) == 0;
+}
+
+/* Whole file with a terminating NUL; the size from fstat is only a first guess */
+static char *read_fd(int fd, uint64_t hint, size_t *out_len) {
+    /* Room for the terminator and one spare byte, so EOF shows up without growing */
+    size_t cap = (size_t)hint + 2, len = 0;
+    char *buf = malloc(cap);
+    while (buf) {
+        if (len + 1 >= cap) {
+            char *grown = realloc(buf, cap * 2);
+            if (!grown) break;
+            buf = grown;
+            cap *= 2;
+        }
+        ssize_t n = read(fd, buf + len, cap - 1 - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) break;
+        if (n == 0) {
+            buf[len] = '\0';
+            *out_len = len;
+            return buf;
+        }
+        len += (size_t)n;
+    }
+    free(buf);
+    return NULL;
+}
+
+static void load_one(load_job_t *job, const load_task_t *task) {
+    const char *path = job->paths[task->index];
+    ison_load_timing_t timing = {0, 0, 0};
+    ison_error_t err = ISON_OK;
+    ison_document_t *doc = NULL;
+    double start = load_clock();
+
+    if (has_suffix(path, ".isonb")) {
+        doc = ison_load_binary(path, &err);
+        timing.bytes = (size_t)task->size;
+        timing.parse_seconds = load_clock() - start;
+    } else {
+        int fd = open(path, O_RDONLY);
+        char *text = NULL;
+        if (fd >= 0) {
+#if defined(POSIX_FADV_SEQUENTIAL)
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+            text = read_fd(fd, task->size, &timing.bytes);
+            close(fd);
+        }
+        double read_done = load_clock();
+        timing.read_seconds = read_done - start;
+        if (!text) {
+            err = fd < 0 ? ISON_ERROR_IO : ISON_ERROR_MEMORY;
+        } else {
+            doc = has_suffix(path, ".isonl") ? ison_parse_isonl_n(text, timing.bytes, &err)
+                                              : ison_parse_n(text, timing.bytes, &err);
+            free(text);
+        }
+        timing.parse_seconds = load_clock() - read_done;
+    }
+
+    if (err != ISON_OK) {
+        ison_document_free(doc);
+        doc = NULL;
+    }
+    job->docs[task->index] = doc;
+    job->errs[task->index] = err;
+    if (job->timings) job->timings[task->index] = timing;
+}
+
+/* Start readahead for a task that has not been picked up yet */
+static void load_prefetch(const load_job_t *job, size_t i) {
+#if defined(POSIX_FADV_WILLNEED)
+    if (i >= job->count) return;
+    int fd = open(job->paths[job->tasks[i].index], O_RDONLY);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+#else
+    (void)job;
+    (void)i;
+#endif
+}
+
+static void *load_worker(void *arg) {
+    load_job_t *job = arg;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        size_t i = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->count) break;
+        /*
+         * Task i + workers is roughly the one that starts when this one ends; each task
+         * is hinted once, by whoever took the task one round before it, so the disk reads
+         * it while this file is parsed.
+         */
+        load_prefetch(job, i + job->workers);
+        load_one(job, &job->tasks[i]);
+    }
+    return NULL;
+}
+
+static int larger_first(const void *a, const void *b) {
+    const load_task_t *x = a, *y = b;
+    if (x->size != y->size) return x->size < y->size ? 1 : -1;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+ison_error_t ison_load_many(const char *const *paths, size_t count, int nthreads, ison_document_t **docs_out,
+                            ison_error_t *errs_out, ison_load_timing_t *timings) {
+    if (!docs_out || (count > 0 && !paths)) return ISON_ERROR_INVALID;
+    for (size_t i = 0; i < count; i++) {
+        docs_out[i] = NULL;
+        if (!paths[i]) return ISON_ERROR_INVALID;
+    }
+    if (count == 0) return ISON_OK;
+
+    load_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.paths = paths;
+    job.count = count;
+    job.docs = docs_out;
+    job.timings = timings;
+    job.tasks = malloc(count * sizeof(load_task_t));
+    job.errs = errs_out ? errs_out : malloc(count * sizeof(ison_error_t));
+    if (!job.tasks || !job.errs) {
+        free(job.tasks);
+        if (!errs_out) free(job.errs);
+        return ISON_ERROR_MEMORY;
+    }
+
+    /* Largest first, so a big file does not start last and hold up the end */
+    for (size_t i = 0; i < count; i++) {
+        struct stat st;
+        job.tasks[i].index = i;
+        job.tasks[i].size = stat(paths[i], &st) == 0 ? (uint64_t)st.st_size : 0;
+    }
+    qsort(job.tasks, count, sizeof(load_task_t), larger_first);
+
+    if (nthreads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 0 ? (int)cpus : 1;
+    }
+    if ((size_t)nthreads > count) nthreads = (int)count;
+    /* The calling thread is one of the workers; without room for the others it loads alone */
+    pthread_t *threads = nthreads > 1 ? malloc((size_t)(nthreads - 1) * sizeof(pthread_t)) : NULL;
+    int started = 0;
+    pthread_mutex_init(&job.lock, NULL);
+    job.workers = threads ? (size_t)nthreads : 1;
+    for (int i = 1; threads && i < nthreads; i++) {
+        if (pthread_create(&threads[started], NULL, load_worker, &job) == 0) started++;
+    }
+    load_worker(&job);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&job.lock);
+    free(threads);
+
+    ison_error_t err = ISON_OK;
+    for (size_t i = 0; i < count && err == ISON_OK; i++) err = job.errs[i];
+    free(job.tasks);
+    if (!errs_out) free(job.errs);
     return err;
 }
@@ -0,0 +1,446 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ison.h"
+#include "lex.h"
+
+/*
+ * Sidecar index for an ISONL file. Rows are record lines, counted the way
+ * ison_parse_isonl counts them; blank, comment and malformed lines are not
+ * rows. Every integer is little-endian.
+ *
+ *   header       48 bytes: magic, version, stride, row count, size of the
+ *                indexed file, checkpoint count, block count
+ *   checkpoints  u64 byte offset of rows 0, stride, 2 * stride, ...
+ *   blocks       per block: u64 row count, u32 name length, name, padded to 8
+ *
+ * The indexed file may grow after the index is built: rows past the last
+ * checkpoint are found by scanning forward from it.
+ */
+
+#define INDEX_MAGIC "ISONLIX\0"
+#define INDEX_VERSION 1
+#define INDEX_HEADER_SIZE 48
+#define INDEX_SCAN_BUFFER 65536
+
+struct isonl_index {
+    int fd;
+    uint32_t stride;
+    uint64_t rows;
+    uint64_t *checkpoints;
+    uint64_t checkpoint_count;
+    char **block_names;
+    uint64_t *block_rows;
+    size_t block_count;
+};
+
+static inline void put_le32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static inline void put_le64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static inline uint32_t get_le32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t get_le64(const unsigned char *p) {
+    return (uint64_t)get_le32(p) | (uint64_t)get_le32(p + 4) << 32;
+}
+
+/* ==================== Line scanning ==================== */
+
+typedef struct {
+    int fd;
+    char *buf;
+    size_t len;
+    size_t pos;
+    size_t cap;
+    uint64_t base;          /* file offset of buf[0] */
+    bool eof;
+    ison_error_t error;
+} line_scan_t;
+
+static void scan_init(line_scan_t *s, int fd, uint64_t offset) {
+    memset(s, 0, sizeof(*s));
+    s->fd = fd;
+    s->base = offset;
+}
+
+/* Next line from the file, without its line break; false at end of file or on error */
+static bool scan_next(line_scan_t *s, const char **line, size_t *len, uint64_t *start) {
+    for (;;) {
+        char *nl = s->pos < s->len ? memchr(s->buf + s->pos, '\n', s->len - s->pos) : NULL;
+        if (nl || (s->eof && s->pos < s->len)) {
+            size_t end = nl ? (size_t)(nl - s->buf) : s->len;
+            *line = s->buf + s->pos;
+            *len = end - s->pos;
+            *start = s->base + s->pos;
+            s->pos = nl ? end + 1 : end;
+            return true;
+        }
+        if (s->eof) return false;
+
+        /* Keep the partial line, then read after it */
+        if (s->pos < s->len) memmove(s->buf, s->buf + s->pos, s->len - s->pos);
+        s->base += s->pos;
+        s->len -= s->pos;
+        s->pos = 0;
+        if (s->cap - s->len < INDEX_SCAN_BUFFER / 2) {
+            size_t cap = s->cap ? s->cap * 2 : INDEX_SCAN_BUFFER;
+            char *buf = realloc(s->buf, cap);
+            if (!buf) {
+                s->error = ISON_ERROR_MEMORY;
+                return false;
+            }
+            s->buf = buf;
+            s->cap = cap;
+        }
+        ssize_t n = pread(s->fd, s->buf + s->len, s->cap - s->len, (off_t)(s->base + s->len));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            s->error = ISON_ERROR_IO;
+            return false;
+        }
+        if (n == 0) s->eof = true;
+        s->len += (size_t)n;
+    }
+}
+
+/* Block name of a record line, or NULL when the line is not a record */
+static const char *record_name(const char *line, size_t len, size_t *name_len) {
+    ison_lex_trim(&line, &len);
+    if (len == 0 || line[0] == '#') return NULL;
+    const char *p1 = memchr(line, '|', len);
+    if (!p1 || !memchr(p1 + 1, '|', len - (size_t)(p1 + 1 - line))) return NULL;
+    const char *dot = memchr(line, '.', (size_t)(p1 - line));
+    if (!dot) return NULL;
+    *name_len = (size_t)(p1 - dot - 1);
+    return dot + 1;
+}
+
+/* ==================== Building ==================== */
+
+typedef struct {
+    char *name;
+    size_t name_len;
+    uint64_t rows;
+} block_count_t;
+
+ison_error_t isonl_build_index(const char *path, const char *index_path, size_t stride) {
+    if (!path || !index_path) return ISON_ERROR_INVALID;
+    if (stride == 0) stride = ISONL_INDEX_STRIDE;
+    if (stride > UINT32_MAX) return ISON_ERROR_INVALID;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return ISON_ERROR_IO;
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    ison_error_t err = ISON_OK;
+    uint64_t *checkpoints = NULL;
+    size_t checkpoint_cap = 0;
+    uint64_t rows = 0;
+    block_count_t *blocks = NULL;
+    size_t block_count = 0, block_cap = 0, last = 0;
+
+    line_scan_t s;
+    scan_init(&s, fd, 0);
+    const char *line;
+    size_t len;
+    uint64_t start;
+    while (err == ISON_OK && scan_next(&s, &line, &len, &start)) {
+        size_t name_len;
+        const char *name = record_name(line, len, &name_len);
+        if (!name) continue;
+
+        if (rows % stride == 0) {
+            if (rows / stride >= checkpoint_cap) {
+                size_t cap = checkpoint_cap ? checkpoint_cap * 2 : 256;
+                uint64_t *grown = realloc(checkpoints, cap * sizeof(uint64_t));
+                if (!grown) {
+                    err = ISON_ERROR_MEMORY;
+                    break;
+                }
+                checkpoints = grown;
+                checkpoint_cap = cap;
+            }
+            checkpoints[rows / stride] = start;
+        }
+        rows++;
+
+        /* Logs tend to repeat a block, so try the last one first */
+        if (last < block_count && blocks[last].name_len == name_len && memcmp(blocks[last].name, name, name_len) == 0) {
+            blocks[last].rows++;
+            continue;
+        }
+        for (last = 0; last < block_count; last++) {
+            if (blocks[last].name_len == name_len && memcmp(blocks[last].name, name, name_len) == 0) break;
+        }
+        if (last == block_count) {
+            if (block_count == block_cap) {
+                size_t cap = block_cap ? block_cap * 2 : 8;
+                block_count_t *grown = realloc(blocks, cap * sizeof(block_count_t));
+                if (!grown) {
+                    err = ISON_ERROR_MEMORY;
+                    break;
+                }
+                blocks = grown;
+                block_cap = cap;
+            }
+            blocks[last].name = malloc(name_len + 1);
+            if (!blocks[last].name) {
+                err = ISON_ERROR_MEMORY;
+                break;
+            }
+            memcpy(blocks[last].name, name, name_len);
+            blocks[last].name[name_len] = '\0';
+            blocks[last].name_len = name_len;
+            blocks[last].rows = 0;
+            block_count++;
+        }
+        blocks[last].rows++;
+    }
+    if (err == ISON_OK) err = s.error;
+    uint64_t file_size = s.base + s.len;
+    free(s.buf);
+    close(fd);
+
+    if (err == ISON_OK) {
+        int out = open(index_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) err = ISON_ERROR_IO;
+        if (out >= 0) {
+            ison_writer_t w;
+            ison_writer_init_fd(&w, out, 0);
+            uint64_t checkpoint_count = (rows + stride - 1) / stride;
+            unsigned char header[INDEX_HEADER_SIZE] = {0};
+            memcpy(header, INDEX_MAGIC, 8);
+            put_le32(header + 8, INDEX_VERSION);
+            put_le32(header + 12, (uint32_t)stride);
+            put_le64(header + 16, rows);
+            put_le64(header + 24, file_size);
+            put_le64(header + 32, checkpoint_count);
+            put_le64(header + 40, block_count);
+            ison_writer_write(&w, (const char *)header, sizeof(header));
+            for (uint64_t i = 0; i < checkpoint_count; i++) {
+                unsigned char buf[8];
+                put_le64(buf, checkpoints[i]);
+                ison_writer_write(&w, (const char *)buf, 8);
+            }
+            for (size_t i = 0; i < block_count; i++) {
+                static const char zeros[8] = {0};
+                unsigned char buf[12];
+                put_le64(buf, blocks[i].rows);
+                put_le32(buf + 8, (uint32_t)blocks[i].name_len);
+                ison_writer_write(&w, (const char *)buf, 12);
+                ison_writer_write(&w, blocks[i].name, blocks[i].name_len);
+                ison_writer_write(&w, zeros, (8 - (12 + blocks[i].name_len) % 8) % 8);
+            }
+            err = ison_writer_flush(&w);
+            ison_writer_free(&w);
+            if (close(out) != 0 && err == ISON_OK) err = ISON_ERROR_IO;
+        }
+    }
+
+    for (size_t i = 0; i < block_count; i++) free(blocks[i].name);
+    free(blocks);
+    free(checkpoints);
+    return err;
+}
+
+/* ==================== Reading ==================== */
+
+static ison_error_t index_load(isonl_index_t *ix, const unsigned char *data, size_t size, uint64_t file_size) {
+    if (size < INDEX_HEADER_SIZE || memcmp(data, INDEX_MAGIC, 8) != 0) return ISON_ERROR_PARSE;
+    if (get_le32(data + 8) != INDEX_VERSION) return ISON_ERROR_PARSE;
+    ix->stride = get_le32(data + 12);
+    ix->rows = get_le64(data + 16);
+    uint64_t indexed_size = get_le64(data + 24);
+    ix->checkpoint_count = get_le64(data + 32);
+    uint64_t block_count = get_le64(data + 40);
+    if (ix->stride == 0 || ix->checkpoint_count != (ix->rows + ix->stride - 1) / ix->stride) return ISON_ERROR_PARSE;
+    if (ix->checkpoint_count > (size - INDEX_HEADER_SIZE) / 8) return ISON_ERROR_PARSE;
+    /* A shorter file is not the one that was indexed */
+    if (file_size < indexed_size) return ISON_ERROR_INVALID;
+
+    ix->checkpoints = malloc((ix->checkpoint_count ? ix->checkpoint_count : 1) * sizeof(uint64_t));
+    if (!ix->checkpoints) return ISON_ERROR_MEMORY;
+    const unsigned char *p = data + INDEX_HEADER_SIZE;
+    for (uint64_t i = 0; i < ix->checkpoint_count; i++, p += 8) {
+        ix->checkpoints[i] = get_le64(p);
+        if (ix->checkpoints[i] >= indexed_size || (i > 0 && ix->checkpoints[i] <= ix->checkpoints[i - 1])) {
+            return ISON_ERROR_PARSE;
+        }
+    }
+
+    const unsigned char *end = data + size;
+    if (block_count > (size_t)(end - p) / 16) return ISON_ERROR_PARSE;
+    ix->block_names = calloc(block_count ? block_count : 1, sizeof(char *));
+    ix->block_rows = malloc((block_count ? block_count : 1) * sizeof(uint64_t));
+    if (!ix->block_names || !ix->block_rows) return ISON_ERROR_MEMORY;
+    for (uint64_t i = 0; i < block_count; i++) {
+        if (end - p < 12) return ISON_ERROR_PARSE;
+        uint64_t rows = get_le64(p);
+        uint32_t name_len = get_le32(p + 8);
+        if ((uint64_t)(end - p - 12) < name_len) return ISON_ERROR_PARSE;
+        char *name = malloc((size_t)name_len + 1);
+        if (!name) return ISON_ERROR_MEMORY;
+        memcpy(name, p + 12, name_len);
+        name[name_len] = '\0';
+        ix->block_names[i] = name;
+        ix->block_rows[i] = rows;
+        ix->block_count++;
+        size_t entry = 12 + (size_t)name_len;
+        entry += (8 - entry % 8) % 8;
+        p += (size_t)(end - p) < entry ? (size_t)(end - p) : entry;
+    }
+    return ISON_OK;
+}
+
+isonl_index_t *isonl_open_indexed(const char *path, const char *index_path, ison_error_t *error) {
+    if (error) *error = ISON_OK;
+    if (!path || !index_path) {
+        if (error) *error = ISON_ERROR_INVALID;
+        return NULL;
+    }
+
+    isonl_index_t *ix = calloc(1, sizeof(isonl_index_t));
+    if (!ix) {
+        if (error) *error = ISON_ERROR_MEMORY;
+        return NULL;
+    }
+    ix->fd = open(path, O_RDONLY);
+    size_t size = 0;
+    char *data = ix->fd >= 0 ? ison_read_file(index_path, &size) : NULL;
+    struct stat st;
+    ison_error_t err = ISON_OK;
+    if (!data || fstat(ix->fd, &st) != 0) {
+        err = ISON_ERROR_IO;
+    } else {
+        err = index_load(ix, (const unsigned char *)data, size, (uint64_t)st.st_size);
+    }
+    free(data);
+    if (err != ISON_OK) {
+        isonl_index_close(ix);
+        ix = NULL;
+    }
+    if (error) *error = err;
+    return ix;
+}
+
+void isonl_index_close(isonl_index_t *ix) {
+    if (!ix) return;
+    if (ix->fd >= 0) close(ix->fd);
+    for (size_t i = 0; i < ix->block_count; i++) free(ix->block_names[i]);
+    free(ix->block_names);
+    free(ix->block_rows);
+    free(ix->checkpoints);
+    free(ix);
+}
+
+uint64_t isonl_index_rows(const isonl_index_t *ix) {
+    return ix ? ix->rows : 0;
+}
+
+uint64_t isonl_index_block_rows(const isonl_index_t *ix, const char *name) {
+    if (!ix || !name) return 0;
+    for (size_t i = 0; i < ix->block_count; i++) {
+        if (strcmp(ix->block_names[i], name) == 0) return ix->block_rows[i];
+    }
+    return 0;
+}
+
+/* Offset of the row `skip` rows after the first row at or past `offset`; ISON_ERROR_INVALID at end of file */
+static ison_error_t scan_rows(int fd, uint64_t offset, uint64_t skip, uint64_t *out) {
+    line_scan_t s;
+    scan_init(&s, fd, offset);
+    const char *line;
+    size_t len;
+    uint64_t start;
+    ison_error_t err = ISON_ERROR_INVALID;
+    while (scan_next(&s, &line, &len, &start)) {
+        size_t name_len;
+        if (!record_name(line, len, &name_len)) continue;
+        if (skip-- == 0) {
+            *out = start;
+            err = ISON_OK;
+            break;
+        }
+    }
+    if (s.error != ISON_OK) err = s.error;
+    free(s.buf);
+    return err;
+}
+
+ison_error_t isonl_seek_row(const isonl_index_t *ix, uint64_t row, uint64_t *offset) {
+    if (!ix || !offset) return ISON_ERROR_INVALID;
+    uint64_t k = row / ix->stride;
+    if (k >= ix->checkpoint_count) k = ix->checkpoint_count ? ix->checkpoint_count - 1 : 0;
+    uint64_t from = ix->checkpoint_count ? ix->checkpoints[k] : 0;
+    return scan_rows(ix->fd, from, row - k * ix->stride, offset);
+}
+
+ison_document_t *isonl_read_range(const isonl_index_t *ix, uint64_t start, uint64_t count, ison_error_t *error) {
+    if (error) *error = ISON_OK;
+    if (!ix) {
+        if (error) *error = ISON_ERROR_INVALID;
+        return NULL;
+    }
+    if (count == 0) return ison_document_create();
+
+    uint64_t from, to;
+    ison_error_t err = isonl_seek_row(ix, start, &from);
+    if (err == ISON_ERROR_INVALID) return ison_document_create();    /* past the last row */
+    if (err == ISON_OK) {
+        /* A short range ends sooner by scanning on than from a checkpoint */
+        if (count <= ix->stride) err = scan_rows(ix->fd, from, count, &to);
+        else err = count <= UINT64_MAX - start ? isonl_seek_row(ix, start + count, &to) : ISON_ERROR_INVALID;
+        if (err == ISON_ERROR_INVALID) {
+            /* The range runs to the end of the file */
+            struct stat st;
+            if (fstat(ix->fd, &st) == 0) {
+                err = ISON_OK;
+                to = (uint64_t)st.st_size;
+            } else {
+                err = ISON_ERROR_IO;
+            }
+        }
+    }
+    if (err != ISON_OK) {
+        if (error) *error = err;
+        return NULL;
+    }
+
+    size_t len = (size_t)(to - from);
+    char *text = malloc(len + 1);
+    if (!text) {
+        if (error) *error = ISON_ERROR_MEMORY;
+        return NULL;
+    }
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = pread(ix->fd, text + got, len - got, (off_t)(from + got));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    text[got] = '\0';
+
+    ison_document_t *doc = NULL;
+    if (got < len) {
+        err = ISON_ERROR_IO;
+    } else {
+        doc = ison_parse_isonl_n(text, got, &err);
+    }
+    free(text);
+    if (error) *error = err;
+    return doc;
+}
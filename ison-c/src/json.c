@@ -0,0 +1,1020 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "ison.h"
+#include "scan.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * JSON is read in two stages. Stage one classifies the input 64 bytes at
+ * a time into bitmasks and records the offset of every structural
+ * character ({}[]:,) outside strings, every opening quote, and the first
+ * byte of every bare atom. Stage two walks that index to build the
+ * document, so string and number bodies are only touched when decoded.
+ */
+
+static char *strdup_safe(const char *str) {
+    if (!str) return NULL;
+    size_t len = strlen(str);
+    char *copy = malloc(len + 1);
+    if (copy) memcpy(copy, str, len + 1);
+    return copy;
+}
+
+/* ==================== Stage 1: structural index ==================== */
+
+/* 32-bit offsets halve the index; inputs of 4 GiB or more are refused with ISON_ERROR_OVERFLOW */
+typedef struct {
+    uint32_t *pos;
+    size_t count;
+    size_t cap;
+} json_index_t;
+
+typedef struct {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;
+    uint64_t ws;
+} json_masks_t;
+
+#define ODD_BITS 0xAAAAAAAAAAAAAAAAULL
+
+#if defined(__SSE2__)
+static inline uint64_t movemask16(__m128i hit, int shift) {
+    return (uint64_t)(uint16_t)_mm_movemask_epi8(hit) << shift;
+}
+
+static void classify_block(const unsigned char *p, json_masks_t *m) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i curly_open = _mm_set1_epi8('{');
+    const __m128i curly_close = _mm_set1_epi8('}');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    
+    memset(m, 0, sizeof(*m));
+    for (int i = 0; i < 64; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+        /* '[' and ']' are '{' and '}' with bit 5 clear */
+        __m128i folded = _mm_or_si128(x, lower);
+        __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, curly_open), _mm_cmpeq_epi8(folded, curly_close)),
+            _mm_or_si128(_mm_cmpeq_epi8(x, colon), _mm_cmpeq_epi8(x, comma)));
+        __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(x, space), _mm_cmpeq_epi8(x, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(x, nl), _mm_cmpeq_epi8(x, cr)));
+        m->quote |= movemask16(_mm_cmpeq_epi8(x, quote), i);
+        m->backslash |= movemask16(_mm_cmpeq_epi8(x, backslash), i);
+        m->op |= movemask16(op, i);
+        m->ws |= movemask16(ws, i);
+    }
+}
+#else
+enum { CLASS_QUOTE = 1, CLASS_BACKSLASH = 2, CLASS_OP = 4, CLASS_WS = 8 };
+
+static const unsigned char json_class[256] = {
+    ['"'] = CLASS_QUOTE, ['\\'] = CLASS_BACKSLASH,
+    ['{'] = CLASS_OP, ['}'] = CLASS_OP, ['['] = CLASS_OP, [']'] = CLASS_OP,
+    [':'] = CLASS_OP, [','] = CLASS_OP,
+    [' '] = CLASS_WS, ['\t'] = CLASS_WS, ['\n'] = CLASS_WS, ['\r'] = CLASS_WS
+};
+
+static void classify_block(const unsigned char *p, json_masks_t *m) {
+    memset(m, 0, sizeof(*m));
+    for (int i = 0; i < 64; i++) {
+        unsigned c = json_class[p[i]];
+        if (!c) continue;
+        uint64_t bit = 1ULL << i;
+        if (c & CLASS_QUOTE) m->quote |= bit;
+        if (c & CLASS_BACKSLASH) m->backslash |= bit;
+        if (c & CLASS_OP) m->op |= bit;
+        if (c & CLASS_WS) m->ws |= bit;
+    }
+}
+#endif
+
+/* Bit i set when the byte at i is inside a string, counting the opening quote */
+static inline uint64_t prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+static int index_reserve(json_index_t *ix, size_t extra) {
+    if (ix->count + extra <= ix->cap) return 1;
+    size_t new_cap = ix->cap ? ix->cap : 1024;
+    while (new_cap < ix->count + extra) new_cap *= 2;
+    uint32_t *pos = realloc(ix->pos, new_cap * sizeof(uint32_t));
+    if (!pos) return 0;
+    ix->pos = pos;
+    ix->cap = new_cap;
+    return 1;
+}
+
+static ison_error_t json_index_build(json_index_t *ix, const char *text, size_t len) {
+    ix->count = 0;
+    if (len > UINT32_MAX) return ISON_ERROR_OVERFLOW;
+    
+    uint64_t prev_escaped = 0;    /* first byte of the next block is escaped */
+    uint64_t prev_in_string = 0;  /* all ones when the last block ended inside a string */
+    uint64_t prev_atom = 0;       /* last byte of the last block was part of an atom */
+    unsigned char tail[64];
+    
+    for (size_t base = 0; base < len; base += 64) {
+        const unsigned char *p = (const unsigned char *)text + base;
+        if (len - base < 64) {
+            /* Pad the final block with blanks, which never start a token */
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, p, len - base);
+            p = tail;
+        }
+    
+        json_masks_t m;
+        classify_block(p, &m);
+    
+        /* A quote is escaped by an odd run of backslashes before it */
+        uint64_t escaped;
+        if (!m.backslash) {
+            escaped = prev_escaped;
+            prev_escaped = 0;
+        } else {
+            uint64_t potential = m.backslash & ~prev_escaped;
+            uint64_t codes = (((potential << 1) | ODD_BITS) - potential) ^ ODD_BITS;
+            escaped = codes ^ (m.backslash | prev_escaped);
+            prev_escaped = (codes & m.backslash) >> 63;
+        }
+    
+        uint64_t quote = m.quote & ~escaped;
+        uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+        prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+    
+        uint64_t outside = ~(in_string | quote);
+        uint64_t atom = outside & ~(m.op | m.ws);
+        uint64_t bits = (m.op & outside) | (quote & in_string) | (atom & ~((atom << 1) | prev_atom));
+        prev_atom = atom >> 63;
+    
+        if (!index_reserve(ix, 64)) return ISON_ERROR_MEMORY;
+        while (bits) {
+            ix->pos[ix->count++] = (uint32_t)(base + (size_t)__builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+    
+    return prev_in_string ? ISON_ERROR_PARSE : ISON_OK;
+}
+
+/* ==================== Stage 2: document builder ==================== */
+
+/* Objects and arrays nest at most this deep; the builder recurses once per level */
+#define JSON_MAX_DEPTH 1024
+
+typedef struct {
+    char *key;
+    size_t token;
+} json_deferred_t;
+
+typedef struct {
+    const char *text;
+    size_t len;
+    json_index_t index;
+    size_t next;
+    ison_document_t *doc;
+    char *key;              /* decoded member key */
+    size_t key_cap;
+    char *str;              /* decoded string value */
+    size_t str_cap;
+    json_deferred_t *deferred;  /* nested members, built once their row has an id */
+    size_t deferred_count;
+    size_t deferred_cap;
+    size_t *emitted;        /* NDJSON: rows already handed out, per document block */
+    size_t emitted_count;
+    size_t depth;           /* objects and arrays being built */
+    bool summaries;         /* see ison_json_options_t */
+    ison_error_t error;
+} json_parser_t;
+
+static int json_fail(json_parser_t *jp, ison_error_t error) {
+    if (jp->error == ISON_OK) jp->error = error;
+    return 0;
+}
+
+static char json_peek(const json_parser_t *jp) {
+    if (jp->next >= jp->index.count) return '\0';
+    return jp->text[jp->index.pos[jp->next]];
+}
+
+static int json_expect(json_parser_t *jp, char ch) {
+    if (json_peek(jp) != ch) return json_fail(jp, ISON_ERROR_PARSE);
+    jp->next++;
+    return 1;
+}
+
+static int grow_buffer(char **buf, size_t *cap, size_t need) {
+    if (need <= *cap) return 1;
+    size_t new_cap = *cap ? *cap : 64;
+    while (new_cap < need) new_cap *= 2;
+    char *grown = realloc(*buf, new_cap);
+    if (!grown) return 0;
+    *buf = grown;
+    *cap = new_cap;
+    return 1;
+}
+
+static int hex_digit(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+static long read_hex4(const char *p, const char *end) {
+    if (end - p < 4) return -1;
+    long value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_digit(p[i]);
+        if (digit < 0) return -1;
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+static char *put_utf8(char *out, unsigned long cp) {
+    if (cp < 0x80) {
+        *out++ = (char)cp;
+    } else if (cp < 0x800) {
+        *out++ = (char)(0xC0 | (cp >> 6));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *out++ = (char)(0xE0 | (cp >> 12));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    } else {
+        *out++ = (char)(0xF0 | (cp >> 18));
+        *out++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    }
+    return out;
+}
+
+/*
+ * Decode the string whose opening quote is the current token into *buf
+ * (NUL-terminated). Escape-free runs are found with the shared scanner
+ * and copied whole. Unpaired surrogates decode to U+FFFD.
+ */
+static int json_string(json_parser_t *jp, char **buf, size_t *cap, size_t *out_len) {
+    if (json_peek(jp) != '"') return json_fail(jp, ISON_ERROR_PARSE);
+    const char *p = jp->text + jp->index.pos[jp->next++] + 1;
+    const char *end = jp->text + jp->len;
+    /* \uXXXX (6 bytes) decodes to at most 3 bytes, so the raw length bounds the output */
+    char *out = NULL;
+    size_t used = 0;
+    
+    for (;;) {
+        size_t run = ison_scan_json_escape(p, (size_t)(end - p));
+        while (p + run < end && (unsigned char)p[run] < 0x20) {
+            run += 1 + ison_scan_json_escape(p + run + 1, (size_t)(end - p - run - 1));
+        }
+        if (!grow_buffer(buf, cap, used + run + 8)) return json_fail(jp, ISON_ERROR_MEMORY);
+        out = *buf + used;
+        memcpy(out, p, run);
+        out += run;
+        p += run;
+        if (p >= end) return json_fail(jp, ISON_ERROR_PARSE);
+    
+        if (*p == '"') break;
+    
+        /* *p == '\\' */
+        if (++p >= end) return json_fail(jp, ISON_ERROR_PARSE);
+        switch (*p++) {
+            case '"': *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '/': *out++ = '/'; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u': {
+                long cp = read_hex4(p, end);
+                if (cp < 0) return json_fail(jp, ISON_ERROR_PARSE);
+                p += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    long low = (end - p >= 6 && p[0] == '\\' && p[1] == 'u') ? read_hex4(p + 2, end) : -1;
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    } else {
+                        cp = 0xFFFD;
+                    }
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    cp = 0xFFFD;
+                }
+                out = put_utf8(out, (unsigned long)cp);
+                break;
+            }
+            default:
+                return json_fail(jp, ISON_ERROR_PARSE);
+        }
+        used = (size_t)(out - *buf);
+    }
+    
+    used = (size_t)(out - *buf);
+    (*buf)[used] = '\0';
+    if (out_len) *out_len = used;
+    return 1;
+}
+
+static int is_atom_end(char ch) {
+    return ch == ',' || ch == '}' || ch == ']' || ch == ':' || ch == ' ' || ch == '\t' ||
+           ch == '\n' || ch == '\r' || ch == '"' || ch == '{' || ch == '[';
+}
+
+static size_t json_digits(const char *p, size_t i, size_t n) {
+    while (i < n && p[i] >= '0' && p[i] <= '9') i++;
+    return i;
+}
+
+/* -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? and nothing else, so no hex, inf or leading zeros */
+static int json_number_valid(const char *p, size_t n) {
+    size_t i = p[0] == '-' ? 1 : 0;
+    if (i >= n || p[i] < '0' || p[i] > '9') return 0;
+    i = p[i] == '0' ? i + 1 : json_digits(p, i, n);
+    if (i < n && p[i] == '.') {
+        size_t start = ++i;
+        i = json_digits(p, i, n);
+        if (i == start) return 0;
+    }
+    if (i < n && (p[i] == 'e' || p[i] == 'E')) {
+        i++;
+        if (i < n && (p[i] == '+' || p[i] == '-')) i++;
+        size_t start = i;
+        i = json_digits(p, i, n);
+        if (i == start) return 0;
+    }
+    return i == n;
+}
+
+static ison_value_t json_number(json_parser_t *jp, const char *p, size_t n) {
+    if (!json_number_valid(p, n)) {
+        json_fail(jp, ISON_ERROR_PARSE);
+        return ison_null();
+    }
+    
+    /* Integers without fraction or exponent stay exact; everything else is a double */
+    const char *q = p;
+    int negative = 0;
+    if (*q == '-') {
+        negative = 1;
+        q++;
+    }
+    if (q < p + n && *q >= '0' && *q <= '9') {
+        uint64_t magnitude = 0;
+        const char *digits = q;
+        while (q < p + n && *q >= '0' && *q <= '9' && q - digits < 19) {
+            magnitude = magnitude * 10 + (uint64_t)(*q - '0');
+            q++;
+        }
+        if (q == p + n && (magnitude <= INT64_MAX || (negative && magnitude == (uint64_t)INT64_MAX + 1))) {
+            return ison_int(negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude);
+        }
+    }
+    
+    /* strtod needs a terminated copy; long mantissas go to the heap */
+    char stack[64];
+    char *buf = n < sizeof(stack) ? stack : malloc(n + 1);
+    if (!buf) {
+        json_fail(jp, ISON_ERROR_MEMORY);
+        return ison_null();
+    }
+    memcpy(buf, p, n);
+    buf[n] = '\0';
+    double d = strtod(buf, NULL);
+    if (buf != stack) free(buf);
+    return ison_float(d);
+}
+
+/* Decode a string or atom at the current token */
+static ison_value_t json_scalar(json_parser_t *jp) {
+    char ch = json_peek(jp);
+    if (ch == '"') {
+        size_t n;
+        if (!json_string(jp, &jp->str, &jp->str_cap, &n)) return ison_null();
+        return ison_string_n(jp->str, n);
+    }
+    if (ch == '\0' || ch == '{' || ch == '[' || ch == '}' || ch == ']' || ch == ':' || ch == ',') {
+        json_fail(jp, ISON_ERROR_PARSE);
+        return ison_null();
+    }
+    
+    const char *p = jp->text + jp->index.pos[jp->next++];
+    const char *end = jp->text + jp->len;
+    size_t n = 0;
+    while (p + n < end && !is_atom_end(p[n])) n++;
+    
+    if (n == 4 && memcmp(p, "true", 4) == 0) return ison_bool(1);
+    if (n == 5 && memcmp(p, "false", 5) == 0) return ison_bool(0);
+    if (n == 4 && memcmp(p, "null", 4) == 0) return ison_null();
+    if (*p == '-' || (*p >= '0' && *p <= '9')) return json_number(jp, p, n);
+    
+    json_fail(jp, ISON_ERROR_PARSE);
+    return ison_null();
+}
+
+/* Step over one complete value at the current token */
+static int json_skip(json_parser_t *jp) {
+    char ch = json_peek(jp);
+    if (ch != '{' && ch != '[') {
+        if (ch == '\0') return json_fail(jp, ISON_ERROR_PARSE);
+        jp->next++;
+        return 1;
+    }
+    /* Counted from the value being skipped, so too deep a value fails before it is built */
+    size_t depth = jp->depth;
+    while (jp->next < jp->index.count) {
+        ch = jp->text[jp->index.pos[jp->next++]];
+        if (ch == '{' || ch == '[') {
+            if (++depth > JSON_MAX_DEPTH) break;
+        } else if ((ch == '}' || ch == ']') && --depth == jp->depth) {
+            return 1;
+        }
+    }
+    return json_fail(jp, ISON_ERROR_PARSE);
+}
+
+static ison_block_t *json_block(json_parser_t *jp, const char *kind, const char *name) {
+    ison_block_t *block = ison_document_get(jp->doc, name);
+    if (block) return block;
+    block = ison_block_create(kind, name);
+    if (!block) {
+        json_fail(jp, ISON_ERROR_MEMORY);
+        return NULL;
+    }
+    ison_document_add_block(jp->doc, block);
+    return block;
+}
+
+/* Add key as a field unless present; rows usually repeat the same order, so try hint first */
+static void json_field(ison_block_t *block, const char *key, size_t hint) {
+    if (hint < block->field_count && strcmp(block->fields[hint].name, key) == 0) return;
+    for (size_t i = 0; i < block->field_count; i++) {
+        if (strcmp(block->fields[i].name, key) == 0) return;
+    }
+    ison_block_add_field(block, key, "");
+}
+
+/* Rows of block that were already drained, so numbering continues across NDJSON lines */
+static size_t json_row_offset(const json_parser_t *jp, const ison_block_t *block) {
+    for (size_t i = 0; i < jp->emitted_count; i++) {
+        if (jp->doc->blocks[i] == block) return jp->emitted[i];
+    }
+    return 0;
+}
+
+static char *json_row_id(const ison_row_t *row, size_t seq) {
+    const ison_value_t *id = ison_row_get_ptr(row, "id");
+    char buf[ISON_NUMBER_BUFFER_SIZE];
+    if (id && id->type == ISON_TYPE_STRING) return strdup_safe(id->data.string_val);
+    if (id && id->type == ISON_TYPE_INT) {
+        buf[ison_format_int(id->data.int_val, buf)] = '\0';
+    } else if (id && id->type == ISON_TYPE_FLOAT) {
+        buf[ison_format_double(id->data.float_val, buf)] = '\0';
+    } else {
+        buf[ison_format_int((int64_t)seq, buf)] = '\0';
+    }
+    return strdup_safe(buf);
+}
+
+static char *json_row(json_parser_t *jp, ison_block_t *block, const ison_reference_t *parent, int want_id,
+                      int summary);
+
+static void json_array_elements(json_parser_t *jp, const char *name, const ison_reference_t *parent);
+
+/* Elements of an array member become rows of the block named after the member */
+static void json_array_rows(json_parser_t *jp, const char *name, const ison_reference_t *parent) {
+    if (jp->depth >= JSON_MAX_DEPTH) {
+        json_fail(jp, ISON_ERROR_PARSE);
+        return;
+    }
+    jp->depth++;
+    json_array_elements(jp, name, parent);
+    jp->depth--;
+}
+
+static void json_array_elements(json_parser_t *jp, const char *name, const ison_reference_t *parent) {
+    if (!json_expect(jp, '[')) return;
+    ison_block_t *block = NULL;
+    
+    if (json_peek(jp) == ']') {
+        jp->next++;
+        return;
+    }
+    
+    for (;;) {
+        if (!block && !(block = json_block(jp, "table", name))) return;
+        char ch = json_peek(jp);
+        if (ch == '{') {
+            free(json_row(jp, block, parent, 0, 0));
+        } else if (ch == '[') {
+            /* Arrays of arrays have no table form */
+            json_skip(jp);
+        } else {
+            ison_value_t val = json_scalar(jp);
+            if (jp->error != ISON_OK) return;
+            ison_row_t *row = ison_row_create();
+            if (!row) {
+                ison_value_free(&val);
+                json_fail(jp, ISON_ERROR_MEMORY);
+                return;
+            }
+            if (parent) {
+                ison_value_t ref = ison_ref(parent);
+                json_field(block, "parent", 0);
+                ison_row_set(row, "parent", &ref);
+            }
+            json_field(block, "value", parent ? 1 : 0);
+            ison_row_set(row, "value", &val);
+            ison_block_take_row(block, row);
+        }
+        if (jp->error != ISON_OK) return;
+    
+        ch = json_peek(jp);
+        jp->next++;
+        if (ch == ']') return;
+        if (ch != ',') {
+            json_fail(jp, ISON_ERROR_PARSE);
+            return;
+        }
+    }
+}
+
+static int defer_member(json_parser_t *jp, const char *key) {
+    if (jp->deferred_count >= jp->deferred_cap) {
+        size_t new_cap = jp->deferred_cap == 0 ? 16 : jp->deferred_cap * 2;
+        json_deferred_t *grown = realloc(jp->deferred, new_cap * sizeof(json_deferred_t));
+        if (!grown) return json_fail(jp, ISON_ERROR_MEMORY);
+        jp->deferred = grown;
+        jp->deferred_cap = new_cap;
+    }
+    char *copy = strdup_safe(key);
+    if (!copy) return json_fail(jp, ISON_ERROR_MEMORY);
+    jp->deferred[jp->deferred_count].key = copy;
+    jp->deferred[jp->deferred_count].token = jp->next;
+    jp->deferred_count++;
+    return json_skip(jp);
+}
+
+/*
+ * Build a row of block from the object at the current token and, with
+ * want_id, return its id: the object's own "id" member, or its 1-based
+ * position in the block. A nested object becomes a row of the block named after its key
+ * and is referenced from this row's cell; array members become rows that
+ * reference this row through a "parent" field, and leave no cell here.
+ * Nested members are built after the row is placed, once its id is known.
+ * With summary, the row replaces block's summary row instead; it has no id,
+ * so its array members become rows without a "parent" field.
+ */
+static char *json_row(json_parser_t *jp, ison_block_t *block, const ison_reference_t *parent, int want_id,
+                      int summary) {
+    if (jp->depth >= JSON_MAX_DEPTH) {
+        json_fail(jp, ISON_ERROR_PARSE);
+        return NULL;
+    }
+    if (!json_expect(jp, '{')) return NULL;
+    ison_row_t *row = ison_row_create();
+    if (!row) {
+        json_fail(jp, ISON_ERROR_MEMORY);
+        return NULL;
+    }
+    jp->depth++;
+    
+    size_t column = 0;
+    if (parent) {
+        ison_value_t ref = ison_ref(parent);
+        json_field(block, "parent", column++);
+        ison_row_set(row, "parent", &ref);
+    }
+    
+    size_t first_deferred = jp->deferred_count;
+    if (json_peek(jp) == '}') {
+        jp->next++;
+    } else {
+        for (;;) {
+            if (!json_string(jp, &jp->key, &jp->key_cap, NULL) || !json_expect(jp, ':')) break;
+            char ch = json_peek(jp);
+            if (ch == '{' || ch == '[') {
+                if (ch == '{') json_field(block, jp->key, column++);
+                if (!defer_member(jp, jp->key)) break;
+            } else {
+                ison_value_t val = json_scalar(jp);
+                if (jp->error != ISON_OK) break;
+                json_field(block, jp->key, column++);
+                ison_row_set(row, jp->key, &val);
+            }
+            ch = json_peek(jp);
+            jp->next++;
+            if (ch == '}') break;
+            if (ch != ',') {
+                json_fail(jp, ISON_ERROR_PARSE);
+                break;
+            }
+        }
+    }
+    
+    /* The id is only rendered when a nested member or the caller needs it */
+    char *id = NULL;
+    if (jp->error == ISON_OK && !summary && (jp->deferred_count > first_deferred || want_id)) {
+        id = json_row_id(row, json_row_offset(jp, block) + block->row_count + 1);
+        if (!id) json_fail(jp, ISON_ERROR_MEMORY);
+    }
+    if (jp->error != ISON_OK) {
+        ison_row_free(row);
+        row = NULL;
+    } else if (summary) {
+        if (block->summary_row) ison_row_free(block->summary_row);
+        block->summary_row = row;
+    } else {
+        ison_block_take_row(block, row);
+    }
+    
+    /* Nested members, in member order; each may push its own deferred entries past these */
+    size_t resume = jp->next;
+    size_t last_deferred = jp->deferred_count;
+    ison_reference_t self = {id, block->name, NULL};
+    for (size_t i = first_deferred; i < last_deferred; i++) {
+        char *key = jp->deferred[i].key;
+        if (jp->error == ISON_OK) {
+            jp->next = jp->deferred[i].token;
+            if (json_peek(jp) == '{') {
+                ison_block_t *child = json_block(jp, "table", key);
+                char *child_id = child ? json_row(jp, child, NULL, 1, 0) : NULL;
+                if (child_id) {
+                    ison_reference_t target = {child_id, key, NULL};
+                    ison_value_t ref = ison_ref(&target);
+                    ison_row_set(row, key, &ref);
+                    free(child_id);
+                }
+            } else {
+                json_array_rows(jp, key, id ? &self : NULL);
+            }
+        }
+        free(key);
+    }
+    jp->deferred_count = first_deferred;
+    jp->next = resume;
+    jp->depth--;
+    
+    if (jp->error != ISON_OK) {
+        free(id);
+        return NULL;
+    }
+    return id;
+}
+
+/* With summaries, a top-level "<name>_summary" object beside block <name> is that block's summary row */
+static ison_block_t *summary_target(json_parser_t *jp, const char *key) {
+    static const char suffix[] = "_summary";
+    size_t len = strlen(key);
+    if (len <= sizeof(suffix) - 1 || strcmp(key + len - (sizeof(suffix) - 1), suffix) != 0) return NULL;
+    
+    ison_block_t *target = NULL;
+    char *name = malloc(len);
+    if (!name) return NULL;
+    memcpy(name, key, len - (sizeof(suffix) - 1));
+    name[len - (sizeof(suffix) - 1)] = '\0';
+    target = ison_document_get(jp->doc, name);
+    free(name);
+    return target;
+}
+
+static void json_document(json_parser_t *jp) {
+    if (!json_expect(jp, '{')) return;
+    if (json_peek(jp) == '}') {
+        jp->next++;
+        return;
+    }
+    
+    for (;;) {
+        if (!json_string(jp, &jp->key, &jp->key_cap, NULL) || !json_expect(jp, ':')) return;
+        char ch = json_peek(jp);
+        if (ch == '[') {
+            char *name = strdup_safe(jp->key);
+            if (!name) {
+                json_fail(jp, ISON_ERROR_MEMORY);
+                return;
+            }
+            /* An empty array still declares its table */
+            json_block(jp, "table", name);
+            json_array_rows(jp, name, NULL);
+            free(name);
+        } else if (ch == '{') {
+            ison_block_t *target = jp->summaries ? summary_target(jp, jp->key) : NULL;
+            if (target) {
+                free(json_row(jp, target, NULL, 0, 1));
+            } else {
+                ison_block_t *block = json_block(jp, "object", jp->key);
+                if (block) free(json_row(jp, block, NULL, 0, 0));
+            }
+        } else {
+            /* Top-level scalars have no block to live in; decode only to validate */
+            ison_value_t val = json_scalar(jp);
+            ison_value_free(&val);
+        }
+        if (jp->error != ISON_OK) return;
+    
+        ch = json_peek(jp);
+        jp->next++;
+        if (ch == '}') break;
+        if (ch != ',') {
+            json_fail(jp, ISON_ERROR_PARSE);
+            return;
+        }
+    }
+    
+    if (jp->next < jp->index.count) json_fail(jp, ISON_ERROR_PARSE);
+}
+
+static void json_parser_free(json_parser_t *jp) {
+    for (size_t i = 0; i < jp->deferred_count; i++) {
+        free(jp->deferred[i].key);
+    }
+    free(jp->deferred);
+    free(jp->emitted);
+    free(jp->index.pos);
+    free(jp->key);
+    free(jp->str);
+}
+
+ison_json_options_t ison_default_json_options(void) {
+    ison_json_options_t opts;
+    opts.summaries = false;
+    return opts;
+}
+
+ison_document_t *ison_from_json_with_options(const char *json_text, size_t len, const ison_json_options_t *options,
+                                             ison_error_t *error) {
+    if (error) *error = ISON_OK;
+    if (!json_text) {
+        if (error) *error = ISON_ERROR_INVALID;
+        return NULL;
+    }
+    ison_json_options_t defaults = ison_default_json_options();
+    if (!options) options = &defaults;
+    
+    json_parser_t jp;
+    memset(&jp, 0, sizeof(jp));
+    jp.summaries = options->summaries;
+    jp.text = json_text;
+    jp.len = len;
+    jp.error = json_index_build(&jp.index, jp.text, jp.len);
+    jp.doc = ison_document_create();
+    if (!jp.doc) jp.error = ISON_ERROR_MEMORY;
+    
+    if (jp.error == ISON_OK) json_document(&jp);
+    json_parser_free(&jp);
+    
+    if (jp.error != ISON_OK) {
+        ison_document_free(jp.doc);
+        if (error) *error = jp.error;
+        return NULL;
+    }
+    return jp.doc;
+}
+
+ison_document_t *ison_from_json_n(const char *json_text, size_t len, ison_error_t *error) {
+    return ison_from_json_with_options(json_text, len, NULL, error);
+}
+
+ison_document_t *ison_from_json(const char *json_text, ison_error_t *error) {
+    return ison_from_json_n(json_text, json_text ? strlen(json_text) : 0, error);
+}
+
+/* ==================== NDJSON ==================== */
+
+typedef ison_error_t (*ndjson_emit_t)(void *userdata, const ison_block_t *block, const ison_row_t *row);
+
+/*
+ * Each line is one object, built as a row of the named block with the
+ * same flattening as ison_from_json. The document only ever holds the
+ * current line's rows: they are handed to emit in block order and freed,
+ * while the blocks keep the union of fields seen so far.
+ */
+static ison_error_t ndjson_run(ison_reader_t *in, const char *name, ndjson_emit_t emit, void *userdata) {
+    json_parser_t jp;
+    memset(&jp, 0, sizeof(jp));
+    jp.doc = ison_document_create();
+    ison_block_t *root = jp.doc ? json_block(&jp, "table", name) : NULL;
+    if (!root) jp.error = ISON_ERROR_MEMORY;
+    
+    const char *line;
+    size_t len;
+    while (jp.error == ISON_OK && ison_reader_next_line(in, &line, &len)) {
+        jp.text = line;
+        jp.len = len;
+        jp.next = 0;
+        jp.error = json_index_build(&jp.index, line, len);
+        if (jp.error != ISON_OK || jp.index.count == 0) continue;
+        
+        free(json_row(&jp, root, NULL, 0, 0));
+        if (jp.error == ISON_OK && jp.next != jp.index.count) json_fail(&jp, ISON_ERROR_PARSE);
+        if (jp.error != ISON_OK) break;
+        
+        if (jp.emitted_count < jp.doc->block_count) {
+            size_t *grown = realloc(jp.emitted, jp.doc->block_count * sizeof(size_t));
+            if (!grown) {
+                json_fail(&jp, ISON_ERROR_MEMORY);
+                break;
+            }
+            memset(grown + jp.emitted_count, 0, (jp.doc->block_count - jp.emitted_count) * sizeof(size_t));
+            jp.emitted = grown;
+            jp.emitted_count = jp.doc->block_count;
+        }
+        
+        for (size_t i = 0; i < jp.doc->block_count; i++) {
+            ison_block_t *block = jp.doc->blocks[i];
+            for (size_t r = 0; r < block->row_count; r++) {
+                if (jp.error == ISON_OK) jp.error = emit(userdata, block, block->rows[r]);
+                ison_row_free(block->rows[r]);
+            }
+            jp.emitted[i] += block->row_count;
+            block->row_count = 0;
+        }
+    }
+    
+    json_parser_free(&jp);
+    ison_document_free(jp.doc);
+    if (in->error != ISON_OK) return in->error;
+    return jp.error;
+}
+
+typedef struct {
+    isonl_callback_t callback;
+    void *userdata;
+    char **fields;
+    ison_value_t *values;
+    size_t cap;
+} ndjson_records_t;
+
+static ison_error_t emit_record(void *userdata, const ison_block_t *block, const ison_row_t *row) {
+    ndjson_records_t *rec = userdata;
+    if (block->field_count > rec->cap) {
+        char **fields = realloc(rec->fields, block->field_count * sizeof(char *));
+        if (!fields) return ISON_ERROR_MEMORY;
+        rec->fields = fields;
+        ison_value_t *values = realloc(rec->values, block->field_count * sizeof(ison_value_t));
+        if (!values) return ISON_ERROR_MEMORY;
+        rec->values = values;
+        rec->cap = block->field_count;
+    }
+    for (size_t i = 0; i < block->field_count; i++) {
+        const ison_value_t *val = ison_row_get_ptr(row, block->fields[i].name);
+        rec->fields[i] = block->fields[i].name;
+        rec->values[i] = val ? *val : ison_null();
+    }
+    
+    isonl_record_t record;
+    record.kind = block->kind;
+    record.name = block->name;
+    record.fields = rec->fields;
+    record.field_count = block->field_count;
+    record.values = rec->values;
+    rec->callback(&record, rec->userdata);
+    return ISON_OK;
+}
+
+ison_error_t ison_from_ndjson_stream(int fd, const char *name, isonl_callback_t callback, void *userdata) {
+    if (!callback) return ISON_ERROR_INVALID;
+    
+    ison_reader_t r;
+    ison_error_t err = ison_reader_init_fd(&r, fd, 0);
+    if (err != ISON_OK) return err;
+    
+    ndjson_records_t rec = {callback, userdata, NULL, NULL, 0};
+    err = ndjson_run(&r, name ? name : "rows", emit_record, &rec);
+    free(rec.fields);
+    free(rec.values);
+    ison_reader_free(&r);
+    return err;
+}
+
+/* ISONL prefix per block, re-rendered whenever the block gains a field */
+typedef struct {
+    const ison_block_t *block;
+    size_t field_count;
+    ison_writer_t text;
+} ndjson_prefix_t;
+
+typedef struct {
+    ison_writer_t *out;
+    ndjson_prefix_t *prefixes;
+    size_t count;
+    bool first_line;
+} ndjson_isonl_t;
+
+static const ison_writer_t *ndjson_prefix(ndjson_isonl_t *ctx, const ison_block_t *block) {
+    ndjson_prefix_t *p = NULL;
+    for (size_t i = 0; i < ctx->count; i++) {
+        if (ctx->prefixes[i].block == block) {
+            p = &ctx->prefixes[i];
+            break;
+        }
+    }
+    if (!p) {
+        ndjson_prefix_t *grown = realloc(ctx->prefixes, (ctx->count + 1) * sizeof(ndjson_prefix_t));
+        if (!grown) return NULL;
+        ctx->prefixes = grown;
+        p = &ctx->prefixes[ctx->count++];
+        p->block = block;
+        p->field_count = SIZE_MAX;
+        if (ison_writer_init_memory(&p->text, 128) != ISON_OK) {
+            ctx->count--;
+            return NULL;
+        }
+    }
+    
+    if (p->field_count != block->field_count) {
+        ison_writer_t *w = &p->text;
+        w->len = 0;
+        ison_writer_puts(w, block->kind);
+        ison_writer_putc(w, '.');
+        ison_writer_puts(w, block->name);
+        ison_writer_putc(w, '|');
+        for (size_t i = 0; i < block->field_count; i++) {
+            if (i > 0) ison_writer_putc(w, ' ');
+            ison_writer_puts(w, block->fields[i].name);
+            if (block->fields[i].type_hint && *block->fields[i].type_hint) {
+                ison_writer_putc(w, ':');
+                ison_writer_puts(w, block->fields[i].type_hint);
+            }
+        }
+        ison_writer_putc(w, '|');
+        if (w->error != ISON_OK) return NULL;
+        p->field_count = block->field_count;
+    }
+    return &p->text;
+}
+
+static ison_error_t emit_isonl(void *userdata, const ison_block_t *block, const ison_row_t *row) {
+    ndjson_isonl_t *ctx = userdata;
+    const ison_writer_t *prefix = ndjson_prefix(ctx, block);
+    if (!prefix) return ISON_ERROR_MEMORY;
+    
+    ison_writer_t *w = ctx->out;
+    if (!ctx->first_line) ison_writer_putc(w, '\n');
+    ctx->first_line = false;
+    ison_writer_write(w, prefix->buf, prefix->len);
+    for (size_t i = 0; i < block->field_count; i++) {
+        if (i > 0) ison_writer_putc(w, ' ');
+        ison_value_append(w, ison_row_get_ptr(row, block->fields[i].name));
+    }
+    return w->error;
+}
+
+ison_error_t ndjson_to_isonl_stream(ison_reader_t *in, ison_writer_t *out, const char *name) {
+    if (!in || !out) return ISON_ERROR_INVALID;
+    
+    ndjson_isonl_t ctx = {out, NULL, 0, true};
+    ison_error_t err = ndjson_run(in, name ? name : "rows", emit_isonl, &ctx);
+    for (size_t i = 0; i < ctx.count; i++) {
+        ison_writer_free(&ctx.prefixes[i].text);
+    }
+    free(ctx.prefixes);
+    return err;
+}
+
+char *ndjson_to_isonl(const char *ndjson_text, const char *name, ison_error_t *error) {
+    if (error) *error = ISON_OK;
+    if (!ndjson_text) {
+        if (error) *error = ISON_ERROR_INVALID;
+        return NULL;
+    }
+    
+    ison_reader_t r;
+    ison_writer_t w;
+    ison_reader_init_memory(&r, ndjson_text, strlen(ndjson_text));
+    ison_writer_init_memory(&w, 1024);
+    ison_error_t err = ndjson_to_isonl_stream(&r, &w, name);
+    ison_reader_free(&r);
+    
+    char *result = ison_writer_finish(&w, NULL);
+    if (!result && err == ISON_OK) err = ISON_ERROR_MEMORY;
+    if (err != ISON_OK) {
+        free(result);
+        result = NULL;
+    }
+    if (error) *error = err;
+    return result;
+}
@@ -0,0 +1,289 @@
+#define _POSIX_C_SOURCE 200809L
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "lex.h"
+
+static int lexer_reserve(ison_lexer_t *lx, size_t len) {
+    /* Every token needs its bytes plus a terminator; a line of len bytes has at most len/2+1 tokens */
+    size_t need = len * 2 + 2;
+    if (need > lx->scratch_cap) {
+        char *scratch = realloc(lx->scratch, need);
+        if (!scratch) return 0;
+        lx->scratch = scratch;
+        lx->scratch_cap = need;
+    }
+    return 1;
+}
+
+static int lexer_push(ison_lexer_t *lx, char *text, size_t len) {
+    if (lx->count >= lx->capacity) {
+        size_t new_cap = lx->capacity == 0 ? 16 : lx->capacity * 2;
+        ison_token_t *tokens = realloc(lx->tokens, new_cap * sizeof(ison_token_t));
+        if (!tokens) return 0;
+        lx->tokens = tokens;
+        lx->capacity = new_cap;
+    }
+    text[len] = '\0';
+    lx->tokens[lx->count].text = text;
+    lx->tokens[lx->count].len = len;
+    lx->count++;
+    return 1;
+}
+
+int ison_lex_line(ison_lexer_t *lx, const char *line, size_t len) {
+    lx->count = 0;
+    if (!lexer_reserve(lx, len)) return 0;
+    
+    char *out = lx->scratch;
+    char *start = out;
+    int in_quotes = 0;
+    int quoted = 0;
+    
+    for (size_t i = 0; i < len; i++) {
+        char ch = line[i];
+        
+        if (in_quotes && ch == '\\' && i + 1 < len) {
+            ch = line[++i];
+            switch (ch) {
+                case 'n': *out++ = '\n'; break;
+                case 't': *out++ = '\t'; break;
+                default: *out++ = ch;
+            }
+            continue;
+        }
+        
+        if (ch == '"') {
+            in_quotes = !in_quotes;
+            quoted = 1;
+            continue;
+        }
+        
+        if (!in_quotes && (ch == ' ' || ch == '\t')) {
+            if (out > start || quoted) {
+                if (!lexer_push(lx, start, (size_t)(out - start))) return 0;
+                start = ++out;
+            }
+            quoted = 0;
+            continue;
+        }
+        
+        *out++ = ch;
+    }
+    
+    if (out > start || quoted) {
+        if (!lexer_push(lx, start, (size_t)(out - start))) return 0;
+    }
+    return 1;
+}
+
+void ison_lexer_free(ison_lexer_t *lx) {
+    if (!lx) return;
+    free(lx->tokens);
+    free(lx->scratch);
+    lx->tokens = NULL;
+    lx->scratch = NULL;
+    lx->count = 0;
+    lx->capacity = 0;
+    lx->scratch_cap = 0;
+}
+
+static int is_all_upper(const char *str) {
+    if (!str || !*str) return 0;
+    for (const char *p = str; *p; p++) {
+        if (*p != '_' && (*p < 'A' || *p > 'Z')) return 0;
+    }
+    return 1;
+}
+
+static ison_value_t lex_reference(char *token) {
+    ison_value_t v;
+    v.type = ISON_TYPE_REFERENCE;
+    v.data.ref_val.id = NULL;
+    v.data.ref_val.ns = NULL;
+    v.data.ref_val.relationship = NULL;
+    
+    token++;
+    char *colon = strchr(token, ':');
+    if (!colon) {
+        v.data.ref_val.id = token;
+        return v;
+    }
+    
+    *colon = '\0';
+    if (is_all_upper(token)) {
+        v.data.ref_val.relationship = token;
+    } else {
+        v.data.ref_val.ns = token;
+    }
+    v.data.ref_val.id = colon + 1;
+    return v;
+}
+
+static ison_value_t borrowed_string(char *token) {
+    ison_value_t v;
+    v.type = ISON_TYPE_STRING;
+    v.data.string_val = token;
+    return v;
+}
+
+ison_value_t ison_lex_value(char *token, const char *type_hint) {
+    if (!token || strcmp(token, "~") == 0 || strcasecmp(token, "null") == 0) {
+        return ison_null();
+    }
+    
+    if (strcasecmp(token, "true") == 0) return ison_bool(1);
+    if (strcasecmp(token, "false") == 0) return ison_bool(0);
+    
+    if (*token == ':') return lex_reference(token);
+    
+    char *end;
+    if (type_hint && *type_hint) {
+        if (strcmp(type_hint, "int") == 0) {
+            long val = strtol(token, &end, 10);
+            if (*end == '\0') return ison_int(val);
+        } else if (strcmp(type_hint, "float") == 0) {
+            double val = strtod(token, &end);
+            if (*end == '\0') return ison_float(val);
+        } else if (strcmp(type_hint, "bool") == 0) {
+            if (strcmp(token, "1") == 0) return ison_bool(1);
+            if (strcmp(token, "0") == 0) return ison_bool(0);
+        } else if (strcmp(type_hint, "string") == 0) {
+            return borrowed_string(token);
+        }
+    }
+    
+    long ival = strtol(token, &end, 10);
+    if (*end == '\0' && end != token) return ison_int(ival);
+    
+    double fval = strtod(token, &end);
+    if (*end == '\0' && end != token) return ison_float(fval);
+    
+    return borrowed_string(token);
+}
+
+#define ARENA_FIRST_CHUNK 4096
+#define ARENA_MAX_CHUNK (1u << 20)
+
+struct ison_arena_chunk {
+    ison_arena_chunk_t *next;
+};
+
+void *ison_arena_alloc(ison_arena_t *arena, size_t size) {
+    /* Entries hold pointers and 8-byte numbers */
+    size = (size + 7) & ~(size_t)7;
+    if (size > arena->left) {
+        size_t chunk_size = arena->chunk_size ? arena->chunk_size : ARENA_FIRST_CHUNK;
+        if (chunk_size < ARENA_MAX_CHUNK) arena->chunk_size = chunk_size * 2;
+        size_t header = (sizeof(ison_arena_chunk_t) + 7) & ~(size_t)7;
+        if (chunk_size < header + size) chunk_size = header + size;
+        ison_arena_chunk_t *chunk = malloc(chunk_size);
+        if (!chunk) return NULL;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->next = (char *)chunk + header;
+        arena->left = chunk_size - header;
+    }
+    void *mem = arena->next;
+    arena->next += size;
+    arena->left -= size;
+    return mem;
+}
+
+void ison_arena_release(void *chunks) {
+    ison_arena_chunk_t *chunk = chunks;
+    while (chunk) {
+        ison_arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+void ison_value_resolve(const ison_value_t *value) {
+    if (!value || value->type != ISON_TYPE_UNKNOWN) return;
+    /* The cell is logically unchanged, only its representation is */
+    ison_value_t *cell = (ison_value_t *)value;
+    ison_value_t raw = ison_lex_value(cell->data.raw_val.text, cell->data.raw_val.type_hint);
+    *cell = ison_value_copy(&raw);
+}
+
+void ison_lex_field_def(char *field, char **name, char **type_hint) {
+    char *colon = strchr(field, ':');
+    *name = field;
+    if (colon && colon != field) {
+        *colon = '\0';
+        *type_hint = colon + 1;
+    } else {
+        *type_hint = field + strlen(field);
+    }
+}
+
+int ison_lex_is_kind(const char *kind, size_t len) {
+    return (len == 5 && memcmp(kind, "table", 5) == 0) ||
+           (len == 6 && memcmp(kind, "object", 6) == 0) ||
+           (len == 4 && memcmp(kind, "meta", 4) == 0);
+}
+
+int ison_lex_is_block_line(const char *line, size_t len) {
+    if (len == 0 || line[0] == '"') return 0;
+    const char *dot = memchr(line, '.', len);
+    return dot && ison_lex_is_kind(line, (size_t)(dot - line));
+}
+
+int ison_field_map_update(ison_field_map_t *fm, ison_block_t *block, ison_lexer_t *lx,
+                          const char *fields, size_t len) {
+    if (fm->block == block && fm->fields && fm->fields_len == len && memcmp(fm->fields, fields, len) == 0) {
+        return 1;
+    }
+    
+    char *copy = realloc(fm->fields, len + 1);
+    if (!copy) return 0;
+    memcpy(copy, fields, len);
+    copy[len] = '\0';
+    fm->fields = copy;
+    fm->fields_len = len;
+    fm->block = NULL;
+    
+    if (!ison_lex_line(lx, fields, len)) return 0;
+    if (lx->count > fm->cap) {
+        size_t *map = realloc(fm->map, lx->count * sizeof(size_t));
+        if (!map) return 0;
+        fm->map = map;
+        fm->cap = lx->count;
+    }
+    
+    for (size_t i = 0; i < lx->count; i++) {
+        char *fname, *ftype;
+        ison_lex_field_def(lx->tokens[i].text, &fname, &ftype);
+        size_t j = 0;
+        while (j < block->field_count && strcmp(block->fields[j].name, fname) != 0) j++;
+        if (j == block->field_count) {
+            ison_block_add_field(block, fname, ftype);
+            if (block->field_count == j) return 0;
+        }
+        fm->map[i] = j;
+    }
+    fm->count = lx->count;
+    fm->block = block;
+    return 1;
+}
+
+void ison_field_map_free(ison_field_map_t *fm) {
+    if (!fm) return;
+    free(fm->fields);
+    free(fm->map);
+    memset(fm, 0, sizeof(*fm));
+}
+
+void ison_lex_trim(const char **line, size_t *len) {
+    const char *s = *line;
+    size_t n = *len;
+    while (n > 0 && isspace((unsigned char)*s)) {
+        s++;
+        n--;
+    }
+    while (n > 0 && isspace((unsigned char)s[n - 1])) n--;
+    *line = s;
+    *len = n;
+}
@@ -0,0 +1,101 @@
+/**
+ * lex.h - line tokenizer and value decoding shared by the parsers and
+ * the streaming converters (internal)
+ */
+
+#ifndef ISON_LEX_H
+#define ISON_LEX_H
+
+#include <stddef.h>
+#include "ison.h"
+
+/* One token, unescaped and NUL-terminated in the lexer's scratch buffer */
+typedef struct {
+    char *text;
+    size_t len;
+} ison_token_t;
+
+/* Reusable tokenizer state; zero-initialize before first use */
+typedef struct {
+    ison_token_t *tokens;
+    size_t count;
+    size_t capacity;
+    char *scratch;
+    size_t scratch_cap;
+} ison_lexer_t;
+
+/* Split a row or field line on blanks outside quotes; returns 0 on allocation failure */
+int ison_lex_line(ison_lexer_t *lx, const char *line, size_t len);
+void ison_lexer_free(ison_lexer_t *lx);
+
+/*
+ * Decode a value token under an optional type hint. Strings and reference
+ * parts point into token, which may be modified; nothing is allocated.
+ * Use ison_value_copy for an owned value.
+ */
+ison_value_t ison_lex_value(char *token, const char *type_hint);
+
+/* Decode an ISON_TYPE_UNKNOWN cell in place; any other value is left alone */
+void ison_value_resolve(const ison_value_t *value);
+
+/*
+ * Bump allocator for row entries. Its chunks form a list that a document
+ * takes over (ison_document_t.arena) and releases with ison_arena_release.
+ */
+typedef struct ison_arena_chunk ison_arena_chunk_t;
+
+typedef struct {
+    ison_arena_chunk_t *chunks;    /* newest first */
+    char *next;
+    size_t left;
+    size_t chunk_size;             /* size of the next chunk */
+} ison_arena_t;
+
+void *ison_arena_alloc(ison_arena_t *arena, size_t size);
+void ison_arena_release(void *chunks);
+
+/*
+ * Set key to a lazily decoded cell; the token and hint are copied into the
+ * entry. With an arena the entry is carved from it while every earlier entry
+ * of the row was too, otherwise it is malloc'd.
+ */
+void ison_row_set_token(ison_row_t *row, const char *key, const char *token, size_t len, const char *type_hint,
+                        ison_arena_t *arena);
+
+/*
+ * Add key without looking for an existing entry, for callers that know
+ * their keys are distinct. Takes ownership of value like ison_row_set.
+ */
+void ison_row_append(ison_row_t *row, const char *key, size_t key_len, const ison_value_t *value);
+
+/* Split "name:type" in place; type is "" when absent */
+void ison_lex_field_def(char *field, char **name, char **type_hint);
+
+/* "table", "object" or "meta" */
+int ison_lex_is_kind(const char *kind, size_t len);
+
+/* A "kind.name" block header: not quoted, with a valid kind before the first '.' */
+int ison_lex_is_block_line(const char *line, size_t len);
+
+/*
+ * Where the cells of an ISONL line land in their block. Each line names its
+ * own fields; fields the block has not seen yet are appended to it. The map
+ * is rebuilt only when the block or the field list text changes.
+ */
+typedef struct {
+    const ison_block_t *block;
+    char *fields;          /* field list the map was built from */
+    size_t fields_len;
+    size_t *map;           /* map[i]: block field index of the line's field i */
+    size_t count;
+    size_t cap;
+} ison_field_map_t;
+
+int ison_field_map_update(ison_field_map_t *fm, ison_block_t *block, ison_lexer_t *lx,
+                          const char *fields, size_t len);
+void ison_field_map_free(ison_field_map_t *fm);
+
+/* Trim blanks on both ends of [*line, *line + *len) */
+void ison_lex_trim(const char **line, size_t *len);
+
+#endif /* ISON_LEX_H */
@@ -0,0 +1,124 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lz.h"
+
+#define LZ_HASH_BITS 14
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+
+static inline uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint32_t lz_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static unsigned char *put_length(unsigned char *op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+static unsigned char *put_sequence(unsigned char *op, const unsigned char *lit, size_t lit_len,
+                                   size_t offset, size_t match_len) {
+    size_t m = match_len ? match_len - LZ_MIN_MATCH : 0;
+    *op++ = (unsigned char)((lit_len < 15 ? lit_len : 15) << 4 | (m < 15 ? m : 15));
+    if (lit_len >= 15) op = put_length(op, lit_len - 15);
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+    if (!match_len) return op;
+    *op++ = (unsigned char)offset;
+    *op++ = (unsigned char)(offset >> 8);
+    if (m >= 15) op = put_length(op, m - 15);
+    return op;
+}
+
+size_t ison_lz_bound(size_t len) {
+    return len + len / 255 + 16;
+}
+
+size_t ison_lz_compress(const void *src, size_t len, void *dst) {
+    const unsigned char *in = src;
+    unsigned char *op = dst;
+    uint32_t *table = calloc((size_t)1 << LZ_HASH_BITS, sizeof(uint32_t));
+    size_t anchor = 0;
+    size_t i = 0;
+
+    /* Without a table everything goes out as literals, which is still a valid stream */
+    while (table && i + LZ_MIN_MATCH <= len) {
+        uint32_t v = read32(in + i);
+        uint32_t h = lz_hash(v);
+        size_t cand = table[h];
+        table[h] = (uint32_t)(i + 1);
+        if (cand == 0 || i - (cand - 1) > LZ_MAX_OFFSET || read32(in + cand - 1) != v) {
+            i++;
+            continue;
+        }
+        cand--;
+        size_t match = LZ_MIN_MATCH;
+        while (i + match < len && in[cand + match] == in[i + match]) match++;
+        op = put_sequence(op, in + anchor, i - anchor, i - cand, match);
+        i += match;
+        anchor = i;
+        /* Seed the table inside the match so runs keep chaining */
+        if (i + 2 <= len) {
+            table[lz_hash(read32(in + i - 2))] = (uint32_t)(i - 1);
+        }
+    }
+    op = put_sequence(op, in + anchor, len - anchor, 0, 0);
+    free(table);
+    return (size_t)(op - (unsigned char *)dst);
+}
+
+static int get_length(const unsigned char **ip, const unsigned char *end, size_t *len) {
+    unsigned char b;
+    do {
+        if (*ip >= end) return 0;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 1;
+}
+
+int ison_lz_decompress(const void *src, size_t len, void *dst, size_t cap) {
+    const unsigned char *ip = src;
+    const unsigned char *end = ip + len;
+    unsigned char *out = dst;
+    size_t op = 0;
+
+    while (ip < end) {
+        unsigned char token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15 && !get_length(&ip, end, &lit)) return 0;
+        if (lit > (size_t)(end - ip) || lit > cap - op) return 0;
+        memcpy(out + op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == end) return op == cap;
+
+        if (end - ip < 2) return 0;
+        size_t offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        size_t match = (token & 15);
+        if (match == 15 && !get_length(&ip, end, &match)) return 0;
+        match += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || match > cap - op) return 0;
+
+        unsigned char *d = out + op;
+        const unsigned char *s = d - offset;
+        if (offset >= match) {
+            memcpy(d, s, match);
+        } else {
+            for (size_t k = 0; k < match; k++) d[k] = s[k];
+        }
+        op += match;
+    }
+    return 0;
+}
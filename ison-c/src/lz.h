@@ -0,0 +1,24 @@
+/**
+ * lz.h - byte-oriented LZ77 block codec (internal)
+ *
+ * A stream is a run of sequences, each a token byte (literal length in the
+ * high nibble, match length - 4 in the low nibble, 15 meaning "more bytes
+ * follow, 255 each"), the literals, and a 2-byte little-endian match
+ * offset. The last sequence carries literals only.
+ */
+
+#ifndef ISON_LZ_H
+#define ISON_LZ_H
+
+#include <stddef.h>
+
+/* Largest compressed size of len input bytes */
+size_t ison_lz_bound(size_t len);
+
+/* Compress src into dst, which holds at least ison_lz_bound(len) bytes; returns the compressed size */
+size_t ison_lz_compress(const void *src, size_t len, void *dst);
+
+/* Decompress exactly cap bytes into dst; 0 when the input is malformed or does not fill dst exactly */
+int ison_lz_decompress(const void *src, size_t len, void *dst, size_t cap);
+
+#endif /* ISON_LZ_H */
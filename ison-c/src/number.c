@@ -0,0 +1,336 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "ison.h"
+
+/*
+ * Number formatting for the serializers.
+ *
+ * Integers are written two digits at a time from a lookup table. Doubles use
+ * Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+ * with Integers", PLDI 2010): the output always parses back to the same
+ * double, and is the shortest such digit string in all but a tiny fraction
+ * of cases, where it is one digit longer.
+ */
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static size_t format_uint(uint64_t v, char *buf) {
+    char tmp[20];
+    char *p = tmp + sizeof(tmp);
+    while (v >= 100) {
+        unsigned idx = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--p = digit_pairs[idx + 1];
+        *--p = digit_pairs[idx];
+    }
+    if (v >= 10) {
+        unsigned idx = (unsigned)v * 2;
+        *--p = digit_pairs[idx + 1];
+        *--p = digit_pairs[idx];
+    } else {
+        *--p = (char)('0' + v);
+    }
+    size_t len = (size_t)(tmp + sizeof(tmp) - p);
+    memcpy(buf, p, len);
+    return len;
+}
+
+size_t ison_format_int(int64_t value, char *buf) {
+    if (value < 0) {
+        *buf = '-';
+        return 1 + format_uint(0 - (uint64_t)value, buf + 1);
+    }
+    return format_uint((uint64_t)value, buf);
+}
+
+/* ---- Grisu2 ---- */
+
+typedef struct {
+    uint64_t f;
+    int e;
+} diy_fp_t;
+
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS (0x3FF + DP_SIGNIFICAND_SIZE)
+#define DP_MIN_EXPONENT (-DP_EXPONENT_BIAS)
+#define DP_EXPONENT_MASK 0x7FF0000000000000ULL
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DP_HIDDEN_BIT 0x0010000000000000ULL
+
+/* Normalized 10^k for k = -348, -340, ..., 340 */
+static const uint64_t cached_powers_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+static const int16_t cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static const uint64_t pow10_u64[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static diy_fp_t diy_fp_from_double(double d) {
+    uint64_t u;
+    memcpy(&u, &d, sizeof(u));
+    int biased_e = (int)((u & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+    uint64_t significand = u & DP_SIGNIFICAND_MASK;
+    diy_fp_t r;
+    if (biased_e != 0) {
+        r.f = significand + DP_HIDDEN_BIT;
+        r.e = biased_e - DP_EXPONENT_BIAS;
+    } else {
+        r.f = significand;
+        r.e = DP_MIN_EXPONENT + 1;
+    }
+    return r;
+}
+
+static diy_fp_t diy_fp_mul(diy_fp_t x, diy_fp_t y) {
+    const uint64_t m32 = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32, b = x.f & m32;
+    uint64_t c = y.f >> 32, d = y.f & m32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+    tmp += 1ULL << 31; /* round */
+    diy_fp_t r;
+    r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    r.e = x.e + y.e + 64;
+    return r;
+}
+
+static diy_fp_t diy_fp_normalize(diy_fp_t x) {
+    while (!(x.f & 0x8000000000000000ULL)) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+static void normalized_boundaries(diy_fp_t v, diy_fp_t *minus, diy_fp_t *plus) {
+    diy_fp_t pl;
+    pl.f = (v.f << 1) + 1;
+    pl.e = v.e - 1;
+    while (!(pl.f & (DP_HIDDEN_BIT << 1))) {
+        pl.f <<= 1;
+        pl.e--;
+    }
+    pl.f <<= 64 - DP_SIGNIFICAND_SIZE - 2;
+    pl.e -= 64 - DP_SIGNIFICAND_SIZE - 2;
+
+    diy_fp_t mi;
+    if (v.f == DP_HIDDEN_BIT) {
+        mi.f = (v.f << 2) - 1;
+        mi.e = v.e - 2;
+    } else {
+        mi.f = (v.f << 1) - 1;
+        mi.e = v.e - 1;
+    }
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+
+    *plus = pl;
+    *minus = mi;
+}
+
+static diy_fp_t cached_power(int e, int *k) {
+    /* Pick c_mk so that the scaled exponent lands in [-60, -32] */
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int ik = (int)dk;
+    if (dk - ik > 0.0) ik++;
+    unsigned index = (unsigned)((ik >> 3) + 1);
+    *k = -(-348 + (int)(index << 3));
+    diy_fp_t r;
+    r.f = cached_powers_f[index];
+    r.e = cached_powers_e[index];
+    return r;
+}
+
+static void grisu_round(char *buf, int len, uint64_t delta, uint64_t rest,
+                        uint64_t ten_kappa, uint64_t wp_w) {
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static int count_digits32(uint32_t n) {
+    int d = 1;
+    while (n >= 10) {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+static void digit_gen(diy_fp_t w, diy_fp_t mp, uint64_t delta, char *buf, int *len, int *k) {
+    diy_fp_t one;
+    one.f = 1ULL << -mp.e;
+    one.e = mp.e;
+    uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = count_digits32(p1);
+    *len = 0;
+
+    while (kappa > 0) {
+        uint32_t div = (uint32_t)pow10_u64[kappa - 1];
+        uint32_t d = p1 / div;
+        p1 %= div;
+        if (d || *len) buf[(*len)++] = (char)('0' + d);
+        kappa--;
+        uint64_t tmp = ((uint64_t)p1 << -one.e) + p2;
+        if (tmp <= delta) {
+            *k += kappa;
+            grisu_round(buf, *len, delta, tmp, pow10_u64[kappa] << -one.e, wp_w);
+            return;
+        }
+    }
+
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if (d || *len) buf[(*len)++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *k += kappa;
+            int index = -kappa;
+            grisu_round(buf, *len, delta, p2, one.f, wp_w * (index < 20 ? pow10_u64[index] : 0));
+            return;
+        }
+    }
+}
+
+static void grisu2(double value, char *buf, int *len, int *k) {
+    diy_fp_t v = diy_fp_from_double(value);
+    diy_fp_t w_m, w_p;
+    normalized_boundaries(v, &w_m, &w_p);
+
+    diy_fp_t c_mk = cached_power(w_p.e, k);
+    diy_fp_t w = diy_fp_mul(diy_fp_normalize(v), c_mk);
+    diy_fp_t wp = diy_fp_mul(w_p, c_mk);
+    diy_fp_t wm = diy_fp_mul(w_m, c_mk);
+    wm.f++;
+    wp.f--;
+    digit_gen(w, wp, wp.f - wm.f, buf, len, k);
+}
+
+/* Lay out digits * 10^k in plain or exponent notation, always with a '.' or 'e' */
+static size_t prettify(char *buf, int len, int k) {
+    int kk = len + k; /* position of the decimal point */
+
+    if (k >= 0 && kk <= 21) {
+        memset(buf + len, '0', (size_t)k);
+        buf[kk] = '.';
+        buf[kk + 1] = '0';
+        return (size_t)kk + 2;
+    }
+    if (kk > 0 && kk <= 21) {
+        memmove(buf + kk + 1, buf + kk, (size_t)(len - kk));
+        buf[kk] = '.';
+        return (size_t)len + 1;
+    }
+    if (kk > -6 && kk <= 0) {
+        int offset = 2 - kk;
+        memmove(buf + offset, buf, (size_t)len);
+        buf[0] = '0';
+        buf[1] = '.';
+        memset(buf + 2, '0', (size_t)(offset - 2));
+        return (size_t)(len + offset);
+    }
+
+    size_t pos;
+    if (len == 1) {
+        pos = 1;
+    } else {
+        memmove(buf + 2, buf + 1, (size_t)(len - 1));
+        buf[1] = '.';
+        pos = (size_t)len + 1;
+    }
+    buf[pos++] = 'e';
+    int exp10 = kk - 1;
+    if (exp10 < 0) {
+        buf[pos++] = '-';
+        exp10 = -exp10;
+    }
+    pos += format_uint((uint64_t)exp10, buf + pos);
+    return pos;
+}
+
+size_t ison_format_double(double value, char *buf) {
+    if (isnan(value)) {
+        memcpy(buf, "nan", 3);
+        return 3;
+    }
+    size_t pos = 0;
+    if (signbit(value)) {
+        buf[pos++] = '-';
+        value = -value;
+    }
+    if (isinf(value)) {
+        memcpy(buf + pos, "inf", 3);
+        return pos + 3;
+    }
+    if (value == 0.0) {
+        memcpy(buf + pos, "0.0", 3);
+        return pos + 3;
+    }
+
+    int len, k;
+    grisu2(value, buf + pos, &len, &k);
+    return pos + prettify(buf + pos, len, k);
+}
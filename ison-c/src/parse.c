@@ -1,463 +1,318 @@
-#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include "ison.h"
+#include "lex.h"
 
-typedef struct {
-    const char *text;
-    char **lines;
-    size_t line_count;
-    size_t pos;
-} parser_t;
+/* ==================== Parser context ==================== */
+
+/*
+ * Everything the parsers need besides the document they build: the
+ * lexer's token and scratch buffers, and a buffer for NUL-terminated
+ * block names. All of it survives between calls, so once a context has
+ * seen inputs of a given shape, parsing more of them allocates only the
+ * document itself. In lazy mode even that is mostly a few arena chunks,
+ * which the document takes over when the parse ends.
+ */
+
+struct ison_parse_ctx {
+    ison_lexer_t lexer;
+    char *name;             /* "kind\0name\0" of the block being opened */
+    size_t name_cap;
+    bool lazy;              /* keep cell tokens, decode on first read */
+    ison_arena_t arena;     /* lazy entries of the document being built */
+};
 
-static char *strdup_safe(const char *str) {
-    if (!str) return NULL;
-    size_t len = strlen(str);
-    char *copy = malloc(len + 1);
-    if (copy) memcpy(copy, str, len + 1);
-    return copy;
+ison_parse_ctx_t *ison_parse_ctx_create(void) {
+    return calloc(1, sizeof(ison_parse_ctx_t));
 }
 
-static void trim_right(char *str) {
-    if (!str) return;
-    size_t len = strlen(str);
-    while (len > 0 && (str[len-1] == '\r' || str[len-1] == '\n')) {
-        str[--len] = '\0';
-    }
+static void parse_ctx_release(ison_parse_ctx_t *ctx) {
+    ison_lexer_free(&ctx->lexer);
+    free(ctx->name);
+    ctx->name = NULL;
+    ctx->name_cap = 0;
 }
 
-static char *trim(const char *str) {
-    if (!str) return strdup_safe("");
-    while (*str && isspace((unsigned char)*str)) str++;
-    if (!*str) return strdup_safe("");
-    
-    const char *end = str + strlen(str) - 1;
-    while (end > str && isspace((unsigned char)*end)) end--;
-    
-    size_t len = end - str + 1;
-    char *result = malloc(len + 1);
-    if (result) {
-        memcpy(result, str, len);
-        result[len] = '\0';
-    }
-    return result;
+void ison_parse_ctx_free(ison_parse_ctx_t *ctx) {
+    if (!ctx) return;
+    parse_ctx_release(ctx);
+    free(ctx);
 }
 
-static char **split_lines(const char *text, size_t *count) {
-    size_t cap = 16;
-    char **lines = malloc(cap * sizeof(char *));
-    *count = 0;
-    
-    const char *p = text;
-    while (*p) {
-        const char *end = p;
-        while (*end && *end != '\n') end++;
-        
-        size_t len = end - p;
-        char *line = malloc(len + 1);
-        if (line) {
-            memcpy(line, p, len);
-            line[len] = '\0';
-            trim_right(line);
-        }
-        
-        if (*count >= cap) {
-            cap *= 2;
-            lines = realloc(lines, cap * sizeof(char *));
-        }
-        lines[(*count)++] = line;
-        
-        if (*end == '\n') end++;
-        p = end;
-    }
-    
-    return lines;
+void ison_parse_ctx_set_lazy(ison_parse_ctx_t *ctx, bool lazy) {
+    if (ctx) ctx->lazy = lazy;
 }
 
-static int is_valid_kind(const char *kind) {
-    return strcmp(kind, "table") == 0 ||
-           strcmp(kind, "object") == 0 ||
-           strcmp(kind, "meta") == 0;
+void ison_parse_ctx_reset(ison_parse_ctx_t *ctx) {
+    if (ctx) parse_ctx_release(ctx);
 }
 
-static char **tokenize(const char *line, size_t *count) {
-    size_t cap = 16;
-    char **tokens = malloc(cap * sizeof(char *));
-    *count = 0;
-    
-    size_t len = strlen(line);
-    char *current = malloc(len + 1);
-    size_t cur_len = 0;
-    int in_quotes = 0;
-    int escaped = 0;
-    
-    for (size_t i = 0; i <= len; i++) {
-        char ch = line[i];
-        
-        if (escaped) {
-            switch (ch) {
-                case 'n': current[cur_len++] = '\n'; break;
-                case 't': current[cur_len++] = '\t'; break;
-                case '"': current[cur_len++] = '"'; break;
-                case '\\': current[cur_len++] = '\\'; break;
-                default: current[cur_len++] = ch;
-            }
-            escaped = 0;
-            continue;
-        }
-        
-        if (ch == '\\' && in_quotes) {
-            escaped = 1;
-            continue;
-        }
-        
-        if (ch == '"') {
-            in_quotes = !in_quotes;
-            continue;
-        }
-        
-        if (!in_quotes && (ch == ' ' || ch == '\t' || ch == '\0')) {
-            if (cur_len > 0) {
-                current[cur_len] = '\0';
-                if (*count >= cap) {
-                    cap *= 2;
-                    tokens = realloc(tokens, cap * sizeof(char *));
-                }
-                tokens[(*count)++] = strdup_safe(current);
-                cur_len = 0;
-            }
-            continue;
-        }
-        
-        current[cur_len++] = ch;
+/* Copies kind and name into the context as "kind\0name\0"; returns the kind, or NULL when out of memory */
+static const char *block_names(ison_parse_ctx_t *ctx, const char *kind, size_t kind_len, const char *name,
+                               size_t name_len) {
+    size_t need = kind_len + name_len + 2;
+    if (need > ctx->name_cap) {
+        char *grown = realloc(ctx->name, need);
+        if (!grown) return NULL;
+        ctx->name = grown;
+        ctx->name_cap = need;
     }
-    
-    free(current);
-    return tokens;
+    memcpy(ctx->name, kind, kind_len);
+    ctx->name[kind_len] = '\0';
+    memcpy(ctx->name + kind_len + 1, name, name_len);
+    ctx->name[kind_len + 1 + name_len] = '\0';
+    return ctx->name;
 }
 
-static void parse_field_def(const char *field, char **name, char **type_hint) {
-    const char *colon = strchr(field, ':');
-    if (colon && colon != field) {
-        size_t name_len = colon - field;
-        *name = malloc(name_len + 1);
-        memcpy(*name, field, name_len);
-        (*name)[name_len] = '\0';
-        *type_hint = strdup_safe(colon + 1);
-    } else {
-        *name = strdup_safe(field);
-        *type_hint = strdup_safe("");
-    }
+/* ==================== ISON ==================== */
+
+typedef struct {
+    ison_parse_ctx_t *ctx;
+    const char *text;
+    size_t len;
+    size_t pos;
+    size_t next;            /* start of the line after the one last peeked */
+    ison_error_t error;
+} parser_t;
+
+/* Trimmed line at the cursor, without consuming it; false at the end of the text */
+static bool peek_line(parser_t *p, const char **line, size_t *len) {
+    if (p->pos >= p->len) return false;
+    const char *start = p->text + p->pos;
+    const char *nl = memchr(start, '\n', p->len - p->pos);
+    size_t n = nl ? (size_t)(nl - start) : p->len - p->pos;
+    p->next = p->pos + n + (nl ? 1 : 0);
+    *line = start;
+    *len = n;
+    ison_lex_trim(line, len);
+    return true;
 }
 
-static int is_all_upper(const char *str) {
-    if (!str || !*str) return 0;
-    for (const char *p = str; *p; p++) {
-        if (*p != '_' && (*p < 'A' || *p > 'Z')) return 0;
-    }
-    return 1;
+static void consume_line(parser_t *p) {
+    p->pos = p->next;
 }
 
-static ison_reference_t parse_reference(const char *token) {
-    ison_reference_t ref = {NULL, NULL, NULL};
-    if (!token || *token != ':') return ref;
-    
-    token++;
-    char *copy = strdup_safe(token);
-    char *colon = strchr(copy, ':');
-    
-    if (!colon) {
-        ref.id = copy;
-        return ref;
-    }
-    
-    *colon = '\0';
-    char *ns = copy;
-    char *id = colon + 1;
-    
-    if (is_all_upper(ns)) {
-        ref.relationship = strdup_safe(ns);
-    } else {
-        ref.ns = strdup_safe(ns);
+static void add_field_defs(ison_block_t *block, ison_lexer_t *lx, const char *line, size_t len) {
+    if (!ison_lex_line(lx, line, len)) return;
+    for (size_t i = 0; i < lx->count; i++) {
+        char *fname, *ftype;
+        ison_lex_field_def(lx->tokens[i].text, &fname, &ftype);
+        ison_block_add_field(block, fname, ftype);
     }
-    ref.id = strdup_safe(id);
-    free(copy);
-    return ref;
 }
 
-static ison_value_t parse_value_token(const char *token, const char *type_hint) {
-    if (!token || strcmp(token, "~") == 0 ||
-        strcasecmp(token, "null") == 0 ||
-        strcasecmp(token, "NULL") == 0) {
-        return ison_null();
-    }
-    
-    if (strcasecmp(token, "true") == 0 || strcasecmp(token, "TRUE") == 0) {
-        return ison_bool(1);
-    }
-    if (strcasecmp(token, "false") == 0 || strcasecmp(token, "FALSE") == 0) {
-        return ison_bool(0);
-    }
-    
-    if (*token == ':') {
-        ison_reference_t ref = parse_reference(token);
-        return ison_ref(&ref);
-    }
-    
-    if (type_hint && *type_hint) {
-        if (strcmp(type_hint, "int") == 0) {
-            char *end;
-            long val = strtol(token, &end, 10);
-            if (*end == '\0') return ison_int(val);
-        } else if (strcmp(type_hint, "float") == 0) {
-            char *end;
-            double val = strtod(token, &end);
-            if (*end == '\0') return ison_float(val);
-        } else if (strcmp(type_hint, "bool") == 0) {
-            if (strcmp(token, "true") == 0 || strcmp(token, "1") == 0)
-                return ison_bool(1);
-            if (strcmp(token, "false") == 0 || strcmp(token, "0") == 0)
-                return ison_bool(0);
-        } else if (strcmp(type_hint, "string") == 0) {
-            return ison_string(token);
+static ison_row_t *parse_row(const ison_block_t *block, ison_lexer_t *lx, const char *line, size_t len,
+                             ison_arena_t *lazy) {
+    ison_row_t *row = ison_row_create();
+    if (!row || !ison_lex_line(lx, line, len)) return row;
+    if (lazy) {
+        for (size_t i = 0; i < lx->count && i < block->field_count; i++) {
+            ison_row_set_token(row, block->fields[i].name, lx->tokens[i].text, lx->tokens[i].len,
+                               block->fields[i].type_hint, lazy);
         }
+        return row;
     }
-    
-    char *end;
-    long ival = strtol(token, &end, 10);
-    if (*end == '\0') return ison_int(ival);
-    
-    double fval = strtod(token, &end);
-    if (*end == '\0') return ison_float(fval);
-    
-    return ison_string(token);
+    for (size_t i = 0; i < lx->count && i < block->field_count; i++) {
+        ison_value_t raw = ison_lex_value(lx->tokens[i].text, block->fields[i].type_hint);
+        ison_value_t val = ison_value_copy(&raw);
+        ison_row_set(row, block->fields[i].name, &val);
+    }
+    return row;
 }
 
 static ison_block_t *parse_block(parser_t *p, const char *kind, const char *name) {
     ison_block_t *block = ison_block_create(kind, name);
-    p->pos++;
-    
-    while (p->pos < p->line_count) {
-        char *line = trim(p->lines[p->pos]);
-        if (strlen(line) > 0 && line[0] != '#') {
-            free(line);
-            break;
-        }
-        free(line);
-        p->pos++;
+    if (!block) {
+        p->error = ISON_ERROR_MEMORY;
+        return NULL;
     }
-    
-    if (p->pos >= p->line_count) return block;
-    
-    char *fields_line = trim(p->lines[p->pos]);
-    size_t field_count;
-    char **field_tokens = tokenize(fields_line, &field_count);
-    
-    for (size_t i = 0; i < field_count; i++) {
-        char *fname, *ftype;
-        parse_field_def(field_tokens[i], &fname, &ftype);
-        ison_block_add_field(block, fname, ftype);
-        free(fname);
-        free(ftype);
-        free(field_tokens[i]);
+    consume_line(p);
+
+    const char *line;
+    size_t len;
+    while (peek_line(p, &line, &len)) {
+        if (len > 0 && line[0] != '#') break;
+        consume_line(p);
     }
-    free(field_tokens);
-    free(fields_line);
-    p->pos++;
-    
+    if (p->pos >= p->len) return block;
+
+    add_field_defs(block, &p->ctx->lexer, line, len);
+    consume_line(p);
+
     int in_summary = 0;
-    while (p->pos < p->line_count) {
-        char *line = trim(p->lines[p->pos]);
-        
-        if (strlen(line) == 0) {
-            free(line);
-            p->pos++;
+    while (peek_line(p, &line, &len)) {
+        if (len == 0) {
+            consume_line(p);
             break;
         }
-        
         if (line[0] == '#') {
-            free(line);
-            p->pos++;
+            consume_line(p);
             continue;
         }
-        
-        if (strchr(line, '.') && line[0] != '"') {
-            char *dot = strchr(line, '.');
-            char *kind_part = malloc(dot - line + 1);
-            memcpy(kind_part, line, dot - line);
-            kind_part[dot - line] = '\0';
-            if (is_valid_kind(kind_part)) {
-                free(kind_part);
-                free(line);
-                break;
-            }
-            free(kind_part);
-        }
-        
-        if (strcmp(line, "---") == 0) {
+        if (ison_lex_is_block_line(line, len)) break;
+        if (len == 3 && memcmp(line, "---", 3) == 0) {
             in_summary = 1;
-            free(line);
-            p->pos++;
+            consume_line(p);
             continue;
         }
-        
-        size_t token_count;
-        char **tokens = tokenize(line, &token_count);
-        ison_row_t *row = ison_row_create();
-        
-        for (size_t i = 0; i < token_count && i < block->field_count; i++) {
-            ison_value_t val = parse_value_token(tokens[i], block->fields[i].type_hint);
-            ison_row_set(row, block->fields[i].name, &val);
-            free(tokens[i]);
-        }
-        free(tokens);
-        
+
+        ison_row_t *row = parse_row(block, &p->ctx->lexer, line, len,
+                                    p->ctx->lazy && !in_summary ? &p->ctx->arena : NULL);
         if (in_summary) {
             ison_block_set_summary(block, row);
+            ison_row_free(row);
         } else {
-            ison_block_add_row(block, row);
+            ison_block_take_row(block, row);
         }
-        free(row);
-        
-        free(line);
-        p->pos++;
+        consume_line(p);
     }
-    
+
     return block;
 }
 
-ison_document_t *ison_parse(const char *text, ison_error_t *error) {
+ison_document_t *ison_parse_with(ison_parse_ctx_t *ctx, const char *text, size_t len, ison_error_t *error) {
     if (error) *error = ISON_OK;
-    if (!text) return ison_document_create();
-    
+    if (!ctx) {
+        if (error) *error = ISON_ERROR_INVALID;
+        return NULL;
+    }
+    ison_document_t *doc = ison_document_create();
+    if (!doc) {
+        if (error) *error = ISON_ERROR_MEMORY;
+        return NULL;
+    }
+    if (!text) return doc;
+
     parser_t p;
+    memset(&p, 0, sizeof(p));
+    p.ctx = ctx;
     p.text = text;
-    p.lines = split_lines(text, &p.line_count);
-    p.pos = 0;
-    
-    ison_document_t *doc = ison_document_create();
-    
-    while (p.pos < p.line_count) {
-        char *line = trim(p.lines[p.pos]);
-        
-        if (strlen(line) == 0 || line[0] == '#') {
-            free(line);
-            p.pos++;
+    p.len = len;
+
+    const char *line;
+    size_t line_len;
+    while (p.error == ISON_OK && peek_line(&p, &line, &line_len)) {
+        if (!ison_lex_is_block_line(line, line_len)) {
+            consume_line(&p);
             continue;
         }
-        
-        char *dot = strchr(line, '.');
-        if (dot && line[0] != '"') {
-            size_t kind_len = dot - line;
-            char *kind = malloc(kind_len + 1);
-            memcpy(kind, line, kind_len);
-            kind[kind_len] = '\0';
-            
-            if (is_valid_kind(kind)) {
-                char *name = strdup_safe(dot + 1);
-                ison_block_t *block = parse_block(&p, kind, name);
-                ison_document_add_block(doc, block);
-                free(kind);
-                free(name);
-                free(line);
-                continue;
-            }
-            free(kind);
+
+        const char *dot = memchr(line, '.', line_len);
+        size_t kind_len = (size_t)(dot - line);
+        const char *kind = block_names(ctx, line, kind_len, dot + 1, line_len - kind_len - 1);
+        if (!kind) {
+            p.error = ISON_ERROR_MEMORY;
+            break;
         }
-        
-        free(line);
-        p.pos++;
+        ison_block_t *block = parse_block(&p, kind, kind + kind_len + 1);
+        if (block) ison_document_add_block(doc, block);
     }
-    
-    for (size_t i = 0; i < p.line_count; i++) {
-        free(p.lines[i]);
+
+    /* The lazy entries now belong to the document's rows */
+    doc->arena = ctx->arena.chunks;
+    memset(&ctx->arena, 0, sizeof(ctx->arena));
+
+    if (p.error != ISON_OK) {
+        ison_document_free(doc);
+        doc = NULL;
+        if (error) *error = p.error;
     }
-    free(p.lines);
-    
     return doc;
 }
 
-ison_document_t *ison_parse_isonl(const char *text, ison_error_t *error) {
+ison_document_t *ison_parse_n(const char *text, size_t len, ison_error_t *error) {
+    ison_parse_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ison_document_t *doc = ison_parse_with(&ctx, text, len, error);
+    parse_ctx_release(&ctx);
+    return doc;
+}
+
+ison_document_t *ison_parse(const char *text, ison_error_t *error) {
+    return ison_parse_n(text, text ? strlen(text) : 0, error);
+}
+
+/* ==================== ISONL ==================== */
+
+static ison_row_t *parse_mapped_row(const ison_block_t *block, const ison_field_map_t *fm, ison_lexer_t *lx,
+                                    const char *line, size_t len) {
+    ison_row_t *row = ison_row_create();
+    if (!row || !ison_lex_line(lx, line, len)) return row;
+    for (size_t i = 0; i < lx->count && i < fm->count; i++) {
+        const ison_field_info_t *field = &block->fields[fm->map[i]];
+        ison_value_t raw = ison_lex_value(lx->tokens[i].text, field->type_hint);
+        ison_value_t val = ison_value_copy(&raw);
+        ison_row_set(row, field->name, &val);
+    }
+    return row;
+}
+
+ison_document_t *ison_parse_isonl_n(const char *text, size_t len, ison_error_t *error) {
     if (error) *error = ISON_OK;
-    if (!text) return ison_document_create();
-    
     ison_document_t *doc = ison_document_create();
-    size_t line_count;
-    char **lines = split_lines(text, &line_count);
-    
-    for (size_t i = 0; i < line_count; i++) {
-        char *line = trim(lines[i]);
-        if (strlen(line) == 0 || line[0] == '#') {
-            free(line);
-            continue;
-        }
-        
-        char *p1 = strchr(line, '|');
-        char *p2 = p1 ? strchr(p1 + 1, '|') : NULL;
-        
-        if (!p1 || !p2) {
-            free(line);
-            continue;
-        }
-        
-        *p1 = '\0';
-        *p2 = '\0';
-        
-        char *header = line;
-        char *fields_str = p1 + 1;
-        char *data_str = p2 + 1;
-        
-        char *dot = strchr(header, '.');
-        if (!dot) {
-            free(line);
-            continue;
+    if (!doc) {
+        if (error) *error = ISON_ERROR_MEMORY;
+        return NULL;
+    }
+    if (!text) return doc;
+
+    ison_parse_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ison_field_map_t fields = {0};
+    parser_t p;
+    memset(&p, 0, sizeof(p));
+    p.ctx = &ctx;
+    p.text = text;
+    p.len = len;
+
+    const char *line;
+    size_t line_len;
+    while (peek_line(&p, &line, &line_len)) {
+        consume_line(&p);
+        if (line_len == 0 || line[0] == '#') continue;
+
+        const char *end = line + line_len;
+        const char *p1 = memchr(line, '|', line_len);
+        const char *p2 = p1 ? memchr(p1 + 1, '|', (size_t)(end - p1 - 1)) : NULL;
+        if (!p2) continue;
+        const char *dot = memchr(line, '.', (size_t)(p1 - line));
+        if (!dot) continue;
+
+        size_t kind_len = (size_t)(dot - line);
+        const char *kind = block_names(&ctx, line, kind_len, dot + 1, (size_t)(p1 - dot - 1));
+        if (!kind) {
+            p.error = ISON_ERROR_MEMORY;
+            break;
         }
-        
-        *dot = '\0';
-        char *kind = header;
-        char *name = dot + 1;
-        
+        const char *name = kind + kind_len + 1;
         ison_block_t *block = ison_document_get(doc, name);
         if (!block) {
             block = ison_block_create(kind, name);
-            
-            size_t field_count;
-            char **field_tokens = tokenize(fields_str, &field_count);
-            for (size_t j = 0; j < field_count; j++) {
-                char *fname, *ftype;
-                parse_field_def(field_tokens[j], &fname, &ftype);
-                ison_block_add_field(block, fname, ftype);
-                free(fname);
-                free(ftype);
-                free(field_tokens[j]);
+            if (!block) {
+                p.error = ISON_ERROR_MEMORY;
+                break;
             }
-            free(field_tokens);
-            
             ison_document_add_block(doc, block);
         }
-        
-        size_t data_count;
-        char **data_tokens = tokenize(data_str, &data_count);
-        ison_row_t *row = ison_row_create();
-        
-        for (size_t j = 0; j < data_count && j < block->field_count; j++) {
-            ison_value_t val = parse_value_token(data_tokens[j], block->fields[j].type_hint);
-            ison_row_set(row, block->fields[j].name, &val);
-            free(data_tokens[j]);
+
+        if (!ison_field_map_update(&fields, block, &ctx.lexer, p1 + 1, (size_t)(p2 - p1 - 1))) {
+            p.error = ISON_ERROR_MEMORY;
+            break;
         }
-        free(data_tokens);
-        
-        ison_block_add_row(block, row);
-        free(row);
-        
-        free(line);
+        ison_block_take_row(block, parse_mapped_row(block, &fields, &ctx.lexer, p2 + 1, (size_t)(end - p2 - 1)));
     }
-    
-    for (size_t i = 0; i < line_count; i++) {
-        free(lines[i]);
+
+    parse_ctx_release(&ctx);
+    ison_field_map_free(&fields);
+    if (p.error != ISON_OK) {
+        ison_document_free(doc);
+        doc = NULL;
+        if (error) *error = p.error;
     }
-    free(lines);
-    
     return doc;
 }
+
+ison_document_t *ison_parse_isonl(const char *text, ison_error_t *error) {
+    return ison_parse_isonl_n(text, text ? strlen(text) : 0, error);
+}
@@ -0,0 +1,163 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ison.h"
+
+static ison_error_t fd_source(void *userdata, char *buf, size_t cap, size_t *out_len) {
+    int fd = (int)(intptr_t)userdata;
+    for (;;) {
+        ssize_t n = read(fd, buf, cap);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            *out_len = 0;
+            return ISON_ERROR_IO;
+        }
+        *out_len = (size_t)n;
+        return ISON_OK;
+    }
+}
+
+static ison_error_t file_source(void *userdata, char *buf, size_t cap, size_t *out_len) {
+    FILE *f = userdata;
+    *out_len = fread(buf, 1, cap, f);
+    if (*out_len == 0 && ferror(f)) return ISON_ERROR_IO;
+    return ISON_OK;
+}
+
+ison_error_t ison_reader_init_memory(ison_reader_t *r, const char *data, size_t len) {
+    if (!r) return ISON_ERROR_INVALID;
+    memset(r, 0, sizeof(*r));
+    if (!data && len > 0) {
+        r->error = ISON_ERROR_INVALID;
+        return r->error;
+    }
+    r->data = data ? data : "";
+    r->data_len = len;
+    return ISON_OK;
+}
+
+ison_error_t ison_reader_init_source(ison_reader_t *r, ison_source_t source, void *userdata, size_t buffer_size) {
+    if (!r) return ISON_ERROR_INVALID;
+    memset(r, 0, sizeof(*r));
+    if (!source) {
+        r->error = ISON_ERROR_INVALID;
+        return r->error;
+    }
+    r->source = source;
+    r->userdata = userdata;
+    r->cap = buffer_size ? buffer_size : ISON_READER_BUFFER_SIZE;
+    r->buf = malloc(r->cap);
+    if (!r->buf) {
+        r->cap = 0;
+        r->error = ISON_ERROR_MEMORY;
+    }
+    return r->error;
+}
+
+ison_error_t ison_reader_init_fd(ison_reader_t *r, int fd, size_t buffer_size) {
+    if (fd < 0) {
+        if (r) memset(r, 0, sizeof(*r));
+        if (r) r->error = ISON_ERROR_INVALID;
+        return ISON_ERROR_INVALID;
+    }
+    return ison_reader_init_source(r, fd_source, (void *)(intptr_t)fd, buffer_size);
+}
+
+ison_error_t ison_reader_init_file(ison_reader_t *r, FILE *file, size_t buffer_size) {
+    if (!file) {
+        if (r) memset(r, 0, sizeof(*r));
+        if (r) r->error = ISON_ERROR_INVALID;
+        return ISON_ERROR_INVALID;
+    }
+    return ison_reader_init_source(r, file_source, file, buffer_size);
+}
+
+/* Make room after the unread bytes, compacting first and growing only if a line needs it */
+static int reader_fill(ison_reader_t *r) {
+    if (r->pos > 0) {
+        memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+        r->len -= r->pos;
+        r->pos = 0;
+    }
+    if (r->len == r->cap) {
+        size_t new_cap = r->cap * 2;
+        char *new_buf = realloc(r->buf, new_cap);
+        if (!new_buf) {
+            r->error = ISON_ERROR_MEMORY;
+            return 0;
+        }
+        r->buf = new_buf;
+        r->cap = new_cap;
+    }
+    size_t n = 0;
+    ison_error_t err = r->source(r->userdata, r->buf + r->len, r->cap - r->len, &n);
+    if (err != ISON_OK) {
+        r->error = err;
+        return 0;
+    }
+    if (n == 0) r->eof = true;
+    r->len += n;
+    return n > 0;
+}
+
+static void strip_cr(const char *line, size_t *len) {
+    while (*len > 0 && line[*len - 1] == '\r') (*len)--;
+}
+
+bool ison_reader_next_line(ison_reader_t *r, const char **line, size_t *len) {
+    if (!r || r->error != ISON_OK) return false;
+    
+    if (!r->source) {
+        if (r->pos >= r->data_len) return false;
+        const char *start = r->data + r->pos;
+        const char *nl = memchr(start, '\n', r->data_len - r->pos);
+        size_t n = nl ? (size_t)(nl - start) : r->data_len - r->pos;
+        r->pos += n + (nl ? 1 : 0);
+        strip_cr(start, &n);
+        *line = start;
+        *len = n;
+        r->line_no++;
+        return true;
+    }
+    
+    size_t scanned = r->pos;
+    for (;;) {
+        char *nl = memchr(r->buf + scanned, '\n', r->len - scanned);
+        if (nl) {
+            size_t n = (size_t)(nl - (r->buf + r->pos));
+            *line = r->buf + r->pos;
+            r->pos += n + 1;
+            strip_cr(*line, &n);
+            *len = n;
+            r->line_no++;
+            return true;
+        }
+        if (r->eof) break;
+        scanned = r->len - r->pos;
+        if (!reader_fill(r) && r->error != ISON_OK) return false;
+    }
+    
+    if (r->pos < r->len) {
+        size_t n = r->len - r->pos;
+        *line = r->buf + r->pos;
+        r->pos = r->len;
+        strip_cr(*line, &n);
+        *len = n;
+        r->line_no++;
+        return true;
+    }
+    return false;
+}
+
+void ison_reader_free(ison_reader_t *r) {
+    if (!r) return;
+    free(r->buf);
+    r->buf = NULL;
+    r->len = 0;
+    r->cap = 0;
+    r->pos = 0;
+}
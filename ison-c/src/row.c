@@ -1,12 +1,24 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ison.h"
+#include "lex.h"
 
 ison_row_t *ison_row_create(void) {
     ison_row_t *row = calloc(1, sizeof(ison_row_t));
     return row;
 }
 
+static void row_append(ison_row_t *row, ison_row_entry_t *entry) {
+    entry->next = NULL;
+    if (row->tail) {
+        row->tail->next = entry;
+    } else {
+        row->head = entry;
+    }
+    row->tail = entry;
+    row->count++;
+}
+
 void ison_row_set(ison_row_t *row, const char *key, const ison_value_t *value) {
     if (!row || !key) return;
     
@@ -19,26 +31,58 @@ void ison_row_set(ison_row_t *row, const char *key, const ison_value_t *value) {
         }
         entry = entry->next;
     }
-    
-    entry = malloc(sizeof(ison_row_entry_t));
+    ison_row_append(row, key, strlen(key), value);
+}
+
+void ison_row_append(ison_row_t *row, const char *key, size_t key_len, const ison_value_t *value) {
+    /* The key lives in the same allocation, right after the entry */
+    ison_row_entry_t *entry = malloc(sizeof(ison_row_entry_t) + key_len + 1);
     if (!entry) return;
     
-    entry->key = malloc(strlen(key) + 1);
-    if (!entry->key) {
-        free(entry);
-        return;
-    }
-    strcpy(entry->key, key);
+    entry->key = (char *)(entry + 1);
+    memcpy(entry->key, key, key_len + 1);
     entry->value = *value;
-    entry->next = NULL;
+    row_append(row, entry);
+}
+
+void ison_row_set_token(ison_row_t *row, const char *key, const char *token, size_t len, const char *type_hint,
+                        ison_arena_t *arena) {
+    if (!row || !key) return;
+    if (!type_hint) type_hint = "";
     
-    if (row->tail) {
-        row->tail->next = entry;
-    } else {
-        row->head = entry;
+    for (ison_row_entry_t *entry = row->head; entry; entry = entry->next) {
+        if (strcmp(entry->key, key) == 0) {
+            /* A repeated field has no room for its token; decode it now */
+            char *copy = malloc(len + 1);
+            if (!copy) return;
+            memcpy(copy, token, len);
+            copy[len] = '\0';
+            ison_value_t raw = ison_lex_value(copy, type_hint);
+            ison_value_t val = ison_value_copy(&raw);
+            free(copy);
+            ison_row_set(row, key, &val);
+            return;
+        }
     }
-    row->tail = entry;
-    row->count++;
+    
+    /* Key, token and hint all live in the entry's allocation */
+    size_t key_len = strlen(key);
+    size_t hint_len = strlen(type_hint);
+    size_t size = sizeof(ison_row_entry_t) + key_len + len + hint_len + 3;
+    bool in_arena = arena && row->arena_count == row->count;
+    ison_row_entry_t *entry = in_arena ? ison_arena_alloc(arena, size) : malloc(size);
+    if (!entry) return;
+    if (in_arena) row->arena_count++;
+    
+    entry->key = (char *)(entry + 1);
+    memcpy(entry->key, key, key_len + 1);
+    entry->value.type = ISON_TYPE_UNKNOWN;
+    entry->value.data.raw_val.text = entry->key + key_len + 1;
+    memcpy(entry->value.data.raw_val.text, token, len);
+    entry->value.data.raw_val.text[len] = '\0';
+    entry->value.data.raw_val.type_hint = entry->value.data.raw_val.text + len + 1;
+    memcpy(entry->value.data.raw_val.type_hint, type_hint, hint_len + 1);
+    row_append(row, entry);
 }
 
 bool ison_row_get(const ison_row_t *row, const char *key, ison_value_t *out) {
@@ -47,6 +91,7 @@ bool ison_row_get(const ison_row_t *row, const char *key, ison_value_t *out) {
     ison_row_entry_t *entry = row->head;
     while (entry) {
         if (strcmp(entry->key, key) == 0) {
+            ison_value_resolve(&entry->value);
             if (out) *out = entry->value;
             return true;
         }
@@ -61,6 +106,7 @@ ison_value_t *ison_row_get_ptr(const ison_row_t *row, const char *key) {
     ison_row_entry_t *entry = row->head;
     while (entry) {
         if (strcmp(entry->key, key) == 0) {
+            ison_value_resolve(&entry->value);
             return &entry->value;
         }
         entry = entry->next;
@@ -71,12 +117,13 @@ ison_value_t *ison_row_get_ptr(const ison_row_t *row, const char *key) {
 void ison_row_free(ison_row_t *row) {
     if (!row) return;
     
+    /* The first arena_count entries belong to the document's arena */
+    size_t index = 0;
     ison_row_entry_t *entry = row->head;
     while (entry) {
         ison_row_entry_t *next = entry->next;
-        free(entry->key);
         ison_value_free(&entry->value);
-        free(entry);
+        if (index++ >= row->arena_count) free(entry);
         entry = next;
     }
     free(row);
@@ -0,0 +1,147 @@
+#include <stdint.h>
+#include <string.h>
+#include "scan.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SCAN_HAVE_AVX2 1
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/*
+ * Every class is up to four literal bytes, optionally plus all bytes
+ * below 0x20. The helpers are inlined with constant arguments, so each
+ * public scanner compiles to its own compare chain.
+ */
+typedef struct {
+    unsigned char a, b, c, d;
+    int controls;
+} byte_class_t;
+
+static inline int in_class(unsigned char ch, byte_class_t k) {
+    return ch == k.a || ch == k.b || ch == k.c || ch == k.d || (k.controls && ch < 0x20);
+}
+
+static inline size_t scan_tail(const char *s, size_t i, size_t len, byte_class_t k) {
+    while (i < len && !in_class((unsigned char)s[i], k)) i++;
+    return i;
+}
+
+static inline unsigned first_bit(uint32_t mask) {
+    return (unsigned)__builtin_ctz(mask);
+}
+
+#if defined(SCAN_HAVE_AVX2)
+__attribute__((target("avx2")))
+static size_t scan_avx2(const char *s, size_t len, byte_class_t k) {
+    const __m256i va = _mm256_set1_epi8((char)k.a);
+    const __m256i vb = _mm256_set1_epi8((char)k.b);
+    const __m256i vc = _mm256_set1_epi8((char)k.c);
+    const __m256i vd = _mm256_set1_epi8((char)k.d);
+    const __m256i ctl = _mm256_set1_epi8(0x1F);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i hit = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, vc), _mm256_cmpeq_epi8(x, vd)));
+        if (k.controls) {
+            /* unsigned x <= 0x1F */
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(_mm256_min_epu8(x, ctl), x));
+        }
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+        if (mask) return i + first_bit(mask);
+    }
+    return scan_tail(s, i, len, k);
+}
+
+/*
+ * Serializer threads call this concurrently, so the cache is read and written
+ * atomically. Racing first calls store the same answer. The CPU model is set up by
+ * libgcc's constructor, so no __builtin_cpu_init (which writes shared state) is needed.
+ */
+static int have_avx2(void) {
+    static int cached = -1;
+    int avx2 = __atomic_load_n(&cached, __ATOMIC_RELAXED);
+    if (avx2 < 0) {
+        avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+        __atomic_store_n(&cached, avx2, __ATOMIC_RELAXED);
+    }
+    return avx2;
+}
+#endif
+
+static inline size_t scan_class(const char *s, size_t len, byte_class_t k) {
+    size_t i = 0;
+#if defined(SCAN_HAVE_AVX2)
+    if (len >= 64 && have_avx2()) return scan_avx2(s, len, k);
+#endif
+#if defined(__SSE2__)
+    const __m128i va = _mm_set1_epi8((char)k.a);
+    const __m128i vb = _mm_set1_epi8((char)k.b);
+    const __m128i vc = _mm_set1_epi8((char)k.c);
+    const __m128i vd = _mm_set1_epi8((char)k.d);
+    const __m128i ctl = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)),
+            _mm_or_si128(_mm_cmpeq_epi8(x, vc), _mm_cmpeq_epi8(x, vd)));
+        if (k.controls) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(x, ctl), x));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hit);
+        if (mask) return i + first_bit(mask);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t va = vdupq_n_u8(k.a);
+    const uint8x16_t vb = vdupq_n_u8(k.b);
+    const uint8x16_t vc = vdupq_n_u8(k.c);
+    const uint8x16_t vd = vdupq_n_u8(k.d);
+    const uint8x16_t ctl = vdupq_n_u8(0x20);
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t x = vld1q_u8((const uint8_t *)(s + i));
+        uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(x, va), vceqq_u8(x, vb)),
+                                  vorrq_u8(vceqq_u8(x, vc), vceqq_u8(x, vd)));
+        if (k.controls) hit = vorrq_u8(hit, vcltq_u8(x, ctl));
+        if (vmaxvq_u8(hit)) break;
+    }
+#else
+    /* SWAR: eight bytes per step, exact match test per literal */
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t x;
+        memcpy(&x, s + i, sizeof(x));
+        uint64_t ea = x ^ (ones * k.a), eb = x ^ (ones * k.b);
+        uint64_t ec = x ^ (ones * k.c), ed = x ^ (ones * k.d);
+        uint64_t hit = ((ea - ones) & ~ea) | ((eb - ones) & ~eb) |
+                       ((ec - ones) & ~ec) | ((ed - ones) & ~ed);
+        if (k.controls) hit |= (x - ones * 0x20) & ~x;
+        if (hit & highs) break;
+    }
+#endif
+    return scan_tail(s, i, len, k);
+}
+
+size_t ison_scan_ison_quote(const char *s, size_t len) {
+    const byte_class_t k = {' ', '\t', '\n', '"', 0};
+    return scan_class(s, len, k);
+}
+
+size_t ison_scan_ison_escape(const char *s, size_t len) {
+    const byte_class_t k = {'\\', '"', '\n', '\t', 0};
+    return scan_class(s, len, k);
+}
+
+size_t ison_scan_json_escape(const char *s, size_t len) {
+    const byte_class_t k = {'\\', '"', '"', '"', 1};
+    return scan_class(s, len, k);
+}
+
+size_t ison_scan_csv_quote(const char *s, size_t len, char delimiter) {
+    const byte_class_t k = {(unsigned char)delimiter, '"', '\n', '\r', 0};
+    return scan_class(s, len, k);
+}
@@ -0,0 +1,26 @@
+/**
+ * scan.h - byte classifiers shared by the serializers (internal)
+ *
+ * Each scanner returns the index of the first byte in s[0, len) that
+ * belongs to its class, or len when there is none. They look at 16 or 32
+ * bytes per step where the CPU allows it.
+ */
+
+#ifndef ISON_SCAN_H
+#define ISON_SCAN_H
+
+#include <stddef.h>
+
+/* Bytes that force an ISON string into quotes: space, tab, newline, '"' */
+size_t ison_scan_ison_quote(const char *s, size_t len);
+
+/* Bytes escaped inside a quoted ISON string: '\\', '"', newline, tab */
+size_t ison_scan_ison_escape(const char *s, size_t len);
+
+/* Bytes escaped inside a JSON string: '\\', '"', and controls below 0x20 */
+size_t ison_scan_json_escape(const char *s, size_t len);
+
+/* Bytes that force a CSV field into quotes: the delimiter, '"', CR, LF */
+size_t ison_scan_csv_quote(const char *s, size_t len, char delimiter);
+
+#endif /* ISON_SCAN_H */
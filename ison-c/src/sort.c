@@ -0,0 +1,697 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ison.h"
+#include "lex.h"
+
+/*
+ * External sort of ISONL rows. Lines are kept verbatim; only the key cells
+ * are decoded. Input is read into memory up to the budget, each such run is
+ * sorted (stable merge sort) and spilled to a temporary file next to the
+ * output, and the runs are merged through a loser tree, at most
+ * SORT_FAN_IN at a time.
+ *
+ * Rows of other blocks sort before every row of the sorted block and keep
+ * their order; blank, comment and malformed lines are dropped. Keys compare
+ * null (or missing) < bool < number < string < reference, ints and floats
+ * numerically with each other, ties keep input order.
+ */
+
+#define SORT_HEADER_CACHE 16
+#define SORT_FAN_IN 64
+#define SORT_ARENA_CHUNK (1u << 20)
+#define SORT_DEFAULT_BUDGET ((size_t)64 << 20)
+
+enum { KEY_NULL, KEY_BOOL, KEY_NUMBER, KEY_STRING, KEY_REF };
+
+typedef struct {
+    int rank;
+    bool is_int;
+    int64_t i;
+    double f;
+    const char *s;          /* string, or reference namespace */
+    size_t len;
+    const char *s2;         /* reference id */
+    size_t len2;
+} sort_key_t;
+
+typedef struct {
+    char *text;             /* "kind.name|fields", then the key hints */
+    size_t len;
+    bool pass;              /* not a row of the sorted block */
+    size_t *columns;        /* token index of each key, SIZE_MAX when the line lacks it */
+    char **hints;
+} sort_header_t;
+
+typedef struct {
+    const char *block;
+    const char **keys;
+    size_t key_count;
+    ison_lexer_t lexer;
+    sort_header_t headers[SORT_HEADER_CACHE];
+    size_t header_count;
+} sort_ctx_t;
+
+static void sort_header_free(sort_header_t *h) {
+    free(h->text);
+    free(h->columns);
+}
+
+static void sort_ctx_free(sort_ctx_t *ctx) {
+    for (size_t i = 0; i < ctx->header_count; i++) sort_header_free(&ctx->headers[i]);
+    ison_lexer_free(&ctx->lexer);
+}
+
+static const sort_header_t *sort_header(sort_ctx_t *ctx, const char *text, size_t len, const char *name,
+                                        size_t name_len, const char *fields, size_t fields_len) {
+    for (size_t i = 0; i < ctx->header_count; i++) {
+        sort_header_t *h = &ctx->headers[i];
+        if (h->len != len || memcmp(h->text, text, len) != 0) continue;
+        if (i > 0) {
+            sort_header_t hit = *h;
+            memmove(&ctx->headers[1], &ctx->headers[0], i * sizeof(sort_header_t));
+            ctx->headers[0] = hit;
+        }
+        return &ctx->headers[0];
+    }
+
+    sort_header_t h;
+    memset(&h, 0, sizeof(h));
+    h.pass = ctx->block && (strlen(ctx->block) != name_len || memcmp(ctx->block, name, name_len) != 0);
+    if (!ison_lex_line(&ctx->lexer, fields, fields_len)) return NULL;
+    h.text = malloc(2 * (len + 1));
+    h.columns = malloc(ctx->key_count * (sizeof(size_t) + sizeof(char *)));
+    if (!h.text || !h.columns) {
+        sort_header_free(&h);
+        return NULL;
+    }
+    memcpy(h.text, text, len);
+    h.text[len] = '\0';
+    h.len = len;
+    h.hints = (char **)(h.columns + ctx->key_count);
+
+    /* Hints are copied after the text; a hint is never longer than its line */
+    char *out = h.text + len + 1;
+    for (size_t k = 0; k < ctx->key_count; k++) {
+        h.columns[k] = SIZE_MAX;
+        h.hints[k] = h.text + len;
+        for (size_t i = 0; i < ctx->lexer.count; i++) {
+            char *fname, *ftype;
+            ison_lex_field_def(ctx->lexer.tokens[i].text, &fname, &ftype);
+            if (strcmp(fname, ctx->keys[k]) != 0) continue;
+            size_t hint_len = strlen(ftype);
+            memcpy(out, ftype, hint_len + 1);
+            h.columns[k] = i;
+            h.hints[k] = out;
+            out += hint_len + 1;
+            break;
+        }
+    }
+
+    if (ctx->header_count == SORT_HEADER_CACHE) {
+        sort_header_free(&ctx->headers[SORT_HEADER_CACHE - 1]);
+        ctx->header_count--;
+    }
+    memmove(&ctx->headers[1], &ctx->headers[0], ctx->header_count * sizeof(sort_header_t));
+    ctx->headers[0] = h;
+    ctx->header_count++;
+    return &ctx->headers[0];
+}
+
+static sort_key_t key_of(const ison_value_t *v) {
+    sort_key_t key;
+    memset(&key, 0, sizeof(key));
+    switch (v->type) {
+        case ISON_TYPE_BOOL:
+            key.rank = KEY_BOOL;
+            key.i = v->data.bool_val;
+            break;
+        case ISON_TYPE_INT:
+            key.rank = KEY_NUMBER;
+            key.is_int = true;
+            key.i = v->data.int_val;
+            key.f = (double)v->data.int_val;
+            break;
+        case ISON_TYPE_FLOAT:
+            key.rank = KEY_NUMBER;
+            key.f = v->data.float_val;
+            break;
+        case ISON_TYPE_STRING:
+            key.rank = KEY_STRING;
+            key.s = v->data.string_val ? v->data.string_val : "";
+            key.len = strlen(key.s);
+            break;
+        case ISON_TYPE_REFERENCE:
+            key.rank = KEY_REF;
+            key.s = v->data.ref_val.ns ? v->data.ref_val.ns : "";
+            key.len = strlen(key.s);
+            key.s2 = v->data.ref_val.id ? v->data.ref_val.id : "";
+            key.len2 = strlen(key.s2);
+            break;
+        default:
+            key.rank = KEY_NULL;
+    }
+    return key;
+}
+
+/*
+ * Keys of one line: 1 for a row, 0 for a line that is not a record, -1 on
+ * allocation failure. Key strings point into the lexer until its next use.
+ */
+static int sort_extract(sort_ctx_t *ctx, const char *line, size_t len, sort_key_t *keys, bool *pass) {
+    ison_lex_trim(&line, &len);
+    if (len == 0 || line[0] == '#') return 0;
+    const char *p1 = memchr(line, '|', len);
+    const char *p2 = p1 ? memchr(p1 + 1, '|', len - (size_t)(p1 + 1 - line)) : NULL;
+    if (!p2) return 0;
+    const char *dot = memchr(line, '.', (size_t)(p1 - line));
+    if (!dot) return 0;
+
+    const sort_header_t *h = sort_header(ctx, line, (size_t)(p2 - line), dot + 1, (size_t)(p1 - dot - 1),
+                                         p1 + 1, (size_t)(p2 - p1 - 1));
+    if (!h) return -1;
+    *pass = h->pass;
+    if (h->pass) return 1;
+    if (!ison_lex_line(&ctx->lexer, p2 + 1, len - (size_t)(p2 + 1 - line))) return -1;
+    for (size_t k = 0; k < ctx->key_count; k++) {
+        size_t col = h->columns[k];
+        if (col >= ctx->lexer.count) {
+            memset(&keys[k], 0, sizeof(sort_key_t));
+            continue;
+        }
+        ison_value_t v = ison_lex_value(ctx->lexer.tokens[col].text, h->hints[k]);
+        keys[k] = key_of(&v);
+    }
+    return 1;
+}
+
+static size_t key_strings_size(const sort_key_t *keys, size_t n) {
+    size_t size = 0;
+    for (size_t k = 0; k < n; k++) size += keys[k].len + keys[k].len2;
+    return size;
+}
+
+/* Move the key strings out of the lexer into dst */
+static void key_strings_copy(sort_key_t *keys, size_t n, char *dst) {
+    for (size_t k = 0; k < n; k++) {
+        if (keys[k].len) {
+            memcpy(dst, keys[k].s, keys[k].len);
+            keys[k].s = dst;
+            dst += keys[k].len;
+        }
+        if (keys[k].len2) {
+            memcpy(dst, keys[k].s2, keys[k].len2);
+            keys[k].s2 = dst;
+            dst += keys[k].len2;
+        }
+    }
+}
+
+static int compare_bytes(const char *a, size_t alen, const char *b, size_t blen) {
+    int c = memcmp(a, b, alen < blen ? alen : blen);
+    if (c != 0) return c;
+    return alen < blen ? -1 : alen > blen;
+}
+
+static int compare_key(const sort_key_t *a, const sort_key_t *b) {
+    if (a->rank != b->rank) return a->rank < b->rank ? -1 : 1;
+    switch (a->rank) {
+        case KEY_BOOL:
+            return (int)(a->i - b->i);
+        case KEY_NUMBER:
+            if (a->is_int && b->is_int) return a->i < b->i ? -1 : a->i > b->i;
+            return a->f < b->f ? -1 : a->f > b->f;
+        case KEY_STRING:
+            return compare_bytes(a->s, a->len, b->s, b->len);
+        case KEY_REF: {
+            int c = compare_bytes(a->s, a->len, b->s, b->len);
+            return c ? c : compare_bytes(a->s2, a->len2, b->s2, b->len2);
+        }
+        default:
+            return 0;
+    }
+}
+
+static int compare_rows(bool apass, const sort_key_t *a, bool bpass, const sort_key_t *b, size_t n) {
+    if (apass || bpass) return bpass - apass;
+    for (size_t k = 0; k < n; k++) {
+        int c = compare_key(&a[k], &b[k]);
+        if (c) return c;
+    }
+    return 0;
+}
+
+/* ==================== Runs ==================== */
+
+typedef struct {
+    const char *line;
+    size_t len;
+    bool pass;
+    int rank;               /* of the first key */
+    uint64_t prefix;        /* first key mapped so unsigned order matches, see key_prefix */
+    sort_key_t *keys;
+} sort_entry_t;
+
+typedef struct {
+    char **chunks;
+    size_t count;
+    size_t cap;
+    size_t used;            /* bytes used in the last chunk */
+    size_t size;            /* size of the last chunk */
+    size_t total;           /* bytes handed out */
+} sort_arena_t;
+
+static void *arena_alloc(sort_arena_t *a, size_t n) {
+    n = (n + 7) & ~(size_t)7;
+    if (a->count == 0 || a->size - a->used < n) {
+        if (a->count == a->cap) {
+            size_t cap = a->cap ? a->cap * 2 : 16;
+            char **chunks = realloc(a->chunks, cap * sizeof(char *));
+            if (!chunks) return NULL;
+            a->chunks = chunks;
+            a->cap = cap;
+        }
+        size_t size = n > SORT_ARENA_CHUNK ? n : SORT_ARENA_CHUNK;
+        char *chunk = malloc(size);
+        if (!chunk) return NULL;
+        a->chunks[a->count++] = chunk;
+        a->size = size;
+        a->used = 0;
+    }
+    void *p = a->chunks[a->count - 1] + a->used;
+    a->used += n;
+    a->total += n;
+    return p;
+}
+
+static void arena_reset(sort_arena_t *a) {
+    for (size_t i = 0; i < a->count; i++) free(a->chunks[i]);
+    a->count = 0;
+    a->total = 0;
+}
+
+/*
+ * Order-preserving 64-bit image of a key: doubles with the sign folded in,
+ * the first eight bytes of strings. Different prefixes decide a comparison
+ * without touching the keys; equal ones fall back to compare_rows.
+ */
+static uint64_t key_prefix(const sort_key_t *key) {
+    uint64_t p = 0;
+    switch (key->rank) {
+        case KEY_BOOL:
+            return (uint64_t)key->i;
+        case KEY_NUMBER: {
+            double f = key->f == 0 ? 0.0 : key->f;
+            memcpy(&p, &f, sizeof(p));
+            return p >> 63 ? ~p : p | (uint64_t)1 << 63;
+        }
+        case KEY_STRING:
+        case KEY_REF:
+            for (size_t i = 0; i < 8; i++) {
+                p = p << 8 | (i < key->len ? (unsigned char)key->s[i] : 0);
+            }
+            return p;
+        default:
+            return 0;
+    }
+}
+
+static int compare_entries(const sort_entry_t *a, const sort_entry_t *b, size_t key_count) {
+    if (!a->pass && !b->pass) {
+        if (a->rank != b->rank) return a->rank < b->rank ? -1 : 1;
+        if (a->prefix != b->prefix) return a->prefix < b->prefix ? -1 : 1;
+    }
+    return compare_rows(a->pass, a->keys, b->pass, b->keys, key_count);
+}
+
+static void merge_sort(sort_entry_t *v, sort_entry_t *tmp, size_t n, size_t key_count) {
+    for (size_t width = 1; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+            size_t i = lo, j = mid, o = lo;
+            while (i < mid && j < hi) {
+                if (compare_entries(&v[j], &v[i], key_count) < 0) tmp[o++] = v[j++];
+                else tmp[o++] = v[i++];
+            }
+            while (i < mid) tmp[o++] = v[i++];
+            while (j < hi) tmp[o++] = v[j++];
+        }
+        memcpy(v, tmp, n * sizeof(sort_entry_t));
+    }
+}
+
+static ison_error_t write_lines(const sort_entry_t *v, size_t n, const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return ISON_ERROR_IO;
+    ison_writer_t w;
+    ison_error_t err = ison_writer_init_fd(&w, fd, 0);
+    for (size_t i = 0; i < n && w.error == ISON_OK; i++) {
+        ison_writer_write(&w, v[i].line, v[i].len);
+        ison_writer_putc(&w, '\n');
+    }
+    if (err == ISON_OK) err = ison_writer_flush(&w);
+    ison_writer_free(&w);
+    if (close(fd) != 0 && err == ISON_OK) err = ISON_ERROR_IO;
+    return err;
+}
+
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t cap;
+    size_t serial;
+    const char *prefix;
+} run_list_t;
+
+static char *run_path(run_list_t *runs) {
+    size_t len = strlen(runs->prefix) + 32;
+    char *path = malloc(len);
+    if (path) snprintf(path, len, "%s.run%zu", runs->prefix, runs->serial++);
+    return path;
+}
+
+static int run_push(run_list_t *runs, char *path) {
+    if (runs->count == runs->cap) {
+        size_t cap = runs->cap ? runs->cap * 2 : 16;
+        char **paths = realloc(runs->paths, cap * sizeof(char *));
+        if (!paths) return 0;
+        runs->paths = paths;
+        runs->cap = cap;
+    }
+    runs->paths[runs->count++] = path;
+    return 1;
+}
+
+static void run_list_free(run_list_t *runs) {
+    for (size_t i = 0; i < runs->count; i++) {
+        remove(runs->paths[i]);
+        free(runs->paths[i]);
+    }
+    free(runs->paths);
+}
+
+/* ==================== Merging ==================== */
+
+typedef struct {
+    int fd;
+    ison_reader_t reader;
+    const char *line;
+    size_t len;
+    bool pass;
+    bool done;
+    sort_key_t *keys;
+    char *strings;
+    size_t strings_cap;
+} merge_src_t;
+
+static ison_error_t src_advance(sort_ctx_t *ctx, merge_src_t *src) {
+    const char *line;
+    size_t len;
+    while (ison_reader_next_line(&src->reader, &line, &len)) {
+        int got = sort_extract(ctx, line, len, src->keys, &src->pass);
+        if (got < 0) return ISON_ERROR_MEMORY;
+        if (got == 0) continue;
+        size_t need = src->pass ? 0 : key_strings_size(src->keys, ctx->key_count);
+        if (need > src->strings_cap) {
+            char *strings = realloc(src->strings, need);
+            if (!strings) return ISON_ERROR_MEMORY;
+            src->strings = strings;
+            src->strings_cap = need;
+        }
+        if (!src->pass) key_strings_copy(src->keys, ctx->key_count, src->strings);
+        src->line = line;
+        src->len = len;
+        return ISON_OK;
+    }
+    src->done = true;
+    return src->reader.error;
+}
+
+/* Does source a come out before source b? Ties go to the earlier source. */
+static bool src_before(const sort_ctx_t *ctx, const merge_src_t *srcs, size_t a, size_t b) {
+    if (srcs[a].done || srcs[b].done) return !srcs[a].done || (srcs[b].done && a < b);
+    int c = compare_rows(srcs[a].pass, srcs[a].keys, srcs[b].pass, srcs[b].keys, ctx->key_count);
+    return c < 0 || (c == 0 && a < b);
+}
+
+static ison_error_t merge_into(sort_ctx_t *ctx, char **paths, size_t n, ison_writer_t *out) {
+    merge_src_t *srcs = calloc(n, sizeof(merge_src_t));
+    size_t *tree = malloc(2 * n * sizeof(size_t));       /* tree[0] winner, tree[1..n-1] losers */
+    size_t *win = malloc(2 * n * sizeof(size_t));
+    sort_key_t *keys = malloc(n * ctx->key_count * sizeof(sort_key_t));
+    ison_error_t err = srcs && tree && win && keys ? ISON_OK : ISON_ERROR_MEMORY;
+    size_t opened = 0;
+    for (; err == ISON_OK && opened < n; opened++) {
+        merge_src_t *src = &srcs[opened];
+        src->keys = keys + opened * ctx->key_count;
+        src->fd = open(paths[opened], O_RDONLY);
+        if (src->fd < 0) {
+            err = ISON_ERROR_IO;
+            break;
+        }
+#if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(src->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        err = ison_reader_init_fd(&src->reader, src->fd, 0);
+        if (err == ISON_OK) err = src_advance(ctx, src);
+    }
+
+    if (err == ISON_OK) {
+        for (size_t i = 0; i < n; i++) win[n + i] = i;
+        for (size_t i = n - 1; i >= 1; i--) {
+            size_t l = win[2 * i], r = win[2 * i + 1];
+            bool left = src_before(ctx, srcs, l, r);
+            win[i] = left ? l : r;
+            tree[i] = left ? r : l;
+        }
+        tree[0] = win[1];
+    }
+    while (err == ISON_OK && out->error == ISON_OK) {
+        size_t s = tree[0];
+        if (srcs[s].done) break;
+        ison_writer_write(out, srcs[s].line, srcs[s].len);
+        ison_writer_putc(out, '\n');
+        err = src_advance(ctx, &srcs[s]);
+        size_t winner = s;
+        for (size_t node = (s + n) / 2; node >= 1; node /= 2) {
+            if (src_before(ctx, srcs, tree[node], winner)) {
+                size_t t = tree[node];
+                tree[node] = winner;
+                winner = t;
+            }
+        }
+        tree[0] = winner;
+    }
+    if (err == ISON_OK) err = out->error;
+
+    for (size_t i = 0; i < opened; i++) {
+        ison_reader_free(&srcs[i].reader);
+        free(srcs[i].strings);
+        close(srcs[i].fd);
+    }
+    free(srcs);
+    free(tree);
+    free(win);
+    free(keys);
+    return err;
+}
+
+static ison_error_t merge_to_path(sort_ctx_t *ctx, char **paths, size_t n, const char *out_path) {
+    int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return ISON_ERROR_IO;
+    ison_writer_t w;
+    ison_error_t err = ison_writer_init_fd(&w, fd, 0);
+    if (err == ISON_OK) err = merge_into(ctx, paths, n, &w);
+    if (err == ISON_OK) err = ison_writer_flush(&w);
+    ison_writer_free(&w);
+    if (close(fd) != 0 && err == ISON_OK) err = ISON_ERROR_IO;
+    return err;
+}
+
+/* Merge runs SORT_FAN_IN at a time, in order, until one pass can finish */
+static ison_error_t reduce_runs(sort_ctx_t *ctx, run_list_t *runs) {
+    while (runs->count > SORT_FAN_IN) {
+        run_list_t next = {NULL, 0, 0, runs->serial, runs->prefix};
+        ison_error_t err = ISON_OK;
+        for (size_t i = 0; i < runs->count && err == ISON_OK; i += SORT_FAN_IN) {
+            size_t group = runs->count - i < SORT_FAN_IN ? runs->count - i : SORT_FAN_IN;
+            char *path = run_path(&next);
+            if (!path || !run_push(&next, path)) {
+                free(path);
+                err = ISON_ERROR_MEMORY;
+                break;
+            }
+            err = merge_to_path(ctx, runs->paths + i, group, path);
+        }
+        runs->serial = next.serial;
+        run_list_free(runs);
+        *runs = next;
+        if (err != ISON_OK) return err;
+    }
+    return ISON_OK;
+}
+
+static bool valid_keys(const char **key_columns, size_t key_count) {
+    if (!key_columns || key_count == 0) return false;
+    for (size_t k = 0; k < key_count; k++) {
+        if (!key_columns[k]) return false;
+    }
+    return true;
+}
+
+ison_error_t isonl_sort_file(const char *in_path, const char *out_path, const char *block,
+                             const char **key_columns, size_t key_count, size_t mem_budget) {
+    if (!in_path || !out_path || !valid_keys(key_columns, key_count)) return ISON_ERROR_INVALID;
+    if (mem_budget == 0) mem_budget = SORT_DEFAULT_BUDGET;
+
+    int fd = open(in_path, O_RDONLY);
+    if (fd < 0) return ISON_ERROR_IO;
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    ison_reader_t r;
+    ison_error_t err = ison_reader_init_fd(&r, fd, 0);
+
+    sort_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.block = block;
+    ctx.keys = key_columns;
+    ctx.key_count = key_count;
+    sort_arena_t arena;
+    memset(&arena, 0, sizeof(arena));
+    run_list_t runs = {NULL, 0, 0, 0, out_path};
+    sort_entry_t *entries = NULL, *tmp = NULL;
+    size_t count = 0, cap = 0;
+    sort_key_t *keys = malloc(key_count * sizeof(sort_key_t));
+    if (!keys && err == ISON_OK) err = ISON_ERROR_MEMORY;
+
+    const char *line;
+    size_t len;
+    bool more = true;
+    while (err == ISON_OK && more) {
+        more = ison_reader_next_line(&r, &line, &len);
+        if (more) {
+            bool pass;
+            int got = sort_extract(&ctx, line, len, keys, &pass);
+            if (got < 0) err = ISON_ERROR_MEMORY;
+            if (got <= 0) continue;
+            if (count == cap) {
+                size_t new_cap = cap ? cap * 2 : 1024;
+                sort_entry_t *grown = realloc(entries, new_cap * sizeof(sort_entry_t));
+                if (!grown) {
+                    err = ISON_ERROR_MEMORY;
+                    break;
+                }
+                entries = grown;
+                cap = new_cap;
+            }
+            size_t strings = pass ? 0 : key_strings_size(keys, key_count);
+            char *copy = arena_alloc(&arena, len + strings);
+            sort_key_t *kept = pass ? NULL : arena_alloc(&arena, key_count * sizeof(sort_key_t));
+            if (!copy || (!pass && !kept)) {
+                err = ISON_ERROR_MEMORY;
+                break;
+            }
+            memcpy(copy, line, len);
+            if (!pass) {
+                memcpy(kept, keys, key_count * sizeof(sort_key_t));
+                key_strings_copy(kept, key_count, copy + len);
+            }
+            entries[count].line = copy;
+            entries[count].len = len;
+            entries[count].pass = pass;
+            entries[count].rank = pass ? 0 : kept[0].rank;
+            entries[count].prefix = pass ? 0 : key_prefix(&kept[0]);
+            entries[count].keys = kept;
+            count++;
+            if (arena.total + cap * sizeof(sort_entry_t) < mem_budget) continue;
+        } else {
+            err = r.error;
+            if (err != ISON_OK) break;
+        }
+
+        /* Budget reached or end of input: sort what is held */
+        if (count > 0 || !more) {
+            free(tmp);
+            tmp = malloc((count ? count : 1) * sizeof(sort_entry_t));
+            if (!tmp) {
+                err = ISON_ERROR_MEMORY;
+                break;
+            }
+            merge_sort(entries, tmp, count, key_count);
+        }
+        if (!more && runs.count == 0) {
+            /* Everything fit: no temporary files */
+            err = write_lines(entries, count, out_path);
+        } else if (count > 0) {
+            char *path = run_path(&runs);
+            if (!path || !run_push(&runs, path)) {
+                free(path);
+                err = ISON_ERROR_MEMORY;
+                break;
+            }
+            err = write_lines(entries, count, path);
+        }
+        count = 0;
+        arena_reset(&arena);
+    }
+    ison_reader_free(&r);
+    close(fd);
+    free(tmp);
+    free(entries);
+    free(keys);
+    arena_reset(&arena);
+    free(arena.chunks);
+
+    if (err == ISON_OK && runs.count > 0) {
+        err = reduce_runs(&ctx, &runs);
+        if (err == ISON_OK) err = merge_to_path(&ctx, runs.paths, runs.count, out_path);
+    }
+    run_list_free(&runs);
+    sort_ctx_free(&ctx);
+    return err;
+}
+
+ison_error_t isonl_merge_sorted(const char **in_paths, size_t count, const char *out_path, const char *block,
+                                const char **key_columns, size_t key_count) {
+    if (!in_paths || !out_path || !valid_keys(key_columns, key_count)) return ISON_ERROR_INVALID;
+    for (size_t i = 0; i < count; i++) {
+        if (!in_paths[i]) return ISON_ERROR_INVALID;
+    }
+
+    sort_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.block = block;
+    ctx.keys = key_columns;
+    ctx.key_count = key_count;
+    ison_error_t err = ISON_OK;
+
+    if (count > SORT_FAN_IN) {
+        /* Merge in groups first; the inputs themselves are never removed */
+        run_list_t runs = {NULL, 0, 0, 0, out_path};
+        for (size_t i = 0; i < count && err == ISON_OK; i += SORT_FAN_IN) {
+            size_t group = count - i < SORT_FAN_IN ? count - i : SORT_FAN_IN;
+            char *path = run_path(&runs);
+            if (!path || !run_push(&runs, path)) {
+                free(path);
+                err = ISON_ERROR_MEMORY;
+                break;
+            }
+            err = merge_to_path(&ctx, (char **)in_paths + i, group, path);
+        }
+        if (err == ISON_OK) err = reduce_runs(&ctx, &runs);
+        if (err == ISON_OK) err = merge_to_path(&ctx, runs.paths, runs.count, out_path);
+        run_list_free(&runs);
+    } else if (count == 0) {
+        err = ison_write_file(out_path, "");
+    } else {
+        err = merge_to_path(&ctx, (char **)in_paths, count, out_path);
+    }
+    sort_ctx_free(&ctx);
+    return err;
+}
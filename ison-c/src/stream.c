@@ -0,0 +1,408 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "ison.h"
+#include "lex.h"
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#define STREAM_HAVE_INOTIFY 1
+#endif
+
+/*
+ * Record-at-a-time ISONL decoding. Each line names its own kind, block and
+ * fields; the parsed "kind.name|fields" prefix is cached by its text, so a
+ * log that repeats a few headers only lexes cell tokens per line. Values
+ * handed to the callback are borrowed and valid until it returns.
+ */
+
+#define STREAM_HEADER_CACHE 16
+
+typedef struct {
+    char *text;             /* "kind.name|fields" as it appeared on the line */
+    size_t text_len;
+    char *kind;
+    char *name;
+    char **fields;
+    char **hints;
+    size_t field_count;
+} stream_header_t;
+
+typedef struct {
+    isonl_callback_t callback;
+    void *userdata;
+    ison_lexer_t lexer;
+    stream_header_t headers[STREAM_HEADER_CACHE];
+    size_t header_count;
+    ison_value_t *values;
+    size_t values_cap;
+} stream_decoder_t;
+
+static void header_free(stream_header_t *h) {
+    free(h->text);
+    free(h->fields);
+}
+
+static void decoder_free(stream_decoder_t *d) {
+    for (size_t i = 0; i < d->header_count; i++) header_free(&d->headers[i]);
+    ison_lexer_free(&d->lexer);
+    free(d->values);
+}
+
+/* Parse a header into one allocation: the text, then kind and name, then the field tokens */
+static int header_parse(stream_header_t *h, ison_lexer_t *lx, const char *text, size_t len, size_t fields_at) {
+    if (!ison_lex_line(lx, text + fields_at, len - fields_at)) return 0;
+    size_t need = 2 * (len + 1);
+    for (size_t i = 0; i < lx->count; i++) need += lx->tokens[i].len + 1;
+
+    memset(h, 0, sizeof(*h));
+    h->text = malloc(need);
+    h->fields = malloc((lx->count ? lx->count : 1) * 2 * sizeof(char *));
+    if (!h->text || !h->fields) {
+        header_free(h);
+        return 0;
+    }
+    h->hints = h->fields + lx->count;
+    memcpy(h->text, text, len);
+    h->text[len] = '\0';
+    h->text_len = len;
+
+    char *out = h->text + len + 1;
+    memcpy(out, text, fields_at - 1);
+    out[fields_at - 1] = '\0';
+    char *dot = strchr(out, '.');
+    *dot = '\0';
+    h->kind = out;
+    h->name = dot + 1;
+    out += fields_at;
+
+    for (size_t i = 0; i < lx->count; i++) {
+        memcpy(out, lx->tokens[i].text, lx->tokens[i].len + 1);
+        ison_lex_field_def(out, &h->fields[i], &h->hints[i]);
+        out += lx->tokens[i].len + 1;
+    }
+    h->field_count = lx->count;
+    return 1;
+}
+
+static const stream_header_t *decoder_header(stream_decoder_t *d, const char *text, size_t len, size_t fields_at) {
+    for (size_t i = 0; i < d->header_count; i++) {
+        stream_header_t *h = &d->headers[i];
+        if (h->text_len != len || memcmp(h->text, text, len) != 0) continue;
+        if (i > 0) {
+            stream_header_t hit = *h;
+            memmove(&d->headers[1], &d->headers[0], i * sizeof(stream_header_t));
+            d->headers[0] = hit;
+        }
+        return &d->headers[0];
+    }
+
+    stream_header_t fresh;
+    if (!header_parse(&fresh, &d->lexer, text, len, fields_at)) return NULL;
+    if (d->header_count == STREAM_HEADER_CACHE) {
+        header_free(&d->headers[STREAM_HEADER_CACHE - 1]);
+        d->header_count--;
+    }
+    memmove(&d->headers[1], &d->headers[0], d->header_count * sizeof(stream_header_t));
+    d->headers[0] = fresh;
+    d->header_count++;
+    return &d->headers[0];
+}
+
+/* Decode one line and hand it to the callback; lines that are not records are skipped */
+static ison_error_t decoder_line(stream_decoder_t *d, const char *line, size_t len) {
+    ison_lex_trim(&line, &len);
+    if (len == 0 || line[0] == '#') return ISON_OK;
+
+    const char *p1 = memchr(line, '|', len);
+    const char *p2 = p1 ? memchr(p1 + 1, '|', len - (size_t)(p1 + 1 - line)) : NULL;
+    if (!p2) return ISON_OK;
+    const char *dot = memchr(line, '.', (size_t)(p1 - line));
+    if (!dot) return ISON_OK;
+
+    const stream_header_t *h = decoder_header(d, line, (size_t)(p2 - line), (size_t)(p1 + 1 - line));
+    if (!h) return ISON_ERROR_MEMORY;
+    if (h->field_count > d->values_cap) {
+        ison_value_t *values = realloc(d->values, h->field_count * sizeof(ison_value_t));
+        if (!values) return ISON_ERROR_MEMORY;
+        d->values = values;
+        d->values_cap = h->field_count;
+    }
+    const char *data = p2 + 1;
+    if (!ison_lex_line(&d->lexer, data, len - (size_t)(data - line))) return ISON_ERROR_MEMORY;
+    for (size_t i = 0; i < h->field_count; i++) {
+        d->values[i] = i < d->lexer.count ? ison_lex_value(d->lexer.tokens[i].text, h->hints[i]) : ison_null();
+    }
+
+    isonl_record_t record;
+    record.kind = h->kind;
+    record.name = h->name;
+    record.fields = h->fields;
+    record.field_count = h->field_count;
+    record.values = d->values;
+    d->callback(&record, d->userdata);
+    return ISON_OK;
+}
+
+static ison_error_t stream_reader(ison_reader_t *r, isonl_callback_t callback, void *userdata) {
+    stream_decoder_t d;
+    memset(&d, 0, sizeof(d));
+    d.callback = callback;
+    d.userdata = userdata;
+    ison_error_t err = ISON_OK;
+    const char *line;
+    size_t len;
+    while (err == ISON_OK && ison_reader_next_line(r, &line, &len)) err = decoder_line(&d, line, len);
+    if (err == ISON_OK) err = r->error;
+    decoder_free(&d);
+    return err;
+}
+
+ison_error_t isonl_stream_buffer(const char *buffer, size_t len, isonl_callback_t callback, void *userdata) {
+    if (!callback) return ISON_ERROR_INVALID;
+    ison_reader_t r;
+    ison_error_t err = ison_reader_init_memory(&r, buffer, len);
+    if (err == ISON_OK) err = stream_reader(&r, callback, userdata);
+    ison_reader_free(&r);
+    return err;
+}
+
+ison_error_t isonl_stream_file(const char *path, isonl_callback_t callback, void *userdata) {
+    if (!path || !callback) return ISON_ERROR_INVALID;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return ISON_ERROR_IO;
+    ison_reader_t r;
+    ison_error_t err = ison_reader_init_fd(&r, fd, 0);
+    if (err == ISON_OK) err = stream_reader(&r, callback, userdata);
+    ison_reader_free(&r);
+    close(fd);
+    return err;
+}
+
+/* ==================== Following ==================== */
+
+isonl_follow_options_t isonl_default_follow_options(void) {
+    isonl_follow_options_t opts;
+    opts.poll_interval_ms = 100;
+    opts.idle_timeout_ms = 0;
+    opts.from_end = false;
+    opts.stop = NULL;
+    return opts;
+}
+
+typedef struct {
+    stream_decoder_t decoder;
+    const char *path;
+    int fd;
+    dev_t dev;
+    ino_t ino;
+    off_t offset;
+    char *buf;              /* bytes read but not yet decoded: at most one partial line */
+    size_t len;
+    size_t cap;
+    bool skip_partial;      /* drop bytes up to the first line break (joined mid-line) */
+#if defined(STREAM_HAVE_INOTIFY)
+    int notify_fd;
+    int file_watch;
+#endif
+} follower_t;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static bool follow_stopped(const isonl_follow_options_t *opts) {
+    return opts->stop && *opts->stop;
+}
+
+/* Decode the complete lines in the buffer; keep a trailing partial line for the next read */
+static ison_error_t follower_lines(follower_t *f, bool final) {
+    size_t pos = 0;
+    ison_error_t err = ISON_OK;
+    while (err == ISON_OK && pos < f->len) {
+        char *nl = memchr(f->buf + pos, '\n', f->len - pos);
+        if (!nl && !final) break;
+        size_t end = nl ? (size_t)(nl - f->buf) : f->len;
+        size_t line_len = end - pos;
+        if (f->skip_partial) {
+            if (!nl) break;
+            f->skip_partial = false;
+        } else {
+            if (line_len > 0 && f->buf[pos + line_len - 1] == '\r') line_len--;
+            err = decoder_line(&f->decoder, f->buf + pos, line_len);
+        }
+        pos = nl ? end + 1 : f->len;
+    }
+    memmove(f->buf, f->buf + pos, f->len - pos);
+    f->len -= pos;
+    return err;
+}
+
+/* Read to the current end of the file; *got says whether anything arrived */
+static ison_error_t follower_drain(follower_t *f, const isonl_follow_options_t *opts, bool *got) {
+    *got = false;
+    while (!follow_stopped(opts)) {
+        if (f->cap - f->len < ISON_READER_BUFFER_SIZE / 2) {
+            size_t cap = f->cap ? f->cap * 2 : ISON_READER_BUFFER_SIZE;
+            char *buf = realloc(f->buf, cap);
+            if (!buf) return ISON_ERROR_MEMORY;
+            f->buf = buf;
+            f->cap = cap;
+        }
+        ssize_t n = read(f->fd, f->buf + f->len, f->cap - f->len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return ISON_ERROR_IO;
+        }
+        if (n == 0) break;
+        *got = true;
+        f->len += (size_t)n;
+        f->offset += n;
+        ison_error_t err = follower_lines(f, false);
+        if (err != ISON_OK) return err;
+    }
+    return ISON_OK;
+}
+
+static void follower_watch(follower_t *f) {
+#if defined(STREAM_HAVE_INOTIFY)
+    if (f->notify_fd < 0) return;
+    if (f->file_watch >= 0) inotify_rm_watch(f->notify_fd, f->file_watch);
+    f->file_watch = inotify_add_watch(f->notify_fd, f->path, IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+#else
+    (void)f;
+#endif
+}
+
+static ison_error_t follower_open(follower_t *f) {
+    int fd = open(f->path, O_RDONLY);
+    if (fd < 0) return ISON_ERROR_IO;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return ISON_ERROR_IO;
+    }
+    if (f->fd >= 0) close(f->fd);
+    f->fd = fd;
+    f->dev = st.st_dev;
+    f->ino = st.st_ino;
+    f->offset = 0;
+    follower_watch(f);
+    return ISON_OK;
+}
+
+/* Sleep until the file may have changed: an inotify event, or the poll interval */
+static void follower_wait(follower_t *f, unsigned timeout_ms) {
+#if defined(STREAM_HAVE_INOTIFY)
+    if (f->notify_fd >= 0) {
+        struct pollfd pfd = {f->notify_fd, POLLIN, 0};
+        if (poll(&pfd, 1, (int)timeout_ms) > 0) {
+            char events[4096];
+            while (read(f->notify_fd, events, sizeof(events)) > 0) {}
+        }
+        return;
+    }
+#else
+    (void)f;
+#endif
+    struct timespec ts = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+/* After a quiet read: switch to a new file at the path, or rewind a truncated one */
+static ison_error_t follower_check(follower_t *f, const isonl_follow_options_t *opts, bool *got) {
+    struct stat st;
+    if (stat(f->path, &st) != 0) return ISON_OK;     /* rotated away, new file not there yet */
+    if (st.st_dev != f->dev || st.st_ino != f->ino) {
+        /* Finish the old file, including a last line without a line break */
+        ison_error_t err = follower_drain(f, opts, got);
+        if (err == ISON_OK) err = follower_lines(f, true);
+        if (err == ISON_OK) err = follower_open(f);
+        return err;
+    }
+    if (st.st_size < f->offset) {
+        if (lseek(f->fd, 0, SEEK_SET) < 0) return ISON_ERROR_IO;
+        f->offset = 0;
+        f->len = 0;
+        f->skip_partial = false;
+    }
+    return ISON_OK;
+}
+
+ison_error_t isonl_follow(const char *path, isonl_callback_t callback, void *userdata,
+                          const isonl_follow_options_t *options) {
+    if (!path || !callback) return ISON_ERROR_INVALID;
+    isonl_follow_options_t opts = options ? *options : isonl_default_follow_options();
+    if (opts.poll_interval_ms == 0) opts.poll_interval_ms = 100;
+
+    follower_t f;
+    memset(&f, 0, sizeof(f));
+    f.decoder.callback = callback;
+    f.decoder.userdata = userdata;
+    f.path = path;
+    f.fd = -1;
+#if defined(STREAM_HAVE_INOTIFY)
+    f.notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    f.file_watch = -1;
+    if (f.notify_fd >= 0) {
+        /* The directory watch catches a replacement file appearing at the path */
+        char dir[4096];
+        const char *slash = strrchr(path, '/');
+        size_t dir_len = !slash ? 1 : slash == path ? 1 : (size_t)(slash - path);
+        if (dir_len < sizeof(dir)) {
+            memcpy(dir, slash ? path : ".", dir_len);
+            dir[dir_len] = '\0';
+            inotify_add_watch(f.notify_fd, dir, IN_CREATE | IN_MOVED_TO);
+        }
+    }
+#endif
+
+    ison_error_t err = follower_open(&f);
+    if (err == ISON_OK && opts.from_end) {
+        off_t end = lseek(f.fd, 0, SEEK_END);
+        char last = '\n';
+        if (end < 0) {
+            err = ISON_ERROR_IO;
+        } else {
+            if (end > 0 && pread(f.fd, &last, 1, end - 1) != 1) err = ISON_ERROR_IO;
+            f.offset = end;
+            f.skip_partial = last != '\n';
+        }
+    }
+
+    double idle_since = now_ms();
+    while (err == ISON_OK && !follow_stopped(&opts)) {
+        bool got;
+        err = follower_drain(&f, &opts, &got);
+        if (err == ISON_OK && !got) err = follower_check(&f, &opts, &got);
+        if (err != ISON_OK || follow_stopped(&opts)) break;
+        if (got) {
+            idle_since = now_ms();
+            continue;
+        }
+
+        unsigned wait = opts.poll_interval_ms;
+        if (opts.idle_timeout_ms) {
+            double left = opts.idle_timeout_ms - (now_ms() - idle_since);
+            if (left <= 0) break;
+            if (left < wait) wait = (unsigned)left + 1;
+        }
+        follower_wait(&f, wait);
+    }
+
+    if (f.fd >= 0) close(f.fd);
+#if defined(STREAM_HAVE_INOTIFY)
+    if (f.notify_fd >= 0) close(f.notify_fd);
+#endif
+    free(f.buf);
+    decoder_free(&f.decoder);
+    return err;
+}
@@ -10,6 +10,7 @@ const char *ison_error_string(ison_error_t error) {
         case ISON_ERROR_PARSE: return "Parse error";
         case ISON_ERROR_IO: return "I/O error";
         case ISON_ERROR_INVALID: return "Invalid argument";
+        case ISON_ERROR_OVERFLOW: return "Buffer too small";
         default: return "Unknown error";
     }
 }
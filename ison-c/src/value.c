@@ -1,7 +1,10 @@
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "ison.h"
+#include "lex.h"
+#include "scan.h"
 
 static char *strdup_safe(const char *str) {
     if (!str) return NULL;
@@ -72,23 +75,41 @@ ison_value_t ison_ref(const ison_reference_t *ref) {
     return v;
 }
 
+ison_value_t ison_value_copy(const ison_value_t *value) {
+    if (!value) return ison_null();
+    ison_value_resolve(value);
+    switch (value->type) {
+        case ISON_TYPE_STRING:
+            if (!value->data.string_val) return *value;
+            return ison_string(value->data.string_val);
+        case ISON_TYPE_REFERENCE:
+            return ison_ref(&value->data.ref_val);
+        default:
+            return *value;
+    }
+}
+
 bool ison_value_is_null(const ison_value_t *value) {
+    ison_value_resolve(value);
     return value && value->type == ISON_TYPE_NULL;
 }
 
 bool ison_value_as_bool(const ison_value_t *value, bool *out) {
+    ison_value_resolve(value);
     if (!value || value->type != ISON_TYPE_BOOL) return false;
     if (out) *out = value->data.bool_val;
     return true;
 }
 
 bool ison_value_as_int(const ison_value_t *value, int64_t *out) {
+    ison_value_resolve(value);
     if (!value || value->type != ISON_TYPE_INT) return false;
     if (out) *out = value->data.int_val;
     return true;
 }
 
 bool ison_value_as_float(const ison_value_t *value, double *out) {
+    ison_value_resolve(value);
     if (!value) return false;
     if (value->type == ISON_TYPE_FLOAT) {
         if (out) *out = value->data.float_val;
@@ -102,135 +123,209 @@ bool ison_value_as_float(const ison_value_t *value, double *out) {
 }
 
 bool ison_value_as_string(const ison_value_t *value, const char **out) {
+    ison_value_resolve(value);
     if (!value || value->type != ISON_TYPE_STRING) return false;
     if (out) *out = value->data.string_val;
     return true;
 }
 
 bool ison_value_as_ref(const ison_value_t *value, ison_reference_t *out) {
+    ison_value_resolve(value);
     if (!value || value->type != ISON_TYPE_REFERENCE) return false;
     if (out) *out = value->data.ref_val;
     return true;
 }
 
-char *ison_value_to_ison(const ison_value_t *value) {
-    if (!value) return strdup_safe("~");
+static void append_reference(ison_writer_t *w, const ison_reference_t *ref) {
+    if (!ref->id) return;
+    ison_writer_putc(w, ':');
+    if (ref->relationship && *ref->relationship) {
+        ison_writer_puts(w, ref->relationship);
+        ison_writer_putc(w, ':');
+    } else if (ref->ns && *ref->ns) {
+        ison_writer_puts(w, ref->ns);
+        ison_writer_putc(w, ':');
+    }
+    ison_writer_puts(w, ref->id);
+}
+
+static void append_number(ison_writer_t *w, const ison_value_t *value) {
+    char buf[ISON_NUMBER_BUFFER_SIZE];
+    size_t n;
+    if (value->type == ISON_TYPE_INT) {
+        n = ison_format_int(value->data.int_val, buf);
+    } else {
+        n = ison_format_double(value->data.float_val, buf);
+    }
+    ison_writer_write(w, buf, n);
+}
+
+static void append_ison_string(ison_writer_t *w, const char *str) {
+    size_t len = strlen(str);
+    if (len > 0 && ison_scan_ison_quote(str, len) == len) {
+        ison_writer_write(w, str, len);
+        return;
+    }
+    
+    ison_writer_putc(w, '"');
+    size_t pos = 0;
+    while (pos < len) {
+        size_t run = ison_scan_ison_escape(str + pos, len - pos);
+        ison_writer_write(w, str + pos, run);
+        pos += run;
+        if (pos == len) break;
+        
+        const char *esc;
+        switch (str[pos]) {
+            case '\\': esc = "\\\\"; break;
+            case '"': esc = "\\\""; break;
+            case '\n': esc = "\\n"; break;
+            default: esc = "\\t"; break;
+        }
+        ison_writer_write(w, esc, 2);
+        pos++;
+    }
+    ison_writer_putc(w, '"');
+}
+
+static void append_json_string(ison_writer_t *w, const char *str) {
+    static const char hex[] = "0123456789abcdef";
+    size_t len = strlen(str);
+    
+    ison_writer_putc(w, '"');
+    size_t pos = 0;
+    while (pos < len) {
+        size_t run = ison_scan_json_escape(str + pos, len - pos);
+        ison_writer_write(w, str + pos, run);
+        pos += run;
+        if (pos == len) break;
+        
+        unsigned char ch = (unsigned char)str[pos++];
+        char esc[6];
+        size_t esc_len = 2;
+        esc[0] = '\\';
+        switch (ch) {
+            case '\\': esc[1] = '\\'; break;
+            case '"': esc[1] = '"'; break;
+            case '\n': esc[1] = 'n'; break;
+            case '\r': esc[1] = 'r'; break;
+            case '\t': esc[1] = 't'; break;
+            default:
+                esc[1] = 'u';
+                esc[2] = '0';
+                esc[3] = '0';
+                esc[4] = hex[ch >> 4];
+                esc[5] = hex[ch & 0xf];
+                esc_len = 6;
+        }
+        ison_writer_write(w, esc, esc_len);
+    }
+    ison_writer_putc(w, '"');
+}
+
+void ison_value_append(ison_writer_t *w, const ison_value_t *value) {
+    if (!w) return;
+    if (!value) {
+        ison_writer_putc(w, '~');
+        return;
+    }
+    ison_value_resolve(value);
     
-    char buf[256];
     switch (value->type) {
-        case ISON_TYPE_NULL:
-            return strdup_safe("~");
         case ISON_TYPE_BOOL:
-            return strdup_safe(value->data.bool_val ? "true" : "false");
+            if (value->data.bool_val) ison_writer_write(w, "true", 4);
+            else ison_writer_write(w, "false", 5);
+            break;
         case ISON_TYPE_INT:
-            snprintf(buf, sizeof(buf), "%ld", (long)value->data.int_val);
-            return strdup_safe(buf);
         case ISON_TYPE_FLOAT:
-            snprintf(buf, sizeof(buf), "%g", value->data.float_val);
-            return strdup_safe(buf);
-        case ISON_TYPE_STRING: {
-            const char *str = value->data.string_val;
-            if (!str) return strdup_safe("~");
-            int needs_quotes = !*str || strchr(str, ' ') || strchr(str, '\t') || 
-                              strchr(str, '\n') || strchr(str, '"');
-            if (!needs_quotes) return strdup_safe(str);
-            
-            size_t len = strlen(str);
-            size_t extra = 2;
-            for (size_t i = 0; i < len; i++) {
-                if (str[i] == '\\' || str[i] == '"' || str[i] == '\n' || str[i] == '\t') extra++;
-            }
-            char *result = malloc(len + extra + 1);
-            if (!result) return NULL;
-            
-            char *p = result;
-            *p++ = '"';
-            for (size_t i = 0; i < len; i++) {
-                switch (str[i]) {
-                    case '\\': *p++ = '\\'; *p++ = '\\'; break;
-                    case '"': *p++ = '\\'; *p++ = '"'; break;
-                    case '\n': *p++ = '\\'; *p++ = 'n'; break;
-                    case '\t': *p++ = '\\'; *p++ = 't'; break;
-                    default: *p++ = str[i];
-                }
-            }
-            *p++ = '"';
-            *p = '\0';
-            return result;
-        }
+            append_number(w, value);
+            break;
+        case ISON_TYPE_STRING:
+            if (value->data.string_val) append_ison_string(w, value->data.string_val);
+            else ison_writer_putc(w, '~');
+            break;
         case ISON_TYPE_REFERENCE:
-            return ison_reference_to_ison(&value->data.ref_val);
+            append_reference(w, &value->data.ref_val);
+            break;
         default:
-            return strdup_safe("~");
+            ison_writer_putc(w, '~');
     }
 }
 
-char *ison_value_to_json(const ison_value_t *value) {
-    if (!value) return strdup_safe("null");
+void ison_value_append_json(ison_writer_t *w, const ison_value_t *value) {
+    if (!w) return;
+    if (!value) {
+        ison_writer_write(w, "null", 4);
+        return;
+    }
+    ison_value_resolve(value);
     
-    char buf[256];
     switch (value->type) {
-        case ISON_TYPE_NULL:
-            return strdup_safe("null");
         case ISON_TYPE_BOOL:
-            return strdup_safe(value->data.bool_val ? "true" : "false");
+            if (value->data.bool_val) ison_writer_write(w, "true", 4);
+            else ison_writer_write(w, "false", 5);
+            break;
         case ISON_TYPE_INT:
-            snprintf(buf, sizeof(buf), "%ld", (long)value->data.int_val);
-            return strdup_safe(buf);
+            append_number(w, value);
+            break;
         case ISON_TYPE_FLOAT:
-            snprintf(buf, sizeof(buf), "%g", value->data.float_val);
-            return strdup_safe(buf);
-        case ISON_TYPE_STRING: {
-            const char *str = value->data.string_val;
-            if (!str) return strdup_safe("null");
-            size_t len = strlen(str);
-            size_t extra = 2;
-            for (size_t i = 0; i < len; i++) {
-                if (str[i] == '\\' || str[i] == '"' || str[i] < 0x20) extra++;
-            }
-            char *result = malloc(len + extra + 1);
-            if (!result) return NULL;
-            
-            char *p = result;
-            *p++ = '"';
-            for (size_t i = 0; i < len; i++) {
-                switch (str[i]) {
-                    case '\\': *p++ = '\\'; *p++ = '\\'; break;
-                    case '"': *p++ = '\\'; *p++ = '"'; break;
-                    case '\n': *p++ = '\\'; *p++ = 'n'; break;
-                    case '\r': *p++ = '\\'; *p++ = 'r'; break;
-                    case '\t': *p++ = '\\'; *p++ = 't'; break;
-                    default:
-                        if (str[i] < 0x20) {
-                            sprintf(p, "\\u%04x", (unsigned char)str[i]);
-                            p += 6;
-                        } else {
-                            *p++ = str[i];
-                        }
-                }
-            }
-            *p++ = '"';
-            *p = '\0';
-            return result;
-        }
-        case ISON_TYPE_REFERENCE: {
-            char *ref_ison = ison_reference_to_ison(&value->data.ref_val);
-            size_t len = strlen(ref_ison);
-            char *result = malloc(len + 3);
-            if (result) {
-                result[0] = '"';
-                memcpy(result + 1, ref_ison, len);
-                result[len + 1] = '"';
-                result[len + 2] = '\0';
-            }
-            free(ref_ison);
-            return result;
-        }
+            /* JSON has no spelling for nan/inf */
+            if (isfinite(value->data.float_val)) append_number(w, value);
+            else ison_writer_write(w, "null", 4);
+            break;
+        case ISON_TYPE_STRING:
+            if (value->data.string_val) append_json_string(w, value->data.string_val);
+            else ison_writer_write(w, "null", 4);
+            break;
+        case ISON_TYPE_REFERENCE:
+            ison_writer_putc(w, '"');
+            append_reference(w, &value->data.ref_val);
+            ison_writer_putc(w, '"');
+            break;
         default:
-            return strdup_safe("null");
+            ison_writer_write(w, "null", 4);
     }
 }
 
+static size_t write_into(void (*append)(ison_writer_t *, const ison_value_t *),
+                         const ison_value_t *value, char *buf, size_t cap) {
+    ison_writer_t w;
+    ison_writer_init_buffer(&w, buf, cap ? cap - 1 : 0);
+    append(&w, value);
+    if (cap > 0) buf[w.len] = '\0';
+    return w.total;
+}
+
+size_t ison_value_write_ison(const ison_value_t *value, char *buf, size_t cap) {
+    return write_into(ison_value_append, value, buf, cap);
+}
+
+size_t ison_value_write_json(const ison_value_t *value, char *buf, size_t cap) {
+    return write_into(ison_value_append_json, value, buf, cap);
+}
+
+static char *format_value(void (*append)(ison_writer_t *, const ison_value_t *),
+                          const ison_value_t *value) {
+    char buf[128];
+    size_t len = write_into(append, value, buf, sizeof(buf));
+    char *result = malloc(len + 1);
+    if (!result) return NULL;
+    if (len < sizeof(buf)) {
+        memcpy(result, buf, len + 1);
+    } else {
+        write_into(append, value, result, len + 1);
+    }
+    return result;
+}
+
+char *ison_value_to_ison(const ison_value_t *value) {
+    return format_value(ison_value_append, value);
+}
+
+char *ison_value_to_json(const ison_value_t *value) {
+    return format_value(ison_value_append_json, value);
+}
+
 void ison_value_free(ison_value_t *value) {
     if (!value) return;
     switch (value->type) {
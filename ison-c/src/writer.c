@@ -0,0 +1,205 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ison.h"
+
+static ison_error_t fd_sink(void *userdata, const char *data, size_t len) {
+    int fd = (int)(intptr_t)userdata;
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return ISON_ERROR_IO;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return ISON_OK;
+}
+
+static ison_error_t file_sink(void *userdata, const char *data, size_t len) {
+    FILE *f = userdata;
+    if (fwrite(data, 1, len, f) != len) return ISON_ERROR_IO;
+    return ISON_OK;
+}
+
+ison_error_t ison_writer_init_memory(ison_writer_t *w, size_t initial_cap) {
+    if (!w) return ISON_ERROR_INVALID;
+    memset(w, 0, sizeof(*w));
+    w->cap = initial_cap ? initial_cap : 1024;
+    w->buf = malloc(w->cap);
+    if (!w->buf) {
+        w->cap = 0;
+        w->error = ISON_ERROR_MEMORY;
+    }
+    return w->error;
+}
+
+ison_error_t ison_writer_init_sink(ison_writer_t *w, ison_sink_t sink, void *userdata, size_t buffer_size) {
+    if (!w) return ISON_ERROR_INVALID;
+    memset(w, 0, sizeof(*w));
+    if (!sink) {
+        w->error = ISON_ERROR_INVALID;
+        return w->error;
+    }
+    w->sink = sink;
+    w->userdata = userdata;
+    w->cap = buffer_size ? buffer_size : ISON_WRITER_BUFFER_SIZE;
+    w->buf = malloc(w->cap);
+    if (!w->buf) {
+        w->cap = 0;
+        w->error = ISON_ERROR_MEMORY;
+    }
+    return w->error;
+}
+
+ison_error_t ison_writer_init_fd(ison_writer_t *w, int fd, size_t buffer_size) {
+    if (fd < 0) {
+        if (w) memset(w, 0, sizeof(*w));
+        if (w) w->error = ISON_ERROR_INVALID;
+        return ISON_ERROR_INVALID;
+    }
+    return ison_writer_init_sink(w, fd_sink, (void *)(intptr_t)fd, buffer_size);
+}
+
+ison_error_t ison_writer_init_file(ison_writer_t *w, FILE *file, size_t buffer_size) {
+    if (!file) {
+        if (w) memset(w, 0, sizeof(*w));
+        if (w) w->error = ISON_ERROR_INVALID;
+        return ISON_ERROR_INVALID;
+    }
+    return ison_writer_init_sink(w, file_sink, file, buffer_size);
+}
+
+ison_error_t ison_writer_init_buffer(ison_writer_t *w, char *buf, size_t cap) {
+    if (!w) return ISON_ERROR_INVALID;
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->cap = buf ? cap : 0;
+    w->fixed = true;
+    return ISON_OK;
+}
+
+static void fixed_write(ison_writer_t *w, const char *data, size_t len) {
+    size_t room = w->cap - w->len;
+    if (len > room) len = room;
+    if (len > 0) {
+        memcpy(w->buf + w->len, data, len);
+        w->len += len;
+    }
+}
+
+static int writer_grow(ison_writer_t *w, size_t need) {
+    size_t new_cap = w->cap ? w->cap : 1024;
+    while (new_cap < need) {
+        if (new_cap > SIZE_MAX / 2) {
+            new_cap = need;
+            break;
+        }
+        new_cap *= 2;
+    }
+    char *new_buf = realloc(w->buf, new_cap);
+    if (!new_buf) {
+        w->error = ISON_ERROR_MEMORY;
+        return 0;
+    }
+    w->buf = new_buf;
+    w->cap = new_cap;
+    return 1;
+}
+
+static void writer_drain(ison_writer_t *w) {
+    if (w->len == 0) return;
+    ison_error_t err = w->sink(w->userdata, w->buf, w->len);
+    if (err != ISON_OK) w->error = err;
+    w->len = 0;
+}
+
+void ison_writer_write(ison_writer_t *w, const char *data, size_t len) {
+    if (!w || len == 0) return;
+    if (w->error != ISON_OK) return;
+    w->total += len;
+    if (w->fixed) {
+        fixed_write(w, data, len);
+        return;
+    }
+
+    if (w->len + len <= w->cap) {
+        memcpy(w->buf + w->len, data, len);
+        w->len += len;
+        return;
+    }
+
+    if (!w->sink) {
+        /* Keep one spare byte so ison_writer_finish can terminate in place */
+        if (!writer_grow(w, w->len + len + 1)) return;
+        memcpy(w->buf + w->len, data, len);
+        w->len += len;
+        return;
+    }
+
+    size_t room = w->cap - w->len;
+    memcpy(w->buf + w->len, data, room);
+    w->len += room;
+    data += room;
+    len -= room;
+    writer_drain(w);
+    if (w->error != ISON_OK) return;
+
+    if (len >= w->cap) {
+        ison_error_t err = w->sink(w->userdata, data, len);
+        if (err != ISON_OK) w->error = err;
+        return;
+    }
+    memcpy(w->buf, data, len);
+    w->len = len;
+}
+
+void ison_writer_puts(ison_writer_t *w, const char *str) {
+    if (!str) return;
+    ison_writer_write(w, str, strlen(str));
+}
+
+void ison_writer_putc(ison_writer_t *w, char ch) {
+    if (!w || w->error != ISON_OK) return;
+    if (w->len < w->cap) {
+        w->buf[w->len++] = ch;
+        w->total++;
+        return;
+    }
+    ison_writer_write(w, &ch, 1);
+}
+
+ison_error_t ison_writer_flush(ison_writer_t *w) {
+    if (!w) return ISON_ERROR_INVALID;
+    if (w->error == ISON_OK && w->sink) writer_drain(w);
+    return w->error;
+}
+
+char *ison_writer_finish(ison_writer_t *w, size_t *out_len) {
+    if (!w || w->sink || w->fixed) return NULL;
+    if (w->error == ISON_OK && w->len + 1 > w->cap) writer_grow(w, w->len + 1);
+    if (w->error != ISON_OK) {
+        ison_writer_free(w);
+        return NULL;
+    }
+    char *result = w->buf;
+    result[w->len] = '\0';
+    if (out_len) *out_len = w->len;
+    w->buf = NULL;
+    w->len = 0;
+    w->cap = 0;
+    return result;
+}
+
+void ison_writer_free(ison_writer_t *w) {
+    if (!w) return;
+    if (!w->fixed) free(w->buf);
+    w->buf = NULL;
+    w->len = 0;
+    w->cap = 0;
+}
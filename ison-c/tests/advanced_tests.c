@@ -2,8 +2,175 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 #include "ison.h"
 
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* Straightforward reference escapers for checking the vectorized ones */
+static size_t reference_ison(const char *str, char *out) {
+    char *p = out;
+    int quote = !*str || strpbrk(str, " \t\n\"") != NULL;
+    if (!quote) {
+        strcpy(out, str);
+        return strlen(out);
+    }
+    *p++ = '"';
+    for (; *str; str++) {
+        if (*str == '\\' || *str == '"') { *p++ = '\\'; *p++ = *str; }
+        else if (*str == '\n') { *p++ = '\\'; *p++ = 'n'; }
+        else if (*str == '\t') { *p++ = '\\'; *p++ = 't'; }
+        else *p++ = *str;
+    }
+    *p++ = '"';
+    *p = '\0';
+    return (size_t)(p - out);
+}
+
+static size_t reference_json(const char *str, char *out) {
+    char *p = out;
+    *p++ = '"';
+    for (; *str; str++) {
+        unsigned char ch = (unsigned char)*str;
+        if (ch == '\\' || ch == '"') { *p++ = '\\'; *p++ = (char)ch; }
+        else if (ch == '\n') { *p++ = '\\'; *p++ = 'n'; }
+        else if (ch == '\r') { *p++ = '\\'; *p++ = 'r'; }
+        else if (ch == '\t') { *p++ = '\\'; *p++ = 't'; }
+        else if (ch < 0x20) p += sprintf(p, "\\u%04x", ch);
+        else *p++ = (char)ch;
+    }
+    *p++ = '"';
+    *p = '\0';
+    return (size_t)(p - out);
+}
+
+typedef struct {
+    char data[4096];
+    size_t len;
+    size_t calls;
+} sink_buffer_t;
+
+static ison_error_t collect_sink(void *userdata, const char *data, size_t len) {
+    sink_buffer_t *sb = userdata;
+    assert(sb->len + len < sizeof(sb->data));
+    memcpy(sb->data + sb->len, data, len);
+    sb->len += len;
+    sb->calls++;
+    return ISON_OK;
+}
+
+typedef struct {
+    const char *data;
+    size_t len;
+    size_t pos;
+    size_t chunk;
+} chunk_source_t;
+
+static ison_error_t chunk_source(void *userdata, char *buf, size_t cap, size_t *out_len) {
+    chunk_source_t *src = userdata;
+    size_t n = src->len - src->pos;
+    if (n > src->chunk) n = src->chunk;
+    if (n > cap) n = cap;
+    memcpy(buf, src->data + src->pos, n);
+    src->pos += n;
+    *out_len = n;
+    return ISON_OK;
+}
+
+typedef struct {
+    size_t records;
+    size_t users;
+    size_t max_fields;
+    int64_t id_sum;
+} ndjson_tally_t;
+
+static void tally_record(const isonl_record_t *record, void *userdata) {
+    ndjson_tally_t *tally = userdata;
+    tally->records++;
+    if (strcmp(record->name, "user") == 0) {
+        tally->users++;
+        return;
+    }
+    if (record->field_count > tally->max_fields) tally->max_fields = record->field_count;
+    for (size_t i = 0; i < record->field_count; i++) {
+        int64_t id;
+        if (strcmp(record->fields[i], "id") == 0 && ison_value_as_int(&record->values[i], &id)) tally->id_sum += id;
+    }
+}
+
+/* Release callbacks for caller-built Arrow structs over static buffers */
+static int arrow_releases = 0;
+
+static void release_static_array(struct ArrowArray *array) {
+    arrow_releases++;
+    array->release = NULL;
+}
+
+static void release_static_schema(struct ArrowSchema *schema) {
+    arrow_releases++;
+    schema->release = NULL;
+}
+
+/* One producer thread for the appender test */
+typedef struct {
+    isonl_appender_t *app;
+    int64_t thread_id;
+    int64_t count;
+} appender_job_t;
+
+static void *append_events(void *arg) {
+    appender_job_t *job = arg;
+    char *fields[] = {"thread:int", "seq:int", "note"};
+    char *kinds[] = {"table", "table"};
+    char *names[] = {"events", "audit"};
+    for (int64_t i = 0; i < job->count; i++) {
+        ison_value_t values[3] = {ison_int(job->thread_id), ison_int(i), ison_string("x y")};
+        isonl_record_t rec = {kinds[i % 2], names[i % 2], fields, i % 2 ? 2 : 3, values};
+        assert(isonl_append(job->app, &rec) == ISON_OK);
+        ison_value_free(&values[2]);
+    }
+    return NULL;
+}
+
+/* Follow test: collects records, and grows then rotates the log once the follower is reading */
+typedef struct {
+    const char *path;
+    int64_t ids[16];
+    int count;
+    volatile int stop;
+    pthread_t writer;
+} follow_state_t;
+
+static void *grow_and_rotate(void *arg) {
+    follow_state_t *st = arg;
+    FILE *f = fopen(st->path, "a");
+    fputs("c\ntable.t|id:int name|4 d\n", f);
+    fclose(f);
+    char rotated[256];
+    snprintf(rotated, sizeof(rotated), "%s.1", st->path);
+    rename(st->path, rotated);
+    f = fopen(st->path, "w");
+    fputs("table.u|id:int|5\n", f);
+    fclose(f);
+    return NULL;
+}
+
+static void follow_record(const isonl_record_t *record, void *userdata) {
+    follow_state_t *st = userdata;
+    int64_t id;
+    assert(strcmp(record->fields[0], "id") == 0 && ison_value_as_int(&record->values[0], &id));
+    st->ids[st->count++] = id;
+    if (st->count == 1) assert(pthread_create(&st->writer, NULL, grow_and_rotate, st) == 0);
+    if (st->count == 5) st->stop = 1;
+}
+
 int main(void) {
     printf("Test: ISON Parse Simple Table... ");
     fflush(stdout);
@@ -62,6 +229,7 @@ int main(void) {
     val = ison_string("Alice");
     ison_row_set(row, "name", &val);
     ison_block_add_row(block, row);
+    ison_row_free(row);
     
     ison_document_add_block(doc, block);
     
@@ -74,6 +242,30 @@ int main(void) {
     ison_document_free(doc);
     printf("PASS\n");
     
+    // Test: Block Add Row And Set Summary Copy Their Row
+    printf("Test: Block Add Row And Set Summary Copy Their Row... ");
+    fflush(stdout);
+    {
+        ison_block_t *owned = ison_block_create("table", "owned");
+        ison_row_t *src = ison_row_create();
+        ison_value_t v = ison_string("kept");
+        ison_row_set(src, "name", &v);
+        ison_reference_t owner = ison_reference_make("7", "user", NULL);
+        v = ison_ref(&owner);
+        ison_reference_free(&owner);
+        ison_row_set(src, "owner", &v);
+        ison_block_add_row(owned, src);
+        ison_block_set_summary(owned, src);
+        ison_row_free(src);
+
+        const char *name;
+        ison_reference_t ref;
+        assert(ison_value_as_string(ison_row_get_ptr(owned->rows[0], "name"), &name) && strcmp(name, "kept") == 0);
+        assert(ison_value_as_ref(ison_row_get_ptr(owned->summary_row, "owner"), &ref) && strcmp(ref.id, "7") == 0);
+        ison_block_free(owned);
+    }
+    printf("PASS\n");
+    
     printf("Test: ISONL Parse... ");
     fflush(stdout);
     
@@ -140,6 +332,1723 @@ int main(void) {
     ison_document_free(doc);
     printf("PASS\n");
     
+    printf("Test: Streaming Writer... ");
+    fflush(stdout);
+    
+    const char *stream_input = 
+        "table.users\n"
+        "id:int name:string\n"
+        "1 Alice\n"
+        "2 \"Bob Smith\"\n"
+        "---\n"
+        "3 total\n"
+        "\n"
+        "object.config\n"
+        "debug timeout\n"
+        "true 30\n";
+    
+    doc = ison_parse(stream_input, &err);
+    assert(doc != NULL);
+    
+    char *expected = ison_dumps(doc);
+    sink_buffer_t sb = {{0}, 0, 0};
+    ison_writer_t w;
+    assert(ison_writer_init_sink(&w, collect_sink, &sb, 16) == ISON_OK);
+    assert(ison_dump_writer(doc, &w, NULL) == ISON_OK);
+    assert(ison_writer_flush(&w) == ISON_OK);
+    ison_writer_free(&w);
+    assert(sb.calls > 1);
+    assert(sb.len == strlen(expected));
+    assert(memcmp(sb.data, expected, sb.len) == 0);
+    free(expected);
+    
+    char *isonl = ison_dumps_isonl(doc);
+    assert(strncmp(isonl, "table.users|id:int name:string|1 Alice\n", 39) == 0);
+    assert(strstr(isonl, "object.config|debug timeout|true 30") != NULL);
+    
+    const char *tmp_path = "bin/writer_test.isonl";
+    assert(ison_dump_isonl(doc, tmp_path) == ISON_OK);
+    char *on_disk = ison_read_file(tmp_path, NULL);
+    assert(on_disk != NULL);
+    assert(strcmp(on_disk, isonl) == 0);
+    free(on_disk);
+    free(isonl);
+    remove(tmp_path);
+    
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: In-place Value Formatting... ");
+    fflush(stdout);
+    
+    char small[8];
+    val = ison_string("say \"hi\"\tnow");
+    size_t needed = ison_value_write_ison(&val, small, sizeof(small));
+    assert(needed == strlen("\"say \\\"hi\\\"\\tnow\""));
+    assert(strlen(small) == sizeof(small) - 1);
+    assert(strncmp(small, "\"say \\\"h", 7) == 0);
+    
+    char big[64];
+    assert(ison_value_write_ison(&val, big, sizeof(big)) == needed);
+    char *heap = ison_value_to_ison(&val);
+    assert(strcmp(big, heap) == 0);
+    free(heap);
+    ison_value_free(&val);
+    
+    val = ison_string("caf\xc3\xa9\x01");
+    assert(ison_value_write_json(&val, big, sizeof(big)) == 13);
+    assert(strcmp(big, "\"caf\xc3\xa9\\u0001\"") == 0);
+    ison_value_free(&val);
+    
+    ison_reference_t wref = ison_reference_make("42", "user", NULL);
+    val = ison_ref(&wref);
+    ison_reference_free(&wref);
+    assert(ison_value_write_ison(&val, big, sizeof(big)) == 8);
+    assert(strcmp(big, ":user:42") == 0);
+    ison_value_free(&val);
+    printf("PASS\n");
+    
+    printf("Test: Number Formatting Round-trip... ");
+    fflush(stdout);
+    
+    char num[ISON_NUMBER_BUFFER_SIZE];
+    size_t n = ison_format_int(INT64_MIN, num);
+    num[n] = '\0';
+    assert(strcmp(num, "-9223372036854775808") == 0);
+    n = ison_format_int(1234567, num);
+    num[n] = '\0';
+    assert(strcmp(num, "1234567") == 0);
+    
+    n = ison_format_double(0.1, num);
+    num[n] = '\0';
+    assert(strcmp(num, "0.1") == 0);
+    n = ison_format_double(2.0, num);
+    num[n] = '\0';
+    assert(strcmp(num, "2.0") == 0);
+    n = ison_format_double(1e300, num);
+    num[n] = '\0';
+    assert(strcmp(num, "1e300") == 0);
+    
+    for (int i = 0; i < 200000; i++) {
+        uint64_t bits = next_random();
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        if (d != d || d - d != 0.0) continue;
+        
+        n = ison_format_double(d, num);
+        assert(n < sizeof(num));
+        num[n] = '\0';
+        double back = strtod(num, NULL);
+        assert(memcmp(&back, &d, sizeof(d)) == 0);
+        
+        int64_t iv = (int64_t)next_random();
+        n = ison_format_int(iv, num);
+        num[n] = '\0';
+        assert(strtoll(num, NULL, 10) == iv);
+    }
+    
+    doc = ison_document_create();
+    block = ison_block_create("table", "metrics");
+    ison_block_add_field(block, "v", "float");
+    row = ison_row_create();
+    val = ison_float(0.30000000000000004);
+    ison_row_set(row, "v", &val);
+    ison_block_add_row(block, row);
+    ison_row_free(row);
+    ison_document_add_block(doc, block);
+    output = ison_dumps(doc);
+    ison_document_free(doc);
+    doc = ison_parse(output, &err);
+    free(output);
+    double parsed = 0;
+    assert(ison_value_as_float(ison_row_get_ptr(ison_document_get(doc, "metrics")->rows[0], "v"), &parsed));
+    assert(parsed == 0.30000000000000004);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Exact-size Dumps... ");
+    fflush(stdout);
+    
+    doc = ison_parse(stream_input, &err);
+    expected = ison_dumps(doc);
+    char *exact = ison_dumps_exact(doc);
+    assert(strcmp(exact, expected) == 0);
+    
+    size_t exact_len = strlen(expected);
+    char into[256];
+    needed = 0;
+    assert(ison_dumps_into(doc, into, 10, &needed) == ISON_ERROR_OVERFLOW);
+    assert(needed == exact_len);
+    assert(strlen(into) == 9);
+    assert(ison_dumps_into(doc, into, exact_len, &needed) == ISON_ERROR_OVERFLOW);
+    assert(ison_dumps_into(doc, into, exact_len + 1, &needed) == ISON_OK);
+    assert(strcmp(into, expected) == 0);
+    assert(ison_dumps_into(doc, NULL, 0, &needed) == ISON_ERROR_OVERFLOW);
+    assert(needed == exact_len);
+    
+    free(exact);
+    free(expected);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Aligned Columns... ");
+    fflush(stdout);
+    
+    doc = ison_parse(
+        "table.people\n"
+        "id:int name note\n"
+        "1 \"Ann Lee\" hi\n"
+        "22 Jos\xc3\xa9 ok\n"
+        "---\n"
+        "23 ~ total\n", &err);
+    ison_dumps_options_t opts = ison_default_dumps_options();
+    opts.align_columns = true;
+    output = ison_dumps_with_options(doc, &opts);
+    assert(strcmp(output,
+        "table.people\n"
+        "id:int name      note\n"
+        "1      \"Ann Lee\" hi\n"
+        "22     Jos\xc3\xa9      ok\n"
+        "---\n"
+        "23     ~         total\n") == 0);
+    
+    ison_document_t *reparsed = ison_parse(output, &err);
+    char *plain = ison_dumps(doc);
+    char *plain_again = ison_dumps(reparsed);
+    assert(strcmp(plain, plain_again) == 0);
+    free(plain);
+    free(plain_again);
+    free(output);
+    ison_document_free(reparsed);
+    ison_document_free(doc);
+    
+    doc = ison_parse(
+        "table.mix\n"
+        "n f b r s last\n"
+        "-1234 2.5 true :user:7 \"a\\\"b\" x\n"
+        "7 -0.125 false :MEMBER_OF:42 \"tab\\there\" y\n"
+        "-9223372036854775808 1e+30 ~ :\xc3\xa9t\xc3\xa9 \"\" z\n", &err);
+    output = ison_dumps_with_options(doc, &opts);
+    assert(strcmp(output,
+        "table.mix\n"
+        "n                    f      b     r             s           last\n"
+        "-1234                2.5    true  :user:7       \"a\\\"b\"      x\n"
+        "7                    -0.125 false :MEMBER_OF:42 \"tab\\there\" y\n"
+        "-9223372036854775808 1e30   ~     :\xc3\xa9t\xc3\xa9          \"\"          z\n") == 0);
+    free(output);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Wide ISONL Headers... ");
+    fflush(stdout);
+    
+    doc = ison_document_create();
+    block = ison_block_create("table", "wide");
+    char fname[64];
+    for (int c = 0; c < 48; c++) {
+        snprintf(fname, sizeof(fname), "a_rather_long_column_name_%02d", c);
+        ison_block_add_field(block, fname, "int");
+    }
+    for (int r = 0; r < 3; r++) {
+        row = ison_row_create();
+        for (int c = 47; c >= 0; c--) {
+            snprintf(fname, sizeof(fname), "a_rather_long_column_name_%02d", c);
+            val = ison_int(r * 100 + c);
+            ison_row_set(row, fname, &val);
+        }
+        ison_block_add_row(block, row);
+        ison_row_free(row);
+    }
+    ison_document_add_block(doc, block);
+    
+    isonl = ison_dumps_isonl(doc);
+    assert(strstr(isonl, "a_rather_long_column_name_47:int|0 1 2 ") != NULL);
+    reparsed = ison_parse_isonl(isonl, &err);
+    ison_block_t *wide = ison_document_get(reparsed, "wide");
+    assert(wide->field_count == 48);
+    assert(wide->row_count == 3);
+    int64_t cell = 0;
+    assert(ison_value_as_int(ison_row_get_ptr(wide->rows[2], "a_rather_long_column_name_47"), &cell));
+    assert(cell == 247);
+    free(isonl);
+    ison_document_free(reparsed);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Parallel Dumps... ");
+    fflush(stdout);
+    
+    doc = ison_parse(stream_input, &err);
+    block = ison_document_get(doc, "users");
+    for (int r = 0; r < 20000; r++) {
+        row = ison_row_create();
+        val = ison_int(r);
+        ison_row_set(row, "id", &val);
+        val = ison_string(r % 7 ? "x" : "a longer name");
+        ison_row_set(row, "name", &val);
+        ison_block_add_row(block, row);
+        ison_row_free(row);
+    }
+    ison_document_add_block(doc, ison_block_create("table", "empty"));
+    
+    for (int threads = 1; threads <= 4; threads += 3) {
+        expected = ison_dumps(doc);
+        output = ison_dumps_parallel(doc, NULL, threads);
+        assert(strcmp(output, expected) == 0);
+        free(output);
+        free(expected);
+        
+        expected = ison_dumps_with_options(doc, &opts);
+        output = ison_dumps_parallel(doc, &opts, threads);
+        assert(strcmp(output, expected) == 0);
+        free(output);
+        free(expected);
+        
+        expected = ison_dumps_isonl(doc);
+        output = ison_dumps_isonl_parallel(doc, threads);
+        assert(strcmp(output, expected) == 0);
+        free(output);
+        free(expected);
+    }
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Vectored fd Dump... ");
+    fflush(stdout);
+    
+    doc = ison_parse(stream_input, &err);
+    block = ison_document_get(doc, "users");
+    for (int r = 0; r < 150000; r++) {
+        row = ison_row_create();
+        val = ison_int(r);
+        ison_row_set(row, "id", &val);
+        val = ison_string("name");
+        ison_row_set(row, "name", &val);
+        ison_block_add_row(block, row);
+        ison_row_free(row);
+    }
+    
+    const char *fd_path = "bin/writev_test.ison";
+    FILE *fp = fopen(fd_path, "wb");
+    assert(fp != NULL);
+    assert(ison_dump_fd(doc, fileno(fp), &opts) == ISON_OK);
+    fclose(fp);
+    expected = ison_dumps_with_options(doc, &opts);
+    on_disk = ison_read_file(fd_path, NULL);
+    assert(strcmp(on_disk, expected) == 0);
+    free(on_disk);
+    free(expected);
+    
+    assert(ison_dump(doc, fd_path) == ISON_OK);
+    expected = ison_dumps(doc);
+    on_disk = ison_read_file(fd_path, NULL);
+    assert(strcmp(on_disk, expected) == 0);
+    free(on_disk);
+    free(expected);
+    remove(fd_path);
+    
+    assert(ison_dump_fd(doc, -1, NULL) == ISON_ERROR_INVALID);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Vectorized String Escaping... ");
+    fflush(stdout);
+    
+    static const char alphabet[] = "abcXYZ019 \t\n\"\\\x01\x1f\x7f\x80\xc3\xa9";
+    char text[200], got[1400], want[1400];
+    for (int i = 0; i < 20000; i++) {
+        size_t tlen = next_random() % (sizeof(text) - 1);
+        int rare = (int)(next_random() % 4);
+        for (size_t c = 0; c < tlen; c++) {
+            uint64_t pick = next_random();
+            /* Mostly clean runs with the occasional special byte */
+            text[c] = (pick % 64 < (uint64_t)(rare * 4)) ? alphabet[(pick >> 8) % (sizeof(alphabet) - 1)]
+                                                         : (char)('a' + (pick >> 16) % 26);
+        }
+        text[tlen] = '\0';
+        
+        val = ison_string(text);
+        size_t want_len = reference_ison(text, want);
+        assert(ison_value_write_ison(&val, got, sizeof(got)) == want_len);
+        assert(strcmp(got, want) == 0);
+        want_len = reference_json(text, want);
+        assert(ison_value_write_json(&val, got, sizeof(got)) == want_len);
+        assert(strcmp(got, want) == 0);
+        ison_value_free(&val);
+    }
+    printf("PASS\n");
+    
+    printf("Test: Streaming ISON to JSON... ");
+    fflush(stdout);
+    
+    const char *ledger =
+        "# ledger\n"
+        "table.orders\n"
+        "id:int total:float paid:bool customer:ref note\n"
+        "1 10.5 true :customer:7 \"first \\\"order\\\"\"\n"
+        "2 3 false :customer:9 \"\"\n"
+        "# interleaved comment\n"
+        "3 4.25 true null caf\xc3\xa9\r\n"
+        "---\n"
+        "null 17.75 null null \"sum\"\n"
+        "object.config\n"
+        "\n"
+        "debug retries\n"
+        "false 3\n"
+        "\n"
+        "table.empty\n"
+        "a b\n";
+    doc = ison_parse(ledger, &err);
+    assert(err == ISON_OK);
+    ison_writer_t jw;
+    ison_writer_init_memory(&jw, 64);
+    assert(ison_dump_json_writer(doc, &jw) == ISON_OK);
+    expected = ison_writer_finish(&jw, NULL);
+    ison_document_free(doc);
+    assert(strstr(expected, "\"orders_summary\":{\"id\":null,\"total\":17.75") != NULL);
+    
+    output = ison_to_json(ledger, &err);
+    assert(err == ISON_OK);
+    assert(strcmp(output, expected) == 0);
+    free(output);
+    
+    for (size_t chunk = 1; chunk <= 16; chunk += 5) {
+        chunk_source_t src = {ledger, strlen(ledger), 0, chunk};
+        ison_reader_t jr;
+        sink_buffer_t jsb = {{0}, 0, 0};
+        assert(ison_reader_init_source(&jr, chunk_source, &src, 8) == ISON_OK);
+        assert(ison_writer_init_sink(&jw, collect_sink, &jsb, 32) == ISON_OK);
+        assert(ison_to_json_stream(&jr, &jw) == ISON_OK);
+        assert(ison_writer_flush(&jw) == ISON_OK);
+        ison_writer_free(&jw);
+        ison_reader_free(&jr);
+        assert(jsb.len == strlen(expected));
+        assert(memcmp(jsb.data, expected, jsb.len) == 0);
+    }
+    free(expected);
+    printf("PASS\n");
+    
+    printf("Test: Streaming ISON/ISONL Conversion... ");
+    fflush(stdout);
+    
+    doc = ison_parse(ledger, &err);
+    expected = ison_dumps_isonl(doc);
+    ison_document_free(doc);
+    output = ison_to_isonl(ledger, &err);
+    assert(err == ISON_OK);
+    assert(strcmp(output, expected) == 0);
+    free(output);
+    free(expected);
+    
+    /* Interleaved blocks, with enough rows in a later block to spill to disk */
+    int64_t number = 0;
+    ison_writer_t lw;
+    ison_writer_init_memory(&lw, 1024);
+    ison_writer_puts(&lw, "table.audit|seq:int ok:bool|-5 true\n");
+    for (int i = 0; i < 6000; i++) {
+        char line[160];
+        snprintf(line, sizeof(line), "table.events|id:int kind msg|%d %s \"event number %d\"\n", i,
+                 i % 3 ? "info" : "warn", i);
+        ison_writer_puts(&lw, line);
+        if (i % 7 == 0) {
+            snprintf(line, sizeof(line), "table.audit|seq:int ok:bool|%d %s\n", i, i % 2 ? "true" : "false");
+            ison_writer_puts(&lw, line);
+        }
+        if (i % 500 == 0) ison_writer_puts(&lw, "object.state|phase|\"mid\"\n");
+    }
+    /* A later line may reorder fields and add new ones */
+    ison_writer_puts(&lw, "table.audit|ok:bool seq:int note|true -1 late\n");
+    char *log = ison_writer_finish(&lw, NULL);
+    
+    doc = ison_parse_isonl(log, &err);
+    block = ison_document_get(doc, "audit");
+    assert(block->field_count == 3 && strcmp(block->fields[2].name, "note") == 0);
+    row = block->rows[block->row_count - 1];
+    assert(ison_value_as_int(ison_row_get_ptr(row, "seq"), &number) && number == -1);
+    expected = ison_dumps(doc);
+    ison_document_free(doc);
+    
+    chunk_source_t lsrc = {log, strlen(log), 0, 4096};
+    ison_reader_t lr;
+    assert(ison_reader_init_source(&lr, chunk_source, &lsrc, 1024) == ISON_OK);
+    ison_writer_init_memory(&lw, 1024);
+    assert(isonl_to_ison_stream(&lr, &lw) == ISON_OK);
+    ison_reader_free(&lr);
+    output = ison_writer_finish(&lw, NULL);
+    reparsed = ison_parse(output, &err);
+    free(output);
+    output = ison_dumps(reparsed);
+    assert(strcmp(output, expected) == 0);
+    ison_document_free(reparsed);
+    free(output);
+    
+    output = ison_to_isonl(expected, &err);
+    reparsed = ison_parse_isonl(output, &err);
+    free(output);
+    output = ison_dumps(reparsed);
+    assert(strcmp(output, expected) == 0);
+    ison_document_free(reparsed);
+    free(output);
+    free(expected);
+    free(log);
+    printf("PASS\n");
+    
+    printf("Test: JSON Ingestion... ");
+    fflush(stdout);
+    
+    output = ison_to_json(ledger, &err);
+    ison_json_options_t jopts = ison_default_json_options();
+    jopts.summaries = true;
+    doc = ison_from_json_with_options(output, strlen(output), &jopts, &err);
+    assert(err == ISON_OK && doc != NULL);
+    block = ison_document_get(doc, "orders");
+    assert(block && block->row_count == 3 && block->summary_row != NULL);
+    ison_writer_init_memory(&jw, 256);
+    ison_dump_json_writer(doc, &jw);
+    expected = ison_writer_finish(&jw, NULL);
+    assert(strcmp(expected, output) == 0);
+    ison_document_free(doc);
+    free(expected);
+    free(output);
+    
+    doc = ison_from_json("{\"t\":[{\"s\":\"a\\u00e9\\ud83d\\ude00\\ud800\\n\\\"x\\\"\\\\\\/\", "
+                         "\"n\":-12, \"f\":2.5e3, \"z\":2.0, \"big\":12345678901234567890}]}", &err);
+    assert(err == ISON_OK);
+    row = ison_document_get(doc, "t")->rows[0];
+    const char *decoded = NULL;
+    assert(ison_value_as_string(ison_row_get_ptr(row, "s"), &decoded));
+    assert(strcmp(decoded, "a\xc3\xa9\xf0\x9f\x98\x80\xef\xbf\xbd\n\"x\"\\/") == 0);
+    assert(ison_value_as_int(ison_row_get_ptr(row, "n"), &number) && number == -12);
+    assert(ison_row_get_ptr(row, "f")->type == ISON_TYPE_FLOAT);
+    assert(ison_row_get_ptr(row, "z")->type == ISON_TYPE_FLOAT);
+    assert(ison_row_get_ptr(row, "big")->type == ISON_TYPE_FLOAT);
+    ison_document_free(doc);
+    
+    doc = ison_from_json("{\"orders\":[{\"id\":7,\"customer\":{\"id\":\"c1\",\"name\":\"Ann\"},"
+                         "\"tags\":[\"a\",\"b\"],\"items\":[{\"sku\":\"x\",\"qty\":2},{\"sku\":\"y\"}]},"
+                         "{\"customer\":{\"name\":\"Bo\"},\"tags\":[]}], \"scores\":[1,2.5,null]}", &err);
+    assert(err == ISON_OK);
+    block = ison_document_get(doc, "orders");
+    assert(block->row_count == 2 && block->field_count == 2);
+    ison_reference_t ref;
+    assert(ison_value_as_ref(ison_row_get_ptr(block->rows[0], "customer"), &ref));
+    assert(strcmp(ref.ns, "customer") == 0 && strcmp(ref.id, "c1") == 0);
+    assert(ison_value_as_ref(ison_row_get_ptr(block->rows[1], "customer"), &ref));
+    assert(strcmp(ref.id, "2") == 0);
+    block = ison_document_get(doc, "tags");
+    assert(block->row_count == 2 && strcmp(block->fields[0].name, "parent") == 0);
+    assert(ison_value_as_ref(ison_row_get_ptr(block->rows[1], "parent"), &ref));
+    assert(strcmp(ref.ns, "orders") == 0 && strcmp(ref.id, "7") == 0);
+    block = ison_document_get(doc, "items");
+    assert(block->row_count == 2 && block->field_count == 3);
+    assert(ison_row_get_ptr(block->rows[1], "qty") == NULL);
+    assert(ison_document_get(doc, "scores")->row_count == 3);
+    output = ison_dumps(doc);
+    reparsed = ison_parse(output, &err);
+    assert(reparsed->block_count == doc->block_count);
+    ison_document_free(reparsed);
+    free(output);
+    ison_document_free(doc);
+    
+    static const char *broken[] = {"{\"a\":[1,2}", "{\"a\":\"open}", "[1]", "{\"a\":tru}", "{\"a\":{}} x",
+                                   "{\"a\":\"\\q\"}", "{\"t\":[{\"a\":0x10}]}", "{\"t\":[{\"b\":-inf}]}",
+                                   "{\"t\":[007]}", "{\"t\":[1.]}", "{\"t\":[.5]}", "{\"t\":[1e]}", "{\"t\":[-]}",
+                                   "{\"t\":[+1]}", "{\"t\":[1.5e+]}", "{\"t\":[nan]}"};
+    for (size_t i = 0; i < sizeof(broken) / sizeof(broken[0]); i++) {
+        assert(ison_from_json(broken[i], &err) == NULL && err == ISON_ERROR_PARSE);
+    }
+    doc = ison_from_json("{\"t\":[0,-0,0.25E+2,1.5e-3,-10,9e0]}", &err);
+    assert(err == ISON_OK && ison_document_get(doc, "t")->row_count == 6);
+    ison_document_free(doc);
+    
+    /* Escaped quotes and backslash runs straddling the 64-byte index blocks */
+    static const char tricky[] = "ab\\\"\\\\\"x";
+    char json_text[1600], encoded[1400];
+    for (int i = 0; i < 2000; i++) {
+        size_t tlen = next_random() % 150;
+        for (size_t c = 0; c < tlen; c++) text[c] = tricky[next_random() % (sizeof(tricky) - 1)];
+        text[tlen] = '\0';
+        val = ison_string(text);
+        ison_value_write_json(&val, encoded, sizeof(encoded));
+        ison_value_free(&val);
+        int shift = (int)(next_random() % 64);
+        snprintf(json_text, sizeof(json_text), "{\"t\":[{\"p\":\"%*s\",\"s\":%s,\"q\":\"\\\\\"}]}", shift, "",
+                 encoded);
+        doc = ison_from_json(json_text, &err);
+        assert(err == ISON_OK);
+        row = ison_document_get(doc, "t")->rows[0];
+        assert(ison_value_as_string(ison_row_get_ptr(row, "s"), &decoded) && strcmp(decoded, text) == 0);
+        assert(ison_value_as_string(ison_row_get_ptr(row, "q"), &decoded) && strcmp(decoded, "\\") == 0);
+        ison_document_free(doc);
+    }
+    printf("PASS\n");
+    
+    printf("Test: NDJSON Streaming... ");
+    fflush(stdout);
+    
+    const char *ndjson =
+        "{\"id\":1,\"event\":\"login\"}\n"
+        "\n"
+        "{\"id\":2,\"event\":\"click\",\"x\":10.5}\r\n"
+        "{\"event\":\"buy\",\"id\":3,\"user\":{\"name\":\"Ann\"}}\n"
+        "{\"id\":4,\"user\":{\"name\":\"Bo\"}}";
+    output = ndjson_to_isonl(ndjson, "events", &err);
+    assert(err == ISON_OK);
+    assert(strncmp(output, "table.events|id event|1 login\n", 30) == 0);
+    doc = ison_parse_isonl(output, &err);
+    free(output);
+    block = ison_document_get(doc, "events");
+    assert(block->row_count == 4 && block->field_count == 4);
+    assert(ison_value_as_ref(ison_row_get_ptr(block->rows[3], "user"), &ref));
+    assert(strcmp(ref.ns, "user") == 0 && strcmp(ref.id, "2") == 0);
+    assert(ison_row_get_ptr(block->rows[0], "x") == NULL);
+    assert(ison_document_get(doc, "user")->row_count == 2);
+    ison_document_free(doc);
+    
+    const char *nd_path = "bin/ndjson_test.ndjson";
+    FILE *nd = fopen(nd_path, "wb");
+    assert(nd != NULL);
+    for (int i = 1; i <= 5000; i++) {
+        fprintf(nd, "{\"id\":%d,\"tag\":\"t%d\"%s}\n", i, i % 10, i == 4000 ? ",\"late\":true" : "");
+    }
+    fprintf(nd, "{\"id\":0,\"user\":{\"name\":\"x\"}}\n");
+    fclose(nd);
+    nd = fopen(nd_path, "rb");
+    ndjson_tally_t tally = {0, 0, 0, 0};
+    assert(ison_from_ndjson_stream(fileno(nd), "events", tally_record, &tally) == ISON_OK);
+    fclose(nd);
+    assert(tally.records == 5002 && tally.users == 1);
+    assert(tally.max_fields == 4 && tally.id_sum == 5000 * 5001 / 2);
+    remove(nd_path);
+    
+    assert(ndjson_to_isonl("{\"a\":1}\n{\"a\":}\n", "t", &err) == NULL && err == ISON_ERROR_PARSE);
+    assert(ndjson_to_isonl("[1,2]\n", "t", &err) == NULL && err == ISON_ERROR_PARSE);
+    printf("PASS\n");
+    
+    printf("Test: Binary ISONB Round Trip... ");
+    fflush(stdout);
+    
+    doc = ison_parse(ledger, &err);
+    expected = ison_dumps(doc);
+    ison_writer_t bw;
+    ison_writer_init_memory(&bw, 256);
+    assert(ison_dump_binary_writer(doc, &bw, NULL) == ISON_OK);
+    size_t image_len;
+    char *image = ison_writer_finish(&bw, &image_len);
+    assert(image_len % 8 == 0 && memcmp(image, "ISONB", 5) == 0);
+    
+    ison_binary_t *bin = ison_binary_from_memory(image, image_len, &err);
+    assert(bin != NULL && err == ISON_OK);
+    assert(ison_binary_block_count(bin) == 3);
+    const ison_binary_block_t *bb = ison_binary_find(bin, "orders");
+    assert(bb->row_count == 3 && bb->has_summary && bb->field_count == 5);
+    assert(strcmp(bb->fields[2].type_hint, "bool") == 0);
+    ison_value_t bcell;
+    assert(ison_binary_get(bin, bb, 0, 3, &bcell) && bcell.type == ISON_TYPE_REFERENCE);
+    assert(strcmp(bcell.data.ref_val.ns, "customer") == 0 && strcmp(bcell.data.ref_val.id, "7") == 0);
+    assert(ison_binary_get(bin, bb, 0, 4, &bcell) && strcmp(bcell.data.string_val, "first \"order\"") == 0);
+    assert(ison_binary_get(bin, bb, 3, 1, &bcell) && bcell.data.float_val == 17.75);
+    assert(ison_binary_get(bin, bb, 2, 3, &bcell) && bcell.type == ISON_TYPE_NULL);
+    assert(!ison_binary_get(bin, bb, 4, 0, &bcell));
+    reparsed = ison_binary_to_document(bin, &err);
+    output = ison_dumps(reparsed);
+    assert(strcmp(output, expected) == 0);
+    free(output);
+    ison_document_free(reparsed);
+    ison_writer_init_memory(&bw, 256);
+    assert(ison_binary_dump_writer(bin, &bw) == ISON_OK);
+    output = ison_writer_finish(&bw, NULL);
+    assert(strcmp(output, expected) == 0);
+    free(output);
+    ison_binary_close(bin);
+    
+    assert(ison_binary_from_memory(image, 40, &err) == NULL && err == ISON_ERROR_PARSE);
+    image[0] = 'X';
+    assert(ison_binary_from_memory(image, image_len, &err) == NULL && err == ISON_ERROR_PARSE);
+    free(image);
+    
+    assert(ison_write_file("bin/ledger_test.ison", ledger) == ISON_OK);
+    assert(ison_to_isonb("bin/ledger_test.ison", "bin/ledger_test.isonb", NULL) == ISON_OK);
+    assert(isonb_to_ison("bin/ledger_test.isonb", "bin/ledger_back.ison") == ISON_OK);
+    output = ison_read_file("bin/ledger_back.ison", NULL);
+    assert(strcmp(output, expected) == 0);
+    free(output);
+    free(expected);
+    ison_document_free(doc);
+    remove("bin/ledger_test.ison");
+    remove("bin/ledger_back.ison");
+    
+    /* Enough rows for several chunks, with mixed, uniform and absent columns */
+    doc = ison_document_create();
+    block = ison_block_create("table", "wide");
+    ison_block_add_field(block, "id", "int");
+    ison_block_add_field(block, "v", "");
+    ison_block_add_field(block, "flag", "bool");
+    ison_block_add_field(block, "gone", "");
+    for (int i = 0; i < 140000; i++) {
+        row = ison_row_create();
+        ison_value_t val = ison_int(i);
+        ison_row_set(row, "id", &val);
+        if (i % 3 == 0) val = ison_int(-i);
+        else if (i % 3 == 1) val = ison_string(i % 2 ? "odd" : "even");
+        else val = ison_float(i * 0.5);
+        if (i % 7 != 0) ison_row_set(row, "v", &val);
+        else ison_value_free(&val);
+        val = ison_bool(i % 5 == 0);
+        ison_row_set(row, "flag", &val);
+        ison_block_take_row(block, row);
+    }
+    ison_document_add_block(doc, block);
+    assert(ison_dump_binary(doc, "bin/wide_test.isonb") == ISON_OK);
+    bin = ison_binary_open("bin/wide_test.isonb", &err);
+    assert(bin != NULL);
+    bb = ison_binary_block(bin, 0);
+    assert(bb->row_count == 140000 && !bb->has_summary);
+    assert(ison_binary_get(bin, bb, 65536, 0, &bcell) && bcell.data.int_val == 65536);
+    assert(ison_binary_get(bin, bb, 139997, 1, &bcell) && bcell.data.float_val == 69998.5);
+    assert(ison_binary_get(bin, bb, 70003, 1, &bcell) && strcmp(bcell.data.string_val, "odd") == 0);
+    assert(!ison_binary_get(bin, bb, 70000 - 70000 % 7, 1, &bcell));
+    assert(ison_binary_get(bin, bb, 131070, 2, &bcell) && bcell.data.bool_val);
+    assert(!ison_binary_get(bin, bb, 5, 3, &bcell));
+    ison_binary_close(bin);
+    reparsed = ison_load_binary("bin/wide_test.isonb", &err);
+    expected = ison_dumps(doc);
+    output = ison_dumps(reparsed);
+    assert(strcmp(output, expected) == 0);
+    free(output);
+    free(expected);
+    ison_document_free(reparsed);
+    ison_document_free(doc);
+    remove("bin/wide_test.isonb");
+    remove("bin/ledger_test.isonb");
+    printf("PASS\n");
+    
+    printf("Test: Binary ISONB Compression... ");
+    fflush(stdout);
+    
+    doc = ison_document_create();
+    block = ison_block_create("table", "readings");
+    ison_block_add_field(block, "seq", "int");
+    ison_block_add_field(block, "sensor", "int");
+    ison_block_add_field(block, "site", "string");
+    ison_block_add_field(block, "value", "float");
+    ison_block_add_field(block, "owner", "ref");
+    for (int i = 0; i < 100000; i++) {
+        row = ison_row_create();
+        ison_value_t val = ison_int(1000000000LL + i);
+        ison_row_set(row, "seq", &val);
+        val = ison_int(-5 + (int64_t)(next_random() % 100));
+        ison_row_set(row, "sensor", &val);
+        val = ison_string(i % 4 == 0 ? "north" : i % 4 == 1 ? "south" : "east west");
+        ison_row_set(row, "site", &val);
+        val = ison_float((double)(next_random() % 1000) / 8);
+        ison_row_set(row, "value", &val);
+        ison_reference_t owner = {"42", "user", NULL};
+        val = ison_ref(&owner);
+        ison_row_set(row, "owner", &val);
+        ison_block_take_row(block, row);
+    }
+    ison_document_add_block(doc, block);
+    expected = ison_dumps(doc);
+    
+    ison_binary_options_t bopts = ison_default_binary_options();
+    bopts.compress = true;
+    ison_writer_init_memory(&bw, 256);
+    assert(ison_dump_binary_writer(doc, &bw, NULL) == ISON_OK);
+    size_t plain_len = bw.len;
+    ison_writer_free(&bw);
+    ison_writer_init_memory(&bw, 256);
+    assert(ison_dump_binary_writer(doc, &bw, &bopts) == ISON_OK);
+    image = ison_writer_finish(&bw, &image_len);
+    assert(image_len * 5 < plain_len);
+    
+    bin = ison_binary_from_memory(image, image_len, &err);
+    assert(bin != NULL);
+    bb = ison_binary_block(bin, 0);
+    assert(ison_binary_get(bin, bb, 99999, 0, &bcell) && bcell.data.int_val == 1000099999LL);
+    assert(ison_binary_get(bin, bb, 65537, 2, &bcell) && strcmp(bcell.data.string_val, "south") == 0);
+    assert(ison_binary_get(bin, bb, 70000, 4, &bcell) && strcmp(bcell.data.ref_val.ns, "user") == 0);
+    reparsed = ison_binary_to_document(bin, &err);
+    ison_binary_close(bin);
+    output = ison_dumps(reparsed);
+    assert(strcmp(output, expected) == 0);
+    free(output);
+    ison_document_free(reparsed);
+    
+    /* Damaged payloads must fail cleanly, never read out of bounds */
+    char *damaged = malloc(image_len);
+    for (int round = 0; round < 64; round++) {
+        memcpy(damaged, image, image_len);
+        for (int k = 0; k < 4; k++) damaged[next_random() % image_len] ^= (char)(1 + next_random() % 255);
+        bin = ison_binary_from_memory(damaged, image_len, &err);
+        if (!bin) continue;
+        reparsed = ison_binary_to_document(bin, &err);
+        ison_document_free(reparsed);
+        ison_binary_close(bin);
+    }
+    free(damaged);
+    free(image);
+    free(expected);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Arrow C Data Interface... ");
+    fflush(stdout);
+    
+    const char *order_text =
+        "table.orders\n"
+        "id:int total:float paid:bool customer:ref note\n"
+        "1 10.5 true :customer:7 \"first \\\"order\\\"\"\n"
+        "2 3 false :customer:9 \"\"\n"
+        "3 4.25 true null caf\xc3\xa9\n";
+    doc = ison_parse(order_text, &err);
+    block = ison_document_get(doc, "orders");
+    struct ArrowArray arr;
+    struct ArrowSchema sch;
+    assert(ison_block_export_arrow(block, &arr, &sch) == ISON_OK);
+    assert(strcmp(sch.format, "+s") == 0 && strcmp(sch.name, "orders") == 0);
+    assert(arr.length == 3 && arr.n_children == 5 && sch.n_children == 5);
+    assert(strcmp(sch.children[0]->format, "l") == 0 && strcmp(sch.children[1]->format, "g") == 0);
+    assert(strcmp(sch.children[2]->format, "b") == 0 && strcmp(sch.children[3]->format, "u") == 0);
+    assert(((const int64_t *)arr.children[0]->buffers[1])[2] == 3);
+    assert(((const double *)arr.children[1]->buffers[1])[0] == 10.5);
+    assert(((const unsigned char *)arr.children[2]->buffers[1])[0] == 0x5);
+    assert(arr.children[3]->null_count == 1 && arr.children[0]->buffers[0] == NULL);
+    const int32_t *offs = arr.children[3]->buffers[1];
+    assert(offs[1] == 11 && memcmp(arr.children[3]->buffers[2], ":customer:7", 11) == 0);
+    offs = arr.children[4]->buffers[1];
+    assert(offs[1] - offs[0] == 13 && offs[2] == offs[1] && offs[3] - offs[2] == 5);
+    
+    ison_block_t *imported = ison_block_import_arrow(&arr, &sch, &err);
+    assert(imported != NULL && err == ISON_OK);
+    assert(arr.release == NULL && sch.release == NULL);
+    reparsed = ison_document_create();
+    ison_document_add_block(reparsed, imported);
+    expected = ison_dumps(doc);
+    output = ison_dumps(reparsed);
+    assert(strcmp(output, expected) == 0);
+    assert(ison_value_as_ref(ison_row_get_ptr(imported->rows[1], "customer"), &ref));
+    assert(strcmp(ref.id, "9") == 0);
+    free(output);
+    free(expected);
+    ison_document_free(reparsed);
+    ison_document_free(doc);
+    
+    /* Foreign arrays: narrow types, offsets, validity, no ISON metadata */
+    static const int32_t small_ints[] = {7, 8, 9, 10};
+    static const unsigned char small_valid[] = {0x0B};
+    static const float ratio[] = {0.5f, 1.5f, 2.5f, 3.5f, 4.5f};
+    static const int32_t word_offs[] = {0, 1, 3, 6, 10};
+    const void *small_bufs[] = {small_valid, small_ints};
+    const void *ratio_bufs[] = {NULL, ratio};
+    const void *word_bufs[] = {NULL, word_offs, "abbcccdddd"};
+    struct ArrowArray cols[4] = {
+        {4, 1, 0, 2, 0, small_bufs, NULL, NULL, release_static_array, NULL},
+        {4, 0, 1, 2, 0, ratio_bufs, NULL, NULL, release_static_array, NULL},
+        {4, 0, 0, 3, 0, word_bufs, NULL, NULL, release_static_array, NULL},
+        {4, 4, 0, 0, 0, NULL, NULL, NULL, release_static_array, NULL}
+    };
+    struct ArrowSchema col_schemas[4] = {
+        {"i", "n", NULL, ARROW_FLAG_NULLABLE, 0, NULL, NULL, release_static_schema, NULL},
+        {"f", "r", NULL, ARROW_FLAG_NULLABLE, 0, NULL, NULL, release_static_schema, NULL},
+        {"u", "w", NULL, ARROW_FLAG_NULLABLE, 0, NULL, NULL, release_static_schema, NULL},
+        {"n", "z", NULL, ARROW_FLAG_NULLABLE, 0, NULL, NULL, release_static_schema, NULL}
+    };
+    struct ArrowArray *col_ptrs[] = {&cols[0], &cols[1], &cols[2], &cols[3]};
+    struct ArrowSchema *schema_ptrs[] = {&col_schemas[0], &col_schemas[1], &col_schemas[2], &col_schemas[3]};
+    const void *root_bufs[] = {NULL};
+    arr = (struct ArrowArray){3, 0, 1, 1, 4, root_bufs, col_ptrs, NULL, release_static_array, NULL};
+    sch = (struct ArrowSchema){"+s", "foreign", NULL, 0, 4, schema_ptrs, NULL, release_static_schema, NULL};
+    arrow_releases = 0;
+    imported = ison_block_import_arrow(&arr, &sch, &err);
+    assert(imported != NULL && arrow_releases == 2);
+    assert(imported->row_count == 3 && imported->field_count == 4);
+    assert(strcmp(imported->fields[0].type_hint, "int") == 0 && strcmp(imported->fields[2].type_hint, "string") == 0);
+    assert(ison_value_is_null(ison_row_get_ptr(imported->rows[1], "n")));
+    assert(ison_value_as_int(ison_row_get_ptr(imported->rows[2], "n"), &number) && number == 10);
+    double ratio_val;
+    assert(ison_value_as_float(ison_row_get_ptr(imported->rows[0], "r"), &ratio_val) && ratio_val == 2.5);
+    const char *word;
+    assert(ison_value_as_string(ison_row_get_ptr(imported->rows[0], "w"), &word) && strcmp(word, "bb") == 0);
+    assert(ison_value_is_null(ison_row_get_ptr(imported->rows[2], "z")));
+    ison_block_free(imported);
+    
+    sch.format = "+l";
+    arr.release = release_static_array;
+    sch.release = release_static_schema;
+    assert(ison_block_import_arrow(&arr, &sch, &err) == NULL && err == ISON_ERROR_INVALID);
+    printf("PASS\n");
+    
+    printf("Test: CSV/TSV Import and Export... ");
+    fflush(stdout);
+    
+    const char *csv =
+        "id,name,note,score\r\n"
+        "1,Alice,\"likes \"\"tea\"\", coffee\",9.5\r\n"
+        "2,Bob,\"line one\r\nline two\",\r\n"
+        "\r\n"
+        "3,\"\",,7\r\n"
+        "4,:x,\"12\",\n";
+    ison_reader_t csv_in;
+    ison_reader_init_memory(&csv_in, csv, strlen(csv));
+    block = ison_block_from_csv(&csv_in, "people", NULL, &err);
+    assert(block != NULL && err == ISON_OK);
+    assert(block->field_count == 4 && block->row_count == 4);
+    const char *csv_str;
+    assert(ison_value_as_string(ison_row_get_ptr(block->rows[0], "note"), &csv_str));
+    assert(strcmp(csv_str, "likes \"tea\", coffee") == 0);
+    assert(ison_value_as_string(ison_row_get_ptr(block->rows[1], "note"), &csv_str));
+    assert(strcmp(csv_str, "line one\nline two") == 0);
+    assert(ison_value_is_null(ison_row_get_ptr(block->rows[1], "score")));
+    assert(ison_value_as_string(ison_row_get_ptr(block->rows[2], "name"), &csv_str) && *csv_str == '\0');
+    assert(ison_value_is_null(ison_row_get_ptr(block->rows[2], "note")));
+    assert(ison_value_as_string(ison_row_get_ptr(block->rows[3], "name"), &csv_str) && strcmp(csv_str, ":x") == 0);
+    /* Quoted cells in untyped columns stay strings, and are written back quoted */
+    assert(ison_value_as_string(ison_row_get_ptr(block->rows[3], "note"), &csv_str) && strcmp(csv_str, "12") == 0);
+    assert(ison_value_as_int(ison_row_get_ptr(block->rows[3], "score"), &number) == false);
+    assert(ison_value_as_int(ison_row_get_ptr(block->rows[2], "score"), &number) && number == 7);
+    
+    ison_writer_t cw;
+    ison_writer_init_memory(&cw, 64);
+    assert(ison_block_to_csv(block, &cw, NULL) == ISON_OK);
+    output = ison_writer_finish(&cw, NULL);
+    assert(strcmp(output,
+        "id,name,note,score\r\n"
+        "1,Alice,\"likes \"\"tea\"\", coffee\",9.5\r\n"
+        "2,Bob,\"line one\nline two\",\r\n"
+        "3,\"\",,7\r\n"
+        "4,:x,\"12\",\r\n") == 0);
+    free(output);
+    ison_block_free(block);
+    
+    /* Typed TSV round trip keeps hints, refs and string-typed numbers */
+    doc = ison_parse(
+        "table.items\n"
+        "sku:string qty:int price:float ok:bool owner:ref tag\n"
+        "007 3 1.25 true :user:1 \"a\\tb\"\n"
+        "008 ~ 2 false ~ plain\n", &err);
+    block = ison_document_get(doc, "items");
+    ison_csv_options_t copts = ison_default_csv_options();
+    copts.delimiter = '\t';
+    copts.type_row = true;
+    ison_writer_init_memory(&cw, 64);
+    assert(ison_block_to_csv(block, &cw, &copts) == ISON_OK);
+    size_t tsv_len;
+    output = ison_writer_finish(&cw, &tsv_len);
+    assert(strncmp(output, "sku\tqty\tprice\tok\towner\ttag\r\nstring\tint\tfloat\tbool\tref\t\r\n", 56) == 0);
+    ison_reader_init_memory(&csv_in, output, tsv_len);
+    ison_block_t *tsv_block = ison_block_from_csv(&csv_in, "items", &copts, &err);
+    assert(tsv_block != NULL);
+    free(output);
+    reparsed = ison_document_create();
+    ison_document_add_block(reparsed, tsv_block);
+    expected = ison_dumps(doc);
+    output = ison_dumps(reparsed);
+    assert(strcmp(output, expected) == 0);
+    free(output);
+    free(expected);
+    ison_document_free(reparsed);
+    ison_document_free(doc);
+    
+    copts = ison_default_csv_options();
+    copts.header = false;
+    ison_reader_init_memory(&csv_in, "1,2\n3,4,5\n", 10);
+    block = ison_block_from_csv(&csv_in, "raw", &copts, &err);
+    assert(block->field_count == 3 && strcmp(block->fields[2].name, "c3") == 0);
+    assert(ison_value_as_int(ison_row_get_ptr(block->rows[1], "c3"), &number) && number == 5);
+    ison_block_free(block);
+    ison_reader_init_memory(&csv_in, "a,b\n1,2,3\n", 10);
+    assert(ison_block_from_csv(&csv_in, "bad", NULL, &err) == NULL && err == ISON_ERROR_PARSE);
+    ison_reader_init_memory(&csv_in, "a\n\"open\n", 8);
+    assert(ison_block_from_csv(&csv_in, "bad", NULL, &err) == NULL && err == ISON_ERROR_PARSE);
+    printf("PASS\n");
+    
+    printf("Test: ISONL Appender... ");
+    fflush(stdout);
+    
+    const char *log_path = "bin/appender_test.isonl";
+    remove(log_path);
+    isonl_appender_options_t aopts = isonl_default_appender_options();
+    aopts.flush_bytes = 4096;
+    aopts.flush_interval_ms = 1;
+    isonl_appender_t *app = isonl_appender_open(log_path, &aopts, &err);
+    assert(app != NULL && err == ISON_OK);
+    pthread_t producers[4];
+    appender_job_t jobs[4];
+    for (int t = 0; t < 4; t++) {
+        jobs[t].app = app;
+        jobs[t].thread_id = t;
+        jobs[t].count = 3000;
+        assert(pthread_create(&producers[t], NULL, append_events, &jobs[t]) == 0);
+    }
+    for (int t = 0; t < 4; t++) pthread_join(producers[t], NULL);
+    assert(isonl_appender_flush(app) == ISON_OK);
+    assert(isonl_appender_close(app) == ISON_OK);
+    
+    /* Reopening appends after the existing lines, with sync on */
+    aopts.sync = true;
+    aopts.flush_interval_ms = 0;
+    app = isonl_appender_open(log_path, &aopts, &err);
+    char *tail_fields[] = {"thread:int", "seq:int", "note"};
+    ison_value_t tail_values[3] = {ison_int(9), ison_int(0), ison_null()};
+    isonl_record_t tail = {"table", "events", tail_fields, 3, tail_values};
+    assert(isonl_append(app, &tail) == ISON_OK);
+    assert(isonl_appender_close(app) == ISON_OK);
+    
+    doc = ison_load_isonl(log_path, &err);
+    assert(doc != NULL && err == ISON_OK);
+    ison_block_t *events = ison_document_get(doc, "events");
+    ison_block_t *audit = ison_document_get(doc, "audit");
+    assert(events->row_count == 4 * 1500 + 1 && audit->row_count == 4 * 1500);
+    assert(strcmp(events->fields[0].type_hint, "int") == 0);
+    int64_t last_seq[4] = {-1, -1, -1, -1};
+    for (size_t r = 0; r + 1 < events->row_count; r++) {
+        int64_t tid, seq;
+        assert(ison_value_as_int(ison_row_get_ptr(events->rows[r], "thread"), &tid) && tid >= 0 && tid < 4);
+        assert(ison_value_as_int(ison_row_get_ptr(events->rows[r], "seq"), &seq));
+        assert(seq > last_seq[tid]);
+        last_seq[tid] = seq;
+        const char *note;
+        assert(ison_value_as_string(ison_row_get_ptr(events->rows[r], "note"), &note) && strcmp(note, "x y") == 0);
+    }
+    assert(ison_value_as_int(ison_row_get_ptr(events->rows[events->row_count - 1], "thread"), &number) && number == 9);
+    ison_document_free(doc);
+    remove(log_path);
+    assert(isonl_appender_open("bin/no_such_dir/log.isonl", NULL, &err) == NULL && err == ISON_ERROR_IO);
+    printf("PASS\n");
+    
+    printf("Test: ISONL Record Streaming and Follow... ");
+    fflush(stdout);
+    
+    const char *isonl_text =
+        "# log\n"
+        "table.users|id:int name|007 \"Ann Lee\"\n"
+        "\n"
+        "table.orders|id user:ref|1 :users:7\r\n"
+        "table.users|id:int name|8\n"
+        "no header here\n"
+        "table.users|id:int name|9 Bo";
+    ndjson_tally_t stally = {0};
+    assert(isonl_stream_buffer(isonl_text, strlen(isonl_text), tally_record, &stally) == ISON_OK);
+    assert(stally.records == 4 && stally.users == 0 && stally.id_sum == 7 + 1 + 8 + 9);
+    assert(stally.max_fields == 2);
+    const char *stream_path = "bin/stream_test.isonl";
+    assert(ison_write_file(stream_path, isonl_text) == ISON_OK);
+    memset(&stally, 0, sizeof(stally));
+    assert(isonl_stream_file(stream_path, tally_record, &stally) == ISON_OK);
+    assert(stally.records == 4 && stally.id_sum == 25);
+    assert(isonl_stream_file("bin/no_such_file.isonl", tally_record, &stally) == ISON_ERROR_IO);
+    
+    /* Existing lines, a partial line completed later, then rotation to a new file */
+    follow_state_t fstate;
+    memset(&fstate, 0, sizeof(fstate));
+    fstate.path = stream_path;
+    assert(ison_write_file(stream_path, "table.t|id:int name|1 a\ntable.t|id:int name|2 b\ntable.t|id:int name|3 ") == ISON_OK);
+    isonl_follow_options_t fopts = isonl_default_follow_options();
+    fopts.poll_interval_ms = 5;
+    fopts.idle_timeout_ms = 5000;
+    fopts.stop = &fstate.stop;
+    assert(isonl_follow(stream_path, follow_record, &fstate, &fopts) == ISON_OK);
+    pthread_join(fstate.writer, NULL);
+    assert(fstate.count == 5);
+    for (int i = 0; i < 5; i++) assert(fstate.ids[i] == i + 1);
+    
+    /* From the end: existing records and the partial tail are skipped */
+    memset(&fstate, 0, sizeof(fstate));
+    fopts.from_end = true;
+    fopts.idle_timeout_ms = 20;
+    assert(ison_write_file(stream_path, "table.t|id:int|1\ntable.t|id:int|2") == ISON_OK);
+    assert(isonl_follow(stream_path, follow_record, &fstate, &fopts) == ISON_OK);
+    assert(fstate.count == 0);
+    remove(stream_path);
+    remove("bin/stream_test.isonl.1");
+    assert(isonl_follow(stream_path, follow_record, &fstate, &fopts) == ISON_ERROR_IO);
+    printf("PASS\n");
+    
+    printf("Test: ISONL Sidecar Index... ");
+    fflush(stdout);
+    
+    const char *ix_path = "bin/index_test.isonl";
+    const char *ix_idx = "bin/index_test.isonl.idx";
+    ison_writer_t iw;
+    ison_writer_init_memory(&iw, 1 << 16);
+    size_t row_offsets[10000];
+    for (int r = 0; r < 10000; r++) {
+        if (r % 97 == 0) ison_writer_puts(&iw, "# checkpoint comment\n\n");
+        row_offsets[r] = iw.len;
+        char line[96];
+        if (r % 3 == 0) snprintf(line, sizeof(line), "table.audit|id:int who|%d \"user %d\"\n", r, r % 10);
+        else snprintf(line, sizeof(line), "table.events|id:int kind|%d click\n", r);
+        ison_writer_puts(&iw, line);
+    }
+    size_t ix_len;
+    char *ix_text = ison_writer_finish(&iw, &ix_len);
+    assert(ison_write_file(ix_path, ix_text) == ISON_OK);
+    assert(isonl_build_index(ix_path, ix_idx, 64) == ISON_OK);
+    isonl_index_t *ix = isonl_open_indexed(ix_path, ix_idx, &err);
+    assert(ix != NULL && err == ISON_OK);
+    assert(isonl_index_rows(ix) == 10000);
+    assert(isonl_index_block_rows(ix, "audit") == 3334 && isonl_index_block_rows(ix, "events") == 6666);
+    assert(isonl_index_block_rows(ix, "missing") == 0);
+    uint64_t row_at;
+    for (int r = 0; r < 10000; r += 37) {
+        assert(isonl_seek_row(ix, (uint64_t)r, &row_at) == ISON_OK && row_at == row_offsets[r]);
+    }
+    assert(isonl_seek_row(ix, 9999, &row_at) == ISON_OK && row_at == row_offsets[9999]);
+    assert(isonl_seek_row(ix, 10000, &row_at) == ISON_ERROR_INVALID);
+    
+    doc = isonl_read_range(ix, 5000, 10, &err);
+    assert(doc != NULL && err == ISON_OK);
+    ison_block_t *page_events = ison_document_get(doc, "events");
+    ison_block_t *page_audit = ison_document_get(doc, "audit");
+    assert(page_events->row_count + page_audit->row_count == 10);
+    assert(ison_value_as_int(ison_row_get_ptr(page_events->rows[0], "id"), &number) && number == 5000);
+    ison_document_free(doc);
+    doc = isonl_read_range(ix, 9995, 100, &err);
+    assert(doc != NULL && ison_document_get(doc, "events")->row_count + ison_document_get(doc, "audit")->row_count == 5);
+    ison_document_free(doc);
+    doc = isonl_read_range(ix, 20000, 5, &err);
+    assert(doc != NULL && err == ISON_OK && doc->block_count == 0);
+    ison_document_free(doc);
+    isonl_index_close(ix);
+    
+    /* Rows appended after indexing are reached from the last checkpoint */
+    FILE *ix_file = fopen(ix_path, "a");
+    fputs("table.events|id:int kind|10000 late\ntable.events|id:int kind|10001 later", ix_file);
+    fclose(ix_file);
+    ix = isonl_open_indexed(ix_path, ix_idx, &err);
+    assert(isonl_seek_row(ix, 10001, &row_at) == ISON_OK && row_at == ix_len + strlen("table.events|id:int kind|10000 late\n"));
+    doc = isonl_read_range(ix, 9998, 4, &err);
+    page_events = ison_document_get(doc, "events");
+    assert(page_events->row_count == 3);
+    const char *late_kind;
+    assert(ison_value_as_string(ison_row_get_ptr(page_events->rows[2], "kind"), &late_kind) && strcmp(late_kind, "later") == 0);
+    ison_document_free(doc);
+    isonl_index_close(ix);
+    
+    /* A shorter file or a damaged index is refused */
+    assert(ison_write_file(ix_path, "table.t|a|1\n") == ISON_OK);
+    assert(isonl_open_indexed(ix_path, ix_idx, &err) == NULL && err == ISON_ERROR_INVALID);
+    assert(ison_write_file(ix_idx, "ISONLIX") == ISON_OK);
+    assert(isonl_open_indexed(ix_path, ix_idx, &err) == NULL && err == ISON_ERROR_PARSE);
+    assert(isonl_open_indexed(ix_path, "bin/no_such.idx", &err) == NULL && err == ISON_ERROR_IO);
+    assert(isonl_build_index(ix_path, ix_idx, 0) == ISON_OK);
+    ix = isonl_open_indexed(ix_path, ix_idx, &err);
+    assert(ix != NULL && isonl_index_rows(ix) == 1);
+    isonl_index_close(ix);
+    free(ix_text);
+    remove(ix_path);
+    remove(ix_idx);
+    printf("PASS\n");
+    
+    printf("Test: ISONL External Sort and Merge... ");
+    fflush(stdout);
+    
+    const char *sort_in = "bin/sort_in.isonl";
+    const char *sort_out = "bin/sort_out.isonl";
+    ison_writer_t sw;
+    ison_writer_init_memory(&sw, 1 << 16);
+    ison_writer_puts(&sw, "# unsorted\n");
+    for (int r = 0; r < 20000; r++) {
+        char line[128];
+        if (r % 1000 == 7) {
+            snprintf(line, sizeof(line), "meta.note|n:int|%d\n", r);
+        } else if (r % 50 == 0) {
+            /* Key missing, then a float key mixed with ints */
+            snprintf(line, sizeof(line), "table.ev|seq:int|%d\n", r);
+        } else if (r % 7 == 0) {
+            int key = (int)(next_random() % 500);
+            snprintf(line, sizeof(line), "table.ev|seq:int k:float tag|%d %d.0 t%d\n", r, key, key % 3);
+        } else {
+            int key = (int)(next_random() % 500);
+            snprintf(line, sizeof(line), "table.ev|k:int tag seq:int|%d t%d %d\n", key, key % 3, r);
+        }
+        ison_writer_puts(&sw, line);
+    }
+    char *sort_text = ison_writer_finish(&sw, NULL);
+    assert(ison_write_file(sort_in, sort_text) == ISON_OK);
+    free(sort_text);
+    
+    const char *sort_keys[] = {"k", "tag"};
+    assert(isonl_sort_file(sort_in, sort_out, "ev", sort_keys, 2, 8192) == ISON_OK);
+    doc = ison_load_isonl(sort_out, &err);
+    ison_block_t *sorted_ev = ison_document_get(doc, "ev");
+    ison_block_t *notes = ison_document_get(doc, "note");
+    assert(sorted_ev->row_count == 20000 - 20 && notes->row_count == 20);
+    assert(doc->blocks[0] == notes);
+    for (size_t r = 1; r < notes->row_count; r++) {
+        int64_t a, b;
+        ison_value_as_int(ison_row_get_ptr(notes->rows[r - 1], "n"), &a);
+        ison_value_as_int(ison_row_get_ptr(notes->rows[r], "n"), &b);
+        assert(a < b);
+    }
+    double prev_key = -1;
+    int64_t prev_tag = -1, prev_seq = -1;
+    for (size_t r = 0; r < sorted_ev->row_count; r++) {
+        const ison_value_t *kv = ison_row_get_ptr(sorted_ev->rows[r], "k");
+        int64_t seq;
+        assert(ison_value_as_int(ison_row_get_ptr(sorted_ev->rows[r], "seq"), &seq));
+        if (!kv) {
+            /* Rows without the key come first, in input order */
+            assert(prev_key < 0 && seq > prev_seq);
+            prev_seq = seq;
+            continue;
+        }
+        double key;
+        int64_t ik;
+        if (ison_value_as_int(kv, &ik)) key = (double)ik;
+        else assert(ison_value_as_float(kv, &key));
+        const char *tag;
+        assert(ison_value_as_string(ison_row_get_ptr(sorted_ev->rows[r], "tag"), &tag));
+        int64_t tag_n = tag[1] - '0';
+        assert(key > prev_key || (key == prev_key && (tag_n > prev_tag || (tag_n == prev_tag && seq > prev_seq))));
+        prev_key = key;
+        prev_tag = tag_n;
+        prev_seq = seq;
+    }
+    ison_document_free(doc);
+    
+    /* Sorting in place with the default budget gives the same bytes */
+    char *spilled = ison_read_file(sort_out, NULL);
+    assert(isonl_sort_file(sort_in, sort_in, "ev", sort_keys, 2, 0) == ISON_OK);
+    char *in_memory = ison_read_file(sort_in, NULL);
+    assert(strcmp(spilled, in_memory) == 0);
+    free(spilled);
+    free(in_memory);
+    
+    /* Merging sorted halves */
+    assert(ison_write_file(sort_in, "table.ev|k:int|5\ntable.ev|k:int|1\ntable.ev|k:string|b\n") == ISON_OK);
+    assert(isonl_sort_file(sort_in, sort_in, NULL, sort_keys, 1, 0) == ISON_OK);
+    assert(ison_write_file(sort_out, "meta.m|x|1\ntable.ev|k:int|3\ntable.ev|k:string|a\n") == ISON_OK);
+    const char *merge_in[] = {sort_in, sort_out};
+    assert(isonl_merge_sorted(merge_in, 2, "bin/sort_merged.isonl", "ev", sort_keys, 1) == ISON_OK);
+    output = ison_read_file("bin/sort_merged.isonl", NULL);
+    assert(strcmp(output, "meta.m|x|1\ntable.ev|k:int|1\ntable.ev|k:int|3\ntable.ev|k:int|5\n"
+                          "table.ev|k:string|a\ntable.ev|k:string|b\n") == 0);
+    free(output);
+    assert(isonl_sort_file(sort_in, sort_out, "ev", NULL, 0, 0) == ISON_ERROR_INVALID);
+    assert(isonl_sort_file("bin/no_such.isonl", sort_out, "ev", sort_keys, 1, 0) == ISON_ERROR_IO);
+    remove(sort_in);
+    remove(sort_out);
+    remove("bin/sort_merged.isonl");
+    printf("PASS\n");
+    
+    printf("Test: Parallel Multi-File Load... ");
+    fflush(stdout);
+    
+    char many_paths[41][64];
+    const char *many[41];
+    for (int i = 0; i < 40; i++) {
+        const char *ext = i % 4 == 1 ? "isonl" : i % 4 == 2 ? "isonb" : "ison";
+        snprintf(many_paths[i], sizeof(many_paths[i]), "bin/many_%d.%s", i, ext);
+        many[i] = many_paths[i];
+        ison_writer_init_memory(&sw, 256);
+        ison_writer_puts(&sw, "table.tenant\nid:int name\n");
+        for (int r = 0; r < i * 20; r++) {
+            char line[64];
+            snprintf(line, sizeof(line), "%d \"tenant %d\"\n", r, i);
+            ison_writer_puts(&sw, line);
+        }
+        char *tenant_text = ison_writer_finish(&sw, NULL);
+        doc = ison_parse(tenant_text, &err);
+        if (i % 4 == 1) assert(ison_dump_isonl(doc, many[i]) == ISON_OK);
+        else if (i % 4 == 2) assert(ison_dump_binary(doc, many[i]) == ISON_OK);
+        else assert(ison_write_file(many[i], tenant_text) == ISON_OK);
+        ison_document_free(doc);
+        free(tenant_text);
+    }
+    many[40] = "bin/many_missing.ison";
+    ison_document_t *many_docs[41];
+    ison_error_t many_errs[41];
+    ison_load_timing_t many_times[41];
+    assert(ison_load_many(many, 41, 4, many_docs, many_errs, many_times) == ISON_ERROR_IO);
+    for (int i = 0; i < 40; i++) {
+        assert(many_errs[i] == ISON_OK && many_docs[i] != NULL);
+        block = ison_document_get(many_docs[i], "tenant");
+        assert(block != NULL && block->row_count == (size_t)i * 20);
+        if (i > 0) {
+            const char *tenant;
+            assert(ison_value_as_string(ison_row_get_ptr(block->rows[0], "name"), &tenant));
+            char want[32];
+            snprintf(want, sizeof(want), "tenant %d", i);
+            assert(strcmp(tenant, want) == 0);
+        }
+        assert(many_times[i].bytes > 0 && many_times[i].parse_seconds >= 0);
+        ison_document_free(many_docs[i]);
+        remove(many[i]);
+    }
+    assert(many_errs[40] == ISON_ERROR_IO && many_docs[40] == NULL);
+    assert(ison_load_many(many, 0, 0, many_docs, NULL, NULL) == ISON_OK);
+    printf("PASS\n");
+    
+    // Test: Reusable Parser Context
+    printf("Test: Reusable Parser Context... ");
+    fflush(stdout);
+    {
+        ison_parse_ctx_t *ctx = ison_parse_ctx_create();
+        assert(ctx != NULL);
+        const char *payloads[] = {
+            "table.users\nid:int name active:bool\n1 Alice true\n2 \"Bob Smith\" false\n",
+            "# header comment\n\nobject.config\n\n# fields next\nhost port:int\nlocalhost 8080\n\n"
+            "table.orders\nid user:ref total:float\n1 :1 9.5\n---\ncount 1\n",
+            "meta.info\nversion\n1.0\ntable.users\nid\n7\n   \n",
+            "\"table.not\"\nnothing here\n",
+            "",
+        };
+        for (int round = 0; round < 50; round++) {
+            for (size_t i = 0; i < sizeof(payloads) / sizeof(payloads[0]); i++) {
+                ison_error_t perr;
+                ison_document_t *with = ison_parse_with(ctx, payloads[i], strlen(payloads[i]), &perr);
+                assert(perr == ISON_OK && with != NULL);
+                ison_document_t *plain = ison_parse(payloads[i], NULL);
+                char *a = ison_dumps(with);
+                char *b = ison_dumps(plain);
+                assert(strcmp(a, b) == 0);
+                free(a);
+                free(b);
+                ison_document_free(with);
+                ison_document_free(plain);
+            }
+            if (round % 10 == 9) ison_parse_ctx_reset(ctx);
+        }
+
+        /* Only len bytes are read: the rest of the buffer is another message */
+        const char wire[] = "table.first\nid:int\n1\n2\ntable.second\nid\n3\n";
+        ison_document_t *slice = ison_parse_with(ctx, wire, strstr(wire, "table.second") - wire, NULL);
+        assert(slice->block_count == 1);
+        assert(ison_document_get(slice, "first")->row_count == 2);
+        ison_document_free(slice);
+
+        ison_error_t perr;
+        assert(ison_parse_with(NULL, wire, sizeof(wire) - 1, &perr) == NULL && perr == ISON_ERROR_INVALID);
+        ison_parse_ctx_free(ctx);
+    }
+    printf("PASS\n");
+    
+    // Test: Length-Delimited Entry Points
+    printf("Test: Length-Delimited Entry Points... ");
+    fflush(stdout);
+    {
+        /* Each payload is copied into an exact-size buffer with no terminator after it */
+        const char *ison_src = "table.users\nid:int name\n1 Alice\n2 \"Bob\"\n\nobject.cfg\nport:int\n80";
+        const char *isonl_src = "table.users|id:int name|1 Alice\ntable.users|id:int name|2 Bob";
+        const char *json_src = "{\"users\": [{\"id\": 1, \"name\": \"Alice\"}], \"n\": 42}";
+        size_t ison_len = strlen(ison_src), isonl_len = strlen(isonl_src), json_len = strlen(json_src);
+        char *ison_buf = malloc(ison_len), *isonl_buf = malloc(isonl_len), *json_buf = malloc(json_len);
+        memcpy(ison_buf, ison_src, ison_len);
+        memcpy(isonl_buf, isonl_src, isonl_len);
+        memcpy(json_buf, json_src, json_len);
+
+        ison_error_t nerr;
+        ison_document_t *a = ison_parse_n(ison_buf, ison_len, &nerr);
+        ison_document_t *b = ison_parse(ison_src, NULL);
+        assert(nerr == ISON_OK && a->block_count == 2);
+        char *da = ison_dumps(a), *db = ison_dumps(b);
+        assert(strcmp(da, db) == 0);
+        int64_t port;
+        assert(ison_value_as_int(ison_row_get_ptr(ison_document_get(a, "cfg")->rows[0], "port"), &port) && port == 80);
+        free(da);
+        free(db);
+        ison_document_free(a);
+        ison_document_free(b);
+
+        a = ison_parse_isonl_n(isonl_buf, isonl_len, &nerr);
+        assert(nerr == ISON_OK && ison_document_get(a, "users")->row_count == 2);
+        const char *uname;
+        assert(ison_value_as_string(ison_row_get_ptr(ison_document_get(a, "users")->rows[1], "name"), &uname));
+        assert(strcmp(uname, "Bob") == 0);
+        ison_document_free(a);
+
+        char *json_n = ison_to_json_n(ison_buf, ison_len, &nerr);
+        char *json_z = ison_to_json(ison_src, NULL);
+        assert(nerr == ISON_OK && strcmp(json_n, json_z) == 0);
+        free(json_n);
+        free(json_z);
+
+        a = ison_from_json_n(json_buf, json_len, &nerr);
+        assert(nerr == ISON_OK && ison_document_get(a, "users")->row_count == 1);
+        ison_document_free(a);
+
+        /* A prefix of a larger buffer: the cut lands mid-row for ISON, mid-object for JSON */
+        a = ison_parse_n(ison_src, strstr(ison_src, "2 \"Bob\"") - ison_src + 1, NULL);
+        assert(ison_document_get(a, "users")->row_count == 2 && ison_document_get(a, "cfg") == NULL);
+        ison_document_free(a);
+        assert(ison_from_json_n(json_src, 20, &nerr) == NULL && nerr == ISON_ERROR_PARSE);
+        assert(ison_from_json_n(NULL, 0, &nerr) == NULL && nerr == ISON_ERROR_INVALID);
+        a = ison_parse_n(NULL, 0, &nerr);
+        assert(nerr == ISON_OK && a->block_count == 0);
+        ison_document_free(a);
+
+        free(ison_buf);
+        free(isonl_buf);
+        free(json_buf);
+    }
+    printf("PASS\n");
+    
+    // Test: Lazy Cell Materialization
+    printf("Test: Lazy Cell Materialization... ");
+    fflush(stdout);
+    {
+        const char *lazy_src =
+            "table.items\n"
+            "id:int name price:float ok:bool owner:ref tag:string\n"
+            "1 Widget 9.5 true :user:7 007\n"
+            "2 \"Big Gadget\" 3 0 :OWNS:9 ~\n"
+            "---\n"
+            "count 2\n"
+            "\n"
+            "object.dup\n"
+            "a a\n"
+            "1 2\n";
+        ison_parse_ctx_t *ctx = ison_parse_ctx_create();
+        ison_parse_ctx_set_lazy(ctx, true);
+        ison_document_t *lazy = ison_parse_with(ctx, lazy_src, strlen(lazy_src), NULL);
+        ison_document_t *eager = ison_parse(lazy_src, NULL);
+        ison_block_t *items = ison_document_get(lazy, "items");
+
+        /* Nothing is decoded until it is read */
+        for (const ison_row_entry_t *e = items->rows[0]->head; e; e = e->next) {
+            assert(e->value.type == ISON_TYPE_UNKNOWN);
+        }
+        ison_value_t *price = ison_row_get_ptr(items->rows[0], "price");
+        assert(price->type == ISON_TYPE_FLOAT && price->data.float_val == 9.5);
+        assert(ison_row_get_ptr(items->rows[0], "price") == price);
+        assert(items->rows[0]->head->value.type == ISON_TYPE_UNKNOWN);
+
+        ison_value_t got;
+        assert(ison_row_get(items->rows[1], "name", &got) && got.type == ISON_TYPE_STRING);
+        assert(strcmp(got.data.string_val, "Big Gadget") == 0);
+        const ison_row_entry_t *e = items->rows[1]->head;
+        int64_t n;
+        double f;
+        bool flag;
+        ison_reference_t ref;
+        const char *tag;
+        assert(ison_value_as_int(&e->value, &n) && n == 2);
+        assert(ison_value_as_float(&e->next->next->value, &f) && f == 3.0);
+        assert(ison_value_as_bool(&e->next->next->next->value, &flag) && !flag);
+        assert(ison_value_as_ref(&e->next->next->next->next->value, &ref) && strcmp(ref.relationship, "OWNS") == 0);
+        assert(ison_value_is_null(&e->next->next->next->next->next->value));
+        assert(ison_value_as_string(ison_row_get_ptr(items->rows[0], "tag"), &tag) && strcmp(tag, "007") == 0);
+        assert(ison_document_get(lazy, "dup")->rows[0]->count == 1);
+
+        /* Serializers and copies decode whatever is still pending */
+        char *lazy_text = ison_dumps(lazy);
+        char *eager_text = ison_dumps(eager);
+        assert(strcmp(lazy_text, eager_text) == 0);
+        free(lazy_text);
+        free(eager_text);
+        ison_document_free(lazy);
+
+        lazy = ison_parse_with(ctx, lazy_src, strlen(lazy_src), NULL);
+        ison_value_t copied = ison_value_copy(&ison_document_get(lazy, "items")->rows[1]->head->next->value);
+        assert(copied.type == ISON_TYPE_STRING && strcmp(copied.data.string_val, "Big Gadget") == 0);
+        ison_value_free(&copied);
+        lazy_text = ison_dumps_isonl(lazy);
+        eager_text = ison_dumps_isonl(eager);
+        assert(strcmp(lazy_text, eager_text) == 0);
+        free(lazy_text);
+        free(eager_text);
+        ison_document_free(lazy);
+
+        lazy = ison_parse_with(ctx, lazy_src, strlen(lazy_src), NULL);
+        ison_document_materialize(lazy);
+        for (size_t r = 0; r < 2; r++) {
+            for (e = ison_document_get(lazy, "items")->rows[r]->head; e; e = e->next) {
+                assert(e->value.type != ISON_TYPE_UNKNOWN);
+            }
+        }
+        ison_document_free(lazy);
+        ison_document_free(eager);
+        ison_parse_ctx_free(ctx);
+    }
+    printf("PASS\n");
+    
+    // Test: JSON Summary With Nested Members
+    printf("Test: JSON Summary With Nested Members... ");
+    fflush(stdout);
+    {
+        const char *summary_json =
+            "{\"orders\": [{\"id\": 1, \"total\": 5}, {\"id\": 2, \"total\": 7}],"
+            " \"orders_summary\": {\"total\": 12, \"stats\": {\"max\": 7, \"min\": 5}, \"tags\": [\"a\", \"b\"]}}";
+        ison_error_t serr;
+        /* By default "orders_summary" is just another member */
+        ison_document_t *sdoc = ison_from_json(summary_json, &serr);
+        assert(serr == ISON_OK && ison_document_get(sdoc, "orders")->summary_row == NULL);
+        assert(ison_document_get(sdoc, "orders_summary")->row_count == 1);
+        ison_document_free(sdoc);
+
+        ison_json_options_t sopts = ison_default_json_options();
+        sopts.summaries = true;
+        sdoc = ison_from_json_with_options(summary_json, strlen(summary_json), &sopts, &serr);
+        assert(serr == ISON_OK && sdoc != NULL);
+        ison_block_t *orders = ison_document_get(sdoc, "orders");
+        assert(orders->row_count == 2 && orders->summary_row != NULL);
+        ison_reference_t sref;
+        assert(ison_value_as_ref(ison_row_get_ptr(orders->summary_row, "stats"), &sref));
+        assert(strcmp(sref.ns, "stats") == 0 && strcmp(sref.id, "1") == 0);
+        assert(ison_document_get(sdoc, "tags")->row_count == 2);
+        assert(ison_row_get_ptr(ison_document_get(sdoc, "tags")->rows[0], "parent") == NULL);
+
+        /* Through ISON text and back, the reference still names an existing row */
+        char *stext = ison_dumps(sdoc);
+        ison_document_t *back = ison_parse(stext, NULL);
+        orders = ison_document_get(back, "orders");
+        assert(orders->row_count == 2 && orders->summary_row != NULL);
+        assert(ison_value_as_ref(ison_row_get_ptr(orders->summary_row, "stats"), &sref));
+        ison_block_t *stats = ison_document_get(back, sref.ns);
+        assert(stats != NULL && stats->row_count == 1);
+        int64_t smax;
+        assert(ison_value_as_int(ison_row_get_ptr(stats->rows[0], "max"), &smax) && smax == 7);
+        free(stext);
+        ison_document_free(back);
+        ison_document_free(sdoc);
+    }
+    printf("PASS\n");
+    
+    // Test: Long JSON Numbers
+    printf("Test: Long JSON Numbers... ");
+    fflush(stdout);
+    {
+        ison_error_t lerr;
+        ison_document_t *ldoc = ison_from_json(
+            "{\"m\": [{\"pi\": 3.14159265358979323846264338327950288419716939937510582097494459230781640628620899,"
+            " \"big\": 123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890,"
+            " \"tiny\": 1.00000000000000000000000000000000000000000000000000000000000000000000000000000000000e-300}]}",
+            &lerr);
+        assert(lerr == ISON_OK && ldoc != NULL);
+        const ison_row_t *lrow = ison_document_get(ldoc, "m")->rows[0];
+        double lval;
+        assert(ison_value_as_float(ison_row_get_ptr(lrow, "pi"), &lval) && lval > 3.1415926 && lval < 3.1415927);
+        assert(ison_value_as_float(ison_row_get_ptr(lrow, "big"), &lval) && lval > 1.2345e89 && lval < 1.2346e89);
+        assert(ison_value_as_float(ison_row_get_ptr(lrow, "tiny"), &lval) && lval > 0.9e-300 && lval < 1.1e-300);
+        ison_document_free(ldoc);
+        assert(ison_from_json("{\"m\": [{\"x\": 1.000000000000000000000000000000000000000000000000000000000000000000e}]}",
+                              &lerr) == NULL && lerr == ISON_ERROR_PARSE);
+    }
+    printf("PASS\n");
+    
+    // Test: ISONL to ISON With Many Blocks
+    printf("Test: ISONL to ISON With Many Blocks... ");
+    fflush(stdout);
+    {
+        /* 3000 interleaved blocks and more rows than the spill budget holds in memory */
+        ison_writer_t mw;
+        ison_writer_init_memory(&mw, 1 << 20);
+        for (int i = 0; i < 60000; i++) {
+            static const char pad[] = " padded out so the rows outgrow the in-memory spill budget";
+            char line[256];
+            int b = (i * 7) % 3000;
+            if (i < 30000) {
+                snprintf(line, sizeof(line), "table.b%d|id:int msg|%d \"row %d of a long message body here%s\"\n",
+                         b, i, i, pad);
+            } else {
+                /* The second half adds a column every block's earlier rows lack */
+                snprintf(line, sizeof(line), "table.b%d|id:int msg extra:int|%d \"row %d late%s\" %d\n", b, i, i, pad, i);
+            }
+            ison_writer_puts(&mw, line);
+        }
+        size_t many_len;
+        char *many_log = ison_writer_finish(&mw, &many_len);
+
+        ison_reader_t mr;
+        ison_reader_init_memory(&mr, many_log, many_len);
+        ison_writer_init_memory(&mw, 1 << 20);
+        assert(isonl_to_ison_stream(&mr, &mw) == ISON_OK);
+        ison_reader_free(&mr);
+        char *many_text = ison_writer_finish(&mw, NULL);
+
+        /* Every row line has all three cells; early rows carry an explicit null */
+        assert(strstr(many_text, "\n0 \"row 0 of a long message body here padded out so the rows outgrow the in-memory spill budget\" ~\n") != NULL);
+        ison_document_t *many_doc = ison_parse(many_text, NULL);
+        assert(many_doc->block_count == 3000);
+        size_t many_rows = 0;
+        for (size_t i = 0; i < many_doc->block_count; i++) {
+            ison_block_t *mb = many_doc->blocks[i];
+            assert(mb->field_count == 3);
+            many_rows += mb->row_count;
+            for (size_t r = 0; r < mb->row_count; r++) {
+                const ison_value_t *extra = ison_row_get_ptr(mb->rows[r], "extra");
+                int64_t mid;
+                assert(extra != NULL);
+                assert(ison_value_as_int(ison_row_get_ptr(mb->rows[r], "id"), &mid));
+                assert(mid < 30000 ? ison_value_is_null(extra) : ison_value_as_int(extra, NULL));
+            }
+        }
+        assert(many_rows == 60000);
+        ison_document_free(many_doc);
+        free(many_text);
+        free(many_log);
+    }
+    printf("PASS\n");
+    
+    // Test: Lazy Rows Copied Out Of Their Document
+    printf("Test: Lazy Rows Copied Out Of Their Document... ");
+    fflush(stdout);
+    {
+        /* Enough rows that the entries span several arena chunks */
+        ison_writer_t lw;
+        ison_writer_init_memory(&lw, 1024);
+        ison_writer_puts(&lw, "table.events\nid:int label\n");
+        for (int i = 0; i < 5000; i++) {
+            char line[64];
+            snprintf(line, sizeof(line), "%d \"event %d\"\n", i, i);
+            ison_writer_puts(&lw, line);
+        }
+        char *events_text = ison_writer_finish(&lw, NULL);
+
+        ison_parse_ctx_t *ctx = ison_parse_ctx_create();
+        ison_parse_ctx_set_lazy(ctx, true);
+        ison_block_t *kept = ison_block_create("table", "kept");
+        for (int pass = 0; pass < 2; pass++) {
+            ison_document_t *lazy = ison_parse_with(ctx, events_text, strlen(events_text), NULL);
+            ison_block_t *events = ison_document_get(lazy, "events");
+            assert(events->row_count == 5000);
+            ison_block_add_row(kept, events->rows[4999 * pass]);
+            ison_document_free(lazy);
+        }
+        ison_parse_ctx_free(ctx);
+
+        int64_t id;
+        const char *label;
+        assert(kept->row_count == 2);
+        assert(ison_value_as_int(ison_row_get_ptr(kept->rows[0], "id"), &id) && id == 0);
+        assert(ison_value_as_int(ison_row_get_ptr(kept->rows[1], "id"), &id) && id == 4999);
+        assert(ison_value_as_string(ison_row_get_ptr(kept->rows[1], "label"), &label));
+        assert(strcmp(label, "event 4999") == 0);
+        ison_block_free(kept);
+        free(events_text);
+    }
+    printf("PASS\n");
+    
+    // Test: CSV Column Batches And Quoted Cells
+    printf("Test: CSV Column Batches And Quoted Cells... ");
+    fflush(stdout);
+    {
+        /* 600 records cross several decode batches; every 100th spans two lines */
+        ison_writer_t cw;
+        ison_writer_init_memory(&cw, 1024);
+        ison_writer_puts(&cw, "code,qty,price,ok,note\r\nint,int,float,bool,\r\n");
+        for (int i = 0; i < 600; i++) {
+            char line[96];
+            if (i % 100 == 0) {
+                snprintf(line, sizeof(line), "\"%03d\",%d,-%d.5,true,\"two\nlines\"\r\n", i, i, i);
+            } else {
+                snprintf(line, sizeof(line), "%d,\"%d\",%d,0,\"%03d\"\r\n", i, i, i, i);
+            }
+            ison_writer_puts(&cw, line);
+        }
+        size_t batch_len;
+        char *batch_csv = ison_writer_finish(&cw, &batch_len);
+        ison_csv_options_t bopts = ison_default_csv_options();
+        bopts.type_row = true;
+        ison_reader_t bin;
+        ison_reader_init_memory(&bin, batch_csv, batch_len);
+        ison_error_t berr;
+        ison_block_t *batch = ison_block_from_csv(&bin, "batch", &bopts, &berr);
+        assert(batch != NULL && berr == ISON_OK && batch->row_count == 600);
+
+        int64_t bn;
+        double bf;
+        bool bb;
+        const char *bs;
+        for (int i = 0; i < 600; i++) {
+            ison_row_t *row = batch->rows[i];
+            /* Quoted cells decode under an explicit hint... */
+            assert(ison_value_as_int(ison_row_get_ptr(row, "code"), &bn) && bn == i);
+            assert(ison_value_as_int(ison_row_get_ptr(row, "qty"), &bn) && bn == i);
+            if (i % 100 == 0) {
+                assert(ison_value_as_float(ison_row_get_ptr(row, "price"), &bf) && bf == -i - 0.5);
+                assert(ison_value_as_bool(ison_row_get_ptr(row, "ok"), &bb) && bb);
+                assert(ison_value_as_string(ison_row_get_ptr(row, "note"), &bs) && strcmp(bs, "two\nlines") == 0);
+            } else {
+                assert(ison_value_as_float(ison_row_get_ptr(row, "price"), &bf) && bf == i);
+                assert(ison_value_as_bool(ison_row_get_ptr(row, "ok"), &bb) && !bb);
+                /* ...and stay strings without one */
+                char want[8];
+                snprintf(want, sizeof(want), "%03d", i);
+                assert(ison_value_as_string(ison_row_get_ptr(row, "note"), &bs) && strcmp(bs, want) == 0);
+            }
+        }
+
+        /* Untyped strings that look like other values are quoted on the way out */
+        ison_writer_init_memory(&cw, 1024);
+        assert(ison_block_to_csv(batch, &cw, NULL) == ISON_OK);
+        char *again = ison_writer_finish(&cw, &batch_len);
+        assert(strstr(again, "\r\n1,1,1.0,false,\"001\"\r\n") != NULL);
+        ison_reader_init_memory(&bin, again, batch_len);
+        ison_block_t *reread = ison_block_from_csv(&bin, "batch", NULL, &berr);
+        assert(reread != NULL && reread->row_count == 600);
+        assert(ison_value_as_string(ison_row_get_ptr(reread->rows[7], "note"), &bs) && strcmp(bs, "007") == 0);
+        ison_block_free(reread);
+        free(again);
+        ison_block_free(batch);
+
+        /* Headerless columns that appear after the first batch */
+        ison_writer_init_memory(&cw, 1024);
+        for (int i = 0; i < 300; i++) ison_writer_puts(&cw, i < 299 ? "1,2\n" : "1,2,3\n");
+        char *wide = ison_writer_finish(&cw, &batch_len);
+        bopts = ison_default_csv_options();
+        bopts.header = false;
+        ison_reader_init_memory(&bin, wide, batch_len);
+        batch = ison_block_from_csv(&bin, "wide", &bopts, &berr);
+        assert(batch != NULL && batch->field_count == 3 && batch->row_count == 300);
+        assert(batch->rows[0]->count == 2);
+        assert(ison_value_as_int(ison_row_get_ptr(batch->rows[299], "c3"), &bn) && bn == 3);
+        ison_block_free(batch);
+
+        /* Untyped cells decode like ISON tokens; a repeated header name keeps its last cell */
+        const char *loose = "a,b,c,a\n-0,+5,1234567890123456789,x\nuser_1, 7,nan,true\n";
+        ison_reader_init_memory(&bin, loose, strlen(loose));
+        batch = ison_block_from_csv(&bin, "loose", NULL, &berr);
+        assert(batch != NULL && batch->row_count == 2 && batch->rows[0]->count == 3);
+        assert(ison_value_as_string(ison_row_get_ptr(batch->rows[0], "a"), &bs) && strcmp(bs, "x") == 0);
+        assert(ison_value_as_int(ison_row_get_ptr(batch->rows[0], "b"), &bn) && bn == 5);
+        assert(ison_value_as_int(ison_row_get_ptr(batch->rows[0], "c"), &bn) && bn == 1234567890123456789LL);
+        assert(ison_value_as_bool(ison_row_get_ptr(batch->rows[1], "a"), &bb) && bb);
+        assert(ison_value_as_int(ison_row_get_ptr(batch->rows[1], "b"), &bn) && bn == 7);
+        assert(ison_value_as_float(ison_row_get_ptr(batch->rows[1], "c"), &bf) && bf != bf);
+        ison_block_free(batch);
+
+        /* A malformed record after a full batch still fails the whole block */
+        memcpy(wide + batch_len - 6, "1,2,\"\n", 6);
+        ison_reader_init_memory(&bin, wide, batch_len);
+        assert(ison_block_from_csv(&bin, "wide", &bopts, &berr) == NULL && berr == ISON_ERROR_PARSE);
+        free(wide);
+        free(batch_csv);
+    }
+    printf("PASS\n");
+    
+    // Test: JSON Nesting Limit
+    printf("Test: JSON Nesting Limit... ");
+    fflush(stdout);
+    {
+        /* {"t":[{"a":{"a":...1...}}]} and {"t":[[[...]]]} at a given depth */
+        size_t depths[] = {1000, 100000};
+        for (size_t d = 0; d < 2; d++) {
+            for (int arrays = 0; arrays < 2; arrays++) {
+                size_t levels = depths[d];
+                char *deep = malloc(levels * 6 + 16);
+                size_t n = 0;
+                n += (size_t)sprintf(deep + n, "{\"t\":[");
+                for (size_t i = 0; i < levels; i++) n += (size_t)sprintf(deep + n, arrays ? "[" : "{\"a\":");
+                deep[n++] = '1';
+                for (size_t i = 0; i < levels; i++) deep[n++] = arrays ? ']' : '}';
+                n += (size_t)sprintf(deep + n, "]}");
+                ison_error_t jerr;
+                ison_document_t *jdoc = ison_from_json_n(deep, n, &jerr);
+                if (levels < 1024) {
+                    assert(jdoc != NULL && jerr == ISON_OK);
+                } else {
+                    assert(jdoc == NULL && jerr == ISON_ERROR_PARSE);
+                }
+                ison_document_free(jdoc);
+                free(deep);
+            }
+        }
+    }
+    printf("PASS\n");
+    
     printf("\nAll advanced tests passed!\n");
     return 0;
 }
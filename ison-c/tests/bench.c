@@ -0,0 +1,545 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "ison.h"
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t ops, size_t bytes, double seconds) {
+    printf("%-32s %10.1f ns/op", name, seconds * 1e9 / (double)ops);
+    if (bytes) printf(" %10.1f MB/s", (double)bytes / seconds / 1e6);
+    printf("\n");
+}
+
+static void bench_numbers(void) {
+    enum { N = 2000000 };
+    double *doubles = malloc(N * sizeof(double));
+    int64_t *ints = malloc(N * sizeof(int64_t));
+    for (size_t i = 0; i < N; i++) {
+        doubles[i] = (double)(next_random() >> 11) / 9007199254740992.0 * 1e6;
+        ints[i] = (int64_t)next_random() >> (next_random() % 60);
+    }
+    
+    char buf[64];
+    size_t bytes = 0;
+    double t = now_seconds();
+    for (size_t i = 0; i < N; i++) bytes += ison_format_double(doubles[i], buf);
+    report("format double (grisu2)", N, bytes, now_seconds() - t);
+    
+    bytes = 0;
+    t = now_seconds();
+    for (size_t i = 0; i < N; i++) bytes += (size_t)snprintf(buf, sizeof(buf), "%.17g", doubles[i]);
+    report("format double (%.17g)", N, bytes, now_seconds() - t);
+    
+    bytes = 0;
+    t = now_seconds();
+    for (size_t i = 0; i < N; i++) bytes += ison_format_int(ints[i], buf);
+    report("format int64 (table)", N, bytes, now_seconds() - t);
+    
+    bytes = 0;
+    t = now_seconds();
+    for (size_t i = 0; i < N; i++) bytes += (size_t)snprintf(buf, sizeof(buf), "%ld", (long)ints[i]);
+    report("format int64 (%ld)", N, bytes, now_seconds() - t);
+    
+    free(doubles);
+    free(ints);
+}
+
+static ison_document_t *make_table(size_t rows) {
+    ison_document_t *doc = ison_document_create();
+    ison_block_t *block = ison_block_create("table", "events");
+    ison_block_add_field(block, "id", "int");
+    ison_block_add_field(block, "user", "string");
+    ison_block_add_field(block, "score", "float");
+    ison_block_add_field(block, "active", "bool");
+    ison_block_add_field(block, "note", "string");
+    
+    static const char *notes[] = {"ok", "needs review", "said \"hello\"", "multi\nline"};
+    char name[32];
+    for (size_t i = 0; i < rows; i++) {
+        ison_row_t *row = ison_row_create();
+        ison_value_t v = ison_int((int64_t)i);
+        ison_row_set(row, "id", &v);
+        snprintf(name, sizeof(name), "user_%zu", i % 1000);
+        v = ison_string(name);
+        ison_row_set(row, "user", &v);
+        v = ison_float((double)(next_random() % 100000) / 7.0);
+        ison_row_set(row, "score", &v);
+        v = ison_bool(i % 3 == 0);
+        ison_row_set(row, "active", &v);
+        v = ison_string(notes[i % 4]);
+        ison_row_set(row, "note", &v);
+        ison_block_add_row(block, row);
+        ison_row_free(row);
+    }
+    ison_document_add_block(doc, block);
+    return doc;
+}
+
+static void bench_dumps(void) {
+    enum { ROWS = 200000 };
+    ison_document_t *doc = make_table(ROWS);
+    
+    double t = now_seconds();
+    char *out = ison_dumps(doc);
+    report("ison_dumps", ROWS, strlen(out), now_seconds() - t);
+    free(out);
+    
+    ison_dumps_options_t opts = ison_default_dumps_options();
+    opts.align_columns = true;
+    t = now_seconds();
+    out = ison_dumps_with_options(doc, &opts);
+    report("ison_dumps (align_columns)", ROWS, strlen(out), now_seconds() - t);
+    free(out);
+    
+    t = now_seconds();
+    out = ison_dumps_exact(doc);
+    report("ison_dumps_exact", ROWS, strlen(out), now_seconds() - t);
+    free(out);
+    
+    t = now_seconds();
+    out = ison_dumps_isonl(doc);
+    report("ison_dumps_isonl", ROWS, strlen(out), now_seconds() - t);
+    free(out);
+    
+    t = now_seconds();
+    out = ison_dumps_parallel(doc, NULL, 0);
+    report("ison_dumps_parallel (all cpus)", ROWS, strlen(out), now_seconds() - t);
+    free(out);
+    
+    ison_document_free(doc);
+}
+
+static void bench_strings(void) {
+    enum { N = 20000, LEN = 400 };
+    ison_value_t *values = malloc(N * sizeof(ison_value_t));
+    char text[LEN + 1];
+    size_t input = 0;
+    for (size_t i = 0; i < N; i++) {
+        for (size_t c = 0; c < LEN; c++) {
+            uint64_t r = next_random();
+            text[c] = r % 97 == 0 ? "\"\n\\"[r % 3] : (r % 7 == 0 ? ' ' : (char)('a' + r % 26));
+        }
+        text[LEN] = '\0';
+        values[i] = ison_string(text);
+        input += LEN;
+    }
+    
+    ison_writer_t w;
+    for (int json = 0; json < 2; json++) {
+        ison_writer_init_memory(&w, input * 2);
+        double t = now_seconds();
+        for (int rep = 0; rep < 10; rep++) {
+            w.len = 0;
+            for (size_t i = 0; i < N; i++) {
+                if (json) ison_value_append_json(&w, &values[i]);
+                else ison_value_append(&w, &values[i]);
+            }
+        }
+        report(json ? "escape text (json)" : "escape text (ison)", N * 10, input * 10, now_seconds() - t);
+        ison_writer_free(&w);
+    }
+    
+    for (size_t i = 0; i < N; i++) ison_value_free(&values[i]);
+    free(values);
+}
+
+/*
+ * Parse and free are timed apart so the numbers compare with the pre-index
+ * parser, which could only be timed without free (it double-freed nested
+ * rows): about 0.045 GB/s on this 18 MB input. The ns/op of "parse text"
+ * below, which reads the same table as ISON, is the row-model floor.
+ */
+static void bench_json(void) {
+    ison_document_t *doc = make_table(200000);
+    ison_writer_t w;
+    ison_writer_init_memory(&w, 1 << 20);
+    ison_dump_json_writer(doc, &w);
+    size_t len;
+    char *json = ison_writer_finish(&w, &len);
+    ison_document_free(doc);
+    
+    enum { ROUNDS = 5 };
+    double parse = 0, release = 0;
+    for (int i = 0; i < ROUNDS; i++) {
+        ison_error_t err;
+        double t = now_seconds();
+        doc = ison_from_json(json, &err);
+        parse += now_seconds() - t;
+        t = now_seconds();
+        ison_document_free(doc);
+        release += now_seconds() - t;
+    }
+    report("from_json (200k rows)", ROUNDS, len * ROUNDS, parse + release);
+    printf("%-32s %10.3f GB/s\n", "from_json parse only", (double)(len * ROUNDS) / parse / 1e9);
+    free(json);
+}
+
+static void bench_binary(void) {
+    ison_document_t *doc = make_table(200000);
+    char *text = ison_dumps(doc);
+    ison_writer_t w;
+    ison_writer_init_memory(&w, 1 << 20);
+    ison_dump_binary_writer(doc, &w, NULL);
+    size_t len;
+    char *image = ison_writer_finish(&w, &len);
+    ison_document_free(doc);
+    
+    enum { ROUNDS = 5 };
+    double t = now_seconds();
+    for (int i = 0; i < ROUNDS; i++) {
+        ison_error_t err;
+        doc = ison_parse(text, &err);
+        ison_document_free(doc);
+    }
+    report("parse text (200k rows)", ROUNDS, strlen(text) * ROUNDS, now_seconds() - t);
+    
+    t = now_seconds();
+    for (int i = 0; i < ROUNDS; i++) {
+        ison_error_t err;
+        ison_binary_t *bin = ison_binary_from_memory(image, len, &err);
+        doc = ison_binary_to_document(bin, &err);
+        ison_binary_close(bin);
+        ison_document_free(doc);
+    }
+    report("load binary (200k rows)", ROUNDS, len * ROUNDS, now_seconds() - t);
+    
+    enum { OPENS = 100000 };
+    int64_t sum = 0;
+    t = now_seconds();
+    for (int i = 0; i < OPENS; i++) {
+        ison_error_t err;
+        ison_binary_t *bin = ison_binary_from_memory(image, len, &err);
+        ison_value_t v;
+        if (ison_binary_get(bin, ison_binary_block(bin, 0), (size_t)i % 200000, 0, &v)) sum += v.data.int_val;
+        ison_binary_close(bin);
+    }
+    report("open binary + one cell", OPENS, 0, now_seconds() - t);
+    free(image);
+    
+    ison_binary_options_t opts = ison_default_binary_options();
+    opts.compress = true;
+    doc = ison_parse(text, NULL);
+    ison_writer_init_memory(&w, 1 << 20);
+    t = now_seconds();
+    ison_dump_binary_writer(doc, &w, &opts);
+    report("dump binary compressed", 1, len, now_seconds() - t);
+    ison_document_free(doc);
+    size_t packed_len;
+    image = ison_writer_finish(&w, &packed_len);
+    printf("%-32s %10.1f%% of raw\n", "compressed size", 100.0 * (double)packed_len / (double)len);
+    
+    t = now_seconds();
+    for (int i = 0; i < ROUNDS; i++) {
+        ison_error_t err;
+        ison_binary_t *bin = ison_binary_from_memory(image, packed_len, &err);
+        doc = ison_binary_to_document(bin, &err);
+        ison_binary_close(bin);
+        ison_document_free(doc);
+    }
+    report("load binary compressed", ROUNDS, len * ROUNDS, now_seconds() - t);
+    free(image);
+    free(text);
+}
+
+static void bench_csv(void) {
+    ison_document_t *doc = make_table(200000);
+    ison_block_t *block = doc->blocks[0];
+    ison_writer_t w;
+    enum { ROUNDS = 5 };
+    
+    size_t len = 0;
+    double t = now_seconds();
+    for (int i = 0; i < ROUNDS; i++) {
+        ison_writer_init_memory(&w, 1 << 20);
+        ison_block_to_csv(block, &w, NULL);
+        len = w.len;
+        ison_writer_free(&w);
+    }
+    double seconds = now_seconds() - t;
+    report("to_csv (200k rows)", ROUNDS, len * ROUNDS, seconds);
+    
+    ison_writer_init_memory(&w, 1 << 20);
+    ison_block_to_csv(block, &w, NULL);
+    char *csv = ison_writer_finish(&w, &len);
+    ison_document_free(doc);
+    
+    t = now_seconds();
+    for (int i = 0; i < ROUNDS; i++) {
+        ison_reader_t r;
+        ison_error_t err;
+        ison_reader_init_memory(&r, csv, len);
+        block = ison_block_from_csv(&r, "bench", NULL, &err);
+        ison_block_free(block);
+    }
+    report("from_csv (200k rows)", ROUNDS, len * ROUNDS, now_seconds() - t);
+    free(csv);
+    
+    /* With a type row every column decodes under its hint */
+    doc = make_table(200000);
+    ison_csv_options_t typed = ison_default_csv_options();
+    typed.type_row = true;
+    ison_writer_init_memory(&w, 1 << 20);
+    ison_block_to_csv(doc->blocks[0], &w, &typed);
+    csv = ison_writer_finish(&w, &len);
+    ison_document_free(doc);
+    
+    t = now_seconds();
+    for (int i = 0; i < ROUNDS; i++) {
+        ison_reader_t r;
+        ison_error_t err;
+        ison_reader_init_memory(&r, csv, len);
+        block = ison_block_from_csv(&r, "bench", &typed, &err);
+        ison_block_free(block);
+    }
+    report("from_csv typed (200k rows)", ROUNDS, len * ROUNDS, now_seconds() - t);
+    free(csv);
+}
+
+static void bench_appender(void) {
+    const char *path = "bin/bench_appender.isonl";
+    char *fields[] = {"id:int", "name", "score:float"};
+    enum { N = 500000 };
+    
+    for (int sync = 0; sync <= 1; sync++) {
+        remove(path);
+        isonl_appender_options_t opts = isonl_default_appender_options();
+        opts.sync = sync;
+        ison_error_t err;
+        isonl_appender_t *app = isonl_appender_open(path, &opts, &err);
+        if (!app) return;
+        double t = now_seconds();
+        for (int64_t i = 0; i < N; i++) {
+            ison_value_t values[3] = {ison_int(i), ison_null(), ison_float((double)i / 8)};
+            isonl_record_t rec = {"table", "events", fields, 3, values};
+            isonl_append(app, &rec);
+        }
+        isonl_appender_close(app);
+        report(sync ? "isonl_append (fdatasync)" : "isonl_append", N, 0, now_seconds() - t);
+    }
+    remove(path);
+}
+
+static void bench_index(void) {
+    const char *path = "bin/bench_index.isonl";
+    const char *idx = "bin/bench_index.isonl.idx";
+    enum { ROWS = 1000000, PAGES = 1000 };
+    ison_writer_t w;
+    ison_writer_init_memory(&w, 1 << 20);
+    for (int r = 0; r < ROWS; r++) {
+        char line[96];
+        snprintf(line, sizeof(line), "table.events|id:int kind score:float|%d click %d.5\n", r, r % 1000);
+        ison_writer_puts(&w, line);
+    }
+    char *text = ison_writer_finish(&w, NULL);
+    ison_write_file(path, text);
+    size_t len = strlen(text);
+    free(text);
+    
+    double t = now_seconds();
+    isonl_build_index(path, idx, 0);
+    report("isonl_build_index (1M rows)", ROWS, len, now_seconds() - t);
+    
+    ison_error_t err;
+    isonl_index_t *ix = isonl_open_indexed(path, idx, &err);
+    t = now_seconds();
+    for (int i = 0; i < PAGES; i++) {
+        uint64_t start = (next_random() % (ROWS / 100)) * 100;
+        ison_document_free(isonl_read_range(ix, start, 100, &err));
+    }
+    report("isonl_read_range (100-row page)", PAGES, 0, now_seconds() - t);
+    isonl_index_close(ix);
+    remove(path);
+    remove(idx);
+}
+
+static void bench_sort(void) {
+    const char *in = "bin/bench_sort.isonl";
+    const char *out = "bin/bench_sorted.isonl";
+    enum { ROWS = 1000000 };
+    ison_writer_t w;
+    ison_writer_init_memory(&w, 1 << 20);
+    for (int r = 0; r < ROWS; r++) {
+        char line[96];
+        snprintf(line, sizeof(line), "table.events|id:int user kind|%d u%u click\n", r,
+                 (unsigned)(next_random() % 100000));
+        ison_writer_puts(&w, line);
+    }
+    char *text = ison_writer_finish(&w, NULL);
+    ison_write_file(in, text);
+    size_t len = strlen(text);
+    free(text);
+    
+    const char *keys[] = {"user", "id"};
+    double t = now_seconds();
+    isonl_sort_file(in, out, "events", keys, 2, 0);
+    report("isonl_sort_file (in memory)", ROWS, len, now_seconds() - t);
+    t = now_seconds();
+    isonl_sort_file(in, out, "events", keys, 2, 4 << 20);
+    report("isonl_sort_file (4 MiB budget)", ROWS, len, now_seconds() - t);
+    remove(in);
+    remove(out);
+}
+
+static void bench_load_many(void) {
+    enum { FILES = 2000 };
+    static char names[FILES][48];
+    static const char *paths[FILES];
+    static ison_document_t *docs[FILES];
+    for (int i = 0; i < FILES; i++) {
+        snprintf(names[i], sizeof(names[i]), "bin/bench_tenant_%d.ison", i);
+        paths[i] = names[i];
+        char text[256];
+        snprintf(text, sizeof(text), "object.config\ntenant plan:string quota:int enabled\n%d pro %d true\n\n"
+                 "table.limits\nname value:int\nrps %d\nburst %d\n", i, i * 10, i % 100, i % 7);
+        ison_write_file(paths[i], text);
+    }
+    
+    double t = now_seconds();
+    for (int i = 0; i < FILES; i++) {
+        ison_error_t err;
+        ison_document_free(ison_load(paths[i], &err));
+    }
+    report("ison_load x2000 (one by one)", FILES, 0, now_seconds() - t);
+    
+    t = now_seconds();
+    ison_load_many(paths, FILES, 0, docs, NULL, NULL);
+    report("ison_load_many x2000 (all cpus)", FILES, 0, now_seconds() - t);
+    for (int i = 0; i < FILES; i++) {
+        ison_document_free(docs[i]);
+        remove(paths[i]);
+    }
+}
+
+typedef struct {
+    const char *path;
+    int seen;
+    int stop;
+} follow_bench_t;
+
+static void count_followed(const isonl_record_t *record, void *userdata) {
+    (void)record;
+    follow_bench_t *fb = userdata;
+    __atomic_add_fetch(&fb->seen, 1, __ATOMIC_RELEASE);
+}
+
+static void *follow_main(void *arg) {
+    follow_bench_t *fb = arg;
+    isonl_follow_options_t opts = isonl_default_follow_options();
+    opts.stop = &fb->stop;
+    isonl_follow(fb->path, count_followed, fb, &opts);
+    return NULL;
+}
+
+static void bench_follow(void) {
+    follow_bench_t fb = {"bin/bench_follow.isonl", 0, 0};
+    remove(fb.path);
+    ison_error_t err;
+    isonl_appender_options_t opts = isonl_default_appender_options();
+    opts.flush_interval_ms = 0;
+    isonl_appender_t *app = isonl_appender_open(fb.path, &opts, &err);
+    if (!app) return;
+    pthread_t follower;
+    pthread_create(&follower, NULL, follow_main, &fb);
+    char *fields[] = {"id:int"};
+    enum { N = 2000 };
+    
+    /* Round trip: append and flush one record, wait until the follower has decoded it */
+    double t = now_seconds();
+    for (int64_t i = 0; i < N; i++) {
+        ison_value_t value = ison_int(i);
+        isonl_record_t rec = {"table", "events", fields, 1, &value};
+        isonl_append(app, &rec);
+        isonl_appender_flush(app);
+        while (__atomic_load_n(&fb.seen, __ATOMIC_ACQUIRE) <= i) sched_yield();
+    }
+    report("isonl_follow latency", N, 0, now_seconds() - t);
+    __atomic_store_n(&fb.stop, 1, __ATOMIC_RELEASE);
+    isonl_appender_close(app);
+    pthread_join(follower, NULL);
+    remove(fb.path);
+}
+
+static void bench_parse_ctx(void) {
+    enum { N = 500000 };
+    const char *payload = "object.request\nmethod id:int user:ref\nget_user 42 :user:7\n";
+    size_t len = strlen(payload);
+    
+    double t = now_seconds();
+    for (int i = 0; i < N; i++) ison_document_free(ison_parse(payload, NULL));
+    report("ison_parse (tiny)", N, (size_t)N * len, now_seconds() - t);
+    
+    ison_parse_ctx_t *ctx = ison_parse_ctx_create();
+    t = now_seconds();
+    for (int i = 0; i < N; i++) ison_document_free(ison_parse_with(ctx, payload, len, NULL));
+    report("ison_parse_with (tiny)", N, (size_t)N * len, now_seconds() - t);
+    ison_parse_ctx_free(ctx);
+}
+
+static void bench_lazy_parse(void) {
+    ison_document_t *doc = make_table(200000);
+    char *text = ison_dumps(doc);
+    size_t len = strlen(text);
+    ison_document_free(doc);
+    ison_parse_ctx_t *ctx = ison_parse_ctx_create();
+    
+    enum { ROUNDS = 5 };
+    double t = now_seconds();
+    for (int i = 0; i < ROUNDS; i++) ison_document_free(ison_parse_with(ctx, text, len, NULL));
+    report("parse eager (200k rows)", ROUNDS, len * ROUNDS, now_seconds() - t);
+    
+    ison_parse_ctx_set_lazy(ctx, true);
+    t = now_seconds();
+    for (int i = 0; i < ROUNDS; i++) ison_document_free(ison_parse_with(ctx, text, len, NULL));
+    report("parse lazy (200k rows)", ROUNDS, len * ROUNDS, now_seconds() - t);
+    
+    /* One column of five read back */
+    t = now_seconds();
+    for (int i = 0; i < ROUNDS; i++) {
+        doc = ison_parse_with(ctx, text, len, NULL);
+        ison_block_t *block = ison_document_get(doc, "events");
+        for (size_t r = 0; r < block->row_count; r++) {
+            int64_t id;
+            ison_value_as_int(ison_row_get_ptr(block->rows[r], "id"), &id);
+        }
+        ison_document_free(doc);
+    }
+    report("parse lazy + read 1/5 cells", ROUNDS, len * ROUNDS, now_seconds() - t);
+    ison_parse_ctx_free(ctx);
+    free(text);
+}
+
+int main(void) {
+    bench_numbers();
+    bench_strings();
+    bench_dumps();
+    bench_json();
+    bench_binary();
+    bench_csv();
+    bench_appender();
+    bench_follow();
+    bench_index();
+    bench_sort();
+    bench_load_many();
+    bench_parse_ctx();
+    bench_lazy_parse();
+    return 0;
+}